@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Micro-benchmark of the AudioBuffer sample kernels.
+ *
+ * Runs every kernel implementation supported by the CPU on 20 ms frames
+ * at 8, 16 and 48 kHz, mono and stereo, and prints the time per frame
+ * and the speedup against the scalar reference.
+ */
+
+#include "media/audio/audio_kernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace ring;
+
+static constexpr unsigned FRAME_MS = 20;
+
+// volatile sink so the compiler can't drop the work
+static volatile int sink;
+
+struct Data {
+    Data(size_t frames, unsigned channels)
+        : n(frames * channels)
+        , frames(frames)
+        , a(n), b(n), il(2 * frames), left(frames), right(frames)
+        , f(2 * n)
+    {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> d(-32768, 32767);
+        for (auto& s : a) s = d(rng);
+        for (auto& s : b) s = d(rng);
+        for (auto& s : left) s = d(rng);
+        for (auto& s : right) s = d(rng);
+        for (auto& s : il) s = d(rng);
+        for (auto& s : f) s = d(rng) / 30000.f;
+    }
+
+    size_t n; // samples over all channels
+    size_t frames;
+    std::vector<AudioSample> a, b, il, left, right;
+    std::vector<float> f;
+};
+
+static double
+nsPerFrame(const std::function<void()>& op, unsigned iterations)
+{
+    // warm-up
+    for (unsigned i = 0; i < iterations / 10 + 1; ++i)
+        op();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        op();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+static void
+run(const char* name, unsigned rate, unsigned channels, unsigned iterations,
+    const std::function<std::function<void()>(const AudioKernels&, Data&)>& makeOp)
+{
+    const auto kernels = getSupportedAudioKernels();
+    const size_t frames = rate * FRAME_MS / 1000;
+    double scalar = 0;
+
+    std::printf("%-16s %5u Hz %u ch", name, rate, channels);
+    for (const auto k : kernels) {
+        Data data(frames, channels);
+        const double ns = nsPerFrame(makeOp(*k, data), iterations);
+        sink = data.a[0];
+        if (k == kernels.front())
+            scalar = ns;
+        std::printf("  %s %8.1f ns (x%.1f)", k->name, ns, scalar / ns);
+    }
+    std::printf("\n");
+}
+
+int
+main(int argc, char** argv)
+{
+    const unsigned iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    std::printf("Best kernels for this CPU: %s\n", getAudioKernels().name);
+    std::printf("Time per %u ms frame, %u iterations\n\n", FRAME_MS, iterations);
+
+    for (const unsigned channels : {1u, 2u}) {
+        for (const unsigned rate : {8000u, 16000u, 48000u}) {
+            run("mix", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                return [&k, &d] { k.mix(d.a.data(), d.b.data(), d.n); };
+            });
+            run("gain", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                return [&k, &d] { k.gain(d.a.data(), d.n, 29491); };
+            });
+            run("s16 to float", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                return [&k, &d] { k.toFloat(d.f.data(), d.a.data(), d.n); };
+            });
+            run("float to s16", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                return [&k, &d] { k.fromFloat(d.a.data(), d.f.data(), d.n); };
+            });
+            if (channels == 2) {
+                run("interleave", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                    return [&k, &d] { k.interleave2(d.il.data(), d.left.data(), d.right.data(), d.frames); };
+                });
+                run("interleave float", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                    return [&k, &d] { k.interleave2Float(d.f.data(), d.left.data(), d.right.data(), d.frames); };
+                });
+                run("deinterleave", rate, channels, iterations, [](const AudioKernels& k, Data& d) {
+                    return [&k, &d] { k.deinterleave2(d.left.data(), d.right.data(), d.il.data(), d.frames); };
+                });
+            }
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Benchmark of HttpConnectionPool against a local mock server answering
+ * after a round-trip delay.
+ *
+ * Compares a connection per request (the server closes every connection),
+ * persistent connections sending one request at a time, and persistent
+ * connections pipelining up to 8 requests.
+ *
+ * usage: bench_http_pool [requests] [round trip in ms] [connections]
+ */
+
+#include "ringdht/http_connection_pool.h"
+#include "mock_http_server.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+
+using clock_type = std::chrono::steady_clock;
+using ring::HttpConnectionPool;
+
+struct Mode {
+    const char* name;
+    bool keepAlive;
+    unsigned pipeline;
+};
+
+int
+main(int argc, char* argv[])
+{
+    const unsigned requests = argc > 1 ? std::atoi(argv[1]) : 400;
+    const std::chrono::milliseconds rtt(argc > 2 ? std::atoi(argv[2]) : 5);
+    const unsigned connections = argc > 3 ? std::atoi(argv[3]) : HttpConnectionPool::DEFAULT_CONNECTIONS;
+
+    const auto handler = [](const std::string& path) {
+        return std::make_pair(200u, "{\"path\":\"" + path + "\"}");
+    };
+
+    std::printf("%u requests, round trip %u ms, %u connections\n",
+                requests, static_cast<unsigned>(rtt.count()), connections);
+    std::printf("%-12s %10s %10s %8s %10s %12s\n",
+                "mode", "total ms", "req/s", "errors", "opened", "accepted");
+
+    for (const auto& mode : {Mode {"close", false, 1},
+                             Mode {"keep-alive", true, 1},
+                             Mode {"pipeline", true, HttpConnectionPool::DEFAULT_PIPELINE}}) {
+        MockHttpServer server(handler, rtt, mode.keepAlive);
+        std::mutex mtx;
+        std::condition_variable cv;
+        unsigned left = requests;
+        unsigned errors = 0;
+        double ms;
+        unsigned opened;
+        {
+            HttpConnectionPool pool(server.host(), connections, mode.pipeline);
+            const auto start = clock_type::now();
+            for (unsigned i = 0; i < requests; ++i) {
+                const auto path = "/name/user" + std::to_string(i);
+                pool.get(path, [&, path](HttpConnectionPool::Response&& response) {
+                    std::lock_guard<std::mutex> lk(mtx);
+                    if (response.status != 200 or response.body.find(path) == std::string::npos)
+                        ++errors;
+                    if (--left == 0)
+                        cv.notify_all();
+                });
+            }
+            std::unique_lock<std::mutex> lk(mtx);
+            cv.wait(lk, [&] { return left == 0; });
+            ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+            opened = pool.connectionsOpened();
+        }
+        std::printf("%-12s %10.1f %10.0f %8u %10u %12u\n",
+                    mode.name, ms, requests * 1000. / ms, errors, opened, server.connections());
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Stress test of IceTransport event handling.
+ *
+ * Creates pairs of local ICE transports (host candidates only) and
+ * negotiates each pair against itself, all at once. Prints the number of
+ * threads and the resident memory used by the transports, and the
+ * negotiation latency.
+ *
+ * usage: bench_ice_transport [transports] [reactor threads, 0 for one per transport]
+ */
+
+#include "dring.h"
+#include "manager.h"
+#include "ice_transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ring;
+using clock_type = std::chrono::steady_clock;
+
+static constexpr unsigned INIT_TIMEOUT = 10; // seconds
+static constexpr unsigned NEGO_TIMEOUT = 30; // seconds
+
+// Read a field of /proc/self/status, 0 if not found
+static long
+procStatus(const std::string& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, field.size() + 1, field + ":") == 0)
+            return std::atol(line.c_str() + field.size() + 1);
+    return 0;
+}
+
+struct Pair {
+    std::shared_ptr<IceTransport> master;
+    std::shared_ptr<IceTransport> slave;
+    clock_type::time_point start;
+    std::atomic<long> latency_us {-1};
+};
+
+int
+main(int argc, char** argv)
+{
+    const unsigned transports = argc > 1 ? std::atoi(argv[1]) : 500;
+    const unsigned threads = argc > 2 ? std::atoi(argv[2]) : 2;
+
+    if (not DRing::init(DRing::InitFlag(0)) or not DRing::start("/tmp/bench_ice_transport.yml"))
+        return 1;
+
+    auto& factory = Manager::instance().getIceTransportFactory();
+    factory.setReactorThreads(threads);
+
+    const auto threads0 = procStatus("Threads");
+    const auto rss0 = procStatus("VmRSS");
+
+    std::vector<std::unique_ptr<Pair>> pairs;
+    for (unsigned i = 0; i < transports / 2; ++i) {
+        std::unique_ptr<Pair> pair(new Pair);
+        auto p = pair.get();
+        IceTransportOptions options;
+        options.onNegoDone = [p](IceTransport&, bool ok) {
+            if (ok and p->latency_us < 0)
+                p->latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    clock_type::now() - p->start).count();
+        };
+        pair->master = factory.createTransport("bench", 1, true, options);
+        pair->slave = factory.createTransport("bench", 1, false, options);
+        if (not pair->master or not pair->slave) {
+            std::fprintf(stderr, "transport creation failed after %u pairs\n", i);
+            break;
+        }
+        pairs.emplace_back(std::move(pair));
+    }
+
+    unsigned ready = 0;
+    for (const auto& pair : pairs)
+        if (pair->master->waitForInitialization(INIT_TIMEOUT) > 0
+            and pair->slave->waitForInitialization(INIT_TIMEOUT) > 0)
+            ++ready;
+
+    const auto threads1 = procStatus("Threads");
+    const auto rss1 = procStatus("VmRSS");
+
+    for (const auto& pair : pairs) {
+        if (not pair->master->isInitialized() or not pair->slave->isInitialized())
+            continue;
+        pair->start = clock_type::now();
+        pair->master->start(pair->slave->packIceMsg());
+        pair->slave->start(pair->master->packIceMsg());
+    }
+
+    std::vector<long> latencies;
+    for (const auto& pair : pairs) {
+        if (pair->master->waitForNegotiation(NEGO_TIMEOUT) > 0 and pair->latency_us >= 0)
+            latencies.push_back(pair->latency_us);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto created = pairs.size() * 2;
+    std::printf("reactor threads: %u\n", threads);
+    std::printf("transports: %zu created, %u pairs initialized, %zu pairs negotiated\n",
+                created, ready, latencies.size());
+    std::printf("threads: %ld (%+ld)\n", threads1, threads1 - threads0);
+    std::printf("memory: %+ld kB, %.1f kB per transport\n",
+                rss1 - rss0, created ? double(rss1 - rss0) / created : 0.);
+    if (not latencies.empty())
+        std::printf("negotiation: median %.1f ms, p95 %.1f ms, max %.1f ms\n",
+                    latencies[latencies.size() / 2] / 1000.,
+                    latencies[latencies.size() * 95 / 100] / 1000.,
+                    latencies.back() / 1000.);
+
+    const auto stop = clock_type::now();
+    pairs.clear();
+    std::printf("destruction: %.1f ms\n",
+                std::chrono::duration<double, std::milli>(clock_type::now() - stop).count());
+
+    DRing::fini();
+    return 0;
+}
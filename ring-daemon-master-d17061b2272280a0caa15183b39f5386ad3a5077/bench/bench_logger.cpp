@@ -0,0 +1,148 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Benchmark of the logger during log-heavy call setups.
+ *
+ * Each thread sets up calls logging like the SIP, ICE and media code do,
+ * waiting between two calls as for the network, with the synchronous and
+ * the asynchronous logger, with and without the rate limiter. Prints the
+ * time spent logging by the threads, the slowest call setup and the time
+ * until everything is printed. A pause of 0 floods the logger.
+ * Logs are printed on stderr, redirect it to measure a terminal or a file.
+ *
+ * usage: bench_logger [threads] [calls per thread] [pause in us] 2>/dev/null
+ */
+
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr unsigned LOGS_PER_CALL {24};
+
+static void
+callSetup(unsigned thread, unsigned call)
+{
+    const unsigned id = thread * 100000 + call;
+    RING_DBG("[call:%u] Outgoing call to sip:%u@example.org", id, id);
+    RING_DBG("[call:%u] Using account 8f4c2b1d%u", id, thread);
+    RING_DBG("[call:%u] Creating SDP offer, %u audio codecs, %u video codecs", id, 6u, 3u);
+    RING_DBG("[call:%u] Adding ICE candidate %u: 192.168.%u.%u:%u typ host", id, 1u, thread, call % 256, 5000 + call);
+    RING_DBG("[call:%u] Adding ICE candidate %u: 10.0.%u.%u:%u typ srflx", id, 2u, thread, call % 256, 6000 + call);
+    RING_DBG("[call:%u] Adding ICE candidate %u: 172.16.%u.%u:%u typ relay", id, 3u, thread, call % 256, 7000 + call);
+    RING_DBG("[call:%u] Sending INVITE, CSeq %u", id, call);
+    RING_DBG("[call:%u] Received 100 Trying", id);
+    RING_DBG("[call:%u] Received 180 Ringing", id);
+    RING_DBG("[call:%u] Received 200 OK, negotiating media", id);
+    RING_DBG("[call:%u] Remote SDP: audio port %u, payload %u", id, 40000 + call, 111u);
+    RING_DBG("[call:%u] ICE negotiation started, %u pairs", id, 9u);
+    RING_DBG("[call:%u] ICE pair %u succeeded", id, 4u);
+    RING_DBG("[call:%u] ICE negotiation done in %u ms", id, 120 + call % 50);
+    RING_DBG("[call:%u] TLS handshake started", id);
+    RING_DBG("[call:%u] TLS handshake done, cipher %s", id, "TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256");
+    RING_DBG("[call:%u] SRTP keys derived", id);
+    RING_DBG("[call:%u] Audio sender started: opus/48000/2", id);
+    RING_DBG("[call:%u] Audio receiver started: opus/48000/2", id);
+    RING_DBG("[call:%u] Video sender started: H264 %ux%u", id, 1280u, 720u);
+    RING_DBG("[call:%u] Video receiver started: H264", id);
+    RING_WARN("[call:%u] Partial get: %u frames", id, 480u);
+    RING_DBG("[call:%u] Call state: CURRENT", id);
+    RING_DBG("[call:%u] Sending ACK", id);
+}
+
+struct Result {
+    double loggingMs;
+    double slowestCallUs;
+    double totalMs;
+};
+
+static Result
+run(unsigned threads, unsigned calls, std::chrono::microseconds pause, bool async, unsigned rateLimit)
+{
+    setLogRateLimit(rateLimit);
+    setAsyncLog(async);
+
+    std::atomic<uint64_t> loggingNs {0};
+    std::atomic<uint64_t> slowestNs {0};
+    const auto start = clock_type::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            uint64_t total = 0, slowest = 0;
+            for (unsigned c = 0; c < calls; ++c) {
+                const auto begin = clock_type::now();
+                callSetup(t, c);
+                const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - begin).count();
+                total += ns;
+                slowest = std::max(slowest, ns);
+                if (pause.count())
+                    std::this_thread::sleep_for(pause);
+            }
+            loggingNs += total;
+            auto cur = slowestNs.load();
+            while (cur < slowest and not slowestNs.compare_exchange_weak(cur, slowest)) {}
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    // Print what is still queued
+    setAsyncLog(false);
+    const auto end = clock_type::now();
+
+    Result r;
+    r.loggingMs = loggingNs / 1e6 / threads;
+    r.slowestCallUs = slowestNs / 1e3;
+    r.totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+    return r;
+}
+
+int
+main(int argc, char* argv[])
+{
+    const unsigned threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    const unsigned calls = argc > 2 ? std::atoi(argv[2]) : 200;
+    const std::chrono::microseconds pause(argc > 3 ? std::atoi(argv[3]) : 1000);
+
+    setConsoleLog(1);
+    setDebugMode(1);
+
+    std::printf("%u threads, %u call setups each, %u messages per call, %u us between calls\n",
+                threads, calls, LOGS_PER_CALL, static_cast<unsigned>(pause.count()));
+    std::printf("%-6s %-10s %14s %14s %14s %12s\n",
+                "mode", "rate limit", "per thread ms", "ns/message", "slowest call us", "total ms");
+
+    for (const bool async : {false, true}) {
+        for (const unsigned limit : {0u, 50u}) {
+            const auto r = run(threads, calls, pause, async, limit);
+            std::printf("%-6s %-10u %14.1f %14.0f %14.0f %12.1f\n",
+                        async ? "async" : "sync", limit, r.loggingMs,
+                        r.loggingMs * 1e6 / (calls * LOGS_PER_CALL), r.slowestCallUs, r.totalMs);
+        }
+    }
+    return 0;
+}
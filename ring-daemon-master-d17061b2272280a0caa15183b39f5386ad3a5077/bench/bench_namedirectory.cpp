@@ -0,0 +1,165 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Benchmark of NameDirectory lookups against a local mock name server.
+ *
+ * Threads look up the same names at once, as when a contact list is
+ * displayed: the first pass hits the server, concurrent lookups of a name
+ * share one request; the second pass is served by the cache. Half of the
+ * names are registered, the others are answered with 404 and cached as
+ * not found. The server answers after a delay, like a remote one, on
+ * connections kept open. Then prints the size of the cache file, written
+ * once.
+ *
+ * usage: bench_namedirectory [threads] [names] [server delay in ms]
+ */
+
+#include "ringdht/namedirectory.h"
+#include "config/config_writer.h"
+#include "fileutils.h"
+#include "mock_http_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+using ring::NameDirectory;
+
+static const std::string NAME_PREFIX {"user"};
+
+/** Answers GET /name/<name> and GET /addr/<addr> like the name server */
+static std::pair<unsigned, std::string>
+nameServer(const std::string& path)
+{
+    // user<i> is registered for an even i, with the address <i>
+    if (path.compare(0, 6, "/name/") == 0) {
+        const auto i = std::atol(path.c_str() + 6 + NAME_PREFIX.size());
+        if (i % 2 == 0)
+            return {200, "{\"name\":\"" + path.substr(6) + "\",\"addr\":\"0x" + std::to_string(i) + "\"}"};
+    } else if (path.compare(0, 6, "/addr/") == 0) {
+        const auto i = std::atol(path.c_str() + 6);
+        if (i % 2 == 0)
+            return {200, "{\"name\":\"" + NAME_PREFIX + std::to_string(i) + "\"}"};
+    }
+    return {404, "{\"error\":\"not found\"}"};
+}
+
+struct Result {
+    unsigned found {0};
+    unsigned notFound {0};
+    unsigned errors {0};
+    double ms {0};
+    double slowestMs {0};
+};
+
+/** Every thread looks up every name, in its own order */
+static Result
+run(NameDirectory& dir, unsigned threads, unsigned names)
+{
+    std::mutex mtx;
+    std::condition_variable cv;
+    Result res;
+    unsigned left = threads * names;
+    const auto start = clock_type::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::vector<unsigned> order(names);
+            for (unsigned i = 0; i < names; ++i)
+                order[i] = i;
+            std::shuffle(order.begin(), order.end(), std::mt19937(t));
+            for (const auto i : order) {
+                const auto begin = clock_type::now();
+                dir.lookupName(NAME_PREFIX + std::to_string(i), [&, begin](const std::string&, NameDirectory::Response r) {
+                    const auto ms = std::chrono::duration<double, std::milli>(clock_type::now() - begin).count();
+                    std::lock_guard<std::mutex> lk(mtx);
+                    if (r == NameDirectory::Response::found)
+                        ++res.found;
+                    else if (r == NameDirectory::Response::notFound)
+                        ++res.notFound;
+                    else
+                        ++res.errors;
+                    res.slowestMs = std::max(res.slowestMs, ms);
+                    if (--left == 0)
+                        cv.notify_all();
+                });
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    std::unique_lock<std::mutex> lk(mtx);
+    cv.wait(lk, [&] { return left == 0; });
+    res.ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    return res;
+}
+
+int
+main(int argc, char* argv[])
+{
+    const unsigned threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    const unsigned names = argc > 2 ? std::atoi(argv[2]) : 200;
+    const std::chrono::milliseconds delay(argc > 3 ? std::atoi(argv[3]) : 20);
+
+    // Don't use the user's cache
+    char cacheDir[] = "/tmp/bench_namedirectory.XXXXXX";
+    if (not mkdtemp(cacheDir)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_CACHE_HOME", cacheDir, 1);
+
+    MockHttpServer server(nameServer, delay);
+    auto& dir = NameDirectory::instance(server.host());
+
+    std::printf("%u threads looking up %u names, server delay %u ms\n",
+                threads, names, static_cast<unsigned>(delay.count()));
+    std::printf("%-6s %10s %10s %12s %10s %8s %10s %12s %12s\n",
+                "pass", "lookups", "requests", "connections", "found", "errors", "total ms", "us/lookup", "slowest ms");
+
+    unsigned requests = 0;
+    unsigned connections = 0;
+    for (const auto pass : {"cold", "cached"}) {
+        const auto r = run(dir, threads, names);
+        const auto lookups = threads * names;
+        std::printf("%-6s %10u %10u %12u %10u %8u %10.1f %12.2f %12.1f\n",
+                    pass, lookups, server.requests() - requests, server.connections() - connections,
+                    r.found, r.errors, r.ms, r.ms * 1000. / lookups, r.slowestMs);
+        requests = server.requests();
+        connections = server.connections();
+    }
+
+    // Let the cache be written
+    std::this_thread::sleep_for(2 * ring::ConfigWriter::DELAY);
+    const auto cache = ring::fileutils::loadFile(std::string(cacheDir) + "/namecache/" + server.host());
+    std::printf("cache: %zu bytes\n", cache.size());
+
+    ring::fileutils::removeAll(cacheDir);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Benchmark of Resampler on the common 48k <-> 16k <-> 8k paths.
+ *
+ * For each path, prints the time to resample a 20 ms frame, the time of the
+ * output conversion alone (the former three passes against the one-pass
+ * AudioBuffer::deinterleaveFloat) and the time to create a Resampler and
+ * convert a first frame, its converter being taken from the cache.
+ */
+
+#include "media/audio/resampler.h"
+#include "media/audio/audiobuffer.h"
+
+#include <samplerate.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace ring;
+
+static constexpr unsigned FRAME_MS = 20;
+
+static double
+nsPerIteration(const std::function<void()>& op, unsigned iterations)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        op();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+static void
+run(unsigned inRate, unsigned outRate, unsigned channels, bool quality, unsigned iterations)
+{
+    const AudioFormat inFormat {inRate, channels};
+    const AudioFormat outFormat {outRate, channels};
+    const size_t inFrames = inRate * FRAME_MS / 1000;
+    const size_t outFrames = outRate * FRAME_MS / 1000;
+
+    AudioBuffer in(inFrames, inFormat);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> d(-20000, 20000);
+    for (unsigned c = 0; c < channels; ++c)
+        for (size_t i = 0; i < inFrames; ++i)
+            in.getChannel(c)[i] = d(rng);
+    AudioBuffer out(outFrames, outFormat);
+
+    // Whole resample() call
+    Resampler resampler(outFormat, quality);
+    resampler.resample(in, out);
+    const double resample = nsPerIteration([&] { resampler.resample(in, out); }, iterations);
+
+    // Output conversion only
+    std::vector<float> floats(outFrames * channels);
+    for (auto& f : floats)
+        f = d(rng) / 32768.f;
+    std::vector<AudioSample> scratch(floats.size());
+    const double threePass = nsPerIteration([&] {
+        src_float_to_short_array(floats.data(), scratch.data(), floats.size());
+        out.deinterleave(scratch.data(), outFrames, channels);
+    }, iterations);
+    const double onePass = nsPerIteration([&] {
+        out.deinterleaveFloat(floats.data(), outFrames, channels);
+    }, iterations);
+
+    // Creation and first frame, the converter is then returned to the cache
+    const unsigned creations = quality ? 10 : iterations / 10 + 1;
+    const double warm = nsPerIteration([&] {
+        Resampler r(outFormat, quality);
+        r.resample(in, out);
+    }, creations);
+
+    std::printf("%5u -> %5u Hz %u ch %-4s  resample %9.1f ns  convert %7.1f -> %7.1f ns  first frame (cached) %9.1f ns\n",
+                inRate, outRate, channels, quality ? "best" : "fast",
+                resample, threePass, onePass, warm);
+}
+
+int
+main(int argc, char** argv)
+{
+    const unsigned iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    std::printf("Time per %u ms frame, %u iterations\n\n", FRAME_MS, iterations);
+
+    const std::pair<unsigned, unsigned> paths[] {
+        {48000, 16000}, {16000, 48000},
+        {48000, 8000}, {8000, 48000},
+        {16000, 8000}, {8000, 16000},
+    };
+
+    for (const bool quality : {false, true}) {
+        for (const unsigned channels : {1u, 2u}) {
+            for (const auto& p : paths)
+                run(p.first, p.second, channels, quality, quality ? iterations / 10 + 1 : iterations);
+            std::printf("\n");
+        }
+    }
+
+    std::printf("Idle converters in cache: %zu\n", Resampler::cachedStates());
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+/*
+ * Loopback benchmark of SocketPair on system sockets.
+ *
+ * Pushes RTP packets from one SocketPair to another through their IO
+ * contexts, as the encoder and the demuxer do, first one packet at a time
+ * then in send batches. Prints the packet rate, the loss and the system
+ * calls per packet on each side.
+ *
+ * usage: bench_socketpair [packets] [batch size] [base port]
+ */
+
+#include "libav_deps.h" // MUST BE INCLUDED FIRST
+#include "media/socket_pair.h"
+#include "media/media_io_handle.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace ring;
+
+static constexpr uint16_t MTU = 1500;
+static constexpr int PACKET_SIZE = 1200;
+
+static void
+run(unsigned packets, unsigned batch, int port)
+{
+    const std::string localhost = "rtp://127.0.0.1:";
+    SocketPair sender((localhost + std::to_string(port + 2)).c_str(), port);
+    SocketPair receiver((localhost + std::to_string(port)).c_str(), port + 2);
+
+    std::unique_ptr<MediaIOHandle> muxContext(sender.createIOContext(MTU));
+    std::unique_ptr<MediaIOHandle> demuxContext(receiver.createIOContext(MTU));
+
+    uint64_t received = 0;
+    std::thread demux([&] {
+        uint8_t buf[PACKET_SIZE];
+        while (avio_read(demuxContext->getContext(), buf, sizeof(buf)) == PACKET_SIZE)
+            ++received;
+    });
+
+    uint8_t pkt[PACKET_SIZE] {};
+    pkt[0] = 0x80; // RTP version 2
+    pkt[1] = 96;   // dynamic payload type
+
+    auto ctx = muxContext->getContext();
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < packets; ++i) {
+        if (batch > 1 and i % batch == 0)
+            sender.beginSendBatch();
+        std::memcpy(pkt + 2, &i, sizeof(uint16_t));
+        avio_write(ctx, pkt, sizeof(pkt));
+        avio_flush(ctx);
+        if (batch > 1 and (i % batch == batch - 1 or i == packets - 1))
+            sender.endSendBatch();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // let the receiver drain its socket
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    receiver.interrupt();
+    demux.join();
+
+    const auto tx = sender.getIOStats();
+    const auto rx = receiver.getIOStats();
+    const double secs = std::chrono::duration<double>(end - start).count();
+    std::printf("batch %3u  %9.0f packets/s  loss %5.2f %%  syscalls/packet: send %.3f  receive %.3f\n",
+                batch, packets / secs,
+                100. * (packets - received) / packets,
+                tx.txPackets ? double(tx.txSyscalls) / tx.txPackets : 0.,
+                rx.rxPackets ? double(rx.rxSyscalls) / rx.rxPackets : 0.);
+}
+
+int
+main(int argc, char** argv)
+{
+    const unsigned packets = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const unsigned batch = argc > 2 ? std::atoi(argv[2]) : 16;
+    const int port = argc > 3 ? std::atoi(argv[3]) : 42000;
+
+    std::printf("%u RTP packets of %d bytes over loopback\n\n", packets, PACKET_SIZE);
+    run(packets, 1, port);
+    run(packets, batch, port + 4);
+    return 0;
+}
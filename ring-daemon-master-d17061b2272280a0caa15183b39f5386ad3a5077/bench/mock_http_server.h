@@ -0,0 +1,163 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Local HTTP/1.1 server for the benchmarks, one thread per connection.
+ *
+ * Every read from a connection waits for delay before being answered, like
+ * a round trip to a remote server: pipelined requests received together
+ * share it. With keepAlive false, connections are closed after a response.
+ */
+class MockHttpServer {
+public:
+    /** Return the status and the body answering a GET of path */
+    using Handler = std::function<std::pair<unsigned, std::string>(const std::string& path)>;
+
+    MockHttpServer(Handler&& handler, std::chrono::milliseconds delay, bool keepAlive = true)
+        : handler_(std::move(handler)), delay_(delay), keepAlive_(keepAlive) {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (::bind(fd_, (sockaddr*)&addr, len) < 0 or ::listen(fd_, 128) < 0
+            or ::getsockname(fd_, (sockaddr*)&addr, &len) < 0) {
+            std::perror("mock http server");
+            std::exit(1);
+        }
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~MockHttpServer() {
+        ::shutdown(fd_, SHUT_RDWR);
+        thread_.join();
+        ::close(fd_);
+        {
+            // Wake up the connections waiting for a request
+            std::lock_guard<std::mutex> lk(mutex_);
+            for (auto conn : sockets_)
+                if (conn >= 0)
+                    ::shutdown(conn, SHUT_RDWR);
+        }
+        for (auto& t : threads_)
+            t.join();
+    }
+
+    std::string host() const {
+        return "127.0.0.1:" + std::to_string(port_);
+    }
+
+    unsigned requests() const {
+        return requests_;
+    }
+
+    unsigned connections() const {
+        return connections_;
+    }
+
+private:
+    void run() {
+        while (true) {
+            const int conn = ::accept(fd_, nullptr, nullptr);
+            if (conn < 0)
+                break;
+            ++connections_;
+            std::lock_guard<std::mutex> lk(mutex_);
+            sockets_.emplace_back(conn);
+            threads_.emplace_back(&MockHttpServer::serve, this, sockets_.size() - 1);
+        }
+    }
+
+    void serve(size_t index) {
+        int conn;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            conn = sockets_[index];
+        }
+        std::string buf;
+        char data[4096];
+        bool closing = false;
+        while (not closing) {
+            const auto n = ::recv(conn, data, sizeof(data), 0);
+            if (n <= 0)
+                break;
+            buf.append(data, n);
+            std::this_thread::sleep_for(delay_);
+
+            std::string out;
+            size_t end;
+            while (not closing and (end = buf.find("\r\n\r\n")) != std::string::npos) {
+                const auto request = buf.substr(0, end);
+                buf.erase(0, end + 4);
+                ++requests_;
+                closing = not keepAlive_ or request.find("Connection: close") != std::string::npos;
+
+                // GET <path> HTTP/1.1
+                const auto begin = request.find(' ') + 1;
+                const auto res = handler_(request.substr(begin, request.find(' ', begin) - begin));
+                out += "HTTP/1.1 " + std::to_string(res.first) + (res.first == 200 ? " OK" : " Not Found")
+                     + "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(res.second.size())
+                     + (closing ? "\r\nConnection: close" : "\r\nConnection: keep-alive")
+                     + "\r\n\r\n" + res.second;
+            }
+            for (size_t sent = 0; sent < out.size();) {
+                const auto s = ::send(conn, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+                if (s <= 0) {
+                    closing = true;
+                    break;
+                }
+                sent += s;
+            }
+        }
+        std::lock_guard<std::mutex> lk(mutex_);
+        sockets_[index] = -1;
+        ::close(conn);
+    }
+
+    const Handler handler_;
+    const std::chrono::milliseconds delay_;
+    const bool keepAlive_;
+    int fd_ {-1};
+    unsigned port_ {0};
+    std::atomic<unsigned> requests_ {0};
+    std::atomic<unsigned> connections_ {0};
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::vector<int> sockets_;
+    std::vector<std::thread> threads_;
+};
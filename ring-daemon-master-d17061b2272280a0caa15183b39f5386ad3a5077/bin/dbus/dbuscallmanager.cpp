@@ -271,3 +271,9 @@ DBusCallManager::stopSmartInfo()
 {
     DRing::stopSmartInfo();
 }
+
+std::vector<std::map<std::string, std::string>>
+DBusCallManager::getCallMediaStats(const std::vector<std::string>& callIds)
+{
+    return DRing::getCallMediaStats(callIds);
+}
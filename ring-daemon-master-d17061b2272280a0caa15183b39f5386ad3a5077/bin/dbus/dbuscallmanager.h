@@ -95,6 +95,7 @@ class DBusCallManager :
         void sendTextMessage(const std::string& callID, const std::map<std::string, std::string>& messages, const bool& isMixed);
         void startSmartInfo(const uint32_t& refreshTimeMs);
         void stopSmartInfo();
+        std::vector<std::map<std::string, std::string>> getCallMediaStats(const std::vector<std::string>& callIds);
 };
 
 #endif // __RING_CALLMANAGER_H__
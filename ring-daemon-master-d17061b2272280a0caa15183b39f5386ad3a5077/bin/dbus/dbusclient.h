@@ -40,7 +40,6 @@ class DBusVideoManager;
 
 namespace DBus {
     class BusDispatcher;
-    class DefaultTimeout;
 }
 
 class DBusClient {
@@ -56,7 +55,6 @@ class DBusClient {
         void finiLibrary() noexcept;
 
         std::unique_ptr<DBus::BusDispatcher>  dispatcher_;
-        std::unique_ptr<DBus::DefaultTimeout> timeout_;
 
         std::unique_ptr<DBusCallManager>          callManager_;
         std::unique_ptr<DBusConfigurationManager> configurationManager_;
@@ -358,6 +358,7 @@ DBusConfigurationManager::getSupportedAudioManagers()
 #if HAVE_JACK
         JACK_API_STR,
 #endif
+        NULL_API_STR,
     };
 }
 
@@ -606,3 +607,15 @@ DBusConfigurationManager::connectivityChanged()
 {
     DRing::connectivityChanged();
 }
+
+auto
+DBusConfigurationManager::getThreadPoolStats() -> decltype(DRing::getThreadPoolStats())
+{
+    return DRing::getThreadPoolStats();
+}
+
+auto
+DBusConfigurationManager::getSignalStats() -> decltype(DRing::getSignalStats())
+{
+    return DRing::getSignalStats();
+}
@@ -150,6 +150,8 @@ class DBusConfigurationManager :
         int exportAccounts(const std::vector<std::string>& accountIDs, const std::string& filepath, const std::string& password);
         int importAccounts(const std::string& archivePath, const std::string& password);
         void connectivityChanged();
+        std::map<std::string, std::string> getThreadPoolStats();
+        std::map<std::string, std::string> getSignalStats();
 };
 
 #endif // __RING_DBUSCONFIGURATIONMANAGER_H__
@@ -96,3 +96,9 @@ DBusVideoManager::setDecodingAccelerated(const bool& state)
 {
     DRing::setDecodingAccelerated(state);
 }
+
+auto
+DBusVideoManager::getFramePoolStats() -> decltype(DRing::getFramePoolStats())
+{
+    return DRing::getFramePoolStats();
+}
@@ -62,6 +62,7 @@ class DBusVideoManager :
         bool hasCameraStarted();
         bool getDecodingAccelerated();
         void setDecodingAccelerated(const bool& state);
+        std::map<std::string, std::string> getFramePoolStats();
 };
 
 #endif // __RING_DBUSVIDEOMANAGER_H__
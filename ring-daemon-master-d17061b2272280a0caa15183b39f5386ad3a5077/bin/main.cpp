@@ -68,6 +68,9 @@ print_usage()
     std::cout << std::endl <<
     "-c, --console \t- Log in console (instead of syslog)" << std::endl <<
     "-d, --debug \t- Debug mode (more verbose)" << std::endl <<
+    "--async-log \t- Print logs from a background thread" << std::endl <<
+    "--log-rate-limit \t- Drop repeated logs beyond " XSTR(LOG_DEFAULT_RATE_LIMIT) " per second from a same place" << std::endl <<
+    "--async-signals \t- Send client signals from a background thread" << std::endl <<
     "-p, --persistent \t- Stay alive after client quits" << std::endl <<
     "--port \t- Port to use for the rest API. Default is 8080" << std::endl <<
     "--auto-answer \t- Force automatic answer to incoming calls" << std::endl <<
@@ -85,6 +88,9 @@ parse_args(int argc, char *argv[], bool& persistent)
     int helpFlag = false;
     int versionFlag = false;
     int autoAnswer = false;
+    int asyncLog = false;
+    int logRateLimit = false;
+    int asyncSignals = false;
 
     const struct option long_options[] = {
         /* These options set a flag. */
@@ -94,6 +100,9 @@ parse_args(int argc, char *argv[], bool& persistent)
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'v'},
         {"auto-answer", no_argument, &autoAnswer, true},
+        {"async-log", no_argument, &asyncLog, true},
+        {"log-rate-limit", no_argument, &logRateLimit, true},
+        {"async-signals", no_argument, &asyncSignals, true},
         {"port", optional_argument, NULL, 'x'},
         {0, 0, 0, 0} /* Sentinel */
     };
@@ -158,6 +167,15 @@ parse_args(int argc, char *argv[], bool& persistent)
     if (autoAnswer)
         ringFlags |= DRing::DRING_FLAG_AUTOANSWER;
 
+    if (asyncLog)
+        ringFlags |= DRing::DRING_FLAG_ASYNC_LOG;
+
+    if (logRateLimit)
+        ringFlags |= DRing::DRING_FLAG_LOG_RATE_LIMIT;
+
+    if (asyncSignals)
+        ringFlags |= DRing::DRING_FLAG_ASYNC_SIGNALS;
+
     return false;
 }
 
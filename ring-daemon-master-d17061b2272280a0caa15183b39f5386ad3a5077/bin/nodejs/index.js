@@ -25,11 +25,6 @@ class RingDaemon{
         if(callbackMap){
             this.dring = require("./build/Release/dring.node");
             this.dring.init(callbackMap);
-            var that = this;
-            this.pollIntervalId = setInterval(function () {
-                that.dring.pollEvents();
-                //console.log("Polling...");
-            }, 10);
         }
     }
 
@@ -113,7 +108,6 @@ class RingDaemon{
     }
 
     stop() {
-        clearInterval(this.pollIntervalId);
         this.dring.fini();
     }
 }
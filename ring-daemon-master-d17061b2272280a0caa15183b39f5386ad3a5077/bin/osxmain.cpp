@@ -160,10 +160,9 @@ osxTests()
     if (!DRing::start())
             return -1;
 
-    while (true) {
-        DRing::pollEvents();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    // the daemon runs its own event loop
+    while (true)
+        std::this_thread::sleep_for(std::chrono::seconds(1));
 
     DRing::fini();
 }
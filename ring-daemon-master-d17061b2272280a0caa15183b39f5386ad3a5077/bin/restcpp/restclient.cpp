@@ -18,6 +18,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
  */
 #include "restclient.h"
+#include "restsession.h"
 
 RestClient::RestClient(int port, int flags, bool persistent) :
     service_()
@@ -34,7 +35,6 @@ RestClient::RestClient(int port, int flags, bool persistent) :
     // Initiate the rest service
     settings_ = std::make_shared<restbed::Settings>();
     settings_->set_port(port);
-    settings_->set_default_header( "Connection", "close" );
     RING_INFO("Restclient running on port [%d]", port);
 
     // Make it run in a thread, because this is a blocking function
@@ -52,13 +52,10 @@ RestClient::~RestClient()
 int
 RestClient::event_loop() noexcept
 {
-    // While the client is running, the events are polled every 10 milliseconds
-    RING_INFO("Restclient starting to poll events");
+    // The daemon runs its own event loop, wait for the client to exit
+    RING_INFO("Restclient started");
     while(!pollNoMore_)
-    {
-        DRing::pollEvents();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     return 0;
 }
 
@@ -160,6 +157,8 @@ RestClient::initResources()
             {"Content-Type", "text/html"},
             {"Content-Length", std::to_string(body.length())}
         };
+
+        respond(session, restbed::OK, body, headers);
     });
 
     // And finally, we give the resource to the service to handle it
@@ -18,6 +18,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
  */
 #include "restconfigurationmanager.h"
+#include "restsession.h"
 
 RestConfigurationManager::RestConfigurationManager() :
     resources_()
@@ -467,7 +468,7 @@ RestConfigurationManager::defaultRoute(const std::shared_ptr<restbed::Session> s
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -484,7 +485,7 @@ RestConfigurationManager::getAccountDetails(const std::shared_ptr<restbed::Sessi
 
     if(accountDetails.size() == 0)
     {
-        session->close(restbed::NOT_FOUND);
+        respond(session, restbed::NOT_FOUND);
     }
     else
     {
@@ -497,7 +498,7 @@ RestConfigurationManager::getAccountDetails(const std::shared_ptr<restbed::Sessi
             {"Content-Length", std::to_string(body.length())}
         };
 
-        session->close(restbed::OK, body, headers);
+        respond(session, restbed::OK, body, headers);
     }
 }
 
@@ -515,7 +516,7 @@ RestConfigurationManager::getVolatileAccountDetails(const std::shared_ptr<restbe
 
     if(volatileAccountDetails.size() == 0)
     {
-        session->close(restbed::NOT_FOUND);
+        respond(session, restbed::NOT_FOUND);
     }
     else
     {
@@ -528,7 +529,7 @@ RestConfigurationManager::getVolatileAccountDetails(const std::shared_ptr<restbe
             {"Content-Length", std::to_string(body.length())}
         };
 
-        session->close(restbed::OK, body, headers);
+        respond(session, restbed::OK, body, headers);
     }
 }
 
@@ -553,7 +554,7 @@ RestConfigurationManager::setAccountDetails(const std::shared_ptr<restbed::Sessi
 
         DRing::setAccountDetails(accountID, details);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -570,7 +571,7 @@ RestConfigurationManager::setAccountActive(const std::shared_ptr<restbed::Sessio
 
     DRing::setAccountActive(accountID, active);
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -594,7 +595,7 @@ RestConfigurationManager::getAccountTemplate(const std::shared_ptr<restbed::Sess
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -617,7 +618,7 @@ RestConfigurationManager::addAccount(const std::shared_ptr<restbed::Session> ses
 
         DRing::addAccount(details);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -633,7 +634,7 @@ RestConfigurationManager::removeAccount(const std::shared_ptr<restbed::Session>
 
     // TODO : found a way to know if there's no accound with this id, and send a 404 NOT FOUND
     // See account_factory.cpp:102 for the function
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -658,7 +659,7 @@ RestConfigurationManager::getAccountList(const std::shared_ptr<restbed::Session>
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -674,7 +675,7 @@ RestConfigurationManager::sendRegister(const std::shared_ptr<restbed::Session> s
 
     DRing::sendRegister(accountID, enable);
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -684,7 +685,7 @@ RestConfigurationManager::registerAllAccounts(const std::shared_ptr<restbed::Ses
 
     DRing::registerAllAccounts();
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -709,7 +710,7 @@ RestConfigurationManager::sendTextMessage(const std::shared_ptr<restbed::Session
 
         DRing::sendAccountTextMessage(accountID, to, payloads);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -757,7 +758,7 @@ RestConfigurationManager::getMessageStatus(const std::shared_ptr<restbed::Sessio
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -778,7 +779,7 @@ RestConfigurationManager::getTlsDefaultSettings(const std::shared_ptr<restbed::S
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -799,7 +800,7 @@ RestConfigurationManager::getCodecList(const std::shared_ptr<restbed::Session> s
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -820,7 +821,7 @@ RestConfigurationManager::getSupportedTlsMethod(const std::shared_ptr<restbed::S
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -844,7 +845,7 @@ RestConfigurationManager::getSupportedCiphers(const std::shared_ptr<restbed::Ses
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -869,7 +870,7 @@ RestConfigurationManager::getCodecDetails(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -895,7 +896,7 @@ RestConfigurationManager::setCodecDetails(const std::shared_ptr<restbed::Session
 
         DRing::setCodecDetails(accountID, std::stoi(codecID), details);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -920,7 +921,7 @@ RestConfigurationManager::getActiveCodecList(const std::shared_ptr<restbed::Sess
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -949,7 +950,7 @@ RestConfigurationManager::getAudioPluginList(const std::shared_ptr<restbed::Sess
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -962,7 +963,7 @@ RestConfigurationManager::setAudioPlugin(const std::shared_ptr<restbed::Session>
 
     DRing::setAudioPlugin(plugin);
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -983,7 +984,7 @@ RestConfigurationManager::getAudioOutputDeviceList(const std::shared_ptr<restbed
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -996,7 +997,7 @@ RestConfigurationManager::setAudioOutputDevice(const std::shared_ptr<restbed::Se
 
     DRing::setAudioOutputDevice(std::stoi(index));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1009,7 +1010,7 @@ RestConfigurationManager::setAudioInputDevice(const std::shared_ptr<restbed::Ses
 
     DRing::setAudioInputDevice(std::stoi(index));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1022,7 +1023,7 @@ RestConfigurationManager::setAudioRingtoneDevice(const std::shared_ptr<restbed::
 
     DRing::setAudioRingtoneDevice(std::stoi(index));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1043,7 +1044,7 @@ RestConfigurationManager::getAudioInputDeviceList(const std::shared_ptr<restbed:
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1064,7 +1065,7 @@ RestConfigurationManager::getCurrentAudioDevicesIndex(const std::shared_ptr<rest
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1085,7 +1086,7 @@ RestConfigurationManager::getAudioInputDeviceIndex(const std::shared_ptr<restbed
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1106,7 +1107,7 @@ RestConfigurationManager::getAudioOutputDeviceIndex(const std::shared_ptr<restbe
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1122,7 +1123,7 @@ RestConfigurationManager::getCurrentAudioOutputPlugin(const std::shared_ptr<rest
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1138,7 +1139,7 @@ RestConfigurationManager::getNoiseSuppressState(const std::shared_ptr<restbed::S
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1151,7 +1152,7 @@ RestConfigurationManager::setNoiseSuppressState(const std::shared_ptr<restbed::S
 
     DRing::setNoiseSuppressState((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1168,7 +1169,7 @@ RestConfigurationManager::isAgcEnabled(const std::shared_ptr<restbed::Session> s
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1181,7 +1182,7 @@ RestConfigurationManager::setAgcState(const std::shared_ptr<restbed::Session> se
 
     DRing::setAgcState((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1194,7 +1195,7 @@ RestConfigurationManager::muteDtmf(const std::shared_ptr<restbed::Session> sessi
 
     DRing::muteDtmf((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1211,7 +1212,7 @@ RestConfigurationManager::isDtmfMuted(const std::shared_ptr<restbed::Session> se
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1228,7 +1229,7 @@ RestConfigurationManager::isCaptureMuted(const std::shared_ptr<restbed::Session>
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1241,7 +1242,7 @@ RestConfigurationManager::muteCapture(const std::shared_ptr<restbed::Session> se
 
     DRing::muteCapture((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1258,7 +1259,7 @@ RestConfigurationManager::isPlaybackMuted(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1271,7 +1272,7 @@ RestConfigurationManager::mutePlayback(const std::shared_ptr<restbed::Session> s
 
     DRing::mutePlayback((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1288,7 +1289,7 @@ RestConfigurationManager::isRingtoneMuted(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1301,7 +1302,7 @@ RestConfigurationManager::muteRingtone(const std::shared_ptr<restbed::Session> s
 
     DRing::muteRingtone((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1317,7 +1318,7 @@ RestConfigurationManager::getAudioManager(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1337,7 +1338,7 @@ RestConfigurationManager::setAudioManager(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1364,7 +1365,7 @@ RestConfigurationManager::getSupportedAudioManagers(const std::shared_ptr<restbe
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1380,7 +1381,7 @@ RestConfigurationManager::getRecordPath(const std::shared_ptr<restbed::Session>
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1393,7 +1394,7 @@ RestConfigurationManager::setRecordPath(const std::shared_ptr<restbed::Session>
 
     DRing::setRecordPath(path);
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1410,7 +1411,7 @@ RestConfigurationManager::getIsAlwaysRecording(const std::shared_ptr<restbed::Se
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1423,7 +1424,7 @@ RestConfigurationManager::setIsAlwaysRecording(const std::shared_ptr<restbed::Se
 
     DRing::setIsAlwaysRecording((state == "true" ? true : false));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1436,7 +1437,7 @@ RestConfigurationManager::setHistoryLimit(const std::shared_ptr<restbed::Session
 
     DRing::setHistoryLimit(std::stoi(days));
 
-    session->close(restbed::OK);
+    respond(session, restbed::OK);
 }
 
 void
@@ -1452,7 +1453,7 @@ RestConfigurationManager::getHistoryLimit(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1482,7 +1483,7 @@ RestConfigurationManager::setAccountsOrder(const std::shared_ptr<restbed::Sessio
         if(search != details.end() && std::regex_match(details["order"], order))
             DRing::setAccountsOrder(details["order"]);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -1504,7 +1505,7 @@ RestConfigurationManager::getHookSettings(const std::shared_ptr<restbed::Session
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1528,7 +1529,7 @@ RestConfigurationManager::setHookSettings(const std::shared_ptr<restbed::Session
 
         DRing::setHookSettings(settings);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -1554,7 +1555,7 @@ RestConfigurationManager::getCredentials(const std::shared_ptr<restbed::Session>
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1579,7 +1580,7 @@ RestConfigurationManager::setCredentials(const std::shared_ptr<restbed::Session>
 
         DRing::setCredentials(accountID, std::vector<std::map<std::string, std::string>>{details});
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
@@ -1599,7 +1600,7 @@ RestConfigurationManager::getAddrFromInterfaceName(const std::shared_ptr<restbed
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1620,7 +1621,7 @@ RestConfigurationManager::getAllIpInterface(const std::shared_ptr<restbed::Sessi
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1641,7 +1642,7 @@ RestConfigurationManager::getAllIpInterfaceByName(const std::shared_ptr<restbed:
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1662,7 +1663,7 @@ RestConfigurationManager::getShortcuts(const std::shared_ptr<restbed::Session> s
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void
@@ -1686,7 +1687,7 @@ RestConfigurationManager::setShortcuts(const std::shared_ptr<restbed::Session> s
 
         DRing::setShortcuts(shortcutsMap);
 
-        session->close(restbed::OK);
+        respond(session, restbed::OK);
     });
 }
 
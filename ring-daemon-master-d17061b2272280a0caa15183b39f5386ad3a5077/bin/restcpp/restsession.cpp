@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+#include "restsession.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static bool
+keepAlive(const restbed::Request& request)
+{
+    // A body left unread would be taken for the next request
+    const auto length = request.get_header("Content-Length", std::string());
+    if (!length.empty() && std::strtoul(length.c_str(), nullptr, 10) != request.get_body().size())
+        return false;
+
+    auto connection = request.get_header("Connection", std::string());
+    std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+
+    // Persistent by default since HTTP/1.1
+    if (request.get_version() >= 1.1)
+        return connection.find("close") == std::string::npos;
+    return connection.find("keep-alive") != std::string::npos;
+}
+
+void
+respond(const std::shared_ptr<restbed::Session>& session,
+        int status,
+        const std::string& body,
+        const std::multimap<std::string, std::string>& headers)
+{
+    auto response = headers;
+    if (response.find("Content-Length") == response.end())
+        response.emplace("Content-Length", std::to_string(body.size()));
+
+    if (keepAlive(*session->get_request()))
+    {
+        response.emplace("Connection", "keep-alive");
+        // Sends the response, then waits for the next request
+        session->yield(status, body, response);
+    }
+    else
+    {
+        response.emplace("Connection", "close");
+        session->close(status, body, response);
+    }
+}
@@ -0,0 +1,37 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <restbed>
+
+/**
+ * Send the response to the request of session.
+ *
+ * The connection stays open for the next request unless the client asked
+ * to close it, didn't ask to keep an HTTP/1.0 connection alive, or sent a
+ * body the handler didn't fetch.
+ * Content-Length is added if missing, as the client needs it to find the
+ * end of the body on a connection kept open.
+ */
+void respond(const std::shared_ptr<restbed::Session>& session,
+             int status,
+             const std::string& body = {},
+             const std::multimap<std::string, std::string>& headers = {});
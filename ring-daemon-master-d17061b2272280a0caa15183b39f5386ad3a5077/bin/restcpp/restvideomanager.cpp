@@ -19,6 +19,7 @@
  */
 #include "restvideomanager.h"
 #include "client/videomanager.h"
+#include "restsession.h"
 
 RestVideoManager::RestVideoManager() :
     resources_()
@@ -102,7 +103,7 @@ RestVideoManager::defaultRoute(const std::shared_ptr<restbed::Session> session)
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 }
 
 void RestVideoManager::getDeviceList(const std::shared_ptr<restbed::Session> session)
@@ -121,7 +122,7 @@ void RestVideoManager::getDeviceList(const std::shared_ptr<restbed::Session> ses
         {"Content-Length", std::to_string(body.length())}
     };
 
-    session->close(restbed::OK, body, headers);
+    respond(session, restbed::OK, body, headers);
 
 }
 
@@ -177,10 +177,9 @@ run()
     if (!DRing::start())
         return -1;
 
-    while (loop) {
-        DRing::pollEvents();
+    // the daemon runs its own event loop
+    while (loop)
         Sleep(1000); // milliseconds
-    }
 
     DRing::fini();
 
@@ -41,6 +41,13 @@ ifdef HAVE_WIN64
 PJPROJECT_EXTRA_CFLAGS += -DPJ_WIN64=1
 endif
 
+# ICE transports share the ioqueues of a few reactor threads
+ifdef HAVE_LINUX
+PJPROJECT_OPTIONS += --enable-epoll
+PJPROJECT_EXTRA_CFLAGS += -DPJ_IOQUEUE_MAX_HANDLES=1024
+PJPROJECT_EXTRA_CXXFLAGS += -DPJ_IOQUEUE_MAX_HANDLES=1024
+endif
+
 PKGS += pjproject
 # FIXME: nominally 2.2.0 is enough, but it has to be patched for gnutls
 ifeq ($(call need_pkg,'libpjproject'),)
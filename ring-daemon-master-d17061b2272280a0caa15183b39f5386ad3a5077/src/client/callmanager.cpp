@@ -34,6 +34,7 @@
 #include "manager.h"
 
 #include "smartools.h"
+#include "media/media_stats.h"
 
 namespace DRing {
 
@@ -156,6 +157,12 @@ stopSmartInfo()
     ring::Smartools::getInstance().stop();
 }
 
+std::vector<std::map<std::string, std::string>>
+getCallMediaStats(const std::vector<std::string>& callIds)
+{
+    return ring::MediaStatsRegistry::instance().getStats(callIds);
+}
+
 bool
 addParticipant(const std::string& callID, const std::string& confID)
 {
@@ -41,6 +41,8 @@
 #include "account_const.h"
 #include "client/ring_signal.h"
 #include "upnp/upnp_context.h"
+#include "thread_pool.h"
+#include "string_utils.h"
 
 #ifdef RING_UWP
 #include "windirent.h"
@@ -530,7 +532,7 @@ setActiveCodecList(const std::string& accountID
     if (auto acc = ring::Manager::instance().getAccount(accountID))
     {
         acc->setActiveCodecs(list);
-        ring::Manager::instance().saveConfig();
+        ring::Manager::instance().saveConfig(acc);
     } else {
         RING_ERR("Could not find account %s", accountID.c_str());
     }
@@ -868,6 +870,46 @@ connectivityChanged()
     }
 }
 
+std::map<std::string, std::string>
+getThreadPoolStats()
+{
+    using ring::ThreadPool;
+    const auto stats = ThreadPool::instance().getStats();
+    std::map<std::string, std::string> ret {
+        {"threads", ring::to_string(stats.threads)},
+        {"idleThreads", ring::to_string(stats.idleThreads)},
+        {"stolen", ring::to_string(stats.stolen)},
+        {"overflowed", ring::to_string(stats.overflowed)},
+    };
+    static const char* const names[] = {"normal", "low"};
+    for (unsigned p = 0; p < static_cast<unsigned>(ThreadPool::Priority::COUNT); ++p) {
+        const std::string prefix = std::string(names[p]) + ".";
+        const auto& s = stats.priority[p];
+        ret.emplace(prefix + "queued", ring::to_string(s.queued));
+        ret.emplace(prefix + "executed", ring::to_string(s.executed));
+        ret.emplace(prefix + "waitTotalUs", ring::to_string(s.waitTotalUs));
+        ret.emplace(prefix + "waitMaxUs", ring::to_string(s.waitMaxUs));
+        ret.emplace(prefix + "runTotalUs", ring::to_string(s.runTotalUs));
+        ret.emplace(prefix + "runMaxUs", ring::to_string(s.runMaxUs));
+    }
+    return ret;
+}
+
+std::map<std::string, std::string>
+getSignalStats()
+{
+    const auto stats = ring::SignalDispatcher::instance().getStats();
+    return {
+        {"posted", ring::to_string(stats.posted)},
+        {"dispatched", ring::to_string(stats.dispatched)},
+        {"coalesced", ring::to_string(stats.coalesced)},
+        {"dropped", ring::to_string(stats.dropped)},
+        {"queued", ring::to_string(stats.queued)},
+        {"latencyTotalUs", ring::to_string(stats.latencyTotalUs)},
+        {"latencyMaxUs", ring::to_string(stats.latencyMaxUs)},
+    };
+}
+
 bool lookupName(const std::string& account, const std::string& nameserver, const std::string& name)
 {
 #if HAVE_RINGNS
@@ -20,6 +20,13 @@
 
 #include "ring_signal.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 namespace ring {
 
 SignalHandlerMap&
@@ -112,4 +119,168 @@ getSignalHandlers()
     return handlers;
 }
 
+using clock = std::chrono::steady_clock;
+
+// Signals waiting to be dispatched
+static constexpr size_t MAX_QUEUED_SIGNALS = 1024;
+
+struct SignalDispatcher::Impl
+{
+    struct Entry {
+        std::function<void()> cb;
+        std::string key;
+        clock::time_point queued;
+    };
+
+    void loop();
+
+    mutable std::mutex mutex {};
+    std::condition_variable cv {};
+    std::condition_variable notFull {};
+    bool running {false};
+    std::thread thread {};
+
+    /* Entries references are kept valid by push_back/pop_front */
+    std::deque<Entry> queue {};
+    std::map<std::string, Entry*> pending {}; // coalescable entries by key
+
+    uint64_t posted {0};
+    uint64_t dispatched {0};
+    uint64_t coalesced {0};
+    uint64_t dropped {0};
+    uint64_t latencyTotal {0};
+    uint64_t latencyMax {0};
+};
+
+void
+SignalDispatcher::Impl::loop()
+{
+    std::unique_lock<std::mutex> lk(mutex);
+    while (true) {
+        cv.wait(lk, [this]{ return not running or not queue.empty(); });
+        if (queue.empty())
+            break;
+
+        auto entry = std::move(queue.front());
+        if (not entry.key.empty())
+            pending.erase(entry.key);
+        queue.pop_front();
+        notFull.notify_one();
+
+        const uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            clock::now() - entry.queued).count();
+        latencyTotal += latency;
+        latencyMax = std::max(latencyMax, latency);
+        ++dispatched;
+
+        lk.unlock();
+        entry.cb();
+        entry.cb = {};
+        lk.lock();
+    }
+}
+
+SignalDispatcher&
+SignalDispatcher::instance()
+{
+    // Never destroyed: signals may be emitted during static destruction
+    static auto dispatcher = new SignalDispatcher();
+    return *dispatcher;
+}
+
+SignalDispatcher::SignalDispatcher()
+    : pimpl_(new Impl)
+{}
+
+SignalDispatcher::~SignalDispatcher()
+{
+    stop();
+}
+
+void
+SignalDispatcher::start()
+{
+    std::lock_guard<std::mutex> lk(pimpl_->mutex);
+    if (pimpl_->running)
+        return;
+    if (pimpl_->thread.joinable())
+        pimpl_->thread.join();
+    pimpl_->running = true;
+    pimpl_->thread = std::thread([this]{ pimpl_->loop(); });
+}
+
+void
+SignalDispatcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(pimpl_->mutex);
+        if (not pimpl_->running)
+            return;
+        pimpl_->running = false;
+    }
+    pimpl_->cv.notify_all();
+    pimpl_->notFull.notify_all();
+    // a client callback may stop the daemon
+    if (pimpl_->thread.get_id() == std::this_thread::get_id())
+        pimpl_->thread.detach();
+    else if (pimpl_->thread.joinable())
+        pimpl_->thread.join();
+}
+
+bool
+SignalDispatcher::post(std::function<void()>&& cb, std::string&& key)
+{
+    auto& d = *pimpl_;
+    std::unique_lock<std::mutex> lk(d.mutex);
+    if (not d.running)
+        return false;
+
+    if (not key.empty()) {
+        auto it = d.pending.find(key);
+        if (it != d.pending.end()) {
+            // keep the position of the pending signal, with the latest values
+            it->second->cb = std::move(cb);
+            ++d.posted;
+            ++d.coalesced;
+            return true;
+        }
+        if (d.queue.size() >= MAX_QUEUED_SIGNALS) {
+            ++d.posted;
+            ++d.dropped;
+            return true;
+        }
+    } else if (d.queue.size() >= MAX_QUEUED_SIGNALS) {
+        // callbacks must not wait for themselves
+        if (d.thread.get_id() == std::this_thread::get_id())
+            return false;
+        d.notFull.wait(lk, [&]{ return not d.running or d.queue.size() < MAX_QUEUED_SIGNALS; });
+        if (not d.running)
+            return false;
+    }
+
+    ++d.posted;
+    d.queue.emplace_back(Impl::Entry {std::move(cb), std::move(key), clock::now()});
+    if (not d.queue.back().key.empty())
+        d.pending.emplace(d.queue.back().key, &d.queue.back());
+    lk.unlock();
+    d.cv.notify_one();
+    return true;
+}
+
+SignalDispatcher::Stats
+SignalDispatcher::getStats() const
+{
+    const auto& d = *pimpl_;
+    std::lock_guard<std::mutex> lk(d.mutex);
+    return {
+        d.posted,
+        d.dispatched,
+        d.coalesced,
+        d.dropped,
+        d.queue.size(),
+        d.latencyTotal,
+        d.latencyMax
+    };
+}
+
 }; // namespace ring
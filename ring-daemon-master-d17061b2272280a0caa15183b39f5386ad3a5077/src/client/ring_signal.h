@@ -34,6 +34,7 @@
 
 #include "dring.h"
 #include "logger.h"
+#include "noncopyable.h"
 
 #ifdef __APPLE__
 #include <TargetConditionals.h>
@@ -44,6 +45,9 @@
 #include <map>
 #include <utility>
 #include <string>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
 
 namespace ring {
 
@@ -51,13 +55,94 @@ using SignalHandlerMap = std::map<std::string, std::shared_ptr<DRing::CallbackWr
 extern SignalHandlerMap& getSignalHandlers();
 
 /*
- * Find related user given callback and call it with given
- * arguments.
+ * Handler slot of signal Ts.
+ * Entries of the handler map are never erased: the lookup by name is done
+ * once per signal type, not on every emission.
+ */
+template <typename Ts>
+const std::shared_ptr<DRing::CallbackWrapperBase>&
+getSignalHandler()
+{
+    static const auto& handler = getSignalHandlers().at(Ts::name);
+    return handler;
+}
+
+/*
+ * Runs client callbacks on its own thread, in emission order.
+ * The queue is bounded: emitters wait when it is full, except for
+ * high-rate signals, which are dropped instead.
+ */
+class SignalDispatcher {
+    public:
+        struct Stats {
+            uint64_t posted;
+            uint64_t dispatched;
+            /** Replaced by a newer signal before being dispatched */
+            uint64_t coalesced;
+            /** High-rate signals dropped on a full queue */
+            uint64_t dropped;
+            uint64_t queued;
+            /** Time spent by signals in the queue */
+            uint64_t latencyTotalUs;
+            uint64_t latencyMaxUs;
+        };
+
+        static SignalDispatcher& instance();
+
+        void start();
+
+        /** Dispatch pending signals and stop the thread */
+        void stop();
+
+        /**
+         * Queue cb, or return false if the caller must run it.
+         * A pending signal with the same non-empty coalesceKey is replaced.
+         */
+        bool post(std::function<void()>&& cb, std::string&& coalesceKey = {});
+
+        Stats getStats() const;
+
+    private:
+        NON_COPYABLE(SignalDispatcher);
+        SignalDispatcher();
+        ~SignalDispatcher();
+
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+};
+
+/*
+ * High-rate signals: a pending one is replaced by a newer one
+ * with the same first argument.
  */
+template <typename Ts> struct SignalCoalescing : std::false_type {};
+template <> struct SignalCoalescing<DRing::CallSignal::SmartInfo> : std::true_type {};
+template <> struct SignalCoalescing<DRing::CallSignal::UpdatePlaybackScale> : std::true_type {};
+template <> struct SignalCoalescing<DRing::ConfigurationSignal::VolumeChanged> : std::true_type {};
+
+/*
+ * Signals returning data to the daemon through pointers, or a result,
+ * are always run by the emitter.
+ */
+template <typename... Args> struct SignalHasPointer : std::false_type {};
+template <typename A, typename... Args>
+struct SignalHasPointer<A, Args...>
+    : std::integral_constant<bool, std::is_pointer<A>::value or SignalHasPointer<Args...>::value> {};
+
+template <typename F> struct SignalIsSynchronous;
+template <typename R, typename... Args>
+struct SignalIsSynchronous<R(Args...)>
+    : std::integral_constant<bool, not std::is_void<R>::value or SignalHasPointer<Args...>::value> {};
+
+inline std::string signalKey() { return {}; }
+template <typename... Args>
+std::string signalKey(const std::string& first, const Args&...) { return first; }
+template <typename First, typename... Args>
+std::string signalKey(const First&, const Args&...) { return {}; }
+
 template <typename Ts, typename ...Args>
-static void emitSignal(Args...args) {
-    const auto& handlers = getSignalHandlers();
-    if (auto cb = *DRing::CallbackWrapper<typename Ts::cb_type>(handlers.at(Ts::name))) {
+static void callSignal(Args...args) {
+    if (auto cb = *DRing::CallbackWrapper<typename Ts::cb_type>(getSignalHandler<Ts>())) {
         try {
             cb(args...);
         } catch (std::exception& e) {
@@ -66,6 +151,23 @@ static void emitSignal(Args...args) {
     }
 }
 
+/*
+ * Find related user given callback and call it with given
+ * arguments, from the signal dispatcher thread if started.
+ */
+template <typename Ts, typename ...Args>
+static void emitSignal(Args...args) {
+    if (not SignalIsSynchronous<typename Ts::cb_type>::value) {
+        std::string key;
+        if (SignalCoalescing<Ts>::value)
+            key = std::string(Ts::name) + '/' + signalKey(args...);
+        if (SignalDispatcher::instance().post([args...]{ callSignal<Ts>(args...); },
+                                              std::move(key)))
+            return;
+    }
+    callSignal<Ts>(args...);
+}
+
 template <typename Ts>
 std::pair<std::string, std::shared_ptr<DRing::CallbackWrapper<typename Ts::cb_type>>>
 exported_callback() {
@@ -30,7 +30,9 @@
 #include "manager.h"
 #include "system_codec_container.h"
 #include "video/sinkclient.h"
+#include "video/video_frame_pool.h"
 #include "client/ring_signal.h"
+#include "string_utils.h"
 
 #include <functional>
 #include <memory>
@@ -181,6 +183,20 @@ setDecodingAccelerated(bool state)
 #endif
 }
 
+std::map<std::string, std::string>
+getFramePoolStats()
+{
+    const auto stats = ring::video::VideoFramePool::instance().getStats();
+    return {
+        {"frameRequests", ring::to_string(stats.frameRequests)},
+        {"frameHits", ring::to_string(stats.frameHits)},
+        {"liveFrames", ring::to_string(stats.liveFrames)},
+        {"bufferRequests", ring::to_string(stats.bufferRequests)},
+        {"bufferHits", ring::to_string(stats.bufferHits)},
+        {"liveBuffers", ring::to_string(stats.liveBuffers)},
+    };
+}
+
 #if defined(__ANDROID__) || defined(RING_UWP)
 void
 addVideoDevice(const std::string &node, std::vector<std::map<std::string, std::string>> const * devInfo)
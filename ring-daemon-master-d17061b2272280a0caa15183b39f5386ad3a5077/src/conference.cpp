@@ -44,6 +44,7 @@ Conference::Conference()
     : id_(Manager::instance().getNewCallID())
     , confState_(ACTIVE_ATTACHED)
     , participants_()
+    , recordTracks_(Manager::instance().audioPreference.getRecordTracks())
 #ifdef RING_VIDEO
     , videoMixer_(nullptr)
 #endif
@@ -80,6 +81,12 @@ void Conference::add(const std::string &participant_id)
         else
             RING_ERR("no call associate to participant %s", participant_id.c_str());
 #endif // RING_VIDEO
+        if (isRecording()) {
+            Manager::instance().getRingBufferPool().bindHalfDuplexOut(recAudio_->getRecorderID(),
+                                                                      participant_id);
+            if (recordTracks_)
+                startTrack(participant_id);
+        }
     }
 }
 
@@ -90,6 +97,12 @@ void Conference::remove(const std::string &participant_id)
         if (auto call = Manager::instance().callFactory.getCall<SIPCall>(participant_id))
             call->getVideoRtp().exitConference();
 #endif // RING_VIDEO
+        if (isRecording()) {
+            Manager::instance().getRingBufferPool().unBindHalfDuplexOut(recAudio_->getRecorderID(),
+                                                                        participant_id);
+            if (recordTracks_)
+                stopTrack(participant_id);
+        }
     }
 }
 
@@ -164,9 +177,56 @@ bool Conference::toggleRecording()
         rbPool.unBindHalfDuplexOut(process_id, RingBufferPool::DEFAULT_ID);
     }
 
+    if (recordTracks_) {
+        for (const auto &item : participants_) {
+            if (startRecording)
+                startTrack(item);
+            else
+                stopTrack(item);
+        }
+        if (startRecording)
+            startTrack(RingBufferPool::DEFAULT_ID);
+        else
+            stopTrack(RingBufferPool::DEFAULT_ID);
+    }
+
     return startRecording;
 }
 
+void Conference::startTrack(const std::string &source_id)
+{
+    std::lock_guard<std::mutex> lk(tracksMutex_);
+    auto& track = tracks_[source_id];
+    if (not track) {
+        std::string name = "local";
+        if (source_id != RingBufferPool::DEFAULT_ID) {
+            auto details = Manager::instance().getCallDetails(source_id);
+            name = details["PEER_NUMBER"].empty() ? source_id : details["PEER_NUMBER"];
+        }
+        track.reset(new AudioRecord);
+        track->setFileFormat(Manager::instance().audioPreference.getRecordFormat());
+        track->initTrackFilename(*recAudio_, name);
+    }
+
+    if (not track->isRecording()) {
+        track->setSndFormat(Manager::instance().getRingBufferPool().getInternalAudioFormat());
+        track->toggleRecording();
+    }
+
+    // Only the audio received from this source
+    Manager::instance().getRingBufferPool().bindHalfDuplexOut(track->getRecorderID(), source_id);
+}
+
+void Conference::stopTrack(const std::string &source_id)
+{
+    std::lock_guard<std::mutex> lk(tracksMutex_);
+    const auto it = tracks_.find(source_id);
+    if (it == tracks_.end())
+        return;
+    Manager::instance().getRingBufferPool().unBindHalfDuplexOut(it->second->getRecorderID(), source_id);
+    it->second->stopRecording();
+}
+
 std::string Conference::getConfID() const {
     return id_;
 }
@@ -25,6 +25,8 @@
 #endif
 
 #include <set>
+#include <map>
+#include <mutex>
 #include <string>
 #include <memory>
 
@@ -38,6 +40,8 @@ class VideoMixer;
 }
 #endif
 
+class AudioRecord;
+
 typedef std::set<std::string> ParticipantSet;
 
 class Conference : public Recordable {
@@ -101,7 +105,9 @@ class Conference : public Recordable {
         getDisplayNames() const;
 
         /**
-         * Start/stop recording toggle
+         * Start/stop recording toggle.
+         * If enabled in the preferences, each participant and the local
+         * capture are also recorded in their own file.
          */
         virtual bool toggleRecording();
 
@@ -110,10 +116,23 @@ class Conference : public Recordable {
 #endif
 
     private:
+        /**
+         * Start or resume the recording of a participant track,
+         * RingBufferPool::DEFAULT_ID for the local capture
+         */
+        void startTrack(const std::string &source_id);
+        void stopTrack(const std::string &source_id);
+
         std::string id_;
         ConferenceState confState_;
         ParticipantSet participants_;
 
+        /** Record separate tracks, read from the preferences on creation */
+        const bool recordTracks_;
+        /** Participant tracks by source, created on demand */
+        std::map<std::string, std::unique_ptr<AudioRecord>> tracks_;
+        std::mutex tracksMutex_;
+
 #ifdef RING_VIDEO
         std::shared_ptr<video::VideoMixer> videoMixer_;
 #endif
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "config_writer.h"
+#include "fileutils.h"
+#include "logger.h"
+
+#include <stdexcept>
+
+namespace ring {
+
+constexpr std::chrono::milliseconds ConfigWriter::DELAY;
+
+ConfigWriter::ConfigWriter(const std::string& path, Serializer&& serializer)
+    : path_(path)
+    , serializer_(std::move(serializer))
+{}
+
+ConfigWriter::~ConfigWriter()
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        running_ = false;
+    }
+    cv_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+    flush();
+}
+
+void
+ConfigWriter::schedule()
+{
+    std::thread finished;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (pending_)
+            return;
+        pending_ = true;
+        deadline_ = std::chrono::steady_clock::now() + DELAY;
+        if (not active_ and running_) {
+            // The previous thread has stopped after its last write
+            finished = std::move(thread_);
+            active_ = true;
+            thread_ = std::thread(&ConfigWriter::run, this);
+        }
+    }
+    if (finished.joinable())
+        finished.join();
+    cv_.notify_one();
+}
+
+void
+ConfigWriter::flush()
+{
+    std::lock_guard<std::mutex> write_lk(writeMutex_);
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (not pending_)
+            return;
+        pending_ = false;
+    }
+    write();
+}
+
+void
+ConfigWriter::run()
+{
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (running_ and pending_) {
+        if (cv_.wait_until(lk, deadline_, [this] { return not running_; }))
+            break;
+
+        // flush() may write in the meantime
+        lk.unlock();
+        std::lock_guard<std::mutex> write_lk(writeMutex_);
+        lk.lock();
+        if (not pending_)
+            continue;
+        pending_ = false;
+        lk.unlock();
+        write();
+        lk.lock();
+    }
+    active_ = false;
+}
+
+void
+ConfigWriter::write()
+{
+    RING_DBG("Saving %s", path_.c_str());
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        const auto content = serializer_();
+        if (fileutils::saveFileAtomic(path_, content))
+            RING_DBG("Saved %s (%zu bytes) in %lld ms", path_.c_str(), content.size(),
+                     static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start).count()));
+    } catch (const std::exception& e) {
+        RING_ERR("Could not save %s: %s", path_.c_str(), e.what());
+    }
+}
+
+} // namespace ring
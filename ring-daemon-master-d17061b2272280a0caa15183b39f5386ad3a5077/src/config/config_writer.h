@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ring {
+
+/**
+ * Writes a configuration or cache file from a background thread.
+ *
+ * The writes requested by schedule() within DELAY of the first one are
+ * coalesced: the content is serialized and written once, when the delay
+ * expires. The thread only runs while a write is pending. Files are
+ * replaced atomically, a crash leaves either the previous or the new
+ * content.
+ */
+class ConfigWriter {
+    public:
+        using Serializer = std::function<std::string()>;
+
+        static constexpr std::chrono::milliseconds DELAY {500};
+
+        ConfigWriter(const std::string& path, Serializer&& serializer);
+
+        /** Write what is scheduled */
+        ~ConfigWriter();
+
+        /** Request a write */
+        void schedule();
+
+        /**
+         * Write now if a write is requested, from this thread.
+         * Return once the file is up to date.
+         */
+        void flush();
+
+        const std::string& getPath() const {
+            return path_;
+        }
+
+    private:
+        NON_COPYABLE(ConfigWriter);
+
+        void run();
+
+        /** Must be called with writeMutex_ held */
+        void write();
+
+        const std::string path_;
+        const Serializer serializer_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool pending_ {false};
+        bool running_ {true};
+        /** Whether thread_ is running run() */
+        bool active_ {false};
+        std::chrono::steady_clock::time_point deadline_ {};
+
+        /** Held while serializing and writing */
+        std::mutex writeMutex_;
+
+        std::thread thread_;
+};
+
+} // namespace ring
@@ -72,6 +72,18 @@ std::map<std::string, std::string> getConferenceDetails(const std::string& callI
 void startSmartInfo(uint32_t refreshTimeMs);
 void stopSmartInfo();
 
+/**
+ * Media counters of the given calls, or of all the calls with media if
+ * callIds is empty. Each map has a "callID" key, then for each stream
+ * ("audio.send.", "audio.receive.", "video.send.", "video.receive."):
+ * codec, packets, bytes, lost, jitterUs, frames, processTimeUs,
+ * processTimeMaxUs, queueDepth, width and height for video, and
+ * concealed, discarded and playoutDelayUs for the audio jitter buffer.
+ * Counters are cumulative since the start of the call.
+ */
+std::vector<std::map<std::string, std::string>>
+getCallMediaStats(const std::vector<std::string>& callIds);
+
 /* File Playback methods */
 bool startRecordedFilePlayback(const std::string& filepath);
 void stopRecordedFilePlayback(const std::string& filepath);
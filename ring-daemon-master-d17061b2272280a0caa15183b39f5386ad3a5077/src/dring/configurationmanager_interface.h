@@ -180,6 +180,12 @@ int importAccounts(std::string archivePath, std::string password);
  */
 void connectivityChanged();
 
+/*
+ * Daemon statistics
+ */
+std::map<std::string, std::string> getThreadPoolStats();
+std::map<std::string, std::string> getSignalStats();
+
 struct AudioSignal {
         struct DeviceEvent {
                 constexpr static const char* name = "audioDeviceEvent";
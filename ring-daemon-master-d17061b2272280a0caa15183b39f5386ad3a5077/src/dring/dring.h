@@ -35,6 +35,9 @@ enum InitFlag {
     DRING_FLAG_DEBUG       = 1<<0,
     DRING_FLAG_CONSOLE_LOG = 1<<1,
     DRING_FLAG_AUTOANSWER  = 1<<2,
+    DRING_FLAG_ASYNC_SIGNALS = 1<<3, // run signal callbacks on a dedicated thread
+    DRING_FLAG_ASYNC_LOG   = 1<<4, // print logs from a dedicated thread
+    DRING_FLAG_LOG_RATE_LIMIT = 1<<5, // drop log floods from a same place, errors excepted
 };
 
 /**
@@ -63,9 +66,9 @@ void fini() noexcept;
 
 /**
  * Poll daemon events.
- * This function has to be called by user at a fixed frequency
- * to let daemon checks its internal ressources and io and
- * manages events reported by them.
+ * Deprecated: the daemon now runs its own event loop from start() to
+ * fini(), this function does nothing meanwhile and is kept for
+ * compatibility.
  */
 void pollEvents() noexcept;
 
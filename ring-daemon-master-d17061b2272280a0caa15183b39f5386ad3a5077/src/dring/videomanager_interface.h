@@ -47,6 +47,7 @@ struct SinkTarget {
     using FrameBufferPtr = std::unique_ptr<FrameBuffer>;
     std::function<FrameBufferPtr(std::size_t bytes)> pull;
     std::function<void(FrameBufferPtr)> push;
+    int format {-1};            // as listed by AVPixelFormat, -1 for BGRA (RGBA on Android and OS X)
 };
 
 using VideoCapabilities = std::map<std::string, std::map<std::string, std::vector<std::string>>>;
@@ -80,6 +81,8 @@ void releaseFrame(void* frame);
 bool getDecodingAccelerated();
 void setDecodingAccelerated(bool state);
 
+std::map<std::string, std::string> getFramePoolStats();
+
 // Video signal type definitions
 struct VideoSignal {
         struct DeviceEvent {
@@ -353,6 +353,75 @@ saveFile(const std::string& path,
 #endif
 }
 
+bool
+saveFileAtomic(const std::string& path, const std::string& data, mode_t UNUSED mode)
+{
+    const auto tmp = path + ".tmp";
+#ifndef _WIN32
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd < 0) {
+        RING_ERR("Could not write data to %s: %s", tmp.c_str(), strerror(errno));
+        return false;
+    }
+
+    const char* p = data.data();
+    size_t left = data.size();
+    bool ok = true;
+    while (ok and left) {
+        const auto n = ::write(fd, p, left);
+        if (n < 0) {
+            ok = errno == EINTR;
+            continue;
+        }
+        p += n;
+        left -= n;
+    }
+    ok = ok and ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 and ok;
+    if (not ok) {
+        RING_ERR("Could not write data to %s: %s", tmp.c_str(), strerror(errno));
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+        RING_ERR("Could not rename %s: %s", tmp.c_str(), strerror(errno));
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    // Make the rename durable
+    const auto sep = path.rfind(DIR_SEPARATOR_CH);
+    const auto dir = sep == std::string::npos ? std::string(".") : path.substr(0, sep + 1);
+    const int dirfd = ::open(dir.c_str(), O_RDONLY);
+    if (dirfd >= 0) {
+        ::fsync(dirfd);
+        ::close(dirfd);
+    }
+    return true;
+#else
+    {
+        std::ofstream file(tmp, std::ios::trunc | std::ios::binary);
+        file.write(data.data(), data.size());
+        file.flush();
+        if (not file) {
+            RING_ERR("Could not write data to %s", tmp.c_str());
+            file.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    // rename() doesn't replace an existing file on Windows
+    if (not MoveFileExA(tmp.c_str(), path.c_str(),
+                        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        RING_ERR("Could not rename %s", tmp.c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+#endif
+}
+
 static size_t
 dirent_buf_size(UNUSED DIR* dirp)
 {
@@ -103,6 +103,13 @@ namespace ring { namespace fileutils {
     std::vector<uint8_t> loadFile(const std::string& path, const std::string& default_dir = {});
     void saveFile(const std::string& path, const std::vector<uint8_t>& data, mode_t mode=0644);
 
+    /**
+     * Replace the content of the file at path, atomically: data is written
+     * and synced to a temporary file, then renamed.
+     * Return false if the file is left unchanged.
+     */
+    bool saveFileAtomic(const std::string& path, const std::string& data, mode_t mode=0644);
+
     struct FileHandle {
         int fd;
         const std::string name;
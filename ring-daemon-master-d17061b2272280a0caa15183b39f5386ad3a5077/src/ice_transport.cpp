@@ -24,6 +24,8 @@
 #include "sip/sip_utils.h"
 #include "manager.h"
 #include "upnp/upnp_control.h"
+#include "string_utils.h"
+#include "noncopyable.h"
 
 #include <pjlib.h>
 #include <msgpack.hpp>
@@ -130,6 +132,134 @@ add_turn_server(pj_pool_t& pool, pj_ice_strans_cfg& cfg, const TurnServerInfo& i
 
 //##################################################################################################
 
+/**
+ * Thread handling the IO and timer events of several IceTransport,
+ * through an ioqueue and a timer heap they share.
+ *
+ * Each round polls the timers then the ioqueue once. A poll handles at
+ * most one pending event per socket, so a busy transport can't starve
+ * the others.
+ */
+class IceReactor {
+public:
+    IceReactor(pj_pool_factory* pf, unsigned index);
+    ~IceReactor();
+
+    pj_ioqueue_t* getIOQueue() const { return ioqueue_; }
+    pj_timer_heap_t* getTimerHeap() const { return timerHeap_; }
+
+    /**
+     * Room left for the sockets of a transport
+     */
+    bool reserve(unsigned handles);
+    void release(unsigned handles);
+    unsigned load() const;
+
+private:
+    NON_COPYABLE(IceReactor);
+
+    // Upper bound of a round, so quitting doesn't wait for too long
+    static constexpr unsigned MAX_POLL_MSEC {100};
+    static constexpr unsigned MAX_HANDLES {1024};
+
+    void loop();
+
+    std::unique_ptr<pj_pool_t, decltype(pj_pool_release)&> pool_;
+    pj_ioqueue_t* ioqueue_ {nullptr};
+    pj_timer_heap_t* timerHeap_ {nullptr};
+    unsigned maxHandles_ {0};
+
+    mutable std::mutex mutex_ {};
+    unsigned handles_ {0};
+    unsigned transports_ {0};
+
+    std::atomic_bool quit_ {false};
+    std::thread thread_;
+};
+
+IceReactor::IceReactor(pj_pool_factory* pf, unsigned index)
+    : pool_(nullptr, pj_pool_release)
+{
+    const auto name = "IceReactor" + ring::to_string(index) + ".pool";
+    pool_.reset(pj_pool_create(pf, name.c_str(), 4096, 4096, nullptr));
+    if (not pool_)
+        throw std::runtime_error("pj_pool_create() failed");
+
+    // Depends on how pjlib was built, fall back to its default
+    maxHandles_ = MAX_HANDLES;
+    if (pj_ioqueue_create(pool_.get(), maxHandles_, &ioqueue_) != PJ_SUCCESS) {
+        maxHandles_ = min(PJ_IOQUEUE_MAX_HANDLES, 64);
+        TRY( pj_ioqueue_create(pool_.get(), maxHandles_, &ioqueue_) );
+    }
+    TRY( pj_timer_heap_create(pool_.get(), 1000, &timerHeap_) );
+
+    thread_ = std::thread([this]{
+            sip_utils::register_thread();
+            loop();
+        });
+    RING_DBG("[ice] reactor %u started, %u handles", index, maxHandles_);
+}
+
+IceReactor::~IceReactor()
+{
+    quit_ = true;
+    if (thread_.joinable())
+        thread_.join();
+
+    if (transports_)
+        RING_WARN("[ice] reactor destroyed with %u transports", transports_);
+
+    pj_ioqueue_destroy(ioqueue_);
+    pj_timer_heap_destroy(timerHeap_);
+}
+
+bool
+IceReactor::reserve(unsigned handles)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (handles_ + handles > maxHandles_)
+        return false;
+    handles_ += handles;
+    ++transports_;
+    return true;
+}
+
+void
+IceReactor::release(unsigned handles)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    handles_ -= handles;
+    --transports_;
+}
+
+unsigned
+IceReactor::load() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return handles_;
+}
+
+void
+IceReactor::loop()
+{
+    const pj_time_val max_timeout = {0, MAX_POLL_MSEC};
+
+    while (not quit_) {
+        pj_time_val timeout = {0, 0};
+        pj_timer_heap_poll(timerHeap_, &timeout);
+        if (PJ_TIME_VAL_GT(timeout, max_timeout))
+            timeout = max_timeout;
+
+        if (pj_ioqueue_poll(ioqueue_, &timeout) < 0) {
+            const auto err = pj_get_os_error();
+            RING_DBG("[ice] reactor ioqueue error %d: %s", err, sip_utils::sip_strerror(err).c_str());
+            std::this_thread::sleep_for(std::chrono::milliseconds(PJ_TIME_VAL_MSEC(timeout)));
+        }
+    }
+}
+
+//##################################################################################################
+
 IceTransport::Packet::Packet(void *pkt, pj_size_t size)
     : data(new char[size]), datalen(size)
 {
@@ -143,9 +273,12 @@ IceTransport::cb_on_rx_data(pj_ice_strans* ice_st,
                             const pj_sockaddr_t* /*src_addr*/,
                             unsigned /*src_addr_len*/)
 {
-    if (auto tr = static_cast<IceTransport*>(pj_ice_strans_get_user_data(ice_st)))
-        tr->onReceiveData(comp_id, pkt, size);
-    else
+    if (auto tr = static_cast<IceTransport*>(pj_ice_strans_get_user_data(ice_st))) {
+        if (tr->enterCallback()) {
+            tr->onReceiveData(comp_id, pkt, size);
+            leaveCallback(tr);
+        }
+    } else
         RING_WARN("null IceTransport");
 }
 
@@ -154,12 +287,42 @@ IceTransport::cb_on_ice_complete(pj_ice_strans* ice_st,
                                  pj_ice_strans_op op,
                                  pj_status_t status)
 {
-    if (auto tr = static_cast<IceTransport*>(pj_ice_strans_get_user_data(ice_st)))
-        tr->onComplete(ice_st, op, status);
-    else
+    if (auto tr = static_cast<IceTransport*>(pj_ice_strans_get_user_data(ice_st))) {
+        if (tr->enterCallback()) {
+            tr->onComplete(ice_st, op, status);
+            leaveCallback(tr);
+        }
+    } else
         RING_WARN("null IceTransport");
 }
 
+// Transport whose callback runs on this thread, it may destroy it
+static thread_local const IceTransport* callbackTransport {nullptr};
+
+bool
+IceTransport::enterCallback()
+{
+    // Pairs with the destructor: either it sees the callback, or the
+    // callback sees it
+    ++callbacks_;
+    if (destroying_) {
+        --callbacks_;
+        return false;
+    }
+    callbackTransport = this;
+    return true;
+}
+
+void
+IceTransport::leaveCallback(IceTransport* tr)
+{
+    // Unset by the destructor if the callback destroyed the transport
+    if (callbackTransport != tr)
+        return;
+    callbackTransport = nullptr;
+    --tr->callbacks_;
+}
+
 
 IceTransport::IceTransport(const char* name, int component_count, bool master,
                            const IceTransportOptions& options)
@@ -195,25 +358,37 @@ IceTransport::IceTransport(const char* name, int component_count, bool master,
     for (auto& server : options.turnServers)
         add_turn_server(*pool_, config_, server);
 
-    static constexpr auto IOQUEUE_MAX_HANDLES = min(PJ_IOQUEUE_MAX_HANDLES, 64);
-    TRY( pj_timer_heap_create(pool_.get(), 100, &config_.stun_cfg.timer_heap) );
-    TRY( pj_ioqueue_create(pool_.get(), IOQUEUE_MAX_HANDLES, &config_.stun_cfg.ioqueue) );
+    // One socket per component and per STUN/TURN transport
+    reactorHandles_ = component_count * (config_.stun_tp_cnt + config_.turn_tp_cnt);
+    reactor_ = iceTransportFactory.acquireReactor(reactorHandles_);
+    if (reactor_) {
+        config_.stun_cfg.ioqueue = reactor_->getIOQueue();
+        config_.stun_cfg.timer_heap = reactor_->getTimerHeap();
+    } else {
+        static constexpr auto IOQUEUE_MAX_HANDLES = min(PJ_IOQUEUE_MAX_HANDLES, 64);
+        TRY( pj_timer_heap_create(pool_.get(), 100, &config_.stun_cfg.timer_heap) );
+        TRY( pj_ioqueue_create(pool_.get(), IOQUEUE_MAX_HANDLES, &config_.stun_cfg.ioqueue) );
+    }
 
     pj_ice_strans* icest = nullptr;
     pj_status_t status = pj_ice_strans_create(name, &config_, component_count,
                                               this, &icecb, &icest);
 
     if (status != PJ_SUCCESS || icest == nullptr) {
+        if (reactor_)
+            reactor_->release(reactorHandles_);
         throw std::runtime_error("pj_ice_strans_create() failed");
     }
 
     // Must be created after any potential failure
-    thread_ = std::thread([this]{
-            sip_utils::register_thread();
-            while (not threadTerminateFlags_) {
-                handleEvents(500); // limit polling to 500ms
-            }
-        });
+    if (not reactor_) {
+        thread_ = std::thread([this]{
+                sip_utils::register_thread();
+                while (not threadTerminateFlags_) {
+                    handleEvents(500); // limit polling to 500ms
+                }
+            });
+    }
 }
 
 IceTransport::~IceTransport()
@@ -224,6 +399,23 @@ IceTransport::~IceTransport()
     if (thread_.joinable())
         thread_.join();
 
+    if (reactor_) {
+        // The shared reactor may be running one of our callbacks: make the
+        // next ones return at once and wait for the running ones, not for
+        // a whole round of the reactor, before tearing down the session
+        destroying_ = true;
+        unsigned own = 0;
+        if (callbackTransport == this) {
+            callbackTransport = nullptr;
+            own = 1;
+        }
+        while (callbacks_ > own)
+            std::this_thread::yield();
+        reactor_->release(reactorHandles_);
+        icest_.reset();
+        return;
+    }
+
     icest_.reset(); // must be done before ioqueue/timer destruction
 
     if (config_.stun_cfg.ioqueue)
@@ -1009,10 +1201,47 @@ IceTransportFactory::IceTransportFactory()
 
 IceTransportFactory::~IceTransportFactory()
 {
+    reactors_.clear();
     pool_.reset();
     pj_caching_pool_destroy(&cp_);
 }
 
+void
+IceTransportFactory::setReactorThreads(unsigned threads)
+{
+    std::lock_guard<std::mutex> lk(reactorMutex_);
+    reactorThreads_ = threads;
+}
+
+IceReactor*
+IceTransportFactory::acquireReactor(unsigned handles)
+{
+    std::lock_guard<std::mutex> lk(reactorMutex_);
+
+    // Reactors are only created when needed, and kept until the end:
+    // transports may still use them after a reduction of their number.
+    while (reactors_.size() < reactorThreads_) {
+        try {
+            reactors_.emplace_back(new IceReactor(&cp_.factory, reactors_.size()));
+        } catch (const std::exception& e) {
+            RING_ERR("[ice] can't create reactor: %s", e.what());
+            break;
+        }
+    }
+
+    std::vector<IceReactor*> candidates;
+    const auto n = std::min<size_t>(reactorThreads_, reactors_.size());
+    for (size_t i = 0; i < n; ++i)
+        candidates.push_back(reactors_[i].get());
+    std::sort(candidates.begin(), candidates.end(),
+              [](const IceReactor* a, const IceReactor* b) { return a->load() < b->load(); });
+
+    for (auto reactor : candidates)
+        if (reactor->reserve(handles))
+            return reactor;
+    return nullptr;
+}
+
 std::shared_ptr<IceTransport>
 IceTransportFactory::createTransport(const char* name, int component_count,
                                      bool master,
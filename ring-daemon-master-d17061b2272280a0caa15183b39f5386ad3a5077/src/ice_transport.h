@@ -45,6 +45,7 @@ class Controller;
 }
 
 class IceTransport;
+class IceReactor;
 
 using IceTransportCompleteCb = std::function<void(IceTransport&, bool)>;
 using IceRecvCb = std::function<ssize_t(unsigned char* buf, size_t len)>;
@@ -226,6 +227,16 @@ class IceTransport {
                                        pj_ice_strans_op op,
                                        pj_status_t status);
 
+        /**
+         * Bracket the work of the callbacks above. enterCallback() returns
+         * false once the transport is being destroyed, the callback must
+         * then return without using it.
+         */
+        bool enterCallback();
+        static void leaveCallback(IceTransport* tr);
+        std::atomic_bool destroying_ {false};
+        std::atomic<unsigned> callbacks_ {0};
+
         struct IceSTransDeleter {
                 void operator ()(pj_ice_strans* ptr) {
                     pj_ice_strans_stop_ice(ptr);
@@ -297,7 +308,10 @@ class IceTransport {
 
         std::unique_ptr<upnp::Controller> upnp_;
 
-        // IO/Timer events are handled by following thread
+        // IO/Timer events are handled by a reactor shared with other
+        // transports, or by following thread if none had room
+        IceReactor* reactor_ {nullptr};
+        unsigned reactorHandles_ {0};
         std::thread thread_;
         std::atomic_bool threadTerminateFlags_ {false};
         void handleEvents(unsigned max_msec);
@@ -319,10 +333,31 @@ class IceTransportFactory {
         pj_ice_strans_cfg getIceCfg() const { return ice_cfg_; }
         pj_pool_factory* getPoolFactory() { return &cp_.factory; }
 
+        /**
+         * Set the number of reactor threads handling the IO and timer
+         * events of transports, shared by all of them.
+         * 0 gives each transport its own thread, ioqueue and timer heap.
+         * Only applies to transports created afterwards.
+         */
+        void setReactorThreads(unsigned threads);
+
+        /**
+         * Return the least loaded reactor with room for a transport
+         * using the given number of sockets, or nullptr.
+         * The room must be given back with IceReactor::release().
+         */
+        IceReactor* acquireReactor(unsigned handles);
+
     private:
+        static constexpr unsigned DEFAULT_REACTOR_THREADS {2};
+
         pj_caching_pool cp_;
         std::unique_ptr<pj_pool_t, decltype(pj_pool_release)&> pool_;
         pj_ice_strans_cfg ice_cfg_;
+
+        std::mutex reactorMutex_ {};
+        unsigned reactorThreads_ {DEFAULT_REACTOR_THREADS};
+        std::vector<std::unique_ptr<IceReactor>> reactors_ {};
 };
 
 };
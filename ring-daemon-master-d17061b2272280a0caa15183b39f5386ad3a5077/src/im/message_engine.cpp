@@ -20,21 +20,29 @@
 #include "message_engine.h"
 #include "sip/sipaccountbase.h"
 #include "manager.h"
+#include "thread_pool.h"
 
 #include "client/ring_signal.h"
 #include "dring/account_const.h"
+#include "fileutils.h"
 
 #include <json/json.h>
 
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
 namespace ring {
 namespace im {
 
 static std::uniform_int_distribution<MessageToken> udist {1};
 const std::chrono::minutes MessageEngine::RETRY_PERIOD = std::chrono::minutes(1);
+const std::chrono::milliseconds MessageEngine::SYNC_DELAY = std::chrono::milliseconds(200);
+constexpr size_t MessageEngine::COMPACT_MIN_RECORDS;
 
-MessageEngine::MessageEngine(SIPAccountBase& acc, const std::string& path) : account_(acc), savePath_(path)
+MessageEngine::MessageEngine(SIPAccountBase& acc, const std::string& path,
+                             std::chrono::milliseconds retryPeriod)
+    : account_(acc), retryPeriod_(retryPeriod), savePath_(path), journal_(path + ".journal")
 {}
 
 MessageToken
@@ -45,14 +53,18 @@ MessageEngine::sendMessage(const std::string& to, const std::map<std::string, st
     MessageToken token;
     {
         std::lock_guard<std::mutex> lock(messagesMutex_);
+        // tokens must not collide with persisted messages
+        if (not journal_.isOpen())
+            openJournal();
         do {
             token = udist(account_.rand_);
         } while (messages_.find(token) != messages_.end());
         auto m = messages_.emplace(token, Message{});
         m.first->second.to = to;
         m.first->second.payloads = payloads;
+        retryQueue_.emplace(m.first->second.last_op + retryPeriod_, token);
+        persist(token, m.first->second, true);
     }
-    save();
     runOnMainThread([this,token]() {
         retrySend();
     });
@@ -76,15 +88,7 @@ MessageEngine::reschedule()
 MessageEngine::clock::time_point
 MessageEngine::nextEvent() const
 {
-    auto next = clock::time_point::max();
-    for (const auto& m : messages_) {
-        if (m.second.status == MessageStatus::UNKNOWN || m.second.status == MessageStatus::IDLE) {
-            auto next_op = m.second.last_op + RETRY_PERIOD;
-            if (next_op < next)
-                next = next_op;
-        }
-    }
-    return next;
+    return retryQueue_.empty() ? clock::time_point::max() : retryQueue_.begin()->first;
 }
 
 void
@@ -99,15 +103,18 @@ MessageEngine::retrySend()
     {
         std::lock_guard<std::mutex> lock(messagesMutex_);
         auto now = clock::now();
-        for (auto m = messages_.begin(); m != messages_.end(); ++m) {
+        while (not retryQueue_.empty() and retryQueue_.begin()->first <= now) {
+            const auto token = retryQueue_.begin()->second;
+            retryQueue_.erase(retryQueue_.begin());
+            auto m = messages_.find(token);
+            if (m == messages_.end())
+                continue;
             if (m->second.status == MessageStatus::UNKNOWN || m->second.status == MessageStatus::IDLE) {
-                auto next_op = m->second.last_op + RETRY_PERIOD;
-                if (next_op <= now) {
-                    m->second.status = MessageStatus::SENDING;
-                    m->second.retried++;
-                    m->second.last_op = clock::now();
-                    pending.emplace_back(PendingMsg {m->first, m->second.to, m->second.payloads});
-                }
+                m->second.status = MessageStatus::SENDING;
+                m->second.retried++;
+                m->second.last_op = now;
+                persist(token, m->second);
+                pending.emplace_back(PendingMsg {m->first, m->second.to, m->second.payloads});
             }
         }
     }
@@ -131,6 +138,25 @@ MessageEngine::getStatus(MessageToken t) const
     return (m == messages_.end()) ? MessageStatus::UNKNOWN : m->second.status;
 }
 
+unsigned
+MessageEngine::getRetried(MessageToken t) const
+{
+    std::lock_guard<std::mutex> lock(messagesMutex_);
+    const auto m = messages_.find(t);
+    return (m == messages_.end()) ? 0 : m->second.retried;
+}
+
+std::vector<MessageToken>
+MessageEngine::getRetryQueue() const
+{
+    std::lock_guard<std::mutex> lock(messagesMutex_);
+    std::vector<MessageToken> tokens;
+    tokens.reserve(retryQueue_.size());
+    for (const auto& r : retryQueue_)
+        tokens.emplace_back(r.second);
+    return tokens;
+}
+
 void
 MessageEngine::onMessageSent(MessageToken token, bool ok)
 {
@@ -141,6 +167,7 @@ MessageEngine::onMessageSent(MessageToken token, bool ok)
         if (f->second.status == MessageStatus::SENDING) {
             if (ok) {
                 f->second.status = MessageStatus::SENT;
+                persist(token, f->second);
                 RING_DBG("[message %" PRIx64 "] status changed to SENT", token);
                 emitSignal<DRing::ConfigurationSignal::AccountMessageStatusChanged>(account_.getAccountID(),
                                                                              token,
@@ -148,6 +175,7 @@ MessageEngine::onMessageSent(MessageToken token, bool ok)
                                                                              static_cast<int>(DRing::Account::MessageStates::SENT));
             } else if (f->second.retried >= MAX_RETRIES) {
                 f->second.status = MessageStatus::FAILURE;
+                persist(token, f->second);
                 RING_WARN("[message %" PRIx64 "] status changed to FAILURE", token);
                 emitSignal<DRing::ConfigurationSignal::AccountMessageStatusChanged>(account_.getAccountID(),
                                                                              token,
@@ -155,6 +183,8 @@ MessageEngine::onMessageSent(MessageToken token, bool ok)
                                                                              static_cast<int>(DRing::Account::MessageStates::FAILURE));
             } else {
                 f->second.status = MessageStatus::IDLE;
+                persist(token, f->second);
+                retryQueue_.emplace(f->second.last_op + retryPeriod_, token);
                 RING_DBG("[message %" PRIx64 "] status changed to IDLE", token);
                 reschedule();
             }
@@ -172,6 +202,62 @@ void
 MessageEngine::load()
 {
     std::lock_guard<std::mutex> lock(messagesMutex_);
+    if (not journal_.isOpen())
+        openJournal();
+    reschedule();
+}
+
+void
+MessageEngine::save()
+{
+    std::lock_guard<std::mutex> lock(messagesMutex_);
+    if (not journal_.isOpen())
+        openJournal();
+    else
+        compact();
+}
+
+void
+MessageEngine::openJournal()
+{
+    // Messages of this session, if a previous opening failed, are newer
+    std::map<MessageToken, Message> loaded;
+    loadLegacy(loaded);
+
+    const auto records = journal_.replay([&](const std::string& record) {
+        Json::Value jmsg;
+        Json::Reader reader;
+        if (not reader.parse(record, jmsg)) {
+            RING_WARN("[Account %s] can't parse message record", account_.getAccountID().c_str());
+            return;
+        }
+        MessageToken token {0};
+        std::istringstream iss(jmsg["id"].asString());
+        iss >> std::hex >> token;
+        if (token)
+            applyRecord(loaded, token, jmsg);
+    });
+    for (auto& m : loaded)
+        messages_.emplace(m.first, std::move(m.second));
+
+    retryQueue_.clear();
+    for (const auto& m : messages_)
+        if (m.second.status == MessageStatus::UNKNOWN || m.second.status == MessageStatus::IDLE)
+            retryQueue_.emplace(m.second.last_op + retryPeriod_, m.first);
+
+    RING_DBG("[Account %s] loaded %zu messages from %zu records of %s", account_.getAccountID().c_str(),
+             messages_.size(), records, journal_.getPath().c_str());
+
+    // Drop the replayed history, and what follows an interrupted append
+    if (compact())
+        std::remove(savePath_.c_str());
+}
+
+void
+MessageEngine::loadLegacy(std::map<MessageToken, Message>& messages) const
+{
+    if (not fileutils::isFile(savePath_))
+        return;
     try {
         std::ifstream file;
         file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -182,65 +268,110 @@ MessageEngine::load()
         if (!reader.parse(file, root))
             throw std::runtime_error("can't parse JSON.");
 
-        long unsigned loaded {0};
         for (auto i = root.begin(); i != root.end(); ++i) {
-            const auto& jmsg = *i;
             MessageToken token;
             std::istringstream iss(i.key().asString());
             iss >> std::hex >> token;
-            Message msg;
-            msg.status = (MessageStatus)jmsg["status"].asInt();
-            msg.to = jmsg["to"].asString();
-            auto wall_time = std::chrono::system_clock::from_time_t(jmsg["last_op"].asInt64());
-            msg.last_op = clock::now() + (wall_time - std::chrono::system_clock::now());
-            msg.retried = jmsg.get("retried", 0).asUInt();
-            const auto& pl = jmsg["payload"];
-            for (auto p = pl.begin(); p != pl.end(); ++p)
-                msg.payloads[p.key().asString()] = p->asString();
-           messages_.emplace(token, std::move(msg));
-           loaded++;
+            applyRecord(messages, token, *i);
         }
-        RING_DBG("[Account %s] loaded %lu messages from %s", account_.getAccountID().c_str(), loaded, savePath_.c_str());
-
-        // everything whent fine, removing the file
-        std::remove(savePath_.c_str());
+        RING_DBG("[Account %s] loaded %u messages from %s", account_.getAccountID().c_str(), root.size(), savePath_.c_str());
     } catch (const std::exception& e) {
         RING_ERR("[Account %s] couldn't load messages from %s: %s", account_.getAccountID().c_str(), savePath_.c_str(), e.what());
     }
-    reschedule();
 }
 
 void
-MessageEngine::save() const
+MessageEngine::applyRecord(std::map<MessageToken, Message>& messages, MessageToken token, const Json::Value& jmsg)
 {
-    try {
-        Json::Value root(Json::objectValue);
-        std::unique_lock<std::mutex> lock(messagesMutex_);
-        for (auto& c : messages_) {
-            auto& v = c.second;
-            Json::Value msg;
-            std::ostringstream msgsId;
-            msgsId << std::hex << c.first;
-            msg["status"] = (int)(v.status == MessageStatus::SENDING ? MessageStatus::IDLE : v.status);
-            msg["to"] = v.to;
-            auto wall_time = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(v.last_op - clock::now());
-            msg["last_op"] = (Json::Value::Int64) std::chrono::system_clock::to_time_t(wall_time);
-            msg["retried"] = v.retried;
-            auto& payloads = msg["payload"];
-            for (const auto& p : v.payloads)
-                payloads[p.first] = p.second;
-            root[msgsId.str()] = std::move(msg);
-        }
-        lock.unlock();
-        Json::FastWriter fastWriter;
-        std::ofstream file;
-        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        file.open(savePath_, std::ios::trunc);
-        file << fastWriter.write(root);
-        RING_DBG("[Account %s] saved %lu messages to %s", account_.getAccountID().c_str(), messages_.size(), savePath_.c_str());
-    } catch (const std::exception& e) {
-        RING_ERR("[Account %s] couldn't save messages to %s: %s", account_.getAccountID().c_str(), savePath_.c_str(), e.what());
+    auto m = messages.find(token);
+    if (m == messages.end()) {
+        // content is only recorded when the message is created
+        if (not jmsg.isMember("to"))
+            return;
+        m = messages.emplace(token, Message{}).first;
+        m->second.to = jmsg["to"].asString();
+        const auto& pl = jmsg["payload"];
+        for (auto p = pl.begin(); p != pl.end(); ++p)
+            m->second.payloads[p.key().asString()] = p->asString();
+    }
+    auto& msg = m->second;
+    msg.status = (MessageStatus)jmsg["status"].asInt();
+    auto wall_time = std::chrono::system_clock::from_time_t(jmsg["last_op"].asInt64());
+    msg.last_op = clock::now() + (wall_time - std::chrono::system_clock::now());
+    msg.retried = jmsg.get("retried", 0).asUInt();
+}
+
+std::string
+MessageEngine::serialize(MessageToken token, const Message& v, bool content)
+{
+    Json::Value msg;
+    std::ostringstream msgsId;
+    msgsId << std::hex << token;
+    msg["id"] = msgsId.str();
+    // a message being sent is sent again after a restart
+    msg["status"] = (int)(v.status == MessageStatus::SENDING ? MessageStatus::IDLE : v.status);
+    auto wall_time = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(v.last_op - clock::now());
+    msg["last_op"] = (Json::Value::Int64) std::chrono::system_clock::to_time_t(wall_time);
+    msg["retried"] = v.retried;
+    if (content) {
+        msg["to"] = v.to;
+        auto& payloads = msg["payload"];
+        for (const auto& p : v.payloads)
+            payloads[p.first] = p.second;
     }
+    Json::FastWriter fastWriter;
+    auto str = fastWriter.write(msg);
+    // one record per line
+    if (not str.empty() and str.back() == '\n')
+        str.pop_back();
+    return str;
+}
+
+void
+MessageEngine::persist(MessageToken token, const Message& v, bool content)
+{
+    if (not journal_.isOpen())
+        return;
+
+    if (not journal_.append(serialize(token, v, content)))
+        return;
+    if (journal_.size() >= std::max(COMPACT_MIN_RECORDS, 2 * messages_.size()))
+        compact();
+    else
+        scheduleSync();
+}
+
+bool
+MessageEngine::compact()
+{
+    std::vector<std::string> records;
+    records.reserve(messages_.size());
+    for (const auto& m : messages_)
+        records.emplace_back(serialize(m.first, m.second, true));
+    if (not journal_.compact(records)) {
+        RING_ERR("[Account %s] couldn't save messages to %s", account_.getAccountID().c_str(), journal_.getPath().c_str());
+        return false;
+    }
+    RING_DBG("[Account %s] saved %zu messages to %s", account_.getAccountID().c_str(), records.size(), journal_.getPath().c_str());
+    return true;
+}
+
+void
+MessageEngine::scheduleSync()
+{
+    if (syncScheduled_.exchange(true))
+        return;
+    std::weak_ptr<Account> w = std::static_pointer_cast<Account>(account_.shared_from_this());
+    // The delay batches the records, fsync blocks: not on the main thread
+    Manager::instance().scheduleTask([w,this](){
+        if (not w.lock())
+            return;
+        syncScheduled_ = false;
+        ThreadPool::instance().run([w,this](){
+            if (auto s = w.lock())
+                journal_.sync();
+        }, ThreadPool::Priority::LOW);
+    }, clock::now() + SYNC_DELAY);
 }
 
 }}
@@ -19,12 +19,21 @@
 
 #pragma once
 
+#include "message_journal.h"
+
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 #include <cstdint>
 
+namespace Json {
+class Value;
+}
+
 namespace ring {
 
 class SIPAccountBase;
@@ -46,7 +55,11 @@ class MessageEngine
 {
 public:
 
-    MessageEngine(SIPAccountBase&, const std::string& path);
+    /**
+     * @param retryPeriod delay before sending again a message that failed
+     */
+    MessageEngine(SIPAccountBase&, const std::string& path,
+                  std::chrono::milliseconds retryPeriod = RETRY_PERIOD);
 
     MessageToken sendMessage(const std::string& to, const std::map<std::string, std::string>& payloads);
 
@@ -58,20 +71,30 @@ public:
 
     void onMessageSent(MessageToken t, bool success);
 
+    /** Number of times the message was sent */
+    unsigned getRetried(MessageToken t) const;
+
+    /** Messages waiting to be sent, by retry time */
+    std::vector<MessageToken> getRetryQueue() const;
+
     /**
      * Load persisted messages
      */
     void load();
 
     /**
-     * Persist messages
+     * Persist messages, compacting the journal
      */
-    void save() const;
+    void save();
 
 private:
 
     static const constexpr unsigned MAX_RETRIES = 3;
     static const std::chrono::minutes RETRY_PERIOD;
+    /** Journal records written before being synced together */
+    static const std::chrono::milliseconds SYNC_DELAY;
+    /** Journal records before compacting, at least twice the messages */
+    static const constexpr size_t COMPACT_MIN_RECORDS = 1024;
     using clock = std::chrono::steady_clock;
 
     clock::time_point nextEvent() const;
@@ -86,11 +109,31 @@ private:
         clock::time_point last_op;
     };
 
+    // Must be called with messagesMutex_ held
+    void openJournal();
+    void loadLegacy(std::map<MessageToken, Message>& messages) const;
+    /** Append the state of the message, and its content for a new one */
+    void persist(MessageToken token, const Message& msg, bool content = false);
+    bool compact();
+    void scheduleSync();
+
+    static void applyRecord(std::map<MessageToken, Message>& messages, MessageToken token, const Json::Value& jmsg);
+    /** Journal record of a message, on a single line */
+    static std::string serialize(MessageToken token, const Message& msg, bool content);
+
     SIPAccountBase& account_;
+    const std::chrono::milliseconds retryPeriod_;
+    /** Messages saved as a whole, by previous versions */
     const std::string savePath_;
 
     std::map<MessageToken, Message> messages_;
+    /** Retry time of the UNKNOWN and IDLE messages */
+    std::set<std::pair<clock::time_point, MessageToken>> retryQueue_;
     mutable std::mutex messagesMutex_ {};
+
+    /** State changes of the messages, since the last compaction */
+    MessageJournal journal_;
+    std::atomic_bool syncScheduled_ {false};
 };
 
 }} // namespace ring::im
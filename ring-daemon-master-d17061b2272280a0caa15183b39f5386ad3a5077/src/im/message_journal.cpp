@@ -0,0 +1,194 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "message_journal.h"
+#include "fileutils.h"
+#include "logger.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ring {
+namespace im {
+
+// "%08x " before each record
+static constexpr size_t CRC_SIZE {9};
+
+static uint32_t
+crc32(const std::string& data)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xffffffff;
+    for (const auto c : data)
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffff;
+}
+
+static std::string
+formatRecord(const std::string& record)
+{
+    char crc[CRC_SIZE + 1];
+    std::snprintf(crc, sizeof(crc), "%08x ", crc32(record));
+    std::string line;
+    line.reserve(CRC_SIZE + record.size() + 1);
+    line.append(crc, CRC_SIZE).append(record).push_back('\n');
+    return line;
+}
+
+static void
+syncFile(std::FILE* file)
+{
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    ::fsync(fileno(file));
+#endif
+}
+
+MessageJournal::MessageJournal(const std::string& path)
+    : path_(path)
+{}
+
+MessageJournal::~MessageJournal()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    close();
+}
+
+size_t
+MessageJournal::replay(const std::function<void(const std::string&)>& cb) const
+{
+    std::ifstream file(path_, std::ios::binary);
+    if (not file)
+        return 0;
+
+    size_t count = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        // Without line break the last append was interrupted
+        if (file.eof())
+            break;
+        if (line.size() < CRC_SIZE or line[CRC_SIZE - 1] != ' ') {
+            RING_WARN("Invalid record %zu in %s, ignoring the rest", count, path_.c_str());
+            break;
+        }
+        const auto record = line.substr(CRC_SIZE);
+        if (std::strtoul(line.substr(0, CRC_SIZE - 1).c_str(), nullptr, 16) != crc32(record)) {
+            RING_WARN("Corrupted record %zu in %s, ignoring the rest", count, path_.c_str());
+            break;
+        }
+        cb(record);
+        ++count;
+    }
+    return count;
+}
+
+bool
+MessageJournal::compact(const std::vector<std::string>& records)
+{
+    std::string content;
+    for (const auto& r : records)
+        content += formatRecord(r);
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    close();
+    const bool ok = fileutils::saveFileAtomic(path_, content, 0600);
+    file_ = std::fopen(path_.c_str(), "ab");
+    if (not file_) {
+        RING_ERR("Could not open %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    if (ok)
+        records_ = records.size();
+    return ok;
+}
+
+bool
+MessageJournal::append(const std::string& record)
+{
+    const auto line = formatRecord(record);
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (not file_)
+        return false;
+    if (std::fwrite(line.data(), 1, line.size(), file_) != line.size()
+        or std::fflush(file_) != 0) {
+        RING_ERR("Could not append to %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    ++records_;
+    ++unsynced_;
+    return true;
+}
+
+void
+MessageJournal::sync()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (not file_ or not unsynced_)
+        return;
+    syncFile(file_);
+    unsynced_ = 0;
+}
+
+bool
+MessageJournal::isOpen() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return file_ != nullptr;
+}
+
+size_t
+MessageJournal::size() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return records_;
+}
+
+void
+MessageJournal::close()
+{
+    if (not file_)
+        return;
+    if (unsynced_) {
+        syncFile(file_);
+        unsynced_ = 0;
+    }
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+}} // namespace ring::im
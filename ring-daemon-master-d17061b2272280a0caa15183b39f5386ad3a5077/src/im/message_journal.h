@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ring {
+namespace im {
+
+/**
+ * Append-only file of checksummed records.
+ *
+ * A record is a single line of text, stored with its CRC-32. Appended
+ * records reach the kernel at once, so they survive a crash of the
+ * process; sync() makes them durable, callers batch it. replay() stops
+ * at the first truncated or corrupted record, as left by a power loss
+ * during an append. compact() atomically replaces the whole file.
+ */
+class MessageJournal {
+    public:
+        MessageJournal(const std::string& path);
+        ~MessageJournal();
+
+        /**
+         * Call cb for every valid record of the file, in order.
+         * Return the number of valid records.
+         */
+        size_t replay(const std::function<void(const std::string&)>& cb) const;
+
+        /**
+         * Replace the content of the file by these records and open it for
+         * appending. Return false on error, the previous file is kept.
+         */
+        bool compact(const std::vector<std::string>& records);
+
+        /**
+         * Append a record, without line break. The journal must be open.
+         */
+        bool append(const std::string& record);
+
+        /** Make the appended records durable */
+        void sync();
+
+        bool isOpen() const;
+
+        /** Records in the file, since the last compaction */
+        size_t size() const;
+
+        const std::string& getPath() const {
+            return path_;
+        }
+
+    private:
+        NON_COPYABLE(MessageJournal);
+
+        /** Must be called with mutex_ held */
+        void close();
+
+        const std::string path_;
+
+        mutable std::mutex mutex_;
+        std::FILE* file_ {nullptr};
+        size_t records_ {0};
+        size_t unsynced_ {0};
+};
+
+}} // namespace ring::im
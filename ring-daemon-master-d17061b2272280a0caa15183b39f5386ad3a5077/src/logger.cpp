@@ -34,12 +34,17 @@
 # include <sys/time.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <string>
-#include <sstream>
-#include <iomanip>
-#include <ios>
 #include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "logger.h"
 
@@ -84,45 +89,473 @@ static int consoleLog;
 static int debugMode;
 static std::mutex logMutex;
 
-static std::string
-getHeader(const char* ctx)
+// Messages per call site and per RATE_WINDOW, 0 for no limit
+static std::atomic<unsigned> rateLimit {0};
+static constexpr auto RATE_WINDOW = std::chrono::seconds(1);
+
+// Call sites followed by the rate limiter, others are not limited
+static constexpr size_t RATE_SITES {1024};
+static constexpr size_t RATE_PROBES {8};
+
+// Asynchronous mode
+static constexpr size_t LOG_QUEUE_DEPTH {256};
+static constexpr size_t LOG_CONTEXT_SIZE {64};
+static constexpr size_t LOG_TEXT_SIZE {256};
+static constexpr auto FLUSH_PERIOD = std::chrono::milliseconds(20);
+
+// Header: "[secs.millis|  tid|context] "
+static constexpr size_t HEADER_SIZE {LOG_CONTEXT_SIZE + 32};
+
+static long
+getTid()
 {
+    // Cached, as gettid is a system call
+    static thread_local long tid = -1;
+    if (tid < 0) {
 #ifdef __linux__
-    auto tid = syscall(__NR_gettid) & 0xffff;
+        tid = syscall(__NR_gettid) & 0xffff;
 #else
-    auto tid = std::this_thread::get_id();
+        tid = std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xffff;
 #endif // __linux__
+    }
+    return tid;
+}
 
-    // Timestamp
-    unsigned int secs, milli;
+static struct timeval
+getTime()
+{
     struct timeval tv;
-    if (!gettimeofday(&tv, NULL)) {
-        secs = tv.tv_sec;
-        milli = tv.tv_usec / 1000; // suppose that milli < 1000
-    } else {
-        secs = time(NULL);
-        milli = 0;
+    if (gettimeofday(&tv, NULL)) {
+        tv.tv_sec = time(NULL);
+        tv.tv_usec = 0;
     }
+    return tv;
+}
 
-    std::ostringstream out;
-    const auto prev_fill = out.fill();
-    out << '[' << secs
-        << '.' << std::right << std::setw(3) << std::setfill('0') << milli << std::left
-        << '|' << std::right << std::setw(5) << std::setfill(' ') << tid << std::left;
-    out.fill(prev_fill);
-
-    // Context
-    if (ctx){
+static void
+formatHeader(char* out, size_t size, const char* ctx, const struct timeval& tv, long tid)
+{
+    // suppose that milli < 1000
 #ifdef RING_UWP
-        out << "|" << std::setw(32) << ctx;
+    static constexpr int CTX_WIDTH = 32;
 #else
-        out << "|" << std::setw(24) << ctx;
+    static constexpr int CTX_WIDTH = 24;
 #endif
+    if (ctx)
+        snprintf(out, size, "[%u.%03u|%5ld|%-*s] ", static_cast<unsigned>(tv.tv_sec),
+                 static_cast<unsigned>(tv.tv_usec / 1000), tid, CTX_WIDTH, ctx);
+    else
+        snprintf(out, size, "[%u.%03u|%5ld] ", static_cast<unsigned>(tv.tv_sec),
+                 static_cast<unsigned>(tv.tv_usec / 1000), tid);
+}
+
+static void
+syslogf(const int level, const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vsyslog(level, format, ap);
+    va_end(ap);
+}
+
+/**
+ * Print a message on the console, after its header if not null.
+ * Messages without header get a line return.
+ */
+static void
+printLog(const int level, const char* header, const char* format, va_list ap)
+{
+#ifndef _WIN32
+    const char* color_header = CYAN;
+    const char* color_prefix = "";
+
+#else
+    WORD color_prefix = LIGHT_GREEN;
+    WORD color_header = CYAN;
+#endif
+#if defined(_WIN32) && !defined(RING_UWP)
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO consoleInfo;
+    WORD saved_attributes;
+#endif
+
+    switch (level) {
+        case LOG_ERR:
+            color_prefix = RED;
+            break;
+        case LOG_WARNING:
+            color_prefix = YELLOW;
+            break;
     }
 
-    out << "] ";
+#ifndef _WIN32
+    fputs(color_header, stderr);
+#elif !defined(RING_UWP)
+    GetConsoleScreenBufferInfo(hConsole, &consoleInfo);
+    saved_attributes = consoleInfo.wAttributes;
+    SetConsoleTextAttribute(hConsole, color_header);
+#endif
+
+    if (header)
+        fputs(header, stderr);
+#ifdef RING_UWP
+    char tmp[4096];
+    vsprintf(tmp, format, ap);
+    ring::emitSignal<DRing::DebugSignal::MessageSend>(std::string(header ? header : "") + std::string(tmp));
+#endif
+#ifndef _WIN32
+    fputs(END_COLOR, stderr);
+    fputs(color_prefix, stderr);
+#elif !defined(RING_UWP)
+    SetConsoleTextAttribute(hConsole, saved_attributes);
+    SetConsoleTextAttribute(hConsole, color_prefix);
+#endif
+
+    vfprintf(stderr, format, ap);
+
+    // WARING: this one also! see vlog()
+    if (not header)
+        fputs(ENDL, stderr);
+
+#ifndef _WIN32
+    fputs(END_COLOR, stderr);
+#elif !defined(RING_UWP)
+    SetConsoleTextAttribute(hConsole, saved_attributes);
+#endif
+}
+
+static void
+printLogf(const int level, const char* header, const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    printLog(level, header, format, ap);
+    va_end(ap);
+}
+
+/*
+ * Rate limiter, without lock: the messages of a call site (its format
+ * string) beyond rateLimit per RATE_WINDOW are counted and dropped.
+ * The count is printed with the next message of the site, or by
+ * reportSuppressed() once the site is quiet.
+ */
+struct RateSite {
+    std::atomic<const void*> site;
+    std::atomic<int64_t> windowStart;
+    std::atomic<unsigned> count;
+    std::atomic<unsigned> suppressed;
+    std::atomic<int> level;
+};
+
+static RateSite rateSites[RATE_SITES];
+
+/**
+ * Return true if the message must be dropped. Otherwise, suppressed is
+ * set to the number of messages dropped since the last one.
+ */
+static int64_t
+nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool
+rateLimited(const void* site, int level, unsigned& suppressed)
+{
+    suppressed = 0;
+    const auto limit = rateLimit.load(std::memory_order_relaxed);
+    if (not limit)
+        return false;
+
+    RateSite* rs = nullptr;
+    const auto hash = std::hash<const void*>()(site);
+    for (size_t i = 0; i < RATE_PROBES and not rs; ++i) {
+        auto& candidate = rateSites[(hash + i) % RATE_SITES];
+        const void* cur = candidate.site.load(std::memory_order_relaxed);
+        if (cur == site or (not cur and (candidate.site.compare_exchange_strong(cur, site)
+                                         or cur == site)))
+            rs = &candidate;
+    }
+    if (not rs)
+        return false;
+
+    const int64_t now = nowMs();
+    auto start = rs->windowStart.load(std::memory_order_relaxed);
+    if (now - start >= std::chrono::milliseconds(RATE_WINDOW).count()
+        and rs->windowStart.compare_exchange_strong(start, now)) {
+        rs->count.store(1, std::memory_order_relaxed);
+        suppressed = rs->suppressed.exchange(0);
+        return false;
+    }
+    if (rs->count.fetch_add(1, std::memory_order_relaxed) < limit)
+        return false;
+    rs->level.store(level, std::memory_order_relaxed);
+    rs->suppressed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+static void reportSuppressed(bool all);
+
+/*
+ * Asynchronous mode: each thread formats its messages in its own queue,
+ * without lock nor system call. A flusher thread prints them every
+ * FLUSH_PERIOD, sooner after an error or when a queue is half full. Messages too long for a queue
+ * entry, or sent while the queue is full, are printed synchronously
+ * after the queued ones: nothing is lost.
+ * The queues are drained by whoever holds logMutex.
+ */
+struct LogEntry {
+    struct timeval time;
+    long tid;
+    int level;
+    bool hasContext;
+    char context[LOG_CONTEXT_SIZE];
+    char text[LOG_TEXT_SIZE];
+};
+
+/** Messages of one thread, single producer and single consumer */
+class LogQueue {
+    public:
+        LogEntry* reserve() {
+            const auto h = head_.load(std::memory_order_relaxed);
+            if (h - tail_.load(std::memory_order_acquire) >= LOG_QUEUE_DEPTH)
+                return nullptr;
+            return &entries_[h % LOG_QUEUE_DEPTH];
+        }
+
+        /** Return the number of queued entries */
+        uint64_t commit() {
+            const auto h = head_.load(std::memory_order_relaxed) + 1;
+            head_.store(h, std::memory_order_release);
+            return h - tail_.load(std::memory_order_relaxed);
+        }
+
+        /** Consumer side: entries from tail to head can be read */
+        uint64_t tail() const { return tail_.load(std::memory_order_relaxed); }
+        uint64_t head() const { return head_.load(std::memory_order_acquire); }
+        const LogEntry& at(uint64_t i) const { return entries_[i % LOG_QUEUE_DEPTH]; }
+        void release(uint64_t tail) { tail_.store(tail, std::memory_order_release); }
+
+        std::atomic<bool> closed {false};
+
+    private:
+        LogEntry entries_[LOG_QUEUE_DEPTH];
+        std::atomic<uint64_t> head_ {0};
+        std::atomic<uint64_t> tail_ {0};
+};
+
+class AsyncLogger {
+    public:
+        static AsyncLogger& instance() {
+            static AsyncLogger logger;
+            return logger;
+        }
+
+        ~AsyncLogger() { stop(); }
+
+        void start() {
+            std::lock_guard<std::mutex> lk(threadMutex_);
+            if (running_)
+                return;
+            running_ = true;
+            thread_ = std::thread([this] {
+                std::unique_lock<std::mutex> lk(wakeMutex_);
+                while (running_) {
+                    wakeCv_.wait_for(lk, FLUSH_PERIOD, [this] { return wake_.load() or not running_; });
+                    wake_ = false;
+                    std::lock_guard<std::mutex> log_lk {logMutex};
+                    drain();
+                    reportSuppressed(false);
+                }
+            });
+            enabled_ = true;
+        }
+
+        void stop() {
+            std::lock_guard<std::mutex> lk(threadMutex_);
+            if (not running_)
+                return;
+            enabled_ = false;
+            {
+                std::lock_guard<std::mutex> wake_lk(wakeMutex_);
+                running_ = false;
+            }
+            wakeCv_.notify_one();
+            thread_.join();
+            std::lock_guard<std::mutex> log_lk {logMutex};
+            drain();
+            reportSuppressed(true);
+        }
+
+        bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        /**
+         * Format a message in the queue of this thread.
+         * Return false if it must be printed synchronously.
+         */
+        bool push(const int level, const char* format, va_list ap) {
+            auto& local = localQueue();
+            auto entry = local.reserve();
+            if (not entry)
+                return false;
+
+            entry->time = getTime();
+            entry->tid = getTid();
+            entry->level = level;
+            const char* sep = strchr(format, '|');
+            entry->hasContext = sep != nullptr;
+            if (sep) {
+                // keep the end of long paths
+                size_t len = sep - format;
+                const char* ctx = format;
+                if (len >= LOG_CONTEXT_SIZE) {
+                    ctx += len - (LOG_CONTEXT_SIZE - 1);
+                    len = LOG_CONTEXT_SIZE - 1;
+                }
+                memcpy(entry->context, ctx, len);
+                entry->context[len] = '\0';
+                format = sep + 2;
+            }
+
+            const auto n = vsnprintf(entry->text, LOG_TEXT_SIZE, format, ap);
+            if (n < 0 or static_cast<size_t>(n) >= LOG_TEXT_SIZE)
+                return false;
+
+            const auto queued = local.commit();
+            if (level <= LOG_ERR or queued == LOG_QUEUE_DEPTH / 2) {
+                wake_ = true;
+                wakeCv_.notify_one();
+            }
+            return true;
+        }
+
+        /**
+         * Print the queued messages, by time. Must be called with
+         * logMutex locked.
+         */
+        void drain() {
+            {
+                std::lock_guard<std::mutex> lk(queuesMutex_);
+                draining_.clear();
+                for (auto it = queues_.begin(); it != queues_.end();) {
+                    // Read for the last time if its thread is gone
+                    const bool closed = (*it)->closed.load();
+                    draining_.emplace_back(*it, (*it)->head());
+                    it = closed ? queues_.erase(it) : std::next(it);
+                }
+            }
+
+            pending_.clear();
+            for (const auto& d : draining_)
+                for (auto i = d.first->tail(); i != d.second; ++i)
+                    pending_.emplace_back(d.first.get(), i);
+
+            std::stable_sort(pending_.begin(), pending_.end(),
+                             [](const Pending& a, const Pending& b) {
+                                 const auto& ta = a.first->at(a.second).time;
+                                 const auto& tb = b.first->at(b.second).time;
+                                 return ta.tv_sec < tb.tv_sec
+                                     or (ta.tv_sec == tb.tv_sec and ta.tv_usec < tb.tv_usec);
+                             });
+
+            for (const auto& p : pending_)
+                print(p.first->at(p.second));
+
+            for (const auto& d : draining_)
+                d.first->release(d.second);
+            draining_.clear();
+
+            if (consoleLog)
+                fflush(stderr);
+        }
+
+    private:
+        using Pending = std::pair<LogQueue*, uint64_t>;
+
+        AsyncLogger() = default;
+
+        LogQueue& localQueue() {
+            struct Local {
+                std::shared_ptr<LogQueue> queue;
+                ~Local() { if (queue) queue->closed = true; }
+            };
+            static thread_local Local local;
+            if (not local.queue) {
+                local.queue = std::make_shared<LogQueue>();
+                std::lock_guard<std::mutex> lk(queuesMutex_);
+                queues_.emplace_back(local.queue);
+            }
+            return *local.queue;
+        }
+
+        void print(const LogEntry& entry) {
+            if (consoleLog) {
+                char header[HEADER_SIZE];
+                if (entry.hasContext)
+                    formatHeader(header, sizeof(header), entry.context, entry.time, entry.tid);
+                printLogf(entry.level, entry.hasContext ? header : nullptr, "%s", entry.text);
+            } else if (entry.hasContext) {
+                syslogf(entry.level, "%s| %s", entry.context, entry.text);
+            } else {
+                syslogf(entry.level, "%s", entry.text);
+            }
+        }
+
+        std::atomic<bool> enabled_ {false};
+        std::mutex threadMutex_;
+        bool running_ {false};
+        std::thread thread_;
+        std::mutex wakeMutex_;
+        std::condition_variable wakeCv_;
+        std::atomic<bool> wake_ {false};
+
+        std::mutex queuesMutex_;
+        std::vector<std::shared_ptr<LogQueue>> queues_;
+
+        // Used by drain() only: queues with their head when drained
+        std::vector<std::pair<std::shared_ptr<LogQueue>, uint64_t>> draining_;
+        std::vector<Pending> pending_;
+};
+
+static void writeLog(const int level, const char* format, va_list ap);
+
+static void
+writeLogf(const int level, const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    writeLog(level, format, ap);
+    va_end(ap);
+}
+
+/** Format of the count of messages suppressed, with the context of format */
+static std::string
+suppressedFormat(const char* format)
+{
+    const char* sep = strchr(format, '|');
+    std::string note = sep ? std::string(format, sep - format + 2) : std::string();
+    note += "%u more messages from here were suppressed";
+    if (sep)
+        note += ENDL;
+    return note;
+}
 
-    return out.str();
+static void
+vlog(const int level, const void* site, const char* format, va_list ap)
+{
+    if (!debugMode && level == LOG_DEBUG)
+        return;
+
+    // Errors are never dropped
+    unsigned suppressed = 0;
+    if (level != LOG_ERR and rateLimited(site, level, suppressed))
+        return;
+
+    writeLog(level, format, ap);
+
+    if (suppressed)
+        writeLogf(level, suppressedFormat(format).c_str(), suppressed);
 }
 
 #ifndef _WIN32
@@ -135,7 +568,7 @@ logger(const int level, const char* format, ...)
 
     va_list ap;
     va_start(ap, format);
-    vlogger(level, format, ap);
+    vlog(level, format, format, ap);
     va_end(ap);
 }
 
@@ -153,7 +586,7 @@ wlogger(const int level, const char* file, const char* format, ...)
 
     va_list ap;
     va_start(ap, format);
-    vlogger(level, buffer.c_str(), ap);
+    vlog(level, format, buffer.c_str(), ap);
     va_end(ap);
 }
 
@@ -162,82 +595,109 @@ wlogger(const int level, const char* file, const char* format, ...)
 void
 vlogger(const int level, const char *format, va_list ap)
 {
-    if (!debugMode && level == LOG_DEBUG)
-        return;
-
-    // syslog is supposed to thread-safe, but not all implementations (Android?)
-    // follow strictly POSIX rules... so we lock our mutex in any cases.
-    std::lock_guard<std::mutex> lk {logMutex};
+    vlog(level, format, format, ap);
+}
 
+/** Print a message now, must be called with logMutex locked */
+static void
+printNow(const int level, const char* format, va_list ap)
+{
     if (consoleLog) {
-#ifndef _WIN32
-        const char* color_header = CYAN;
-        const char* color_prefix = "";
-
-#else
-        WORD color_prefix = LIGHT_GREEN;
-        WORD color_header = CYAN;
-#endif
-#if defined(_WIN32) && !defined(RING_UWP)
-        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-        CONSOLE_SCREEN_BUFFER_INFO consoleInfo;
-        WORD saved_attributes;
-#endif
-
-        switch (level) {
-            case LOG_ERR:
-                color_prefix = RED;
-                break;
-            case LOG_WARNING:
-                color_prefix = YELLOW;
-                break;
-        }
-
-#ifndef _WIN32
-        fputs(color_header, stderr);
-#elif !defined(RING_UWP)
-        GetConsoleScreenBufferInfo(hConsole, &consoleInfo);
-        saved_attributes = consoleInfo.wAttributes;
-        SetConsoleTextAttribute(hConsole, color_header);
-#endif
-
-        std::string ctx;
-
         // WARNING : the '|' exists only with ring logs, not other logs like thus from OpenDHT
         // WARNING : PLEASE DO NOT DROP THIS TEST !!!! (or die)
         auto sep = strchr(format, '|');
         if (sep) {
-            ctx = std::string(format, sep - format);
-            format = sep + 2;
-            fputs(getHeader(ctx.c_str()).c_str(), stderr);
+            char header[HEADER_SIZE];
+            std::string ctx(format, sep - format);
+            formatHeader(header, sizeof(header), ctx.c_str(), getTime(), getTid());
+            printLog(level, header, sep + 2, ap);
+        } else {
+            printLog(level, nullptr, format, ap);
         }
-#ifdef RING_UWP
-        char tmp[4096];
-        vsprintf(tmp, format, ap);
-        ring::emitSignal<DRing::DebugSignal::MessageSend>(getHeader(ctx.c_str()).c_str() + std::string(tmp));
-#endif
-#ifndef _WIN32
-        fputs(END_COLOR, stderr);
-        fputs(color_prefix, stderr);
-#elif !defined(RING_UWP)
-        SetConsoleTextAttribute(hConsole, saved_attributes);
-        SetConsoleTextAttribute(hConsole, color_prefix);
-#endif
+    } else {
+        vsyslog(level, format, ap);
+    }
+}
 
-        vfprintf(stderr, format, ap);
+static void
+printNowf(const int level, const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    printNow(level, format, ap);
+    va_end(ap);
+}
 
-        // WARING: this one also! see above
-        if (not sep)
-            fputs(ENDL, stderr);
+/**
+ * Print the counts of messages suppressed at call sites quiet since their
+ * last window, or at all sites. Must be called with logMutex locked.
+ */
+static void
+reportSuppressed(bool all)
+{
+    if (not rateLimit.load(std::memory_order_relaxed) and not all)
+        return;
 
-#ifndef _WIN32
-        fputs(END_COLOR, stderr);
-#elif !defined(RING_UWP)
-        SetConsoleTextAttribute(hConsole, saved_attributes);
-#endif
+    // Sites are checked at most once per window
+    static int64_t lastReport {0};
+    const int64_t now = nowMs();
+    const int64_t window = std::chrono::milliseconds(RATE_WINDOW).count();
+    if (not all and now - lastReport < window)
+        return;
+    lastReport = now;
+
+    for (auto& rs : rateSites) {
+        if (not rs.suppressed.load(std::memory_order_relaxed))
+            continue;
+        if (not all and now - rs.windowStart.load(std::memory_order_relaxed) < window)
+            continue;
+        if (const auto n = rs.suppressed.exchange(0)) {
+            const auto format = static_cast<const char*>(rs.site.load(std::memory_order_relaxed));
+            printNowf(rs.level.load(std::memory_order_relaxed), suppressedFormat(format).c_str(), n);
+        }
+    }
+}
 
-    } else {
-        vsyslog(level, format, ap);
+static void
+writeLog(const int level, const char* format, va_list ap)
+{
+    auto& async = AsyncLogger::instance();
+    if (async.enabled()) {
+        va_list aq;
+        va_copy(aq, ap);
+        const bool queued = async.push(level, format, aq);
+        va_end(aq);
+        if (queued)
+            return;
+    }
+
+    // syslog is supposed to thread-safe, but not all implementations (Android?)
+    // follow strictly POSIX rules... so we lock our mutex in any cases.
+    std::lock_guard<std::mutex> lk {logMutex};
+
+    // Queued messages first
+    if (async.enabled())
+        async.drain();
+    reportSuppressed(false);
+
+    printNow(level, format, ap);
+}
+
+void
+setAsyncLog(int a)
+{
+    if (a)
+        AsyncLogger::instance().start();
+    else
+        AsyncLogger::instance().stop();
+}
+
+void
+setLogRateLimit(unsigned n)
+{
+    if (rateLimit.exchange(n) and not n) {
+        std::lock_guard<std::mutex> lk {logMutex};
+        reportSuppressed(true);
     }
 }
 
@@ -52,6 +52,22 @@ void vlogger(const int level, const char* format, va_list);
  */
 void setConsoleLog(int c);
 
+/**
+ * Print the logs from a background thread: the logging threads only
+ * format their messages in a queue of their own. Disabling it prints
+ * the queued messages.
+ */
+void setAsyncLog(int a);
+
+/**
+ * Messages printed per second from a same place in the code, the next
+ * ones are dropped and counted. 0, the default, to print them all.
+ * Errors are never dropped.
+ */
+void setLogRateLimit(unsigned n);
+
+#define LOG_DEFAULT_RATE_LIMIT 50
+
 /**
  * When debug mode is not set, logging will not print anything
  */
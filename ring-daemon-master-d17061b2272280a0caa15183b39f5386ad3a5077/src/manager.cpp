@@ -53,6 +53,7 @@ using random_device = dht::crypto::random_device;
 #include "im/instant_messaging.h"
 
 #include "config/yamlparser.h"
+#include "config/config_writer.h"
 
 #if HAVE_ALSA
 #include "audio/alsa/alsalayer.h"
@@ -88,8 +89,11 @@ using random_device = dht::crypto::random_device;
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <list>
 #include <random>
+#include <set>
 
 
 namespace ring {
@@ -102,6 +106,12 @@ using CallIDSet = std::set<std::string>;
 
 static constexpr int ICE_INIT_TIMEOUT {10};
 
+// Event loop period while event handlers must be polled
+static constexpr std::chrono::milliseconds EVENT_POLL_INTERVAL {10};
+
+// Longest event loop sleep without event
+static constexpr std::chrono::minutes MAX_EVENT_WAIT {1};
+
 std::atomic_bool Manager::initialized = {false};
 
 static void
@@ -235,6 +245,7 @@ setGnuTlsLogLevel()
 struct Manager::ManagerPimpl
 {
     explicit ManagerPimpl(Manager& base);
+    ~ManagerPimpl();
 
     bool parseConfiguration();
 
@@ -338,6 +349,26 @@ struct Manager::ManagerPimpl
      */
     std::string path_;
 
+    /**
+     * Serialize the preferences, and all the accounts or only account,
+     * on the thread that changed them. The file is written later.
+     */
+    void saveConfig(const std::shared_ptr<Account>& account, bool allAccounts);
+
+    /** Assemble the configuration file from what was serialized */
+    std::string assembleConfig();
+
+    /** Serialized accounts, in the order of the accounts */
+    std::vector<std::pair<std::string, std::string>> accountsConfig_;
+    /** False until all the accounts are serialized */
+    bool accountsConfigComplete_ {false};
+    std::string preferencesConfig_;
+    /** Protects what was serialized */
+    std::mutex configMutex_;
+
+    /** Declared after the state it serializes, to be destroyed first */
+    std::unique_ptr<ConfigWriter> configWriter_;
+
     /**
      * Instance of the RingBufferPool for the whole application
      *
@@ -349,6 +380,30 @@ struct Manager::ManagerPimpl
 
     std::unique_ptr<PluginManager> pluginManager_;
 
+    void processEvents();
+
+    /**
+     * Event loop thread: process events, then sleep until the next
+     * scheduled task, or until woken up.
+     */
+    void eventLoop();
+    void startEventLoop();
+    void stopEventLoop();
+    void wakeEventLoop();
+    std::chrono::steady_clock::time_point nextEventDeadline();
+
+    std::thread eventLoopThread_;
+    std::atomic_bool eventLoopRunning_ {false};
+    std::atomic_bool eventLoopWakeup_ {false};
+
+    /* Protects the event waiter and the waker */
+    std::mutex eventWaitMutex_;
+    std::condition_variable eventWaitCv_;
+    Manager::EventWaiter eventWaiter_;
+    std::function<void()> eventWaker_;
+    bool inEventWaiter_ {false};
+
+    std::recursive_mutex eventHandlersMutex_;
     std::map<uintptr_t, Manager::EventHandler> eventHandlerMap_;
 
     decltype(eventHandlerMap_)::iterator nextEventHandler_;
@@ -403,6 +458,12 @@ Manager::ManagerPimpl::ManagerPimpl(Manager& base)
     ring::libav_utils::ring_avcodec_init();
 }
 
+Manager::ManagerPimpl::~ManagerPimpl()
+{
+    // finish() was not called
+    stopEventLoop();
+}
+
 bool
 Manager::ManagerPimpl::parseConfiguration()
 {
@@ -706,6 +767,9 @@ Manager::init(const std::string &config_file)
 
     pimpl_->path_ = config_file.empty() ? pimpl_->retrieveConfigPath() : config_file;
     RING_DBG("Configuration file path: %s", pimpl_->path_.c_str());
+    pimpl_->configWriter_.reset(new ConfigWriter(pimpl_->path_, [this] {
+        return pimpl_->assembleConfig();
+    }));
 
     bool no_errors = true;
 
@@ -752,6 +816,8 @@ Manager::init(const std::string &config_file)
     }
 
     registerAccounts();
+
+    pimpl_->startEventLoop();
 }
 
 void
@@ -761,6 +827,9 @@ Manager::finish() noexcept
     if (not pimpl_->finished_.compare_exchange_strong(expected, true))
         return;
 
+    // Cleanup runs in this thread, without the event loop
+    pimpl_->stopEventLoop();
+
     try {
         // Forbid call creation
         callFactory.forbid();
@@ -776,7 +845,9 @@ Manager::finish() noexcept
                 removeAccount(account->getAccountID());
         }
 
+        // Written now, while the accounts still exist
         saveConfig();
+        pimpl_->configWriter_.reset();
 
         // Disconnect accounts, close link stacks and free allocated ressources
         unregisterAccounts();
@@ -793,7 +864,10 @@ Manager::finish() noexcept
         // Flush remaining tasks (free lambda' with capture)
         pimpl_->pendingTaskList_.clear();
         pimpl_->scheduledTasks_.clear();
-        pimpl_->eventHandlerMap_.clear();
+        {
+            std::lock_guard<std::recursive_mutex> lock(pimpl_->eventHandlersMutex_);
+            pimpl_->eventHandlerMap_.clear();
+        }
 
         pj_shutdown();
         ThreadPool::instance().join();
@@ -1658,17 +1732,21 @@ Manager::removeAudio(Call& call)
     getRingBufferPool().unBindAll(call_id);
 }
 
-// Not thread-safe, SHOULD be called in same thread that run pollEvents()
 void
 Manager::registerEventHandler(uintptr_t handlerId, EventHandler handler)
 {
-    pimpl_->eventHandlerMap_[handlerId] = handler;
+    {
+        std::lock_guard<std::recursive_mutex> lock(pimpl_->eventHandlersMutex_);
+        pimpl_->eventHandlerMap_[handlerId] = handler;
+    }
+    // switch the loop to polling
+    wakeEventLoop();
 }
 
-// Not thread-safe, SHOULD be called in same thread that run pollEvents()
 void
 Manager::unregisterEventHandler(uintptr_t handlerId)
 {
+    std::lock_guard<std::recursive_mutex> lock(pimpl_->eventHandlersMutex_);
     auto iter = pimpl_->eventHandlerMap_.find(handlerId);
     if (iter != pimpl_->eventHandlerMap_.end()) {
         if (iter == pimpl_->nextEventHandler_)
@@ -1681,8 +1759,11 @@ Manager::unregisterEventHandler(uintptr_t handlerId)
 void
 Manager::addTask(const std::function<bool()>&& task)
 {
-    std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
-    pimpl_->pendingTaskList_.emplace_back(std::move(task));
+    {
+        std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
+        pimpl_->pendingTaskList_.emplace_back(std::move(task));
+    }
+    wakeEventLoop();
 }
 
 std::shared_ptr<Manager::Runnable>
@@ -1696,60 +1777,183 @@ Manager::scheduleTask(const std::function<void()>&& task, std::chrono::steady_cl
 void
 Manager::scheduleTask(const std::shared_ptr<Runnable>& task, std::chrono::steady_clock::time_point when)
 {
-    std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
-    pimpl_->scheduledTasks_.emplace(when, task);
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
+        first = pimpl_->scheduledTasks_.emplace(when, task) == pimpl_->scheduledTasks_.begin();
+    }
+    // the loop may sleep past the new deadline
+    if (first)
+        wakeEventLoop();
+}
+
+void
+Manager::pollEvents()
+{
+    if (not pimpl_->eventLoopRunning_)
+        pimpl_->processEvents();
+}
+
+void
+Manager::wakeEventLoop()
+{
+    pimpl_->wakeEventLoop();
+}
+
+void
+Manager::setEventWaiter(EventWaiter waiter, std::function<void()> waker)
+{
+    std::unique_lock<std::mutex> lock(pimpl_->eventWaitMutex_);
+    if (pimpl_->inEventWaiter_
+        and std::this_thread::get_id() != pimpl_->eventLoopThread_.get_id()) {
+        // interrupt the current waiter and wait for the loop to leave it
+        if (pimpl_->eventWaker_)
+            pimpl_->eventWaker_();
+        pimpl_->eventWaitCv_.wait(lock, [this]{ return not pimpl_->inEventWaiter_; });
+    }
+    pimpl_->eventWaiter_ = std::move(waiter);
+    pimpl_->eventWaker_ = std::move(waker);
+}
+
+void
+Manager::ManagerPimpl::wakeEventLoop()
+{
+    if (eventLoopWakeup_.exchange(true))
+        return;
+    std::lock_guard<std::mutex> lock(eventWaitMutex_);
+    if (eventWaker_)
+        eventWaker_();
+    eventWaitCv_.notify_all();
 }
 
-// Must be invoked periodically by a timer from the main event loop
-void Manager::pollEvents()
+void
+Manager::ManagerPimpl::startEventLoop()
+{
+    if (eventLoopThread_.joinable())
+        return;
+    eventLoopRunning_ = true;
+    eventLoopThread_ = std::thread([this]{ eventLoop(); });
+}
+
+void
+Manager::ManagerPimpl::stopEventLoop()
+{
+    eventLoopRunning_ = false;
+    if (not eventLoopThread_.joinable())
+        return;
+    eventLoopWakeup_ = false;
+    wakeEventLoop();
+    if (std::this_thread::get_id() == eventLoopThread_.get_id())
+        eventLoopThread_.detach();
+    else
+        eventLoopThread_.join();
+}
+
+void
+Manager::ManagerPimpl::eventLoop()
+{
+    sip_utils::register_thread();
+
+    while (eventLoopRunning_) {
+        // wake-ups from now on are for the next round
+        eventLoopWakeup_ = false;
+        processEvents();
+        const auto deadline = nextEventDeadline();
+
+        std::unique_lock<std::mutex> lock(eventWaitMutex_);
+        if (not eventLoopRunning_ or eventLoopWakeup_)
+            continue;
+        if (eventWaiter_) {
+            auto waiter = eventWaiter_;
+            inEventWaiter_ = true;
+            lock.unlock();
+            try {
+                waiter(deadline);
+            } catch (const std::exception& e) {
+                RING_ERR("MainLoop exception (waiter): %s", e.what());
+            }
+            lock.lock();
+            inEventWaiter_ = false;
+            eventWaitCv_.notify_all();
+        } else {
+            eventWaitCv_.wait_until(lock, deadline, [this] {
+                return eventLoopWakeup_ or not eventLoopRunning_;
+            });
+        }
+    }
+}
+
+std::chrono::steady_clock::time_point
+Manager::ManagerPimpl::nextEventDeadline()
+{
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::recursive_mutex> lock(eventHandlersMutex_);
+        if (not eventHandlerMap_.empty())
+            return now + EVENT_POLL_INTERVAL;
+    }
+
+    std::lock_guard<std::mutex> lock(scheduledTasksMutex_);
+    // tasks returning true are retried
+    if (not pendingTaskList_.empty())
+        return now + EVENT_POLL_INTERVAL;
+    const auto deadline = now + MAX_EVENT_WAIT;
+    if (not scheduledTasks_.empty())
+        return std::min(deadline, scheduledTasks_.begin()->first);
+    return deadline;
+}
+
+void
+Manager::ManagerPimpl::processEvents()
 {
     //-- Handlers
     {
-        auto iter = pimpl_->eventHandlerMap_.begin();
-        while (iter != pimpl_->eventHandlerMap_.end()) {
-            if (pimpl_->finished_)
+        std::lock_guard<std::recursive_mutex> lock(eventHandlersMutex_);
+        auto iter = eventHandlerMap_.begin();
+        while (iter != eventHandlerMap_.end()) {
+            if (finished_)
                 return;
 
             // WARN: following callback can do anything and typically
             // calls (un)registerEventHandler.
             // Think twice before modify this code.
 
-            pimpl_->nextEventHandler_ = std::next(iter);
+            nextEventHandler_ = std::next(iter);
             try {
                 iter->second();
             } catch (const std::exception& e) {
                 RING_ERR("MainLoop exception (handler): %s", e.what());
             }
-            iter = pimpl_->nextEventHandler_;
+            iter = nextEventHandler_;
         }
     }
 
     //-- Scheduled tasks
     {
         auto now = std::chrono::steady_clock::now();
-        std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
-        while (not pimpl_->scheduledTasks_.empty() && pimpl_->scheduledTasks_.begin()->first <= now) {
-            auto f = pimpl_->scheduledTasks_.begin();
+        std::lock_guard<std::mutex> lock(scheduledTasksMutex_);
+        while (not scheduledTasks_.empty() && scheduledTasks_.begin()->first <= now) {
+            auto f = scheduledTasks_.begin();
             auto task = std::move(f->second->cb);
             if (task)
-                pimpl_->pendingTaskList_.emplace_back([task](){
+                pendingTaskList_.emplace_back([task](){
                     task();
                     return false;
                 });
-            pimpl_->scheduledTasks_.erase(f);
+            scheduledTasks_.erase(f);
         }
     }
 
     //-- Tasks
     {
-        decltype(pimpl_->pendingTaskList_) tmpList;
+        decltype(pendingTaskList_) tmpList;
         {
-            std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
-            std::swap(pimpl_->pendingTaskList_, tmpList);
+            std::lock_guard<std::mutex> lock(scheduledTasksMutex_);
+            std::swap(pendingTaskList_, tmpList);
         }
         auto iter = std::begin(tmpList);
         while (iter != tmpList.cend()) {
-            if (pimpl_->finished_)
+            if (finished_)
                 return;
 
             auto next = std::next(iter);
@@ -1765,8 +1969,8 @@ void Manager::pollEvents()
             iter = next;
         }
         {
-            std::lock_guard<std::mutex> lock(pimpl_->scheduledTasksMutex_);
-            pimpl_->pendingTaskList_.splice(std::end(pimpl_->pendingTaskList_), tmpList);
+            std::lock_guard<std::mutex> lock(scheduledTasksMutex_);
+            pendingTaskList_.splice(std::end(pendingTaskList_), tmpList);
         }
     }
 }
@@ -1775,45 +1979,96 @@ void Manager::pollEvents()
 void
 Manager::saveConfig()
 {
-    RING_DBG("Saving Configuration to XDG directory %s", pimpl_->path_.c_str());
+    pimpl_->saveConfig(nullptr, true);
+}
 
-    if (pimpl_->audiodriver_) {
-        audioPreference.setVolumemic(pimpl_->audiodriver_->getCaptureGain());
-        audioPreference.setVolumespkr(pimpl_->audiodriver_->getPlaybackGain());
-        audioPreference.setCaptureMuted(pimpl_->audiodriver_->isCaptureMuted());
-        audioPreference.setPlaybackMuted(pimpl_->audiodriver_->isPlaybackMuted());
-    }
+void
+Manager::saveConfig(const std::shared_ptr<Account>& account)
+{
+    pimpl_->saveConfig(account, false);
+}
 
-    try {
-        YAML::Emitter out;
+/** An item of the accounts sequence */
+static std::string
+serializeAccount(Account& account)
+{
+    YAML::Emitter out;
+    out << YAML::BeginSeq;
+    account.serialize(out);
+    out << YAML::EndSeq;
+    std::string item = out.c_str();
+    item += '\n';
+    return item;
+}
 
-        // FIXME maybe move this into accountFactory?
-        out << YAML::BeginMap << YAML::Key << "accounts";
-        out << YAML::Value << YAML::BeginSeq;
+void
+Manager::ManagerPimpl::saveConfig(const std::shared_ptr<Account>& account, bool allAccounts)
+{
+    if (audiodriver_) {
+        base_.audioPreference.setVolumemic(audiodriver_->getCaptureGain());
+        base_.audioPreference.setVolumespkr(audiodriver_->getPlaybackGain());
+        base_.audioPreference.setCaptureMuted(audiodriver_->isCaptureMuted());
+        base_.audioPreference.setPlaybackMuted(audiodriver_->isPlaybackMuted());
+    }
 
-        for (const auto& account : accountFactory.getAllAccounts()) {
-            account->serialize(out);
+    try {
+        std::lock_guard<std::mutex> lk(configMutex_);
+        if (allAccounts or not accountsConfigComplete_) {
+            // A write in progress keeps the previous accounts on errors
+            std::vector<std::pair<std::string, std::string>> accountsConfig;
+            for (const auto& a : base_.accountFactory.getAllAccounts())
+                accountsConfig.emplace_back(a->getAccountID(), serializeAccount(*a));
+            accountsConfig_.swap(accountsConfig);
+            accountsConfigComplete_ = true;
+        } else if (account and base_.accountFactory.getAccount(account->getAccountID()) == account) {
+            const auto& id = account->getAccountID();
+            auto it = std::find_if(accountsConfig_.begin(), accountsConfig_.end(),
+                                   [&](const std::pair<std::string, std::string>& a) {
+                                       return a.first == id;
+                                   });
+            if (it != accountsConfig_.end())
+                it->second = serializeAccount(*account);
+            else
+                accountsConfig_.emplace_back(id, serializeAccount(*account));
         }
-        out << YAML::EndSeq;
 
+        YAML::Emitter out;
+        out << YAML::BeginMap;
         // FIXME: this is a hack until we get rid of accountOrder
-        preferences.verifyAccountOrder(getAccountList());
-        preferences.serialize(out);
-        voipPreferences.serialize(out);
-        hookPreference.serialize(out);
-        audioPreference.serialize(out);
+        base_.preferences.verifyAccountOrder(base_.getAccountList());
+        base_.preferences.serialize(out);
+        base_.voipPreferences.serialize(out);
+        base_.hookPreference.serialize(out);
+        base_.audioPreference.serialize(out);
 #ifdef RING_VIDEO
-        videoPreferences.serialize(out);
+        base_.videoPreferences.serialize(out);
 #endif
-        shortcutPreferences.serialize(out);
-
-        std::ofstream fout(pimpl_->path_);
-        fout << out.c_str();
+        base_.shortcutPreferences.serialize(out);
+        out << YAML::EndMap;
+        preferencesConfig_ = out.c_str();
+        preferencesConfig_ += '\n';
     } catch (const YAML::Exception &e) {
         RING_ERR("%s", e.what());
+        return;
     } catch (const std::runtime_error &e) {
         RING_ERR("%s", e.what());
+        return;
     }
+
+    if (configWriter_)
+        configWriter_->schedule();
+}
+
+//THREAD=ConfigWriter
+std::string
+Manager::ManagerPimpl::assembleConfig()
+{
+    std::lock_guard<std::mutex> lk(configMutex_);
+    std::string config = accountsConfig_.empty() ? "accounts: []\n" : "accounts:\n";
+    for (const auto& a : accountsConfig_)
+        config += a.second;
+    config += preferencesConfig_;
+    return config;
 }
 
 //THREAD=Main | VoIPLink
@@ -1855,12 +2110,15 @@ Manager::playDtmf(char code)
     //                            ms/s
     int size = (int)((pulselen * (float) pimpl_->audiodriver_->getSampleRate()) / 1000);
     pimpl_->dtmfBuf_.resize(size);
+    std::vector<AudioSample> dtmfSamples(size);
 
     // Handle dtmf
     pimpl_->dtmfKey_->startTone(code);
 
     // copy the sound
-    if (pimpl_->dtmfKey_->generateDTMF(*pimpl_->dtmfBuf_.getChannel(0))) {
+    if (pimpl_->dtmfKey_->generateDTMF(dtmfSamples)) {
+        pimpl_->dtmfBuf_.copy(dtmfSamples.data(), size);
+
         // Put buffer to urgentRingBuffer
         // put the size in bytes...
         // so size * 1 channel (mono) * sizeof (bytes for the data)
@@ -2647,7 +2905,7 @@ Manager::setAccountDetails(const std::string& accountID,
     account->doUnregister([&](bool /* transport_free */) {
         account->setAccountDetails(details);
         // Serialize configuration to disk once it is done
-        saveConfig();
+        saveConfig(account);
 
         if (account->isUsable())
             account->doRegister();
@@ -2733,7 +2991,7 @@ Manager::addAccount(const std::map<std::string, std::string>& details, const std
 
     newAccount->doRegister();
 
-    saveConfig();
+    saveConfig(newAccount);
 
     emitSignal<DRing::ConfigurationSignal::AccountsChanged>();
 
@@ -2942,7 +3200,7 @@ Manager::sendRegister(const std::string& accountID, bool enable)
     acc->setEnabled(enable);
     acc->loadConfig();
 
-    Manager::instance().saveConfig();
+    Manager::instance().saveConfig(acc);
 
     if (acc->isEnabled()) {
         acc->doRegister();
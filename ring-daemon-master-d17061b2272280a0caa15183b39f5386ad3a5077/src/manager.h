@@ -41,6 +41,7 @@
 #include <memory>
 #include <atomic>
 #include <functional>
+#include <chrono>
 
 namespace ring {
 
@@ -298,10 +299,18 @@ class Manager {
         void removeAudio(Call& call);
 
         /**
-         * Save config to file
+         * Save config to file. All the accounts and the preferences are
+         * serialized now, the file is written from a background thread
+         * shortly after.
          */
         void saveConfig();
 
+        /**
+         * Save config to file, with the changes of this account only
+         * and the preferences
+         */
+        void saveConfig(const std::shared_ptr<Account>& account);
+
         /**
          * Play a ringtone
          */
@@ -817,10 +826,32 @@ class Manager {
         void checkAudio();
 
         /**
-         * Call periodically to poll for VoIP events */
+         * Process pending VoIP events.
+         * The daemon runs its own event loop since init(): this is only
+         * kept for compatibility and does nothing while the loop runs.
+         */
         void
         pollEvents();
 
+        /**
+         * Wake up the event loop, to process new events or tasks.
+         * Thread-safe, successive calls before the loop wakes are coalesced.
+         */
+        void wakeEventLoop();
+
+        /**
+         * Blocks until an event is ready or the given deadline is reached.
+         */
+        using EventWaiter = std::function<void(std::chrono::steady_clock::time_point)>;
+
+        /**
+         * Install the function used by the event loop to wait for events,
+         * and the function interrupting it from another thread.
+         * Without waiter, the loop only wakes for tasks and event handlers.
+         * Removing the waiter returns once the loop stopped using it.
+         */
+        void setEventWaiter(EventWaiter waiter, std::function<void()> waker);
+
         /**
          * Create a new outgoing call
          * @param toUrl The address to call
@@ -837,7 +868,7 @@ class Manager {
         using EventHandler = std::function<void()>;
 
         /**
-         * Install an event handler called periodically by pollEvents().
+         * Install an event handler called periodically by the event loop.
          * @param handlerId an unique identifier for the handler.
          * @param handler the event handler function.
          */
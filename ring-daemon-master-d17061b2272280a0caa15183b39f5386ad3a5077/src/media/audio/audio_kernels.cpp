@@ -0,0 +1,621 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "audio_kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define RING_KERNELS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RING_KERNELS_AVX2 1
+#include <immintrin.h>
+#define RING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RING_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace ring {
+
+static constexpr float S16_TO_FLOAT = 1.f / 32768.f;
+static constexpr float FLOAT_TO_S16 = 32768.f;
+
+//
+// Scalar reference, also used for the tail of vectorized loops
+//
+
+static inline AudioSample
+saturate(int32_t v)
+{
+    return static_cast<AudioSample>(std::min(std::max(v, -32768), 32767));
+}
+
+static void
+mixScalar(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = saturate(int32_t(dst[i]) + src[i]);
+}
+
+static void
+gainScalar(AudioSample* dst, size_t n, int16_t gain)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = saturate((int32_t(dst[i]) * gain) >> 15);
+}
+
+static void
+toFloatScalar(float* dst, const AudioSample* src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = src[i] * S16_TO_FLOAT;
+}
+
+static inline AudioSample
+fromFloat(float v)
+{
+    v = std::max(-1.f, std::min(v, 1.f));
+    return saturate(static_cast<int32_t>(v * FLOAT_TO_S16));
+}
+
+static void
+fromFloatScalar(AudioSample* dst, const float* src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = fromFloat(src[i]);
+}
+
+static void
+interleave2Scalar(AudioSample* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        *dst++ = l[i];
+        *dst++ = r[i];
+    }
+}
+
+static void
+interleave2FloatScalar(float* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        *dst++ = l[i] * S16_TO_FLOAT;
+        *dst++ = r[i] * S16_TO_FLOAT;
+    }
+}
+
+static void
+deinterleave2Scalar(AudioSample* l, AudioSample* r, const AudioSample* src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        l[i] = *src++;
+        r[i] = *src++;
+    }
+}
+
+static void
+deinterleave2FromFloatScalar(AudioSample* l, AudioSample* r, const float* src, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        l[i] = fromFloat(*src++);
+        r[i] = fromFloat(*src++);
+    }
+}
+
+static const AudioKernels SCALAR_KERNELS {
+    "scalar",
+    mixScalar,
+    gainScalar,
+    toFloatScalar,
+    fromFloatScalar,
+    interleave2Scalar,
+    interleave2FloatScalar,
+    deinterleave2Scalar,
+    deinterleave2FromFloatScalar,
+};
+
+//
+// SSE2
+//
+
+#ifdef RING_KERNELS_SSE2
+
+static inline __m128i
+gainSSE2(__m128i x, __m128i g)
+{
+    const __m128i lo = _mm_mullo_epi16(x, g);
+    const __m128i hi = _mm_mulhi_epi16(x, g);
+    const __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+    const __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+    return _mm_packs_epi32(p0, p1);
+}
+
+static inline void
+storeFloatSSE2(float* dst, __m128i x)
+{
+    const __m128 scale = _mm_set1_ps(S16_TO_FLOAT);
+    // sign-extend 16-bit samples to 32-bit
+    const __m128i x0 = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    const __m128i x1 = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(x0), scale));
+    _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(x1), scale));
+}
+
+static void
+mixSSE2(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_adds_epi16(a, b));
+    }
+    mixScalar(dst + i, src + i, n - i);
+}
+
+static void
+gainSSE2(AudioSample* dst, size_t n, int16_t gain)
+{
+    const __m128i g = _mm_set1_epi16(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), gainSSE2(x, g));
+    }
+    gainScalar(dst + i, n - i, gain);
+}
+
+static void
+toFloatSSE2(float* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        storeFloatSSE2(dst + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+    toFloatScalar(dst + i, src + i, n - i);
+}
+
+static inline __m128i
+fromFloatSSE2(__m128 f)
+{
+    f = _mm_max_ps(_mm_set1_ps(-1.f), _mm_min_ps(f, _mm_set1_ps(1.f)));
+    return _mm_cvttps_epi32(_mm_mul_ps(f, _mm_set1_ps(FLOAT_TO_S16)));
+}
+
+static void
+fromFloatSSE2(AudioSample* dst, const float* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i x0 = fromFloatSSE2(_mm_loadu_ps(src + i));
+        const __m128i x1 = fromFloatSSE2(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(x0, x1));
+    }
+    fromFloatScalar(dst + i, src + i, n - i);
+}
+
+static void
+interleave2SSE2(AudioSample* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi16(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+    }
+    interleave2Scalar(dst + 2 * i, l + i, r + i, n - i);
+}
+
+static void
+interleave2FloatSSE2(float* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        storeFloatSSE2(dst + 2 * i, _mm_unpacklo_epi16(a, b));
+        storeFloatSSE2(dst + 2 * i + 8, _mm_unpackhi_epi16(a, b));
+    }
+    interleave2FloatScalar(dst + 2 * i, l + i, r + i, n - i);
+}
+
+static void
+deinterleave2SSE2(AudioSample* l, AudioSample* r, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i + 8));
+        // even samples sign-extended from the low half of each 32-bit word
+        const __m128i la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        const __m128i lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        const __m128i ra = _mm_srai_epi32(a, 16);
+        const __m128i rb = _mm_srai_epi32(b, 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(l + i), _mm_packs_epi32(la, lb));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r + i), _mm_packs_epi32(ra, rb));
+    }
+    deinterleave2Scalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static void
+deinterleave2FromFloatSSE2(AudioSample* l, AudioSample* r, const float* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const float* s = src + 2 * i;
+        const __m128 a = _mm_loadu_ps(s);
+        const __m128 b = _mm_loadu_ps(s + 4);
+        const __m128 c = _mm_loadu_ps(s + 8);
+        const __m128 d = _mm_loadu_ps(s + 12);
+        const __m128i l0 = fromFloatSSE2(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i l1 = fromFloatSSE2(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i r0 = fromFloatSSE2(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m128i r1 = fromFloatSSE2(_mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(l + i), _mm_packs_epi32(l0, l1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r + i), _mm_packs_epi32(r0, r1));
+    }
+    deinterleave2FromFloatScalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static const AudioKernels SSE2_KERNELS {
+    "sse2",
+    mixSSE2,
+    gainSSE2,
+    toFloatSSE2,
+    fromFloatSSE2,
+    interleave2SSE2,
+    interleave2FloatSSE2,
+    deinterleave2SSE2,
+    deinterleave2FromFloatSSE2,
+};
+
+#endif // RING_KERNELS_SSE2
+
+//
+// AVX2 (compiled for any x86 target, selected at runtime)
+//
+
+#ifdef RING_KERNELS_AVX2
+
+RING_TARGET_AVX2 static inline void
+storeFloatAVX2(float* dst, __m128i x)
+{
+    const __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+    _mm256_storeu_ps(dst, _mm256_mul_ps(v, _mm256_set1_ps(S16_TO_FLOAT)));
+}
+
+RING_TARGET_AVX2 static void
+mixAVX2(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_adds_epi16(a, b));
+    }
+    _mm256_zeroupper();
+    mixScalar(dst + i, src + i, n - i);
+}
+
+RING_TARGET_AVX2 static void
+gainAVX2(AudioSample* dst, size_t n, int16_t gain)
+{
+    const __m256i g = _mm256_set1_epi16(gain);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        const __m256i lo = _mm256_mullo_epi16(x, g);
+        const __m256i hi = _mm256_mulhi_epi16(x, g);
+        // unpack and pack work per 128-bit lane, so the order is preserved
+        const __m256i p0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 15);
+        const __m256i p1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 15);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packs_epi32(p0, p1));
+    }
+    _mm256_zeroupper();
+    gainScalar(dst + i, n - i, gain);
+}
+
+RING_TARGET_AVX2 static void
+toFloatAVX2(float* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        storeFloatAVX2(dst + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+    _mm256_zeroupper();
+    toFloatScalar(dst + i, src + i, n - i);
+}
+
+RING_TARGET_AVX2 static inline __m256i
+fromFloatAVX2(__m256 f)
+{
+    f = _mm256_max_ps(_mm256_set1_ps(-1.f), _mm256_min_ps(f, _mm256_set1_ps(1.f)));
+    return _mm256_cvttps_epi32(_mm256_mul_ps(f, _mm256_set1_ps(FLOAT_TO_S16)));
+}
+
+RING_TARGET_AVX2 static void
+fromFloatAVX2(AudioSample* dst, const float* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i x0 = fromFloatAVX2(_mm256_loadu_ps(src + i));
+        const __m256i x1 = fromFloatAVX2(_mm256_loadu_ps(src + i + 8));
+        // packs interleaves 128-bit lanes: restore sample order
+        const __m256i x = _mm256_permute4x64_epi64(_mm256_packs_epi32(x0, x1), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), x);
+    }
+    _mm256_zeroupper();
+    fromFloatScalar(dst + i, src + i, n - i);
+}
+
+RING_TARGET_AVX2 static void
+interleave2AVX2(AudioSample* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + i));
+        const __m256i lo = _mm256_unpacklo_epi16(a, b);
+        const __m256i hi = _mm256_unpackhi_epi16(a, b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    _mm256_zeroupper();
+    interleave2Scalar(dst + 2 * i, l + i, r + i, n - i);
+}
+
+RING_TARGET_AVX2 static void
+interleave2FloatAVX2(float* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        storeFloatAVX2(dst + 2 * i, _mm_unpacklo_epi16(a, b));
+        storeFloatAVX2(dst + 2 * i + 8, _mm_unpackhi_epi16(a, b));
+    }
+    _mm256_zeroupper();
+    interleave2FloatScalar(dst + 2 * i, l + i, r + i, n - i);
+}
+
+RING_TARGET_AVX2 static void
+deinterleave2AVX2(AudioSample* l, AudioSample* r, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i + 16));
+        const __m256i la = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+        const __m256i lb = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+        const __m256i ra = _mm256_srai_epi32(a, 16);
+        const __m256i rb = _mm256_srai_epi32(b, 16);
+        const __m256i left = _mm256_permute4x64_epi64(_mm256_packs_epi32(la, lb), 0xD8);
+        const __m256i right = _mm256_permute4x64_epi64(_mm256_packs_epi32(ra, rb), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(l + i), left);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + i), right);
+    }
+    _mm256_zeroupper();
+    deinterleave2Scalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+RING_TARGET_AVX2 static void
+deinterleave2FromFloatAVX2(AudioSample* l, AudioSample* r, const float* src, size_t n)
+{
+    // shuffle and pack work per 128-bit lane: 32-bit pairs end up as 0 4 1 5 2 6 3 7
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const float* s = src + 2 * i;
+        const __m256 a = _mm256_loadu_ps(s);
+        const __m256 b = _mm256_loadu_ps(s + 8);
+        const __m256 c = _mm256_loadu_ps(s + 16);
+        const __m256 d = _mm256_loadu_ps(s + 24);
+        const __m256i l0 = fromFloatAVX2(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m256i l1 = fromFloatAVX2(_mm256_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m256i r0 = fromFloatAVX2(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m256i r1 = fromFloatAVX2(_mm256_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m256i left = _mm256_permutevar8x32_epi32(_mm256_packs_epi32(l0, l1), order);
+        const __m256i right = _mm256_permutevar8x32_epi32(_mm256_packs_epi32(r0, r1), order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(l + i), left);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + i), right);
+    }
+    _mm256_zeroupper();
+    deinterleave2FromFloatScalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static const AudioKernels AVX2_KERNELS {
+    "avx2",
+    mixAVX2,
+    gainAVX2,
+    toFloatAVX2,
+    fromFloatAVX2,
+    interleave2AVX2,
+    interleave2FloatAVX2,
+    deinterleave2AVX2,
+    deinterleave2FromFloatAVX2,
+};
+
+#endif // RING_KERNELS_AVX2
+
+//
+// NEON
+//
+
+#ifdef RING_KERNELS_NEON
+
+static void
+mixNEON(AudioSample* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+    mixScalar(dst + i, src + i, n - i);
+}
+
+static void
+gainNEON(AudioSample* dst, size_t n, int16_t gain)
+{
+    const int16x4_t g = vdup_n_s16(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t x = vld1q_s16(dst + i);
+        const int16x4_t lo = vqshrn_n_s32(vmull_s16(vget_low_s16(x), g), 15);
+        const int16x4_t hi = vqshrn_n_s32(vmull_s16(vget_high_s16(x), g), 15);
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+    gainScalar(dst + i, n - i, gain);
+}
+
+static inline float32x4_t
+toFloatNEON(int16x4_t x)
+{
+    return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(x)), S16_TO_FLOAT);
+}
+
+static void
+toFloatNEON(float* dst, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t x = vld1q_s16(src + i);
+        vst1q_f32(dst + i, toFloatNEON(vget_low_s16(x)));
+        vst1q_f32(dst + i + 4, toFloatNEON(vget_high_s16(x)));
+    }
+    toFloatScalar(dst + i, src + i, n - i);
+}
+
+static inline int16x4_t
+fromFloatNEON(float32x4_t f)
+{
+    f = vmaxq_f32(vdupq_n_f32(-1.f), vminq_f32(f, vdupq_n_f32(1.f)));
+    return vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(f, FLOAT_TO_S16)));
+}
+
+static void
+fromFloatNEON(AudioSample* dst, const float* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x4_t lo = fromFloatNEON(vld1q_f32(src + i));
+        const int16x4_t hi = fromFloatNEON(vld1q_f32(src + i + 4));
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+    fromFloatScalar(dst + i, src + i, n - i);
+}
+
+static void
+interleave2NEON(AudioSample* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t x;
+        x.val[0] = vld1q_s16(l + i);
+        x.val[1] = vld1q_s16(r + i);
+        vst2q_s16(dst + 2 * i, x);
+    }
+    interleave2Scalar(dst + 2 * i, l + i, r + i, n - i);
+}
+
+static void
+interleave2FloatNEON(float* dst, const AudioSample* l, const AudioSample* r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t x;
+        x.val[0] = toFloatNEON(vld1_s16(l + i));
+        x.val[1] = toFloatNEON(vld1_s16(r + i));
+        vst2q_f32(dst + 2 * i, x);
+    }
+    interleave2FloatScalar(dst + 2 * i, l + i, r + i, n - i);
+}
+
+static void
+deinterleave2NEON(AudioSample* l, AudioSample* r, const AudioSample* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8x2_t x = vld2q_s16(src + 2 * i);
+        vst1q_s16(l + i, x.val[0]);
+        vst1q_s16(r + i, x.val[1]);
+    }
+    deinterleave2Scalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static void
+deinterleave2FromFloatNEON(AudioSample* l, AudioSample* r, const float* src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const float32x4x2_t a = vld2q_f32(src + 2 * i);
+        const float32x4x2_t b = vld2q_f32(src + 2 * i + 8);
+        vst1q_s16(l + i, vcombine_s16(fromFloatNEON(a.val[0]), fromFloatNEON(b.val[0])));
+        vst1q_s16(r + i, vcombine_s16(fromFloatNEON(a.val[1]), fromFloatNEON(b.val[1])));
+    }
+    deinterleave2FromFloatScalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static const AudioKernels NEON_KERNELS {
+    "neon",
+    mixNEON,
+    gainNEON,
+    toFloatNEON,
+    fromFloatNEON,
+    interleave2NEON,
+    interleave2FloatNEON,
+    deinterleave2NEON,
+    deinterleave2FromFloatNEON,
+};
+
+#endif // RING_KERNELS_NEON
+
+std::vector<const AudioKernels*>
+getSupportedAudioKernels()
+{
+    std::vector<const AudioKernels*> ret {&SCALAR_KERNELS};
+#ifdef RING_KERNELS_SSE2
+    ret.push_back(&SSE2_KERNELS);
+#endif
+#ifdef RING_KERNELS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        ret.push_back(&AVX2_KERNELS);
+#endif
+#ifdef RING_KERNELS_NEON
+    ret.push_back(&NEON_KERNELS);
+#endif
+    return ret;
+}
+
+const AudioKernels&
+getAudioKernels()
+{
+    static const AudioKernels& kernels = *getSupportedAudioKernels().back();
+    return kernels;
+}
+
+const AudioKernels&
+getScalarAudioKernels()
+{
+    return SCALAR_KERNELS;
+}
+
+} // namespace ring
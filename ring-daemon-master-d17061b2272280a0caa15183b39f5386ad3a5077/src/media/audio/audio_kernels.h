@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "ring_types.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace ring {
+
+/**
+ * Sample processing kernels used by AudioBuffer.
+ *
+ * Every implementation gives bit-exact results with the scalar one.
+ * Pointers don't need to be aligned, and buffers must not overlap
+ * (except dst and src of mix(), which may be the same).
+ */
+struct AudioKernels {
+    const char* name;
+
+    /** dst[i] = saturate(dst[i] + src[i]) */
+    void (*mix)(AudioSample* dst, const AudioSample* src, size_t n);
+
+    /** dst[i] = saturate((dst[i] * gain) >> 15), gain in Q15 format */
+    void (*gain)(AudioSample* dst, size_t n, int16_t gain);
+
+    /** dst[i] = src[i] / 32768 */
+    void (*toFloat)(float* dst, const AudioSample* src, size_t n);
+
+    /** dst[i] = saturate(clamp(src[i], -1, 1) * 32768), truncated toward zero */
+    void (*fromFloat)(AudioSample* dst, const float* src, size_t n);
+
+    /** Interleave two channels of n samples each */
+    void (*interleave2)(AudioSample* dst, const AudioSample* left, const AudioSample* right, size_t n);
+
+    /** Interleave two channels of n samples each, converted to float */
+    void (*interleave2Float)(float* dst, const AudioSample* left, const AudioSample* right, size_t n);
+
+    /** Split n interleaved stereo frames in two channels */
+    void (*deinterleave2)(AudioSample* left, AudioSample* right, const AudioSample* src, size_t n);
+
+    /** Split n interleaved float stereo frames in two channels, converted like fromFloat */
+    void (*deinterleave2FromFloat)(AudioSample* left, AudioSample* right, const float* src, size_t n);
+};
+
+/**
+ * Return the fastest kernels supported by the running CPU.
+ * Selection is done once, at first call.
+ */
+const AudioKernels& getAudioKernels();
+
+/**
+ * Return the portable reference implementation.
+ */
+const AudioKernels& getScalarAudioKernels();
+
+/**
+ * Return every implementation supported by the running CPU,
+ * the scalar one first.
+ */
+std::vector<const AudioKernels*> getSupportedAudioKernels();
+
+} // namespace ring
@@ -32,13 +32,16 @@
 #include "media_decoder.h"
 #include "media_io_handle.h"
 #include "media_device.h"
+#include "media_stats.h"
+#include "rtp_jitter_buffer.h"
+#include "rtcp_receiver_report.h"
 
 #include "audio/audiobuffer.h"
 #include "audio/ringbufferpool.h"
 #include "audio/resampler.h"
 #include "manager.h"
-#include "smartools.h"
-#include <sstream>
+
+#include <algorithm>
 
 namespace ring {
 
@@ -48,6 +51,7 @@ class AudioSender {
                     const std::string& dest,
                     const MediaDescription& args,
                     SocketPair& socketPair,
+                    MediaStreamStats& stats,
                     const uint16_t seqVal,
                     bool muteState,
                     const uint16_t mtu);
@@ -67,6 +71,7 @@ class AudioSender {
         std::unique_ptr<MediaEncoder> audioEncoder_;
         std::unique_ptr<MediaIOHandle> muxContext_;
         std::unique_ptr<Resampler> resampler_;
+        MediaStreamStats& stats_;
 
         AudioBuffer micData_;
         AudioBuffer resampledData_;
@@ -86,12 +91,14 @@ AudioSender::AudioSender(const std::string& id,
                          const std::string& dest,
                          const MediaDescription& args,
                          SocketPair& socketPair,
+                         MediaStreamStats& stats,
                          const uint16_t seqVal,
                          bool muteState,
                          const uint16_t mtu) :
     id_(id),
     dest_(dest),
     args_(args),
+    stats_(stats),
     seqVal_(seqVal),
     muteState_(muteState),
     mtu_(mtu),
@@ -130,6 +137,7 @@ AudioSender::setup(SocketPair& socketPair)
     audioEncoder_->print_sdp();
 #endif
 
+    stats_.setCodec(audioEncoder_->getEncoderName());
     return true;
 }
 
@@ -168,6 +176,7 @@ AudioSender::process()
     auto accountAudioCodec = std::static_pointer_cast<AccountAudioCodecInfo>(args_.codec);
     micData_.setChannelNum(accountAudioCodec->audioformat.nb_channels, true);
 
+    const auto encodeStart = MediaStreamStats::clock::now();
     if (mainBuffFormat.sample_rate != accountAudioCodec->audioformat.sample_rate) {
         if (not resampler_) {
             RING_DBG("Creating audio resampler");
@@ -176,13 +185,13 @@ AudioSender::process()
         resampledData_.setFormat(accountAudioCodec->audioformat);
         resampledData_.resize(samplesToGet);
         resampler_->resample(micData_, resampledData_);
-        Smartools::getInstance().setLocalAudioCodec(audioEncoder_->getEncoderName());
         if (audioEncoder_->encode_audio(resampledData_) < 0)
             RING_ERR("encoding failed");
     } else {
         if (audioEncoder_->encode_audio(micData_) < 0)
             RING_ERR("encoding failed");
     }
+    stats_.onFrame(MediaStreamStats::clock::now() - encodeStart);
 }
 void
 AudioSender::setMuted(bool isMuted)
@@ -198,44 +207,53 @@ AudioSender::getLastSeqValue()
 }
 
 
+static constexpr size_t RTP_BUFFER_SIZE {2048};
+static constexpr size_t RTCP_REPORT_SIZE {512};
+// Longest wait for a packet, to check if the loop is stopped
+static constexpr auto RECEIVE_MAX_WAIT = std::chrono::milliseconds(20);
+// Consecutive frames concealed before playing silence
+static constexpr unsigned MAX_CONCEALED {5};
+
 class AudioReceiveThread
 {
     public:
         AudioReceiveThread(const std::string &id,
-                           const AudioFormat& format,
-                           const std::string& sdp,
-                           const uint16_t mtu);
+                           const MediaDescription& args,
+                           SocketPair& socketPair,
+                           MediaStreamStats& stats);
         ~AudioReceiveThread();
-        void addIOContext(SocketPair &socketPair);
         void startLoop();
 
     private:
         NON_COPYABLE(AudioReceiveThread);
 
-        static constexpr auto SDP_FILENAME = "dummyFilename";
-
-        static int interruptCb(void *ctx);
-        static int readFunction(void *opaque, uint8_t *buf, int buf_size);
-
-        void openDecoder();
-        bool decodeFrame();
+        bool setupDecoder();
+        void playout();
+        void conceal();
+        void sendReport();
 
         /*-----------------------------------------------------------------*/
         /* These variables should be used in thread (i.e. process()) only! */
         /*-----------------------------------------------------------------*/
         const std::string id_;
-        const AudioFormat& format_;
+        const MediaDescription args_;
+        SocketPair& socketPair_;
 
-        DeviceParams args_;
-
-        std::istringstream stream_;
         std::unique_ptr<MediaDecoder> audioDecoder_;
-        std::unique_ptr<MediaIOHandle> sdpContext_;
-        std::unique_ptr<MediaIOHandle> demuxContext_;
+        RtpJitterBuffer jitterBuffer_;
+        std::vector<uint8_t> packet_;
+        RtpJitterBuffer::Packet playoutPacket_;
 
-        std::shared_ptr<RingBuffer> ringbuffer_;
+        // The libav demuxer used to send the receiver reports
+        RtcpReceiverReport rtcpReport_;
+        std::vector<uint8_t> rtcpPacket_;
 
-        uint16_t mtu_;
+        // Last frame played, repeated to conceal losses
+        AudioBuffer lastFrame_;
+        unsigned concealed_ {0};
+
+        std::shared_ptr<RingBuffer> ringbuffer_;
+        MediaStreamStats& stats_;
 
         ThreadLoop loop_;
         bool setup();
@@ -244,15 +262,17 @@ class AudioReceiveThread
 };
 
 AudioReceiveThread::AudioReceiveThread(const std::string& id,
-                                       const AudioFormat& format,
-                                       const std::string& sdp,
-                                       const uint16_t mtu)
+                                       const MediaDescription& args,
+                                       SocketPair& socketPair,
+                                       MediaStreamStats& stats)
     : id_(id)
-    , format_(format)
-    , stream_(sdp)
-    , sdpContext_(new MediaIOHandle(sdp.size(), false, &readFunction,
-                                    0, 0, this))
-    , mtu_(mtu)
+    , args_(args)
+    , socketPair_(socketPair)
+    , jitterBuffer_(args.rtp_clockrate)
+    , packet_(RTP_BUFFER_SIZE)
+    , rtcpReport_(id)
+    , rtcpPacket_(RTCP_REPORT_SIZE)
+    , stats_(stats)
     , loop_(std::bind(&AudioReceiveThread::setup, this),
             std::bind(&AudioReceiveThread::process, this),
             std::bind(&AudioReceiveThread::cleanup, this))
@@ -263,26 +283,24 @@ AudioReceiveThread::~AudioReceiveThread()
     loop_.join();
 }
 
-
 bool
-AudioReceiveThread::setup()
+AudioReceiveThread::setupDecoder()
 {
+    // Packets are depayloaded by the jitter buffer, not by a demuxer
+    auto accountAudioCodec = std::static_pointer_cast<AccountAudioCodecInfo>(args_.codec);
     audioDecoder_.reset(new MediaDecoder());
-    audioDecoder_->setInterruptCallback(interruptCb, this);
-    // custom_io so the SDP demuxer will not open any UDP connections
-    args_.input = SDP_FILENAME;
-    args_.format = "sdp";
-    args_.sdp_flags = "custom_io";
-    EXIT_IF_FAIL(not stream_.str().empty(), "No SDP loaded");
-    audioDecoder_->setIOContext(sdpContext_.get());
-    EXIT_IF_FAIL(not audioDecoder_->openInput(args_),
-        "Could not open input \"%s\"", SDP_FILENAME);
-    // Now replace our custom AVIOContext with one that will read packets
-    audioDecoder_->setIOContext(demuxContext_.get());
-
-    EXIT_IF_FAIL(not audioDecoder_->setupFromAudioData(format_),
-                 "decoder IO startup failed");
+    if (audioDecoder_->setupFromAudioCodec(accountAudioCodec->systemCodecInfo.avcodecId,
+                                           accountAudioCodec->audioformat) < 0)
+        return false;
+    audioDecoder_->setStats(&stats_);
+    return true;
+}
 
+bool
+AudioReceiveThread::setup()
+{
+    EXIT_IF_FAIL(setupDecoder(), "decoder IO startup failed");
+    stats_.setCodec(audioDecoder_->getDecoderName());
     ringbuffer_ = Manager::instance().getRingBufferPool().getRingBuffer(id_);
     return true;
 }
@@ -290,71 +308,106 @@ AudioReceiveThread::setup()
 void
 AudioReceiveThread::process()
 {
-    AudioFormat mainBuffFormat = Manager::instance().getRingBufferPool().getInternalAudioFormat();
-    AudioFrame decodedFrame;
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        jitterBuffer_.nextPlayout() - RtpJitterBuffer::clock::now());
+    bool fromRTCP;
+    const auto len = socketPair_.readMediaPacket(packet_.data(), packet_.size(),
+        std::max(std::min(wait, RECEIVE_MAX_WAIT), std::chrono::milliseconds::zero()), fromRTCP);
+    if (len < 0) {
+        if (loop_.isRunning())
+            RING_ERR("fatal error, read failed");
+        loop_.stop();
+        return;
+    }
+    if (len > 0) {
+        if (fromRTCP)
+            rtcpReport_.onRtcp(packet_.data(), len);
+        else
+            jitterBuffer_.push(packet_.data(), len);
+    }
 
-    switch (audioDecoder_->decode(decodedFrame)) {
+    playout();
+    sendReport();
+}
 
-        case MediaDecoder::Status::FrameFinished:
-            audioDecoder_->writeToRingBuffer(decodedFrame, *ringbuffer_,
-                                             mainBuffFormat);
-            // Refresh the remote audio codec in the callback SmartInfo
-            Smartools::getInstance().setRemoteAudioCodec(audioDecoder_->getDecoderName());
-            return;
+void
+AudioReceiveThread::sendReport()
+{
+    RtpJitterBuffer::Reception reception;
+    if (not rtcpReport_.due() or not jitterBuffer_.getReception(reception))
+        return;
 
-        case MediaDecoder::Status::DecodeError:
-            RING_WARN("decoding failure, trying to reset decoder...");
-            if (not setup()) {
-                RING_ERR("fatal error, rx thread re-setup failed");
-                loop_.stop();
-                break;
-            }
-            if (not audioDecoder_->setupFromAudioData(format_)) {
-                RING_ERR("fatal error, a-decoder setup failed");
-                loop_.stop();
+    const auto size = rtcpReport_.build(reception, rtcpPacket_.data(), rtcpPacket_.size());
+    if (size and socketPair_.sendRtcpPacket(rtcpPacket_.data(), size) < 0)
+        RING_WARN("failed to send RTCP receiver report");
+}
+
+void
+AudioReceiveThread::playout()
+{
+    const auto mainBuffFormat = Manager::instance().getRingBufferPool().getInternalAudioFormat();
+    RtpJitterBuffer::Status status;
+
+    while ((status = jitterBuffer_.pop(playoutPacket_)) != RtpJitterBuffer::Status::Empty) {
+        if (status == RtpJitterBuffer::Status::Lost) {
+            conceal();
+            continue;
+        }
+
+        // telephone-event, comfort noise...
+        if (playoutPacket_.payloadType != args_.payload_type)
+            continue;
+
+        AudioFrame decodedFrame;
+        switch (audioDecoder_->decode(playoutPacket_.payload.data(),
+                                      playoutPacket_.payload.size(),
+                                      decodedFrame)) {
+            case MediaDecoder::Status::FrameFinished:
+                lastFrame_ = audioDecoder_->toAudioBuffer(decodedFrame, mainBuffFormat);
+                ringbuffer_->put(lastFrame_);
+                concealed_ = 0;
                 break;
-            }
-            break;
 
-        case MediaDecoder::Status::ReadError:
-            RING_ERR("fatal error, read failed");
-            loop_.stop();
-            break;
+            case MediaDecoder::Status::DecodeError:
+                RING_WARN("decoding failure, trying to reset decoder...");
+                if (not setupDecoder()) {
+                    RING_ERR("fatal error, a-decoder setup failed");
+                    loop_.stop();
+                    return;
+                }
+                break;
 
-        case MediaDecoder::Status::Success:
-        case MediaDecoder::Status::EOFError:
-        default:
-            break;
+            default:
+                break;
+        }
     }
+
+    const auto jbStats = jitterBuffer_.getStats();
+    stats_.setJitterBuffer(jbStats.late + jbStats.duplicated + jbStats.overflowed,
+                           jbStats.delayUs);
 }
 
 void
-AudioReceiveThread::cleanup()
+AudioReceiveThread::conceal()
 {
-    audioDecoder_.reset();
-    demuxContext_.reset();
-}
+    // Nothing to repeat yet
+    if (not lastFrame_.frames())
+        return;
 
-int
-AudioReceiveThread::readFunction(void* opaque, uint8_t* buf, int buf_size)
-{
-    std::istream& is = static_cast<AudioReceiveThread*>(opaque)->stream_;
-    is.read(reinterpret_cast<char*>(buf), buf_size);
-    return is.gcount();
-}
+    // Fade out the last frame, then play silence
+    if (++concealed_ > MAX_CONCEALED)
+        lastFrame_.reset();
+    else
+        lastFrame_.applyGain(0.5);
 
-// This callback is used by libav internally to break out of blocking calls
-int
-AudioReceiveThread::interruptCb(void* data)
-{
-    auto context = static_cast<AudioReceiveThread*>(data);
-    return not context->loop_.isRunning();
+    ringbuffer_->put(lastFrame_);
+    stats_.onConcealed();
 }
 
 void
-AudioReceiveThread::addIOContext(SocketPair& socketPair)
+AudioReceiveThread::cleanup()
 {
-    demuxContext_.reset(socketPair.createIOContext(mtu_));
+    audioDecoder_.reset();
 }
 
 void
@@ -367,7 +420,9 @@ AudioRtpSession::AudioRtpSession(const std::string& id)
     : RtpSession(id)
 {
     // don't move this into the initializer list or Cthulus will emerge
-    ringbuffer_ = Manager::instance().getRingBufferPool().createRingBuffer(callID_);
+    // Only written by the receive thread, read by the audio layer and the mixer
+    ringbuffer_ = Manager::instance().getRingBufferPool().createRingBuffer(
+        callID_, RingBufferPool::RingBufferType::LOCK_FREE);
 }
 
 AudioRtpSession::~AudioRtpSession()
@@ -400,7 +455,8 @@ AudioRtpSession::startSender()
         sender_.reset();
         socketPair_->stopSendOp(false);
         sender_.reset(new AudioSender(callID_, getRemoteRtpUri(), send_,
-                                      *socketPair_, initSeqVal_, muteState_, mtu_));
+                                      *socketPair_, stats_->audioSend,
+                                      initSeqVal_, muteState_, mtu_));
     } catch (const MediaEncoderException &e) {
         RING_ERR("%s", e.what());
         send_.enabled = false;
@@ -430,11 +486,8 @@ AudioRtpSession::startReceiver()
     if (receiveThread_)
         RING_WARN("Restarting audio receiver");
 
-    auto accountAudioCodec = std::static_pointer_cast<AccountAudioCodecInfo>(receive_.codec);
-    receiveThread_.reset(new AudioReceiveThread(callID_, accountAudioCodec->audioformat,
-                                                receive_.receiving_sdp,
-                                                mtu_));
-    receiveThread_->addIOContext(*socketPair_);
+    receiveThread_.reset(new AudioReceiveThread(callID_, receive_, *socketPair_,
+                                                stats_->audioReceive));
     receiveThread_->startLoop();
 }
 
@@ -465,6 +518,9 @@ AudioRtpSession::start(std::unique_ptr<IceSocket> rtp_sock, std::unique_ptr<IceS
         else
             socketPair_.reset(new SocketPair(getRemoteRtpUri().c_str(), receive_.addr.getPort()));
 
+        stats_->audioReceive.setClockRate(receive_.rtp_clockrate);
+        socketPair_->setStats(&stats_->audioSend, &stats_->audioReceive);
+
         if (send_.crypto and receive_.crypto) {
             socketPair_->createSRTP(receive_.crypto.getCryptoSuite().c_str(),
                                     receive_.crypto.getSrtpKeyInfo().c_str(),
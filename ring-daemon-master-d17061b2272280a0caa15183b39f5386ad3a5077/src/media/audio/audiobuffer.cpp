@@ -19,50 +19,147 @@
  */
 
 #include "audiobuffer.h"
+#include "audio_kernels.h"
 #include "logger.h"
 #include <string.h>
 #include <cstring> // memset
+#include <cstdlib>
+#include <cmath>
 #include <algorithm>
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 namespace ring {
 
+constexpr size_t AudioBuffer::CHANNEL_ALIGNMENT;
+
 std::ostream& operator <<(std::ostream& stream, const AudioFormat& f) {
     stream << f.toString();
     return stream;
 }
 
+static AudioSample*
+allocSamples(size_t n)
+{
+    void* p = nullptr;
+#ifdef _WIN32
+    p = _aligned_malloc(n * sizeof(AudioSample), AudioBuffer::CHANNEL_ALIGNMENT);
+#else
+    if (posix_memalign(&p, AudioBuffer::CHANNEL_ALIGNMENT, n * sizeof(AudioSample)))
+        p = nullptr;
+#endif
+    if (not p)
+        throw std::bad_alloc();
+    return static_cast<AudioSample*>(p);
+}
+
+void AudioBuffer::AlignedFree::operator()(AudioSample* p) const
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
 AudioBuffer::AudioBuffer(size_t sample_num, AudioFormat format)
     :  sampleRate_(format.sample_rate),
-       samples_(std::max(1U, format.nb_channels),
-                std::vector<AudioSample>(sample_num, 0))
+       channels_(std::max(1U, format.nb_channels)),
+       frames_(sample_num)
 {
+    reserve(channels_, frames_);
+    reset();
 }
 
 AudioBuffer::AudioBuffer(const AudioSample* in, size_t sample_num, AudioFormat format)
-    :  sampleRate_(format.sample_rate),
-       samples_((std::max(1U, format.nb_channels)), std::vector<AudioSample>(sample_num, 0))
+    :  AudioBuffer(sample_num, format)
 {
     deinterleave(in, sample_num, format.nb_channels);
 }
 
 AudioBuffer::AudioBuffer(const AudioBuffer& other, bool copy_content /* = false */)
     :  sampleRate_(other.sampleRate_),
-       samples_(copy_content ? other.samples_ :
-                std::vector<std::vector<AudioSample> >(other.samples_.size(), std::vector<AudioSample>(other.frames())))
-{}
+       channels_(other.channels_),
+       frames_(other.frames_)
+{
+    reserve(channels_, frames_);
+    if (copy_content)
+        copy(other);
+    else
+        reset();
+}
+
+AudioBuffer::AudioBuffer(AudioBuffer&& other)
+    :  sampleRate_(other.sampleRate_),
+       channels_(other.channels_),
+       frames_(other.frames_),
+       stride_(other.stride_),
+       allocatedChannels_(other.allocatedChannels_),
+       data_(std::move(other.data_))
+{
+    other.channels_ = 0;
+    other.frames_ = 0;
+    other.stride_ = 0;
+    other.allocatedChannels_ = 0;
+}
 
 AudioBuffer& AudioBuffer::operator=(const AudioBuffer& other) {
-    samples_ = other.samples_;
+    if (this == &other)
+        return *this;
+    // nothing to preserve: avoid copying old content on reallocation
+    channels_ = 0;
+    frames_ = 0;
+    reserve(other.channels_, other.frames_);
+    channels_ = other.channels_;
+    frames_ = other.frames_;
     sampleRate_ = other.sampleRate_;
+    copy(other);
     return *this;
 }
 
 AudioBuffer& AudioBuffer::operator=(AudioBuffer&& other) {
-    samples_ = std::move( other.samples_ );
+    data_ = std::move(other.data_);
+    stride_ = other.stride_;
+    allocatedChannels_ = other.allocatedChannels_;
+    channels_ = other.channels_;
+    frames_ = other.frames_;
     sampleRate_ = other.sampleRate_;
+    other.channels_ = 0;
+    other.frames_ = 0;
+    other.stride_ = 0;
+    other.allocatedChannels_ = 0;
     return *this;
 }
 
+void AudioBuffer::reserve(unsigned channels, size_t frames)
+{
+    static constexpr size_t ALIGN_SAMPLES = CHANNEL_ALIGNMENT / sizeof(AudioSample);
+
+    size_t stride = stride_;
+    if (frames > stride or stride == 0)
+        stride = std::max(ALIGN_SAMPLES, (frames + ALIGN_SAMPLES - 1) / ALIGN_SAMPLES * ALIGN_SAMPLES);
+    const unsigned chans = std::max(channels, allocatedChannels_);
+
+    if (stride == stride_ and chans == allocatedChannels_)
+        return;
+
+    if (chans == 0) {
+        stride_ = stride;
+        return;
+    }
+
+    std::unique_ptr<AudioSample, AlignedFree> data(allocSamples(chans * stride));
+    if (data_)
+        for (unsigned c = 0; c < channels_; c++)
+            std::memcpy(data.get() + c * stride, channelData(c), frames_ * sizeof(AudioSample));
+
+    data_ = std::move(data);
+    stride_ = stride;
+    allocatedChannels_ = chans;
+}
+
 int AudioBuffer::getSampleRate() const
 {
     return sampleRate_;
@@ -75,38 +172,38 @@ void AudioBuffer::setSampleRate(int sr)
 
 void AudioBuffer::setChannelNum(unsigned n, bool mix /* = false */)
 {
-    const unsigned c = samples_.size();
+    const unsigned c = channels_;
+    n = std::max(1U, n);
     if (n == c)
         return;
 
-    n = std::max(1U, n);
+    if (n > c)
+        reserve(n, frames_);
 
     if (!mix or c == 0) {
-        if (n < c)
-            samples_.resize(n);
-        else
-            samples_.resize(n, std::vector<AudioSample>(frames(), 0));
+        for (unsigned i = c; i < n; i++)
+            std::fill_n(channelData(i), frames_, 0);
+        channels_ = n;
         return;
     }
 
     // 2ch->1ch
     if (n == 1) {
-        std::vector<AudioSample>& chan1 = samples_[0];
-        std::vector<AudioSample>& chan2 = samples_[1];
-        for (unsigned i = 0, f = frames(); i < f; i++)
+        AudioSample* chan1 = channelData(0);
+        const AudioSample* chan2 = channelData(1);
+        for (size_t i = 0; i < frames_; i++)
             chan1[i] = chan1[i] / 2 + chan2[i] / 2;
-        samples_.resize(1);
+        channels_ = 1;
         return;
     }
 
-    // 1ch->Nch
-    if (c == 1) {
-        samples_.resize(n, samples_[0]);
-        return;
-    }
+    if (c != 1)
+        RING_WARN("Unsupported channel mixing: %dch->%dch", c, n);
 
-    RING_WARN("Unsupported channel mixing: %dch->%dch", c, n);
-    samples_.resize(n, samples_[0]);
+    // 1ch->Nch
+    for (unsigned i = c; i < n; i++)
+        std::memcpy(channelData(i), channelData(0), frames_ * sizeof(AudioSample));
+    channels_ = n;
 }
 
 void AudioBuffer::setFormat(AudioFormat format)
@@ -117,18 +214,38 @@ void AudioBuffer::setFormat(AudioFormat format)
 
 void AudioBuffer::resize(size_t sample_num)
 {
-    if (frames() == sample_num)
+    if (frames_ == sample_num)
         return;
 
+    reserve(channels_, sample_num);
+
     // will add zero padding if buffer is growing
-    for (auto &s : samples_)
-        s.resize(sample_num, 0);
+    if (sample_num > frames_)
+        for (unsigned c = 0; c < channels_; c++)
+            std::fill_n(channelData(c) + frames_, sample_num - frames_, 0);
+
+    frames_ = sample_num;
 }
 
-std::vector<AudioSample> * AudioBuffer::getChannel(unsigned chan /* = 0 */)
+void AudioBuffer::reset()
 {
-    if (chan < samples_.size())
-        return &samples_[chan];
+    if (data_)
+        std::memset(data_.get(), 0, channels_ * stride_ * sizeof(AudioSample));
+}
+
+AudioSample* AudioBuffer::getChannel(unsigned chan /* = 0 */)
+{
+    if (chan < channels_)
+        return channelData(chan);
+
+    RING_ERR("Audio channel %u out of range", chan);
+    return nullptr;
+}
+
+const AudioSample* AudioBuffer::getChannel(unsigned chan /* = 0 */) const
+{
+    if (chan < channels_)
+        return channelData(chan);
 
     RING_ERR("Audio channel %u out of range", chan);
     return nullptr;
@@ -141,28 +258,46 @@ void AudioBuffer::applyGain(double gain)
     const double g = std::max(std::min(1.0, gain), -1.0);
     if (g != gain)
         RING_DBG("Normalizing %f to [-1.0, 1.0]", gain);
+    if (g == 1.0) return;
 
-    for (auto &channel : samples_)
-        for (auto &sample : channel)
-            sample *= g;
+    // Q15 fixed-point gain
+    const auto q15 = static_cast<int16_t>(std::max(-32768L, std::min(std::lrint(g * 32768.), 32767L)));
+    const auto& kernels = getAudioKernels();
+    for (unsigned c = 0; c < channels_; c++)
+        kernels.gain(channelData(c), frames_, q15);
 }
 
 size_t AudioBuffer::channelToFloat(float* out, const int& channel) const
 {
-
-    for (int i=0, f=frames(); i < f; i++)
-        *out++ = (float) samples_[channel][i] * .000030517578125f;
-
-    return frames() * samples_.size();
+    getAudioKernels().toFloat(out, channelData(channel), frames_);
+    return frames_ * channels_;
 }
 
 size_t AudioBuffer::interleave(AudioSample* out) const
 {
-    for (unsigned i=0, f=frames(), c=channels(); i < f; ++i)
-        for (unsigned j = 0; j < c; ++j)
-            *out++ = samples_[j][i];
+    return interleave(out, 0, frames_);
+}
+
+size_t AudioBuffer::interleave(AudioSample* out, size_t pos, size_t frame_num) const
+{
+    if (pos >= frames_)
+        return 0;
+    frame_num = std::min(frame_num, frames_ - pos);
+
+    switch (channels_) {
+        case 1:
+            std::copy_n(channelData(0) + pos, frame_num, out);
+            break;
+        case 2:
+            getAudioKernels().interleave2(out, channelData(0) + pos, channelData(1) + pos, frame_num);
+            break;
+        default:
+            for (size_t i = pos; i < pos + frame_num; ++i)
+                for (unsigned j = 0; j < channels_; ++j)
+                    *out++ = channelData(j)[i];
+    }
 
-    return frames() * channels();
+    return frame_num * channels_;
 }
 
 size_t AudioBuffer::fillWithZero(AudioSample* out) const
@@ -187,11 +322,21 @@ std::vector<AudioSample> AudioBuffer::interleave() const
 
 size_t AudioBuffer::interleaveFloat(float* out) const
 {
-    for (unsigned i=0, f=frames(), c=channels(); i < f; i++)
-        for (unsigned j = 0; j < c; j++)
-            *out++ = (float) samples_[j][i] * .000030517578125f;
+    const auto& kernels = getAudioKernels();
+    switch (channels_) {
+        case 1:
+            kernels.toFloat(out, channelData(0), frames_);
+            break;
+        case 2:
+            kernels.interleave2Float(out, channelData(0), channelData(1), frames_);
+            break;
+        default:
+            for (size_t i = 0; i < frames_; i++)
+                for (unsigned j = 0; j < channels_; j++)
+                    *out++ = (float) channelData(j)[i] * .000030517578125f;
+    }
 
-    return frames() * samples_.size();
+    return frames_ * channels_;
 }
 
 void AudioBuffer::deinterleave(const AudioSample* in, size_t frame_num, unsigned nb_channels)
@@ -203,9 +348,18 @@ void AudioBuffer::deinterleave(const AudioSample* in, size_t frame_num, unsigned
     setChannelNum(nb_channels);
     resize(frame_num);
 
-    for (unsigned i=0, f=frames(), c=channels(); i < f; i++)
-        for (unsigned j = 0; j < c; j++)
-            samples_[j][i] = *in++;
+    switch (channels_) {
+        case 1:
+            std::copy_n(in, frames_, channelData(0));
+            break;
+        case 2:
+            getAudioKernels().deinterleave2(channelData(0), channelData(1), in, frames_);
+            break;
+        default:
+            for (size_t i = 0; i < frames_; i++)
+                for (unsigned j = 0; j < channels_; j++)
+                    channelData(j)[i] = *in++;
+    }
 }
 
 void AudioBuffer::deinterleave(const std::vector<AudioSample>& in, AudioFormat format)
@@ -214,43 +368,63 @@ void AudioBuffer::deinterleave(const std::vector<AudioSample>& in, AudioFormat f
     deinterleave(in.data(), in.size()/format.nb_channels, format.nb_channels);
 }
 
-void AudioBuffer::convertFloatPlanarToSigned16(uint8_t** extended_data, size_t frame_num, unsigned nb_channels)
+void AudioBuffer::deinterleaveFloat(const float* in, size_t frame_num, unsigned nb_channels)
 {
-    if (extended_data == nullptr)
+    if (in == nullptr)
         return;
 
     // Resize buffer
     setChannelNum(nb_channels);
     resize(frame_num);
 
-    for (unsigned j = 0, c = channels(); j < c; j++){
-        float* inputChannel = (float*)extended_data[j];
-        for (unsigned i=0, f=frames(); i < f; i++){
-            float inputChannelVal = *inputChannel++;
-            // avoid saturation: limit val between -1 and 1
-            inputChannelVal = std::max(-1.0f, std::min(inputChannelVal, 1.0f));
-            samples_[j][i] = (int16_t) (inputChannelVal * 32768.0f);
+    const auto& kernels = getAudioKernels();
+    switch (channels_) {
+        case 1:
+            kernels.fromFloat(channelData(0), in, frames_);
+            break;
+        case 2:
+            kernels.deinterleave2FromFloat(channelData(0), channelData(1), in, frames_);
+            break;
+        default: {
+            const auto& scalar = getScalarAudioKernels();
+            for (size_t i = 0; i < frames_; i++)
+                for (unsigned j = 0; j < channels_; j++)
+                    scalar.fromFloat(channelData(j) + i, in++, 1);
         }
     }
 }
 
+void AudioBuffer::convertFloatPlanarToSigned16(uint8_t** extended_data, size_t frame_num, unsigned nb_channels)
+{
+    if (extended_data == nullptr)
+        return;
+
+    // Resize buffer
+    setChannelNum(nb_channels);
+    resize(frame_num);
+
+    // input is clamped to [-1, 1] to avoid saturation
+    const auto& kernels = getAudioKernels();
+    for (unsigned j = 0; j < channels_; j++)
+        kernels.fromFloat(channelData(j), reinterpret_cast<const float*>(extended_data[j]), frames_);
+}
+
 size_t AudioBuffer::mix(const AudioBuffer& other, bool up /* = true */)
 {
-    const bool upmix = up && (other.samples_.size() < samples_.size());
-    const size_t samp_num = std::min(frames(), other.frames());
-    const unsigned chan_num = upmix ? samples_.size() : std::min(samples_.size(), other.samples_.size());
+    const bool upmix = up && (other.channels_ < channels_);
+    const size_t samp_num = std::min(frames_, other.frames_);
+    const unsigned chan_num = upmix ? channels_ : std::min(channels_, other.channels_);
 
+    const auto& kernels = getAudioKernels();
     for (unsigned i = 0; i < chan_num; i++) {
-        unsigned src_chan = upmix ? std::min<unsigned>(i, other.samples_.size() - 1) : i;
-
-        for (unsigned j = 0; j < samp_num; j++)
-            samples_[i][j] += other.samples_[src_chan][j];
+        unsigned src_chan = upmix ? std::min<unsigned>(i, other.channels_ - 1) : i;
+        kernels.mix(channelData(i), other.channelData(src_chan), samp_num);
     }
 
     return samp_num;
 }
 
-size_t AudioBuffer::copy(AudioBuffer& in, int sample_num /* = -1 */, size_t pos_in /* = 0 */, size_t pos_out /* = 0 */, bool up /* = true */)
+size_t AudioBuffer::copy(const AudioBuffer& in, int sample_num /* = -1 */, size_t pos_in /* = 0 */, size_t pos_out /* = 0 */, bool up /* = true */)
 {
     if (sample_num == -1)
         sample_num = in.frames();
@@ -259,8 +433,8 @@ size_t AudioBuffer::copy(AudioBuffer& in, int sample_num /* = -1 */, size_t pos_
 
     if (to_copy <= 0) return 0;
 
-    const bool upmix = up && (in.samples_.size() < samples_.size());
-    const size_t chan_num = upmix ? samples_.size() : std::min(in.samples_.size(), samples_.size());
+    const bool upmix = up && (in.channels_ < channels_);
+    const size_t chan_num = upmix ? channels_ : std::min(in.channels_, channels_);
 
     if ((pos_out + to_copy) > frames())
         resize(pos_out + to_copy);
@@ -268,8 +442,8 @@ size_t AudioBuffer::copy(AudioBuffer& in, int sample_num /* = -1 */, size_t pos_
     sampleRate_ = in.sampleRate_;
 
     for (unsigned i = 0; i < chan_num; i++) {
-        size_t src_chan = upmix ? std::min<size_t>(i, in.samples_.size() - 1U) : i;
-        std::copy(in.samples_[src_chan].begin() + pos_in, in.samples_[src_chan].begin() + pos_in + to_copy, samples_[i].begin() + pos_out);
+        size_t src_chan = upmix ? std::min<size_t>(i, in.channels_ - 1U) : i;
+        std::memcpy(channelData(i) + pos_out, in.channelData(src_chan) + pos_in, to_copy * sizeof(AudioSample));
     }
 
     return to_copy;
@@ -282,9 +456,8 @@ size_t AudioBuffer::copy(AudioSample* in, size_t sample_num, size_t pos_out /* =
     if ((pos_out + sample_num) > frames())
         resize(pos_out + sample_num);
 
-    const size_t chan_num = samples_.size();
-    for (unsigned i = 0; i < chan_num; i++)
-        std::copy(in, in + sample_num, samples_[i].begin() + pos_out);
+    for (unsigned i = 0; i < channels_; i++)
+        std::memcpy(channelData(i) + pos_out, in, sample_num * sizeof(AudioSample));
 
     return sample_num;
 }
@@ -28,6 +28,7 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <memory>
 #include <cstddef> // for size_t
 
 #include "ring_types.h"
@@ -109,7 +110,7 @@ class AudioBuffer {
         /**
          * Move constructor
          */
-        AudioBuffer(AudioBuffer&& other) : sampleRate_(other.sampleRate_), samples_( std::move(other.samples_) ) {};
+        AudioBuffer(AudioBuffer&& other);
 
         /**
          * Copy operator
@@ -148,7 +149,7 @@ class AudioBuffer {
          * Returns the number of channels in this buffer.
          */
         inline unsigned channels() const {
-            return samples_.size();
+            return channels_;
         }
 
         /**
@@ -171,17 +172,22 @@ class AudioBuffer {
         void setFormat(AudioFormat format);
 
         inline AudioFormat getFormat() const {
-            return AudioFormat(sampleRate_, samples_.size());
+            return AudioFormat(sampleRate_, channels_);
         }
 
         /**
          * Returns the number of (multichannel) frames in this buffer.
          */
         inline size_t frames() const {
-            if (not samples_.empty())
-                return samples_[0].size();
-            else
-                return 0;
+            return frames_;
+        }
+
+        /**
+         * Returns the distance, in samples, between the start of two channels.
+         * Channel data is aligned on CHANNEL_ALIGNMENT bytes.
+         */
+        inline size_t channelStride() const {
+            return stride_;
         }
 
         /**
@@ -203,30 +209,21 @@ class AudioBuffer {
          * Resize the buffer to 0. All samples are lost but the number of channels and sample rate are kept.
          */
         void clear() {
-            for(auto& c : samples_)
-                c.clear();
+            frames_ = 0;
         }
 
         /**
          * Set all samples in this buffer to 0. Buffer size is not changed.
          */
-        void reset() {
-            for(auto& c : samples_)
-                std::fill(c.begin(), c.end(), 0);
-        }
-
-        /**
-         * Return the data (audio samples) for a given channel number.
-         * Channel data can be modified but size of individual channel vectors should not be changed by the user.
-         */
-        std::vector<AudioSample> *getChannel(unsigned chan);
+        void reset();
 
         /**
-         * Return a pointer to the raw data in this buffer.
+         * Return the data (frames() audio samples) for a given channel number,
+         * or nullptr if the channel doesn't exist.
+         * Pointer validity is limited until the next resize or channel change.
          */
-        inline std::vector<std::vector<AudioSample> > &getData() {
-            return samples_;
-        }
+        AudioSample* getChannel(unsigned chan);
+        const AudioSample* getChannel(unsigned chan) const;
 
         /**
          * Returns pointers to non-interleaved raw data.
@@ -234,10 +231,9 @@ class AudioBuffer {
          * limited in time.
          */
         inline const std::vector<AudioSample*> getDataRaw() {
-            const unsigned chans = samples_.size();
-            std::vector<AudioSample*> raw_data(chans, nullptr);
-            for(unsigned i=0; i<chans; i++)
-                raw_data[i] = samples_[i].data();
+            std::vector<AudioSample*> raw_data(channels_, nullptr);
+            for(unsigned i=0; i<channels_; i++)
+                raw_data[i] = channelData(i);
             return raw_data;
         }
 
@@ -257,6 +253,14 @@ class AudioBuffer {
          */
         size_t interleave(AudioSample* out) const;
 
+        /**
+         * Same as interleave(out), for frame_num frames starting at frame pos.
+         * The out buffer must hold frame_num*channels() samples.
+         *
+         * @returns Number of samples writen.
+         */
+        size_t interleave(AudioSample* out, size_t pos, size_t frame_num) const;
+
         /**
          * Write null data (silence) to the out buffer (fixed-point 16-bits).
          * The out buffer must be at least of size capacity()*sizeof(AudioSample) bytes.
@@ -298,6 +302,12 @@ class AudioBuffer {
          */
         void deinterleave(const std::vector<AudioSample>& in, AudioFormat format);
 
+        /**
+         * Import interleaved float data, converted in the same pass.
+         * Internal buffer is resized as needed. Input is clamped to [-1, 1].
+         */
+        void deinterleaveFloat(const float* in, size_t frame_num, unsigned nb_channels = 1);
+
         /**
          * convert float planar data to signed 16
          */
@@ -312,13 +322,11 @@ class AudioBuffer {
         void applyGain(double gain);
 
         /**
-         * Mix samples from the other buffer within this buffer (in-place simple addition).
+         * Mix samples from the other buffer within this buffer (in-place saturating addition).
          * If the other buffer has more channels than this one, only the first this.channels() channels are imported.
          * If the other buffer has less channels than this one, behavior depends on upmix.
          * Sample rate is not considered by this function.
          *
-         * TODO: some kind of check for overflow/saturation.
-         *
          * @param other: the other buffer to mix in this one.
          * @param upmix: if true, upmixing occurs when other.channels() < this.channels().
          *              If false, only the first other.channels() channels are edited in this buffer.
@@ -333,7 +341,7 @@ class AudioBuffer {
          *
          * Buffer sample number is increased if required to hold the new requested samples.
          */
-        size_t copy(AudioBuffer& in, int sample_num = -1, size_t pos_in = 0, size_t pos_out = 0, bool upmix = true);
+        size_t copy(const AudioBuffer& in, int sample_num = -1, size_t pos_in = 0, size_t pos_out = 0, bool upmix = true);
 
         /**
          * Copy sample_num samples from in to this buffer (at sample pos_out).
@@ -343,11 +351,35 @@ class AudioBuffer {
          */
         size_t copy(AudioSample* in, size_t sample_num, size_t pos_out = 0);
 
+        static constexpr size_t CHANNEL_ALIGNMENT = 32;
+
     private:
+        struct AlignedFree {
+            void operator()(AudioSample* p) const;
+        };
+
+        inline AudioSample* channelData(unsigned chan) {
+            return data_.get() + chan * stride_;
+        }
+
+        inline const AudioSample* channelData(unsigned chan) const {
+            return data_.get() + chan * stride_;
+        }
+
+        /**
+         * Make room for the given number of channels and frames,
+         * keeping current content. Never shrinks the allocation.
+         */
+        void reserve(unsigned channels, size_t frames);
+
         int sampleRate_;
+        unsigned channels_;
+        size_t frames_;
 
-        // buffers holding data for each channels
-        std::vector<std::vector<AudioSample> > samples_;
+        // all channels are held in one allocation, stride_ samples apart
+        size_t stride_ {0};
+        unsigned allocatedChannels_ {0};
+        std::unique_ptr<AudioSample, AlignedFree> data_;
 };
 
 } // namespace ring
@@ -46,6 +46,7 @@
 #define JACK_API_STR                "jack"
 #define COREAUDIO_API_STR           "coreaudio"
 #define PORTAUDIO_API_STR           "portaudio"
+#define NULL_API_STR                "null"
 
 #define PCM_DEFAULT "default"         // Default ALSA plugin
 #define PCM_DSNOOP  "plug:dsnoop"     // Alsa plugin for microphone sharing
@@ -24,6 +24,7 @@
 #endif
 
 #include "audiorecord.h"
+#include "media/packet_ring.h"
 #include "logger.h"
 #include "fileutils.h"
 #include "manager.h"
@@ -33,12 +34,32 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
 #include <sstream> // for stringstream
+#include <cinttypes>
 #include <cstdio>
 #include <unistd.h>
 
 namespace ring {
 
+static constexpr const char* DEFAULT_FILE_FORMAT = "wav";
+
+// Queue between the recorder and the writer: about 2.7s at 48kHz stereo
+static constexpr size_t QUEUE_SLOT_SIZE {8192};
+static constexpr size_t QUEUE_DEPTH {64};
+
+// The writer thread wakes up to write a batch every WRITE_PERIOD
+static constexpr auto WRITE_PERIOD = std::chrono::milliseconds(500);
+
+// Vorbis VBR quality, from 0 to 1
+static constexpr double VORBIS_QUALITY {0.4};
+
+static std::string
+fileExtension(const std::string& format)
+{
+    return "." + format;
+}
+
 static std::string
 createFilename()
 {
@@ -84,6 +105,13 @@ AudioRecord::AudioRecord()
     : sndFormat_(AudioFormat::MONO())
     , filename_(createFilename())
     , savePath_()
+    , fileFormat_(DEFAULT_FILE_FORMAT)
+    , writer_([] { return true; },
+              [this] {
+                  writer_.wait_for(WRITE_PERIOD);
+                  writeQueued();
+              },
+              [this] { writeQueued(); })
     , recorder_(this, Manager::instance().getRingBufferPool())
 {
     RING_DBG("Generate filename for this call %s ", filename_.c_str());
@@ -114,6 +142,16 @@ void AudioRecord::setRecordingOptions(AudioFormat format, const std::string &pat
     savePath_ = (*filePath.rbegin() == DIR_SEPARATOR_CH) ? filePath : filePath + DIR_SEPARATOR_STR;
 }
 
+void AudioRecord::setFileFormat(const std::string &format)
+{
+    if (format == "wav" or format == "flac" or format == "ogg") {
+        fileFormat_ = format;
+    } else {
+        RING_WARN("Unsupported recording format %s, using %s", format.c_str(), DEFAULT_FILE_FORMAT);
+        fileFormat_ = DEFAULT_FILE_FORMAT;
+    }
+}
+
 static bool
 nonFilenameCharacter(char c)
 {
@@ -132,15 +170,28 @@ void AudioRecord::initFilename(const std::string &peerNumber)
 {
     RING_DBG("Initialize audio record for peer  : %s", peerNumber.c_str());
     // if savePath_ don't contains filename
-    if (savePath_.find(".wav") == std::string::npos) {
+    if (savePath_.find(fileExtension(fileFormat_)) == std::string::npos) {
         filename_ = createFilename();
         filename_.append("-" + sanitize(peerNumber) + "-" PACKAGE);
-        filename_.append(".wav");
+        filename_.append(fileExtension(fileFormat_));
     } else {
         filename_ = "";
     }
 }
 
+void AudioRecord::initTrackFilename(const AudioRecord &mix, const std::string &track)
+{
+    // Path of the mix, without its extension
+    auto name = mix.getFilename();
+    const auto mixExtension = fileExtension(mix.fileFormat_);
+    if (name.size() > mixExtension.size()
+        and name.compare(name.size() - mixExtension.size(), mixExtension.size(), mixExtension) == 0)
+        name.erase(name.size() - mixExtension.size());
+
+    savePath_ = "";
+    filename_ = name + "-" + sanitize(track) + fileExtension(fileFormat_);
+}
+
 std::string AudioRecord::getFilename() const
 {
     return savePath_ + filename_;
@@ -152,26 +203,45 @@ AudioRecord::openFile()
 #ifndef RING_UWP
     fileHandle_.reset(); // do it before calling fileExists()
 
-    const bool doAppend = fileExists();
+    // Only WAV files can be appended to, compressed ones are rewritten
+    int format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    if (fileFormat_ == "flac")
+        format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+    else if (fileFormat_ == "ogg")
+        format = SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+
+    const bool doAppend = fileFormat_ == "wav" and fileExists();
     const int access = doAppend ? SFM_RDWR : SFM_WRITE;
 
-    RING_DBG("Opening file %s with format %s", getFilename().c_str(), sndFormat_.toString().c_str());
+    RING_DBG("Opening %s file %s with format %s", fileFormat_.c_str(), getFilename().c_str(),
+             sndFormat_.toString().c_str());
     fileHandle_.reset(new SndfileHandle (getFilename().c_str(),
                                          access,
-                                         SF_FORMAT_WAV | SF_FORMAT_PCM_16,
+                                         format,
                                          sndFormat_.nb_channels,
                                          sndFormat_.sample_rate));
 
     // check overloaded boolean operator
     if (!*fileHandle_) {
-        RING_WARN("Could not open WAV file!");
+        RING_WARN("Could not open %s file!", fileFormat_.c_str());
         fileHandle_.reset();
         return false;
     }
 
+    if (fileFormat_ == "ogg") {
+        double quality = VORBIS_QUALITY;
+        fileHandle_->command(SFC_SET_VBR_ENCODING_QUALITY, &quality, sizeof(quality));
+    }
+
     if (doAppend and fileHandle_->seek(0, SEEK_END) < 0)
         RING_WARN("Couldn't seek to the end of the file ");
 
+    if (not queue_) {
+        queue_.reset(new PacketRing(QUEUE_DEPTH, QUEUE_SLOT_SIZE));
+        batch_.resize(QUEUE_DEPTH * QUEUE_SLOT_SIZE / sizeof(AudioSample));
+    }
+    writer_.start();
+
     return true;
 #else
     return false;
@@ -181,7 +251,15 @@ AudioRecord::openFile()
 void
 AudioRecord::closeFile()
 {
-    stopRecording(); // needed as recData accesses to fileHandle_
+    stopRecording();
+    writer_.join(); // writes what is still queued
+
+    if (queue_) {
+        const auto stats = queue_->getStats();
+        if (stats.dropped)
+            RING_WARN("Recording %s: %" PRIu64 " of %" PRIu64 " chunks dropped, disk too slow",
+                      getFilename().c_str(), stats.dropped, stats.received);
+    }
     fileHandle_.reset();
 }
 
@@ -225,16 +303,39 @@ void
 AudioRecord::recData(AudioBuffer& buffer)
 {
 #ifndef RING_UWP
-    if (not recordingEnabled_)
+    if (not recordingEnabled_ or not queue_)
         return;
 
-    auto interleaved = buffer.interleave();
-    const int nSamples = interleaved.size();
-    if (fileHandle_->write(interleaved.data(), nSamples) != nSamples) {
-        RING_WARN("Could not record data!");
-    } else {
-        fileHandle_->writeSync();
+    buffer.interleave(interleaved_);
+
+    // Whole frames in each chunk
+    const size_t frameSize = buffer.channels() * sizeof(AudioSample);
+    const size_t chunkSize = QUEUE_SLOT_SIZE / frameSize * frameSize;
+    const auto data = reinterpret_cast<const uint8_t*>(interleaved_.data());
+    const size_t size = interleaved_.size() * sizeof(AudioSample);
+    for (size_t pos = 0; pos < size; pos += chunkSize)
+        queue_->push(data + pos, std::min(chunkSize, size - pos));
+#endif
+}
+
+void
+AudioRecord::writeQueued()
+{
+#ifndef RING_UWP
+    if (not fileHandle_)
+        return;
+
+    size_t samples = 0;
+    const size_t slotSamples = QUEUE_SLOT_SIZE / sizeof(AudioSample);
+    while (samples + slotSamples <= batch_.size()) {
+        const int size = queue_->pop(&batch_[samples], QUEUE_SLOT_SIZE);
+        if (size < 0)
+            break;
+        samples += size / sizeof(AudioSample);
     }
+
+    if (samples and fileHandle_->write(batch_.data(), samples) != static_cast<sf_count_t>(samples))
+        RING_WARN("Could not record data!");
 #endif
 }
 
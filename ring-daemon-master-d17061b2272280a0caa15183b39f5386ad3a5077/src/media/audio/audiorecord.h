@@ -23,17 +23,29 @@
 
 #include "audiobuffer.h"
 #include "audiorecorder.h"
+#include "threadloop.h"
 #include "noncopyable.h"
 
 #include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
 class SndfileHandle;
 
 namespace ring {
 
+class PacketRing;
+
+/**
+ * Recording file of a call, a conference or a conference participant.
+ *
+ * The recorder thread hands the samples over to a writer thread through a
+ * lock-free queue, so that it never waits for the disk: if the writer
+ * falls behind, the oldest queued samples are dropped. The writer
+ * encodes and writes them in batches.
+ */
 class AudioRecord {
     public:
         AudioRecord();
@@ -42,11 +54,22 @@ class AudioRecord {
         void setSndFormat(AudioFormat format);
         void setRecordingOptions(AudioFormat format, const std::string &path);
 
+        /**
+         * Set the file format: "wav", "flac" or "ogg" (Vorbis).
+         * Must be called before initFilename().
+         */
+        void setFileFormat(const std::string &format);
+
         /**
          * Init recording file path
          */
         void initFilename(const std::string &peerNumber);
 
+        /**
+         * Init the file path of a track of another recording, named after it
+         */
+        void initTrackFilename(const AudioRecord &mix, const std::string &track);
+
         /**
          * Return the filepath of the recording
          */
@@ -92,9 +115,9 @@ class AudioRecord {
         void stopRecording() const noexcept;
 
         /**
-         * Record a chunk of data in an openend file
+         * Queue a chunk of data to be written in the opened file.
+         * Called by the recorder thread, never blocks.
          * @param buffer  The data chunk to be recorded
-         * @param nSamples Number of samples (number of bytes) to be recorded
          */
         void recData(AudioBuffer& buffer);
 
@@ -120,6 +143,11 @@ class AudioRecord {
          */
         void closeWavFile();
 
+        /**
+         * Writer thread: write the queued samples in one batch
+         */
+        void writeQueued();
+
         /**
          * Pointer to the recorded file
          */
@@ -145,6 +173,31 @@ class AudioRecord {
          */
         std::string savePath_;
 
+        /**
+         * File format name, see setFileFormat()
+         */
+        std::string fileFormat_;
+
+        /**
+         * Interleaved chunks, from the recorder thread to the writer thread
+         */
+        std::unique_ptr<PacketRing> queue_;
+
+        /**
+         * Interleaving buffer of the recorder thread
+         */
+        std::vector<AudioSample> interleaved_;
+
+        /**
+         * Write buffer of the writer thread
+         */
+        std::vector<AudioSample> batch_;
+
+        /**
+         * File writing thread
+         */
+        InterruptedThreadLoop writer_;
+
         /**
          * Audio recording thread
          */
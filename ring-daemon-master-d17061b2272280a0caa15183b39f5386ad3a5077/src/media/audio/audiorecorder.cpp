@@ -79,14 +79,21 @@ AudioRecorder::start()
 void
 AudioRecorder::process()
 {
+    // Wake up as soon as a period is available, the recording only queues
+    // the samples so that we keep up with the other readers
+    const auto period = buffer_->getSampleRate() * SLEEP_TIME.count() / 1000;
+    ringBufferPool_.waitForDataAvailable(recorderId_, period, SLEEP_TIME);
+
     auto availableSamples = ringBufferPool_.availableForGet(recorderId_);
+    if (availableSamples == 0) {
+        // not bound, or nothing to record
+        std::this_thread::sleep_for(SLEEP_TIME);
+        return;
+    }
+
     buffer_->resize(std::min(availableSamples, BUFFER_LENGTH));
     ringBufferPool_.getData(*buffer_, recorderId_);
-
-    if (availableSamples > 0)
-        arecord_->recData(*buffer_);
-
-    std::this_thread::sleep_for(SLEEP_TIME);
+    arecord_->recData(*buffer_);
 }
 
 } // namespace ring
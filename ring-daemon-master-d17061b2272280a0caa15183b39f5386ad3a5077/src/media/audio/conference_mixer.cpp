@@ -0,0 +1,248 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "conference_mixer.h"
+#include "ringbuffer.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace ring {
+
+constexpr size_t ConferenceMixer::HISTORY_SIZE;
+
+static std::string
+nextMixerId()
+{
+    static std::atomic<unsigned> count {0};
+    return "conference_mixer_" + std::to_string(++count);
+}
+
+ConferenceMixer::ConferenceMixer(const std::vector<std::shared_ptr<RingBuffer>>& members,
+                                 AudioFormat format)
+    : id_(nextMixerId())
+    , format_(format)
+    , chunk_(0, format)
+{
+    members_.reserve(members.size());
+    for (const auto& rbuf : members) {
+        rbuf->createReadOffset(id_);
+        members_.push_back(Member {rbuf, AudioBuffer(HISTORY_SIZE, format_), 0});
+    }
+    sum_.assign(format_.nb_channels * HISTORY_SIZE, 0);
+    RING_DBG("Conference mixer '%s' created with %zu members", id_.c_str(), members_.size());
+}
+
+ConferenceMixer::~ConferenceMixer()
+{
+    for (const auto& m : members_)
+        m.rbuf->removeReadOffset(id_);
+}
+
+std::vector<std::string>
+ConferenceMixer::getMemberIds() const
+{
+    std::vector<std::string> ids;
+    ids.reserve(members_.size());
+    for (const auto& m : members_)
+        ids.push_back(m.rbuf->id);
+    return ids;
+}
+
+void
+ConferenceMixer::setFormat(AudioFormat format)
+{
+    if (format == format_)
+        return;
+
+    format_ = format;
+    chunk_.setFormat(format_);
+    for (auto& m : members_)
+        m.history = AudioBuffer(HISTORY_SIZE, format_);
+    sum_.assign(format_.nb_channels * HISTORY_SIZE, 0);
+    flushAll();
+}
+
+ConferenceMixer::Member*
+ConferenceMixer::getMember(const std::string& call_id)
+{
+    for (auto& m : members_)
+        if (m.rbuf->id == call_id)
+            return &m;
+    return nullptr;
+}
+
+const ConferenceMixer::Member*
+ConferenceMixer::getMember(const std::string& call_id) const
+{
+    for (const auto& m : members_)
+        if (m.rbuf->id == call_id)
+            return &m;
+    return nullptr;
+}
+
+void
+ConferenceMixer::mix(size_t n)
+{
+    size_t available = 0;
+    for (const auto& m : members_)
+        available = std::max(available, m.rbuf->availableForGet(id_));
+
+    n = std::min({n, available, HISTORY_SIZE});
+    const unsigned channels = format_.nb_channels;
+
+    while (n) {
+        const size_t pos = mixPos_ % HISTORY_SIZE;
+        const size_t block = std::min(n, HISTORY_SIZE - pos);
+
+        for (unsigned c = 0; c < channels; ++c)
+            std::fill_n(&sum_[c * HISTORY_SIZE + pos], block, 0);
+
+        chunk_.resize(block);
+        for (auto& m : members_) {
+            // a member without enough data contributes silence
+            chunk_.reset();
+            m.rbuf->get(chunk_, id_);
+            m.history.copy(chunk_, block, 0, pos);
+            for (unsigned c = 0; c < channels; ++c) {
+                const AudioSample* in = chunk_.getChannel(c);
+                int32_t* sum = &sum_[c * HISTORY_SIZE + pos];
+                for (size_t i = 0; i < block; ++i)
+                    sum[i] += in[i];
+            }
+        }
+
+        mixPos_ += block;
+        n -= block;
+    }
+}
+
+size_t
+ConferenceMixer::unread(const Member& member) const
+{
+    return std::min<uint64_t>(mixPos_ - member.readPos, HISTORY_SIZE);
+}
+
+size_t
+ConferenceMixer::prepare(Member& member, size_t n)
+{
+    if (member.readPos + n > mixPos_)
+        mix(member.readPos + n - mixPos_);
+
+    // Too late, the oldest frames were overwritten
+    if (mixPos_ - member.readPos > HISTORY_SIZE)
+        member.readPos = mixPos_ - HISTORY_SIZE;
+
+    return std::min(n, unread(member));
+}
+
+size_t
+ConferenceMixer::get(AudioBuffer& buf, const std::string& call_id)
+{
+    auto self = getMember(call_id);
+    if (not self)
+        return 0;
+
+    buf.setFormat(format_);
+    buf.reset();
+
+    const size_t frames = prepare(*self, buf.frames());
+
+    for (unsigned c = 0; c < format_.nb_channels; ++c) {
+        const int32_t* sum = &sum_[c * HISTORY_SIZE];
+        const AudioSample* own = self->history.getChannel(c);
+        AudioSample* out = buf.getChannel(c);
+        size_t pos = self->readPos % HISTORY_SIZE;
+        size_t done = 0;
+
+        while (done < frames) {
+            const size_t block = std::min(frames - done, HISTORY_SIZE - pos);
+            for (size_t i = 0; i < block; ++i) {
+                const int32_t v = sum[pos + i] - own[pos + i];
+                out[done + i] = std::min(std::max(v, -32768), 32767);
+            }
+            done += block;
+            pos = 0;
+        }
+    }
+
+    self->readPos += frames;
+    return frames;
+}
+
+size_t
+ConferenceMixer::mixedForGet(const std::string& call_id) const
+{
+    const auto self = getMember(call_id);
+    return self ? unread(*self) : 0;
+}
+
+size_t
+ConferenceMixer::availableForGet(const std::string& call_id) const
+{
+    const auto self = getMember(call_id);
+    if (not self)
+        return 0;
+
+    // like RingBufferPool::availableForGet(), ignore empty sources
+    size_t pending = 0;
+    for (const auto& m : members_) {
+        if (&m == self)
+            continue;
+        const size_t n = m.rbuf->availableForGet(id_);
+        if (n > 0)
+            pending = pending ? std::min(pending, n) : n;
+    }
+
+    return unread(*self) + pending;
+}
+
+size_t
+ConferenceMixer::discard(size_t toDiscard, const std::string& call_id)
+{
+    if (auto self = getMember(call_id))
+        self->readPos += prepare(*self, toDiscard);
+    return toDiscard;
+}
+
+void
+ConferenceMixer::flush(const std::string& call_id)
+{
+    if (auto self = getMember(call_id))
+        self->readPos = mixPos_;
+}
+
+void
+ConferenceMixer::flushAll()
+{
+    for (auto& m : members_)
+        m.readPos = mixPos_;
+}
+
+std::vector<std::shared_ptr<RingBuffer>>
+ConferenceMixer::getSources(const std::string& call_id) const
+{
+    std::vector<std::shared_ptr<RingBuffer>> sources;
+    for (const auto& m : members_)
+        if (m.rbuf->id != call_id)
+            sources.push_back(m.rbuf);
+    return sources;
+}
+
+} // namespace ring
@@ -0,0 +1,139 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "audiobuffer.h"
+#include "noncopyable.h"
+#include "ring_types.h" // for SIZEBUF
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ring {
+
+class RingBuffer;
+
+/**
+ * Mix-minus stage shared by the members of a conference.
+ *
+ * Members are ring buffers whose owners read all the other members
+ * (see RingBufferPool::bindCallID). Instead of mixing the N-1 other ring
+ * buffers for each member, the mixer reads every ring buffer once, keeps
+ * the sum of all of them and gives each member this sum minus its own
+ * contribution. Members read the mix at their own pace from a history of
+ * HISTORY_SIZE frames.
+ *
+ * The mixer has its own read offset on each member ring buffer.
+ * It's not thread-safe: RingBufferPool serializes all calls.
+ */
+class ConferenceMixer {
+    public:
+        static constexpr size_t HISTORY_SIZE = SIZEBUF;
+
+        ConferenceMixer(const std::vector<std::shared_ptr<RingBuffer>>& members,
+                        AudioFormat format);
+
+        ~ConferenceMixer();
+
+        /**
+         * Read offset ID used by the mixer on member ring buffers.
+         */
+        const std::string& getId() const {
+            return id_;
+        }
+
+        std::vector<std::string> getMemberIds() const;
+
+        /**
+         * Change the mix format, pending mixed data is dropped.
+         */
+        void setFormat(AudioFormat format);
+
+        /**
+         * Fill buf with the mix of all members except call_id.
+         * Return the number of frames mixed, missing frames are silent.
+         */
+        size_t get(AudioBuffer& buf, const std::string& call_id);
+
+        size_t availableForGet(const std::string& call_id) const;
+
+        size_t discard(size_t toDiscard, const std::string& call_id);
+
+        void flush(const std::string& call_id);
+
+        void flushAll();
+
+        /**
+         * Number of frames already mixed and not read yet by call_id.
+         */
+        size_t mixedForGet(const std::string& call_id) const;
+
+        /**
+         * Ring buffers call_id must wait on for more data (all other members).
+         */
+        std::vector<std::shared_ptr<RingBuffer>> getSources(const std::string& call_id) const;
+
+    private:
+        NON_COPYABLE(ConferenceMixer);
+
+        struct Member {
+            std::shared_ptr<RingBuffer> rbuf;
+            /** Last HISTORY_SIZE frames read from rbuf */
+            AudioBuffer history;
+            /** Next mixed frame given to this member */
+            uint64_t readPos;
+        };
+
+        Member* getMember(const std::string& call_id);
+        const Member* getMember(const std::string& call_id) const;
+
+        /**
+         * Read up to n more frames from all members, at least one of them
+         * must have data. Members with less data contribute silence.
+         */
+        void mix(size_t n);
+
+        /**
+         * Mix frames needed by member to read n frames.
+         * Return the number of mixed frames member can read (at most n).
+         */
+        size_t prepare(Member& member, size_t n);
+
+        /**
+         * Number of mixed frames not read yet by member.
+         */
+        size_t unread(const Member& member) const;
+
+        const std::string id_;
+        AudioFormat format_;
+        std::vector<Member> members_ {};
+
+        /** Sum of all members, HISTORY_SIZE frames per channel */
+        std::vector<int32_t> sum_ {};
+
+        /** Total frames mixed */
+        uint64_t mixPos_ {0};
+
+        /** Scratch buffer to read from member ring buffers */
+        AudioBuffer chunk_;
+};
+
+} // namespace ring
@@ -362,7 +362,7 @@ CoreLayer::read(AudioUnitRenderActionFlags* ioActionFlags,
     for (int i = 0; i < inChannelsPerFrame_; ++i) {
         auto data = reinterpret_cast<Float32*>(captureBuff_->mBuffers[i].mData);
         for (int j = 0; j < inNumberFrames; ++j) {
-            (*inBuff.getChannel(i))[j] = static_cast<AudioSample>(data[j] / .000030517578125f);
+            inBuff.getChannel(i)[j] = static_cast<AudioSample>(data[j] / .000030517578125f);
         }
     }
 
@@ -62,7 +62,7 @@ void DcBlocker::process(AudioBuffer& buf)
 
     unsigned i;
     for(i=0; i<chans; i++) {
-        AudioSample *chan = buf.getChannel(i)->data();
+        AudioSample *chan = buf.getChannel(i);
         doProcess(chan, chan, samples, &states[i]);
     }
 }
@@ -82,12 +82,9 @@ void DSP::process(AudioBuffer& buff, int samples)
         return;
     }
 
-    auto &channelData = buff.getData();
-    size_t index = 0;
-    for (auto &c : channelData) {
-        if (index < dspStates_.size() and dspStates_[index].get())
-            speex_preprocess_run(dspStates_[index].get(), c.data());
-        ++index;
+    for (unsigned c = 0, n = buff.channels(); c < n; ++c) {
+        if (c < dspStates_.size() and dspStates_[c].get())
+            speex_preprocess_run(dspStates_[c].get(), buff.getChannel(c));
     }
 }
 
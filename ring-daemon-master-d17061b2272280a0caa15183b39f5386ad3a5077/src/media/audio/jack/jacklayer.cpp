@@ -163,10 +163,10 @@ JackLayer::capture()
 }
 
 static void
-convertToFloat(const std::vector<AudioSample> &src, std::vector<float> &dest)
+convertToFloat(const AudioSample* src, size_t src_size, std::vector<float> &dest)
 {
     static const float INV_SHORT_MAX = 1 / (float) SHRT_MAX;
-    if (dest.size() != src.size()) {
+    if (dest.size() != src_size) {
         RING_ERR("MISMATCH");
         return;
     }
@@ -175,13 +175,13 @@ convertToFloat(const std::vector<AudioSample> &src, std::vector<float> &dest)
 }
 
 static void
-convertFromFloat(std::vector<float> &src, std::vector<AudioSample> &dest)
+convertFromFloat(std::vector<float> &src, AudioSample* dest, size_t dest_size)
 {
-    if (dest.size() != src.size()) {
+    if (dest_size != src.size()) {
         RING_ERR("MISMATCH");
         return;
     }
-    for (size_t i = 0; i < dest.size(); ++i)
+    for (size_t i = 0; i < dest_size; ++i)
         dest[i] = src[i] * SHRT_MAX;
 }
 
@@ -190,7 +190,7 @@ JackLayer::write(AudioBuffer &buffer, std::vector<float> &floatBuffer)
 {
     for (unsigned i = 0; i < out_ringbuffers_.size(); ++i) {
         const unsigned inChannel = std::min(i, buffer.channels() - 1);
-        convertToFloat(*buffer.getChannel(inChannel), floatBuffer);
+        convertToFloat(buffer.getChannel(inChannel), buffer.frames(), floatBuffer);
 
         // write to output
         const size_t to_ringbuffer = jack_ringbuffer_write_space(out_ringbuffers_[i]);
@@ -230,7 +230,7 @@ JackLayer::read(AudioBuffer &buffer)
          * inefficient, but makes things simpler. */
         // FIXME: this is braindead, we should write blocks of samples at a time
         // convert a vector of samples from 1 channel to a float vector
-        convertFromFloat(captureFloatBuffer_, *buffer.getChannel(i));
+        convertFromFloat(captureFloatBuffer_, buffer.getChannel(i), buffer.frames());
     }
 }
 
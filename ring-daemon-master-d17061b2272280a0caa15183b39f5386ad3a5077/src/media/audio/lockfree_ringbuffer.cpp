@@ -0,0 +1,422 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "lockfree_ringbuffer.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ring {
+
+constexpr LockFreeRingBuffer::ReaderHandle LockFreeRingBuffer::INVALID_READER;
+constexpr unsigned LockFreeRingBuffer::MAX_READERS;
+constexpr unsigned LockFreeRingBuffer::MAX_CHANNELS;
+
+LockFreeRingBuffer::LockFreeRingBuffer(const std::string& rbuf_id, size_t size,
+                                       AudioFormat format /* = MONO */)
+    : RingBuffer(rbuf_id, size, format)
+    , size_(buffer_.frames())
+    , capacity_(size_ - 1)
+    , channels_(std::min(std::max(1U, format.nb_channels), MAX_CHANNELS))
+    , sampleRate_(format.sample_rate)
+{
+    // Storage is allocated once: the writer never reallocates it under the readers
+    buffer_.setChannelNum(MAX_CHANNELS);
+}
+
+AudioFormat
+LockFreeRingBuffer::getFormat() const
+{
+    return AudioFormat(sampleRate_.load(std::memory_order_relaxed),
+                       channels_.load(std::memory_order_relaxed));
+}
+
+void
+LockFreeRingBuffer::setFormat(AudioFormat format)
+{
+    channels_.store(std::min(std::max(1U, format.nb_channels), MAX_CHANNELS));
+    sampleRate_.store(format.sample_rate);
+}
+
+LockFreeRingBuffer::ReaderSlot*
+LockFreeRingBuffer::getSlot(ReaderHandle reader)
+{
+    if (reader < 0 or static_cast<unsigned>(reader) >= MAX_READERS)
+        return nullptr;
+    auto& slot = readers_[reader];
+    return slot.state.load(std::memory_order_acquire) == SlotState::ACTIVE ? &slot : nullptr;
+}
+
+const LockFreeRingBuffer::ReaderSlot*
+LockFreeRingBuffer::getSlot(ReaderHandle reader) const
+{
+    if (reader < 0 or static_cast<unsigned>(reader) >= MAX_READERS)
+        return nullptr;
+    const auto& slot = readers_[reader];
+    return slot.state.load(std::memory_order_acquire) == SlotState::ACTIVE ? &slot : nullptr;
+}
+
+LockFreeRingBuffer::ReaderHandle
+LockFreeRingBuffer::getReaderHandle(const std::string &call_id) const
+{
+    ReaderHandle found = INVALID_READER;
+    lookups_.fetch_add(1);
+    for (unsigned i = 0; i < MAX_READERS; ++i) {
+        const auto& slot = readers_[i];
+        if (slot.state.load() == SlotState::ACTIVE and slot.call_id == call_id) {
+            found = i;
+            break;
+        }
+    }
+    lookups_.fetch_sub(1);
+    return found;
+}
+
+void
+LockFreeRingBuffer::createReadOffset(const std::string &call_id)
+{
+    std::lock_guard<std::mutex> l(slotsLock_);
+    if (getReaderHandle(call_id) != INVALID_READER)
+        return;
+
+    for (auto& slot : readers_) {
+        if (slot.state.load() != SlotState::FREE)
+            continue;
+
+        // A concurrent lookup may still be reading the old call ID
+        while (lookups_.load() != 0)
+            std::this_thread::yield();
+
+        slot.call_id = call_id;
+        slot.pos.store(writePos_.load(std::memory_order_acquire));
+        slot.state.store(SlotState::ACTIVE);
+        ++readerCount_;
+        return;
+    }
+
+    RING_ERR("LockFreeRingBuffer '%s': no free reader slot for call '%s'",
+             id.c_str(), call_id.c_str());
+}
+
+void
+LockFreeRingBuffer::removeReadOffset(const std::string &call_id)
+{
+    {
+        std::lock_guard<std::mutex> l(slotsLock_);
+        const auto reader = getReaderHandle(call_id);
+        if (reader == INVALID_READER)
+            return;
+        readers_[reader].state.store(SlotState::FREE);
+        --readerCount_;
+    }
+    notifyWaiters();
+}
+
+size_t
+LockFreeRingBuffer::readOffsetCount() const
+{
+    return readerCount_.load();
+}
+
+bool
+LockFreeRingBuffer::hasNoReadOffsets() const
+{
+    return readerCount_.load() == 0;
+}
+
+size_t
+LockFreeRingBuffer::lengthFrom(uint64_t readPos, uint64_t writePos) const
+{
+    // The writer moves overrun readers before publishing its data
+    if (readPos >= writePos)
+        return 0;
+    const uint64_t len = writePos - readPos;
+    return len > capacity_ ? 0 : len;
+}
+
+bool
+LockFreeRingBuffer::commitReadPos(ReaderSlot& slot, uint64_t expected, uint64_t desired)
+{
+    return slot.pos.compare_exchange_strong(expected, desired, std::memory_order_acq_rel);
+}
+
+void
+LockFreeRingBuffer::flush(const std::string &call_id)
+{
+    flush(getReaderHandle(call_id));
+}
+
+void
+LockFreeRingBuffer::flush(ReaderHandle reader)
+{
+    if (auto slot = getSlot(reader))
+        slot->pos.store(writePos_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+void
+LockFreeRingBuffer::flushAll()
+{
+    const auto w = writePos_.load(std::memory_order_acquire);
+    for (auto& slot : readers_)
+        if (slot.state.load(std::memory_order_acquire) == SlotState::ACTIVE)
+            slot.pos.store(w, std::memory_order_release);
+}
+
+size_t
+LockFreeRingBuffer::putLength() const
+{
+    const auto w = writePos_.load(std::memory_order_acquire);
+    size_t len = 0;
+    for (const auto& slot : readers_)
+        if (slot.state.load(std::memory_order_acquire) == SlotState::ACTIVE)
+            len = std::max(len, lengthFrom(slot.pos.load(std::memory_order_acquire), w));
+    return len;
+}
+
+size_t
+LockFreeRingBuffer::getLength(const std::string &call_id) const
+{
+    return getLength(getReaderHandle(call_id));
+}
+
+size_t
+LockFreeRingBuffer::getLength(ReaderHandle reader) const
+{
+    const auto slot = getSlot(reader);
+    if (not slot)
+        return 0;
+    const auto r = slot->pos.load(std::memory_order_acquire);
+    return lengthFrom(r, writePos_.load(std::memory_order_acquire));
+}
+
+size_t
+LockFreeRingBuffer::availableForGet(const std::string &call_id) const
+{
+    return getLength(call_id);
+}
+
+void
+LockFreeRingBuffer::debug()
+{
+    RING_DBG("Write=%llu; Readers=%u; BufferSize=%zu",
+             (unsigned long long) writePos_.load(), readerCount_.load(), size_);
+}
+
+//
+// For the writer only:
+//
+
+void
+LockFreeRingBuffer::put(AudioBuffer& buf)
+{
+    const size_t sample_num = buf.frames();
+    const unsigned in_chans = buf.channels();
+
+    // Add more channels if the input buffer holds more channels than the ring.
+    auto chans = channels_.load(std::memory_order_relaxed);
+    if (chans < in_chans) {
+        chans = std::min(in_chans, MAX_CHANNELS);
+        channels_.store(chans, std::memory_order_relaxed);
+    }
+    sampleRate_.store(buf.getSampleRate(), std::memory_order_relaxed);
+
+    const auto start = writePos_.load(std::memory_order_relaxed);
+    const auto end = start + sample_num;
+
+    // Like RingBuffer::discard(): readers without room for this write lose
+    // their pending data and this write, and start reading after it.
+    for (auto& slot : readers_) {
+        if (slot.state.load(std::memory_order_acquire) != SlotState::ACTIVE)
+            continue;
+        auto r = slot.pos.load(std::memory_order_acquire);
+        while (r < end and end - r > capacity_
+               and not slot.pos.compare_exchange_weak(r, end, std::memory_order_acq_rel)) {}
+    }
+
+    // Announce the overwritten range before touching the data (seqlock)
+    pendingPos_.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Only the last size_ frames can be kept
+    size_t toCopy = std::min(sample_num, size_);
+    size_t in_pos = sample_num - toCopy;
+    size_t pos = (start + in_pos) % size_;
+
+    while (toCopy) {
+        const size_t block = std::min(toCopy, size_ - pos);
+        for (unsigned c = 0; c < chans; ++c) {
+            const AudioSample* src = buf.getChannel(std::min(c, in_chans - 1)) + in_pos;
+            std::copy(src, src + block, buffer_.getChannel(c) + pos);
+        }
+        in_pos += block;
+        pos = (pos + block) % size_;
+        toCopy -= block;
+    }
+
+    writePos_.store(end, std::memory_order_release);
+    notifyWaiters();
+}
+
+void
+LockFreeRingBuffer::notifyWaiters()
+{
+    // Pairs with the waiters_ increment in waitForDataAvailable(): either
+    // the waiter sees the new data, or it is counted here
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (not waiters_.load(std::memory_order_relaxed))
+        return;
+    // A waiter between its check and its wait holds waitLock_: taking it
+    // ensures the notification can't be missed
+    { std::lock_guard<std::mutex> l(waitLock_); }
+    dataReady_.notify_all();
+}
+
+//
+// For the reader only:
+//
+
+size_t
+LockFreeRingBuffer::get(AudioBuffer& buf, const std::string &call_id)
+{
+    return get(buf, getReaderHandle(call_id));
+}
+
+size_t
+LockFreeRingBuffer::get(AudioBuffer& buf, ReaderHandle reader)
+{
+    auto slot = getSlot(reader);
+    if (not slot)
+        return 0;
+
+    const size_t sample_num = buf.frames();
+    const unsigned out_chans = buf.channels();
+
+    while (true) {
+        auto r = slot->pos.load(std::memory_order_acquire);
+        const auto w = writePos_.load(std::memory_order_acquire);
+
+        // Moved by the writer after the data it is writing
+        if (r >= w)
+            return 0;
+
+        // Single write larger than the buffer: data is lost
+        if (w - r > capacity_) {
+            if (commitReadPos(*slot, r, w))
+                return 0;
+            continue;
+        }
+
+        const size_t len = w - r;
+        size_t toCopy = std::min(sample_num, len);
+
+        const size_t copied = toCopy;
+        const auto chans = channels_.load(std::memory_order_relaxed);
+        size_t dest = 0;
+        size_t startPos = r % size_;
+
+        while (toCopy > 0) {
+            const size_t block = std::min(toCopy, size_ - startPos);
+            for (unsigned c = 0; c < out_chans; ++c) {
+                const AudioSample* src = buffer_.getChannel(std::min(c, chans - 1)) + startPos;
+                std::copy(src, src + block, buf.getChannel(c) + dest);
+            }
+            dest += block;
+            startPos = (startPos + block) % size_;
+            toCopy -= block;
+        }
+
+        // The writer may have wrapped over the frames we just copied,
+        // it then moves this reader: start over
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const auto pending = pendingPos_.load(std::memory_order_relaxed);
+        if (pending - r > capacity_)
+            continue;
+
+        if (commitReadPos(*slot, r, r + copied)) {
+            if (copied)
+                buf.setSampleRate(sampleRate_.load(std::memory_order_relaxed));
+            return copied;
+        }
+        // flushed or discarded concurrently, start over
+    }
+}
+
+size_t
+LockFreeRingBuffer::discard(size_t toDiscard, const std::string &call_id)
+{
+    return discard(toDiscard, getReaderHandle(call_id));
+}
+
+size_t
+LockFreeRingBuffer::discard(size_t toDiscard, ReaderHandle reader)
+{
+    auto slot = getSlot(reader);
+    if (not slot)
+        return 0;
+
+    while (true) {
+        auto r = slot->pos.load(std::memory_order_acquire);
+        const auto w = writePos_.load(std::memory_order_acquire);
+        if (r > w)
+            return 0;
+        const size_t len = lengthFrom(r, w);
+        const size_t n = std::min(toDiscard, len);
+        if (commitReadPos(*slot, r, len ? r + n : w))
+            return n;
+    }
+}
+
+size_t
+LockFreeRingBuffer::waitForDataAvailable(const std::string &call_id,
+                                         const size_t min_data_length,
+                                         const std::chrono::high_resolution_clock::time_point& deadline) const
+{
+    if (size_ < min_data_length)
+        return 0;
+    if (getReaderHandle(call_id) == INVALID_READER)
+        return 0;
+
+    const bool forever = deadline == std::chrono::high_resolution_clock::time_point();
+    size_t getl = 0;
+
+    waiters_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> l(waitLock_);
+    while (true) {
+        // Re-find the reader: it may be destroyed during the wait
+        const auto reader = getReaderHandle(call_id);
+        if (reader == INVALID_READER)
+            break;
+        getl = getLength(reader);
+        if (getl >= min_data_length)
+            break;
+
+        if (forever)
+            dataReady_.wait(l);
+        else if (std::chrono::high_resolution_clock::now() < deadline)
+            dataReady_.wait_until(l, deadline);
+        else
+            break;
+    }
+    l.unlock();
+    waiters_.fetch_sub(1);
+    return getl;
+}
+
+} // namespace ring
@@ -0,0 +1,153 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "ringbuffer.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace ring {
+
+/**
+ * Single-writer / multi-reader RingBuffer without lock on the data path.
+ *
+ * The writer and each reader own a monotonic frame counter; put() and get()
+ * only use atomic operations on them, so the real-time audio thread never
+ * waits for another thread. Readers are kept in a fixed table of slots and
+ * can be addressed by an integer handle, avoiding the call ID lookup.
+ *
+ * Behaves like RingBuffer with the following restrictions:
+ *  - put() must not be called concurrently from several threads;
+ *  - at most MAX_READERS read offsets can exist at the same time;
+ *  - at most MAX_CHANNELS channels are stored, extra channels are dropped.
+ */
+class LockFreeRingBuffer : public RingBuffer {
+    public:
+        using ReaderHandle = int;
+        static constexpr ReaderHandle INVALID_READER = -1;
+        static constexpr unsigned MAX_READERS = 64;
+        static constexpr unsigned MAX_CHANNELS = 2;
+
+        LockFreeRingBuffer(const std::string& id, size_t size,
+                           AudioFormat format=AudioFormat::MONO());
+
+        AudioFormat getFormat() const override;
+        void setFormat(AudioFormat format) override;
+
+        void createReadOffset(const std::string &call_id) override;
+        void removeReadOffset(const std::string &call_id) override;
+        size_t readOffsetCount() const override;
+        bool hasNoReadOffsets() const override;
+
+        /**
+         * Return the handle of the read offset of this call,
+         * or INVALID_READER if the call doesn't read this ring buffer.
+         * The handle stays valid until removeReadOffset() is called.
+         */
+        ReaderHandle getReaderHandle(const std::string &call_id) const;
+
+        void flush(const std::string &call_id) override;
+        void flush(ReaderHandle reader);
+        void flushAll() override;
+
+        void put(AudioBuffer& buf) override;
+
+        size_t availableForGet(const std::string &call_id) const override;
+        size_t get(AudioBuffer& buf, const std::string &call_id) override;
+        size_t get(AudioBuffer& buf, ReaderHandle reader);
+
+        size_t discard(size_t toDiscard, const std::string &call_id) override;
+        size_t discard(size_t toDiscard, ReaderHandle reader);
+
+        size_t putLength() const override;
+        size_t getLength(const std::string &call_id) const override;
+        size_t getLength(ReaderHandle reader) const;
+
+        /**
+         * Same as RingBuffer::waitForDataAvailable().
+         * The writer only takes a lock to wake up waiters when there are.
+         */
+        size_t waitForDataAvailable(const std::string &call_id,
+                                    const size_t min_data_length,
+                                    const std::chrono::high_resolution_clock::time_point& deadline) const override;
+
+        void debug() override;
+
+    private:
+        NON_COPYABLE(LockFreeRingBuffer);
+
+        enum class SlotState : int { FREE, ACTIVE };
+
+        struct ReaderSlot {
+            std::atomic<SlotState> state {SlotState::FREE};
+            /** Total frames read (or discarded) by this reader */
+            std::atomic<uint64_t> pos {0};
+            /** Only modified while the slot is FREE and no lookup is running */
+            std::string call_id {};
+        };
+
+        ReaderSlot* getSlot(ReaderHandle reader);
+        const ReaderSlot* getSlot(ReaderHandle reader) const;
+
+        /**
+         * Return the number of frames available for given read position,
+         * 0 if the writer overran it (like RingBuffer, data is then lost).
+         */
+        size_t lengthFrom(uint64_t readPos, uint64_t writePos) const;
+
+        /**
+         * Move a reader position from expected to desired.
+         * Fails if another thread moved it in the meantime.
+         */
+        bool commitReadPos(ReaderSlot& slot, uint64_t expected, uint64_t desired);
+
+        void notifyWaiters();
+
+        /** Number of frames in the storage (buffer_) */
+        const size_t size_;
+
+        /** Maximum number of frames a reader can lag behind the writer */
+        const size_t capacity_;
+
+        /** Total frames published by the writer */
+        std::atomic<uint64_t> writePos_ {0};
+
+        /** Total frames the writer is about to publish (seqlock) */
+        std::atomic<uint64_t> pendingPos_ {0};
+
+        std::atomic<unsigned> channels_;
+        std::atomic<int> sampleRate_;
+
+        std::array<ReaderSlot, MAX_READERS> readers_;
+        std::atomic<unsigned> readerCount_ {0};
+
+        /** Number of call ID lookups running on readers_ */
+        mutable std::atomic<unsigned> lookups_ {0};
+
+        /** Serialize read offsets creation and removal, never taken by put/get */
+        std::mutex slotsLock_ {};
+
+        mutable std::mutex waitLock_ {};
+        mutable std::condition_variable dataReady_ {};
+        mutable std::atomic<unsigned> waiters_ {0};
+};
+
+} // namespace ring
@@ -0,0 +1,242 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "nulllayer.h"
+#include "audio/ringbufferpool.h"
+#include "audio/sound/audiofile.h"
+#include "audio/sound/tone.h"
+#include "manager.h"
+#include "preferences.h"
+#include "logger.h"
+
+#include <cinttypes>
+#include <cstring>
+#include <ciso646> // fix windows compiler bug
+
+namespace ring {
+
+constexpr std::chrono::milliseconds NullLayer::PERIOD;
+
+static constexpr const char* DEVICE_NAME = "null";
+static constexpr const char* TONE_PREFIX = "tone:";
+
+/**
+ * Sound file looped as capture, without the playback position signals
+ * sent for the files played to the user.
+ */
+class CaptureFile : public AudioFile {
+    public:
+        CaptureFile(const std::string& path, unsigned sampleRate)
+            : AudioFile(path, sampleRate) {}
+
+    private:
+        void onBufferFinish() {}
+};
+
+NullLayer::NullLayer(const AudioPreference& pref)
+    : AudioLayer(pref)
+    , captureSource_(pref.getNullCapture())
+    , realtime_(pref.getNullRealtime())
+    , mainRingBuffer_(Manager::instance().getRingBufferPool().getRingBuffer(RingBufferPool::DEFAULT_ID))
+{
+    hardwareFormatAvailable(audioFormat_);
+    hardwareInputFormatAvailable(audioInputFormat_);
+}
+
+NullLayer::~NullLayer()
+{
+    stopStream();
+}
+
+std::vector<std::string>
+NullLayer::getCaptureDeviceList() const
+{
+    return {DEVICE_NAME};
+}
+
+std::vector<std::string>
+NullLayer::getPlaybackDeviceList() const
+{
+    return {DEVICE_NAME};
+}
+
+int
+NullLayer::getAudioDeviceIndex(const std::string& name, DeviceType) const
+{
+    return name == DEVICE_NAME ? 0 : -1;
+}
+
+std::string
+NullLayer::getAudioDeviceName(int index, DeviceType) const
+{
+    return index == 0 ? DEVICE_NAME : "";
+}
+
+int
+NullLayer::getIndexCapture() const
+{
+    return 0;
+}
+
+int
+NullLayer::getIndexPlayback() const
+{
+    return 0;
+}
+
+int
+NullLayer::getIndexRingtone() const
+{
+    return 0;
+}
+
+void
+NullLayer::updatePreference(AudioPreference&, int, DeviceType)
+{}
+
+void
+NullLayer::startStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (status_ != Status::Idle)
+            return;
+        status_ = Status::Started;
+    }
+
+    flushUrgent();
+    flushMain();
+
+    RING_DBG("Starting null audio layer (%s, capture from %s)",
+             realtime_ ? "realtime" : "as fast as possible",
+             captureSource_.empty() ? "silence" : captureSource_.c_str());
+    running_ = true;
+    thread_ = std::thread(&NullLayer::run, this);
+    startedCv_.notify_all();
+}
+
+void
+NullLayer::stopStream()
+{
+    if (status_ != Status::Started)
+        return;
+
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+
+    RING_DBG("Null audio layer stopped after %" PRIu64 " periods, %" PRIu64 " underruns, %" PRIu64 " late",
+             periods_, underruns_, late_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_ = Status::Idle;
+    }
+    startedCv_.notify_all();
+
+    flushUrgent();
+}
+
+std::unique_ptr<AudioLoop>
+NullLayer::createCaptureSource(unsigned sampleRate) const
+{
+    if (captureSource_.empty())
+        return {};
+
+    std::unique_ptr<AudioLoop> loop;
+    try {
+        if (captureSource_.compare(0, strlen(TONE_PREFIX), TONE_PREFIX) == 0)
+            loop.reset(new Tone(captureSource_.substr(strlen(TONE_PREFIX)), sampleRate));
+        else
+            loop.reset(new CaptureFile(captureSource_, sampleRate));
+    } catch (const AudioFileException& e) {
+        RING_ERR("Null audio layer capture: %s", e.what());
+        return {};
+    }
+
+    if (not loop->getSize()) {
+        RING_ERR("Null audio layer capture: %s is empty", captureSource_.c_str());
+        return {};
+    }
+    return loop;
+}
+
+void
+NullLayer::run()
+{
+    using clock = std::chrono::steady_clock;
+
+    auto next = clock::now();
+    while (running_) {
+        const auto format = Manager::instance().getRingBufferPool().getInternalAudioFormat();
+        const size_t frames = format.sample_rate * PERIOD.count() / 1000;
+
+        playback(frames);
+        capture(frames);
+        ++periods_;
+
+        if (not realtime_)
+            continue;
+
+        // Absolute deadlines, so that the clock doesn't drift
+        next += PERIOD;
+        const auto now = clock::now();
+        if (now > next + PERIOD) {
+            ++late_;
+            next = now;
+        } else {
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+void
+NullLayer::playback(size_t frames)
+{
+    // Ringtones and tones are consumed like the main buffer
+    getToRing(audioFormat_, frames);
+    const auto& buff = getToPlay(audioFormat_, frames);
+    if (buff.frames() and buff.frames() < frames)
+        ++underruns_;
+}
+
+void
+NullLayer::capture(size_t frames)
+{
+    const auto format = Manager::instance().getRingBufferPool().getInternalAudioFormat();
+
+    if (captureRate_ != format.sample_rate) {
+        captureLoop_ = createCaptureSource(format.sample_rate);
+        captureRate_ = format.sample_rate;
+    }
+
+    if (captureLoop_) {
+        captureBuffer_.setFormat(captureLoop_->getFormat());
+        captureBuffer_.resize(frames);
+        captureLoop_->getNext(captureBuffer_, isCaptureMuted_ ? 0.0 : captureGain_);
+        captureBuffer_.setChannelNum(format.nb_channels, true);
+    } else {
+        captureBuffer_.setFormat(format);
+        captureBuffer_.resize(frames);
+        captureBuffer_.reset();
+    }
+
+    mainRingBuffer_->put(captureBuffer_);
+}
+
+} // namespace ring
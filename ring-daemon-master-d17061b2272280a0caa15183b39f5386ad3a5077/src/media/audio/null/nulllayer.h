@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "audio/audiolayer.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace ring {
+
+class AudioLoop;
+
+/**
+ * Audio layer without sound card, for servers and load tests.
+ *
+ * An internal clock plays the main buffer (the samples are dropped) and
+ * captures from a sound file, a tone or silence, every PERIOD. In
+ * realtime mode the clock follows the steady clock, otherwise periods
+ * are processed as fast as possible.
+ */
+class NullLayer : public AudioLayer {
+    public:
+        NullLayer(const AudioPreference& pref);
+        ~NullLayer();
+
+        std::vector<std::string> getCaptureDeviceList() const;
+        std::vector<std::string> getPlaybackDeviceList() const;
+        int getAudioDeviceIndex(const std::string& name, DeviceType type) const;
+        std::string getAudioDeviceName(int index, DeviceType type) const;
+        int getIndexCapture() const;
+        int getIndexPlayback() const;
+        int getIndexRingtone() const;
+
+        void startStream();
+        void stopStream();
+
+        void updatePreference(AudioPreference& pref, int index, DeviceType type);
+
+        static constexpr std::chrono::milliseconds PERIOD {10};
+
+    private:
+        NON_COPYABLE(NullLayer);
+
+        void run();
+        void playback(size_t frames);
+        void capture(size_t frames);
+        std::unique_ptr<AudioLoop> createCaptureSource(unsigned sampleRate) const;
+
+        /** Sound file path, "tone:<definition>" or empty for silence */
+        const std::string captureSource_;
+        const bool realtime_;
+
+        std::thread thread_;
+        std::atomic_bool running_ {false};
+
+        // Used by the clock thread only
+        std::unique_ptr<AudioLoop> captureLoop_;
+        unsigned captureRate_ {0};
+        AudioBuffer captureBuffer_;
+        std::shared_ptr<RingBuffer> mainRingBuffer_;
+        uint64_t periods_ {0};
+        uint64_t underruns_ {0};
+        uint64_t late_ {0};
+};
+
+} // namespace ring
@@ -25,14 +25,24 @@
 
 #include <samplerate.h>
 
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
 namespace ring {
 
+/** Input rate, output rate, channels, quality */
+using SrcKey = std::tuple<unsigned, unsigned, unsigned, bool>;
+
 class SrcState {
     public:
-        SrcState(int nb_channels, bool high_quality = false)
+        SrcState(const SrcKey& key)
+            : key_(key)
         {
             int err;
-            state_ = src_new(high_quality ? SRC_SINC_BEST_QUALITY : SRC_LINEAR, nb_channels, &err);
+            state_ = src_new(std::get<3>(key) ? SRC_SINC_BEST_QUALITY : SRC_LINEAR,
+                             std::get<2>(key), &err);
         }
 
         ~SrcState()
@@ -40,39 +50,118 @@ class SrcState {
             src_delete(state_);
         }
 
+        const SrcKey& key() const {
+            return key_;
+        }
+
         void process(SRC_DATA *src_data)
         {
             src_process(state_, src_data);
         }
 
+        void reset()
+        {
+            src_reset(state_);
+        }
+
     private:
+        NON_COPYABLE(SrcState);
+
+        const SrcKey key_;
         SRC_STATE *state_ {nullptr};
 };
 
+/**
+ * Idle converter states shared by all resamplers.
+ * A state holds the filter history of one stream, so it's only given to
+ * one Resampler at a time; the cache avoids creating it again when a
+ * Resampler is created or changes of format.
+ */
+class SrcStateCache {
+    public:
+        static std::shared_ptr<SrcStateCache> instance()
+        {
+            static const auto cache = std::make_shared<SrcStateCache>();
+            return cache;
+        }
+
+        std::unique_ptr<SrcState> acquire(const SrcKey& key)
+        {
+            {
+                std::lock_guard<std::mutex> lk(lock_);
+                auto it = idle_.find(key);
+                if (it != idle_.end() and not it->second.empty()) {
+                    auto state = std::move(it->second.back());
+                    it->second.pop_back();
+                    return state;
+                }
+            }
+            return std::unique_ptr<SrcState>(new SrcState(key));
+        }
+
+        void release(std::unique_ptr<SrcState> state)
+        {
+            state->reset();
+            std::lock_guard<std::mutex> lk(lock_);
+            auto& states = idle_[state->key()];
+            if (states.size() < MAX_IDLE_PER_KEY)
+                states.emplace_back(std::move(state));
+        }
+
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> lk(lock_);
+            size_t n = 0;
+            for (const auto& item : idle_)
+                n += item.second.size();
+            return n;
+        }
+
+    private:
+        static constexpr size_t MAX_IDLE_PER_KEY = 4;
+
+        mutable std::mutex lock_ {};
+        std::map<SrcKey, std::vector<std::unique_ptr<SrcState>>> idle_ {};
+};
+
 Resampler::Resampler(AudioFormat format, bool quality) : floatBufferIn_(),
-    floatBufferOut_(), scratchBuffer_(), samples_(0), format_(format), high_quality_(quality), src_state_()
+    floatBufferOut_(), samples_(0), format_(format), high_quality_(quality),
+    cache_(SrcStateCache::instance()), src_state_()
 {
     setFormat(format, quality);
 }
 
 Resampler::Resampler(unsigned sample_rate, unsigned channels, bool quality) : floatBufferIn_(),
-    floatBufferOut_(), scratchBuffer_(), samples_(0), format_(sample_rate, channels), high_quality_(quality), src_state_()
+    floatBufferOut_(), samples_(0), format_(sample_rate, channels), high_quality_(quality),
+    cache_(SrcStateCache::instance()), src_state_()
 {
     setFormat(format_, quality);
 }
 
-Resampler::~Resampler() = default;
+Resampler::~Resampler()
+{
+    if (src_state_)
+        cache_->release(std::move(src_state_));
+}
+
+size_t
+Resampler::cachedStates()
+{
+    return SrcStateCache::instance()->size();
+}
 
 void
 Resampler::setFormat(AudioFormat format, bool quality)
 {
     format_ = format;
+    high_quality_ = quality;
     samples_ = (format.nb_channels * format.sample_rate * 20) / 1000; // start with 20 ms buffers
     floatBufferIn_.resize(samples_);
     floatBufferOut_.resize(samples_);
-    scratchBuffer_.resize(samples_);
 
-    src_state_.reset(new SrcState(format.nb_channels, quality));
+    // the converter is taken from the cache at next resample()
+    if (src_state_)
+        cache_->release(std::move(src_state_));
 }
 
 void Resampler::resample(const AudioBuffer &dataIn, AudioBuffer &dataOut)
@@ -88,14 +177,15 @@ void Resampler::resample(const AudioBuffer &dataIn, AudioBuffer &dataOut)
     const size_t nbChans = dataIn.channels();
 
     if (nbChans != format_.nb_channels) {
-        // change channel num if needed
-        src_state_.reset(new SrcState(nbChans, high_quality_));
         format_.nb_channels = nbChans;
         RING_DBG("SRC channel number changed.");
     }
-    if (nbChans != dataOut.channels()) {
-        RING_DBG("Output buffer had the wrong number of channels (in: %zu, out: %u).", nbChans, dataOut.channels());
-        dataOut.setChannelNum(nbChans);
+
+    const SrcKey key {dataIn.getSampleRate(), dataOut.getSampleRate(), nbChans, high_quality_};
+    if (not src_state_ or src_state_->key() != key) {
+        if (src_state_)
+            cache_->release(std::move(src_state_));
+        src_state_ = cache_->acquire(key);
     }
 
     size_t inSamples = nbChans * nbFrames;
@@ -104,7 +194,6 @@ void Resampler::resample(const AudioBuffer &dataIn, AudioBuffer &dataOut)
     // grow buffer if needed
     floatBufferIn_.resize(inSamples);
     floatBufferOut_.resize(outSamples);
-    scratchBuffer_.resize(outSamples);
 
     SRC_DATA src_data;
     src_data.data_in = floatBufferIn_.data();
@@ -117,11 +206,10 @@ void Resampler::resample(const AudioBuffer &dataIn, AudioBuffer &dataOut)
     dataIn.interleaveFloat(floatBufferIn_.data());
 
     src_state_->process(&src_data);
-    /*
-    TODO: one-shot deinterleave and float-to-short conversion
-    */
-    src_float_to_short_array(floatBufferOut_.data(), scratchBuffer_.data(), outSamples);
-    dataOut.deinterleave(scratchBuffer_.data(), src_data.output_frames, nbChans);
+
+    // one pass deinterleave and float to short conversion,
+    // also sets the output channel number
+    dataOut.deinterleaveFloat(floatBufferOut_.data(), src_data.output_frames, nbChans);
 }
 
 } // namespace ring
@@ -32,7 +32,8 @@
 
 namespace ring {
 
-struct SrcState;
+class SrcState;
+class SrcStateCache;
 
 class Resampler {
     public:
@@ -54,6 +55,14 @@ class Resampler {
          */
         void setFormat(AudioFormat format, bool quality = false);
 
+        /**
+         * Number of idle converter states kept in the shared cache.
+         * Converter states are keyed by (input rate, output rate, channels,
+         * quality) and are reused by any Resampler needing the same one,
+         * instead of being created again.
+         */
+        static size_t cachedStates();
+
         /**
          * resample from the samplerate1 to the samplerate2
          * @param dataIn  Input buffer
@@ -68,12 +77,12 @@ class Resampler {
         /* temporary buffers */
         std::vector<float> floatBufferIn_;
         std::vector<float> floatBufferOut_;
-        std::vector<AudioSample> scratchBuffer_;
 
         size_t samples_; // size in samples of temporary buffers
         AudioFormat format_; // number of channels and max output frequency
         bool high_quality_;
 
+        std::shared_ptr<SrcStateCache> cache_;
         std::unique_ptr<SrcState> src_state_;
 };
 
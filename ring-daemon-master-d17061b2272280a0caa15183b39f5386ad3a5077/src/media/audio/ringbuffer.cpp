@@ -41,8 +41,8 @@ static const size_t MIN_BUFFER_SIZE = 1024;
 RingBuffer::RingBuffer(const std::string& rbuf_id, size_t size,
                        AudioFormat format /* = MONO */)
     : id(rbuf_id)
-    , endPos_(0)
     , buffer_(std::max(size, MIN_BUFFER_SIZE), format)
+    , endPos_(0)
     , lock_()
     , not_empty_()
     , readoffsets_()
@@ -50,47 +50,49 @@ class RingBuffer {
         RingBuffer(const std::string& id, size_t size,
                    AudioFormat format=AudioFormat::MONO());
 
+        virtual ~RingBuffer() = default;
+
         /**
          * Reset the counters to 0 for this read offset
          */
-        void flush(const std::string &call_id);
+        virtual void flush(const std::string &call_id);
 
-        void flushAll();
+        virtual void flushAll();
 
-        inline  AudioFormat getFormat() const {
+        virtual AudioFormat getFormat() const {
             return buffer_.getFormat();
         }
 
-        inline void setFormat(AudioFormat format) {
+        virtual void setFormat(AudioFormat format) {
             buffer_.setFormat(format);
         }
 
         /**
          * Add a new readoffset for this ringbuffer
          */
-        void createReadOffset(const std::string &call_id);
+        virtual void createReadOffset(const std::string &call_id);
 
         /**
          * Remove a readoffset for this ringbuffer
          */
-        void removeReadOffset(const std::string &call_id);
+        virtual void removeReadOffset(const std::string &call_id);
 
-        size_t readOffsetCount() const { return readoffsets_.size(); }
+        virtual size_t readOffsetCount() const { return readoffsets_.size(); }
 
-        bool hasNoReadOffsets() const;
+        virtual bool hasNoReadOffsets() const;
 
         /**
          * Write data in the ring buffer
          * @param buffer Data to copied
          * @param toCopy Number of bytes to copy
          */
-         void put(AudioBuffer& buf);
+        virtual void put(AudioBuffer& buf);
 
         /**
          * To get how much samples are available in the buffer to read in
          * @return int The available (multichannel) samples number
          */
-        size_t availableForGet(const std::string &call_id) const;
+        virtual size_t availableForGet(const std::string &call_id) const;
 
         /**
          * Get data in the ring buffer
@@ -98,22 +100,22 @@ class RingBuffer {
          * @param toCopy Number of bytes to copy
          * @return size_t Number of bytes copied
          */
-         size_t get(AudioBuffer& buf, const std::string &call_id);
+        virtual size_t get(AudioBuffer& buf, const std::string &call_id);
 
         /**
          * Discard data from the buffer
          * @param toDiscard Number of samples to discard
          * @return size_t Number of samples discarded
          */
-        size_t discard(size_t toDiscard, const std::string &call_id);
+        virtual size_t discard(size_t toDiscard, const std::string &call_id);
 
         /**
          * Total length of the ring buffer which is available for "putting"
          * @return int
          */
-        size_t putLength() const;
+        virtual size_t putLength() const;
 
-        size_t getLength(const std::string &call_id) const;
+        virtual size_t getLength(const std::string &call_id) const;
 
         inline bool isFull() const {
             return putLength() == buffer_.frames();
@@ -132,15 +134,19 @@ class RingBuffer {
          * @param deadline The call is garenteed to end after this time point. If no deadline is provided, the the call blocks indefinitely.
          * @return available data for call_id after the call returned (same as calling getLength(call_id) ).
          */
-        size_t waitForDataAvailable(const std::string &call_id, const size_t min_data_length, const std::chrono::high_resolution_clock::time_point& deadline) const;
+        virtual size_t waitForDataAvailable(const std::string &call_id, const size_t min_data_length, const std::chrono::high_resolution_clock::time_point& deadline) const;
 
         /**
          * Debug function print mEnd, mStart, mBufferSize
          */
-        void debug();
+        virtual void debug();
 
         const std::string id;
 
+    protected:
+        /** Data */
+        AudioBuffer buffer_;
+
     private:
         NON_COPYABLE(RingBuffer);
 
@@ -172,9 +178,6 @@ class RingBuffer {
         /** Offset on the last data */
         size_t endPos_;
 
-        /** Data */
-        AudioBuffer buffer_;
-
         mutable std::mutex lock_;
         mutable std::condition_variable not_empty_;
 
@@ -21,6 +21,8 @@
 
 #include "ringbufferpool.h"
 #include "ringbuffer.h"
+#include "lockfree_ringbuffer.h"
+#include "conference_mixer.h"
 #include "ring_types.h" // for SIZEBUF
 #include "logger.h"
 
@@ -28,6 +30,7 @@
 #include <utility> // for std::pair
 #include <cstring>
 #include <algorithm>
+#include <vector>
 
 namespace ring {
 
@@ -39,6 +42,7 @@ RingBufferPool::RingBufferPool()
 
 RingBufferPool::~RingBufferPool()
 {
+    mixers_.clear();
     readBindingsMap_.clear();
     defaultRingBuffer_.reset();
 
@@ -59,6 +63,8 @@ RingBufferPool::setInternalSamplingRate(unsigned sr)
     if (sr != internalAudioFormat_.sample_rate) {
         flushAllBuffers();
         internalAudioFormat_.sample_rate = sr;
+        for (const auto& item : mixers_)
+            item.second->setFormat(internalAudioFormat_);
     }
 }
 
@@ -70,6 +76,8 @@ RingBufferPool::setInternalAudioFormat(AudioFormat format)
     if (format != internalAudioFormat_) {
         flushAllBuffers();
         internalAudioFormat_ = format;
+        for (const auto& item : mixers_)
+            item.second->setFormat(internalAudioFormat_);
     }
 }
 
@@ -101,7 +109,7 @@ RingBufferPool::getRingBuffer(const std::string& id) const
 }
 
 std::shared_ptr<RingBuffer>
-RingBufferPool::createRingBuffer(const std::string& id)
+RingBufferPool::createRingBuffer(const std::string& id, RingBufferType type)
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
@@ -111,8 +119,12 @@ RingBufferPool::createRingBuffer(const std::string& id)
         return rbuf;
     }
 
-    rbuf.reset(new RingBuffer(id, SIZEBUF));
-    RING_DBG("Ringbuffer created with id '%s'", id.c_str());
+    if (type == RingBufferType::LOCK_FREE)
+        rbuf.reset(new LockFreeRingBuffer(id, SIZEBUF));
+    else
+        rbuf.reset(new RingBuffer(id, SIZEBUF));
+    RING_DBG("Ringbuffer created with id '%s'%s", id.c_str(),
+             type == RingBufferType::LOCK_FREE ? " (lock-free)" : "");
     ringBufferMap_.insert(std::make_pair(id, std::weak_ptr<RingBuffer>(rbuf)));
     return rbuf;
 }
@@ -166,6 +178,95 @@ RingBufferPool::removeReaderFromRingBuffer(const std::shared_ptr<RingBuffer>& rb
     rbuf->removeReadOffset(call_id);
 }
 
+std::shared_ptr<ConferenceMixer>
+RingBufferPool::getMixer(const std::string& call_id) const
+{
+    const auto& iter = mixers_.find(call_id);
+    return iter != mixers_.cend() ? iter->second : nullptr;
+}
+
+void
+RingBufferPool::parkReadOffsets(const std::string& call_id)
+{
+    if (const auto bindings = getReadBindings(call_id))
+        for (const auto& rbuf : *bindings)
+            rbuf->removeReadOffset(call_id);
+}
+
+void
+RingBufferPool::restoreReadOffsets(const std::string& call_id)
+{
+    if (const auto bindings = getReadBindings(call_id))
+        for (const auto& rbuf : *bindings)
+            rbuf->createReadOffset(call_id);
+}
+
+void
+RingBufferPool::updateMixers()
+{
+    // A conference is a set of at least 3 calls where each one reads
+    // all the others and nothing else.
+    std::set<std::set<std::string>> groups;
+    for (const auto& item : readBindingsMap_) {
+        const auto& bindings = item.second;
+        if (bindings.size() < 2)
+            continue;
+
+        std::set<std::string> group {item.first};
+        for (const auto& rbuf : bindings)
+            group.insert(rbuf->id);
+        if (group.size() != bindings.size() + 1 or groups.count(group))
+            continue;
+
+        const auto isConference = [&] {
+            for (const auto& id : group) {
+                const auto others = getReadBindings(id);
+                if (not others or others->size() != group.size() - 1)
+                    return false;
+                for (const auto& rbuf : *others)
+                    if (rbuf->id == id or not group.count(rbuf->id))
+                        return false;
+            }
+            return true;
+        };
+        if (isConference())
+            groups.insert(group);
+    }
+
+    // Keep mixers of unchanged conferences, remove the others
+    std::set<std::shared_ptr<ConferenceMixer>> current;
+    for (const auto& item : mixers_)
+        current.insert(item.second);
+
+    for (const auto& mixer : current) {
+        const auto ids = mixer->getMemberIds();
+        if (groups.erase(std::set<std::string>(ids.cbegin(), ids.cend())))
+            continue;
+        RING_DBG("Remove conference mixer '%s'", mixer->getId().c_str());
+        for (const auto& id : ids) {
+            mixers_.erase(id);
+            restoreReadOffsets(id);
+        }
+    }
+
+    for (const auto& group : groups) {
+        // each member is read by the others, so every ringbuffer is found
+        std::map<std::string, std::shared_ptr<RingBuffer>> rbufs;
+        for (const auto& id : group)
+            for (const auto& rbuf : *getReadBindings(id))
+                rbufs.emplace(rbuf->id, rbuf);
+
+        std::vector<std::shared_ptr<RingBuffer>> members;
+        for (const auto& item : rbufs)
+            members.push_back(item.second);
+        auto mixer = std::make_shared<ConferenceMixer>(members, internalAudioFormat_);
+        for (const auto& id : group) {
+            parkReadOffsets(id);
+            mixers_[id] = mixer;
+        }
+    }
+}
+
 void
 RingBufferPool::bindCallID(const std::string& call_id1,
                            const std::string& call_id2)
@@ -186,6 +287,7 @@ RingBufferPool::bindCallID(const std::string& call_id1,
 
     addReaderToRingBuffer(rb_call1, call_id2);
     addReaderToRingBuffer(rb_call2, call_id1);
+    updateMixers();
 }
 
 void
@@ -198,6 +300,7 @@ RingBufferPool::bindHalfDuplexOut(const std::string& process_id,
         std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
         addReaderToRingBuffer(rb, process_id);
+        updateMixers();
     }
 }
 
@@ -221,6 +324,7 @@ RingBufferPool::unBindCallID(const std::string& call_id1,
 
     removeReaderFromRingBuffer(rb_call1, call_id2);
     removeReaderFromRingBuffer(rb_call2, call_id1);
+    updateMixers();
 }
 
 void
@@ -229,8 +333,10 @@ RingBufferPool::unBindHalfDuplexOut(const std::string& process_id,
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
-    if (const auto& rb = getRingBuffer(call_id))
+    if (const auto& rb = getRingBuffer(call_id)) {
         removeReaderFromRingBuffer(rb, process_id);
+        updateMixers();
+    }
 }
 
 void
@@ -253,6 +359,7 @@ RingBufferPool::unBindAll(const std::string& call_id)
         removeReaderFromRingBuffer(rbuf, call_id);
         removeReaderFromRingBuffer(rb_call, rbuf->id);
     }
+    updateMixers();
 }
 
 size_t
@@ -260,6 +367,9 @@ RingBufferPool::getData(AudioBuffer& buffer, const std::string& call_id)
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
+    if (const auto mixer = getMixer(call_id))
+        return mixer->get(buffer, call_id);
+
     const auto bindings = getReadBindings(call_id);
     if (not bindings)
         return 0;
@@ -294,6 +404,19 @@ RingBufferPool::waitForDataAvailable(const std::string& call_id,
     // convert to absolute time
     const auto deadline = std::chrono::high_resolution_clock::now() + max_wait;
 
+    if (const auto mixer = getMixer(call_id)) {
+        const size_t mixed = mixer->mixedForGet(call_id);
+        if (mixed >= min_frames)
+            return true;
+        const auto sources = mixer->getSources(call_id);
+        const size_t missing = min_frames - mixed;
+        lk.unlock();
+        for (const auto& rbuf : sources)
+            if (rbuf->waitForDataAvailable(mixer->getId(), missing, deadline) < missing)
+                return false;
+        return true;
+    }
+
     auto bindings = getReadBindings(call_id);
     if (not bindings)
         return 0;
@@ -313,6 +436,11 @@ RingBufferPool::getAvailableData(AudioBuffer& buffer, const std::string& call_id
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
+    if (const auto mixer = getMixer(call_id)) {
+        buffer.resize(std::min(mixer->availableForGet(call_id), buffer.frames()));
+        return mixer->get(buffer, call_id);
+    }
+
     auto bindings = getReadBindings(call_id);
     if (not bindings)
         return 0;
@@ -352,6 +480,9 @@ RingBufferPool::availableForGet(const std::string& call_id) const
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
+    if (const auto mixer = getMixer(call_id))
+        return mixer->availableForGet(call_id);
+
     const auto bindings = getReadBindings(call_id);
     if (not bindings)
         return 0;
@@ -377,6 +508,9 @@ RingBufferPool::discard(size_t toDiscard, const std::string& call_id)
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
+    if (const auto mixer = getMixer(call_id))
+        return mixer->discard(toDiscard, call_id);
+
     const auto bindings = getReadBindings(call_id);
     if (not bindings)
         return 0;
@@ -392,6 +526,11 @@ RingBufferPool::flush(const std::string& call_id)
 {
     std::lock_guard<std::recursive_mutex> lk(stateLock_);
 
+    if (const auto mixer = getMixer(call_id)) {
+        mixer->flush(call_id);
+        return;
+    }
+
     const auto bindings = getReadBindings(call_id);
     if (not bindings)
         return;
@@ -414,6 +553,9 @@ RingBufferPool::flushAllBuffers()
             item = ringBufferMap_.erase(item);
         }
     }
+
+    for (const auto& item : mixers_)
+        item.second->flushAll();
 }
 
 } // namespace ring
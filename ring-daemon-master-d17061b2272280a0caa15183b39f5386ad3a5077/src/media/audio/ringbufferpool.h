@@ -34,6 +34,7 @@
 namespace ring {
 
 class RingBuffer;
+class ConferenceMixer;
 
 class RingBufferPool {
 
@@ -59,6 +60,8 @@ class RingBufferPool {
         /**
          * Bind together two audio streams so taht a client will be able
          * to put and get data specifying its callid only.
+         * When calls end up all bound to each other (a conference), the
+         * data they get is mixed once for all by a ConferenceMixer.
          */
         void bindCallID(const std::string& call_id1,
                         const std::string& call_id2);
@@ -101,12 +104,22 @@ class RingBufferPool {
 
         void flushAllBuffers();
 
+        /**
+         * RingBuffer implementations.
+         * LOCK_FREE is restricted to a single writer thread
+         * (see LockFreeRingBuffer).
+         */
+        enum class RingBufferType { LOCKED, LOCK_FREE };
+
         /**
          * Create a new ringbuffer with a default readoffset.
          * This class keeps a weak reference on returned pointer,
          * so the caller is responsible of the refered instance.
+         * If a ringbuffer already exists with this ID, it is returned
+         * whatever its type.
          */
-        std::shared_ptr<RingBuffer> createRingBuffer(const std::string& id);
+        std::shared_ptr<RingBuffer> createRingBuffer(const std::string& id,
+                                                     RingBufferType type = RingBufferType::LOCKED);
 
         /**
          * Obtain a shared pointer on a RingBuffer given by its ID.
@@ -141,12 +154,31 @@ class RingBufferPool {
         void removeReaderFromRingBuffer(const std::shared_ptr<RingBuffer>& rbuf,
                                         const std::string& call_id);
 
+        /**
+         * Look for groups of calls all reading each other (conferences)
+         * and mix them with a ConferenceMixer.
+         * Must be called after each change of the read bindings.
+         */
+        void updateMixers();
+
+        /**
+         * Move read offsets of a call from its bindings to its mixer,
+         * or back when the mixer is removed.
+         */
+        void parkReadOffsets(const std::string& call_id);
+        void restoreReadOffsets(const std::string& call_id);
+
+        std::shared_ptr<ConferenceMixer> getMixer(const std::string& call_id) const;
+
         // A cache of created RingBuffers listed by IDs.
         std::map<std::string, std::weak_ptr<RingBuffer> > ringBufferMap_ {};
 
         // A map of which RingBuffers a call has some ReadOffsets
         std::map<std::string, ReadBindings> readBindingsMap_ {};
 
+        // Conference mixers listed by member call IDs
+        std::map<std::string, std::shared_ptr<ConferenceMixer> > mixers_ {};
+
         mutable std::recursive_mutex stateLock_ {};
 
         AudioFormat internalAudioFormat_ {AudioFormat::DEFAULT()};
@@ -22,6 +22,9 @@
 #include "libav_utils.h"
 #include "media_buffer.h"
 #include "dring/videomanager_interface.h"
+#ifdef RING_VIDEO
+#include "video/video_frame_pool.h"
+#endif
 
 #include <new> // std::bad_alloc
 #include <cstdlib>
@@ -55,10 +58,11 @@ void
 VideoFrame::reset() noexcept
 {
     MediaFrame::reset();
-#if !USE_OLD_AVU
     allocated_ = false;
-#endif
-    releaseBufferCb_ = {};
+    if (releaseBufferCb_) {
+        releaseBufferCb_(ptr_);
+        releaseBufferCb_ = {};
+    }
 }
 
 size_t
@@ -99,23 +103,18 @@ VideoFrame::reserve(int format, int width, int height)
     auto libav_format = (AVPixelFormat)libav_utils::libav_pixel_format(format);
     auto libav_frame = frame_.get();
 
-    if (allocated_) {
-        // nothing to do if same properties
-        if (width == libav_frame->width
-            and height == libav_frame->height
-            and libav_format == libav_frame->format)
-#if USE_OLD_AVU
-        avpicture_free((AVPicture *) libav_frame);
-#else
-        av_frame_unref(libav_frame);
-#endif
-    }
+    // nothing to do if same properties and buffers not shared
+    if (allocated_
+        and width == libav_frame->width
+        and height == libav_frame->height
+        and libav_format == libav_frame->format
+        and av_frame_is_writable(libav_frame))
+        return;
 
+    reset();
     setGeometry(format, width, height);
-    if (av_frame_get_buffer(libav_frame, 32))
-        throw std::bad_alloc();
+    video::VideoFramePool::instance().allocate(libav_frame);
     allocated_ = true;
-    releaseBufferCb_ = {};
 }
 
 void
@@ -151,6 +150,19 @@ VideoFrame::noise()
     }
 }
 
+void
+VideoFrame::copyFrom(const VideoFrame& src)
+{
+    auto source = src.pointer();
+    if (source->buf[0]) {
+        // refcounted buffers, just take a reference
+        reset();
+        if (av_frame_ref(frame_.get(), source) < 0)
+            throw std::bad_alloc();
+    } else
+        *this = src;
+}
+
 VideoFrame&
 VideoFrame::operator =(const VideoFrame& src)
 {
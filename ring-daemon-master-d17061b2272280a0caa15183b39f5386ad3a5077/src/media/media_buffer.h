@@ -76,6 +76,7 @@ class VideoFrame: public MediaFrame {
         int height() const noexcept;
 
         // Allocate internal pixel buffers following given specifications
+        // Buffers come from VideoFramePool, reused if already fitting.
         void reserve(int format, int width, int height);
 
         // Set internal pixel buffers on given memory buffer
@@ -88,6 +89,10 @@ class VideoFrame: public MediaFrame {
         // Copy-Assignement
         VideoFrame& operator =(const VideoFrame& src);
 
+        // Share the pixel buffers of src if refcounted, else copy them.
+        // The shared buffers must not be written.
+        void copyFrom(const VideoFrame& src);
+
     private:
         std::function<void(uint8_t*)> releaseBufferCb_ {};
         uint8_t* ptr_ {nullptr};
@@ -23,6 +23,7 @@
 #include "media_device.h"
 #include "media_buffer.h"
 #include "media_io_handle.h"
+#include "media_stats.h"
 #include "audio/audiobuffer.h"
 #include "audio/ringbuffer.h"
 #include "audio/resampler.h"
@@ -232,6 +233,34 @@ int MediaDecoder::setupFromAudioData(const AudioFormat format)
     return 0;
 }
 
+int MediaDecoder::setupFromAudioCodec(int codecId, const AudioFormat format)
+{
+    // the context is reallocated below, it is not reused
+    if (decoderCtx_)
+        avcodec_free_context(&decoderCtx_);
+
+    inputDecoder_ = avcodec_find_decoder(static_cast<AVCodecID>(codecId));
+    if (!inputDecoder_) {
+        RING_ERR("Unsupported codec");
+        return -1;
+    }
+
+    decoderCtx_ = avcodec_alloc_context3(inputDecoder_);
+    decoderCtx_->channels = format.nb_channels;
+    decoderCtx_->sample_rate = format.sample_rate;
+
+    RING_DBG("Audio decoding using %s with %s",
+             inputDecoder_->name, format.toString().c_str());
+
+    decoderCtx_->refcounted_frames = 1;
+    if (avcodec_open2(decoderCtx_, inputDecoder_, NULL)) {
+        RING_ERR("Could not open codec");
+        return -1;
+    }
+
+    return 0;
+}
+
 #ifdef RING_VIDEO
 int MediaDecoder::setupFromVideoData()
 {
@@ -354,6 +383,7 @@ MediaDecoder::decode(VideoFrame& result)
         return Status::Success;
     }
 
+    const auto decodeStart = MediaStreamStats::clock::now();
     auto frame = result.pointer();
     int frameFinished = 0;
     ret = avcodec_send_packet(decoderCtx_, &inpacket);
@@ -387,6 +417,10 @@ MediaDecoder::decode(VideoFrame& result)
                 return Status::RestartRequired;
         }
 #endif // RING_ACCEL
+        if (stats_) {
+            stats_->onFrame(MediaStreamStats::clock::now() - decodeStart);
+            stats_->setFrameSize(frame->width, frame->height);
+        }
         if (emulateRate_ and frame->pts != AV_NOPTS_VALUE) {
             auto frame_time = getTimeBase()*(frame->pts - avStream_->start_time);
             auto target = startTime_ + static_cast<std::int64_t>(frame_time.real() * 1e6);
@@ -428,6 +462,7 @@ MediaDecoder::decode(const AudioFrame& decodedFrame)
         return Status::Success;
     }
 
+    const auto decodeStart = MediaStreamStats::clock::now();
     int frameFinished = 0;
         ret = avcodec_send_packet(decoderCtx_, &inpacket);
         if (ret < 0)
@@ -441,6 +476,8 @@ MediaDecoder::decode(const AudioFrame& decodedFrame)
 
     if (frameFinished) {
         av_packet_unref(&inpacket);
+        if (stats_)
+            stats_->onFrame(MediaStreamStats::clock::now() - decodeStart);
         if (emulateRate_ and frame->pts != AV_NOPTS_VALUE) {
             auto frame_time = getTimeBase()*(frame->pts - avStream_->start_time);
             auto target = startTime_ + static_cast<std::int64_t>(frame_time.real() * 1e6);
@@ -455,6 +492,30 @@ MediaDecoder::decode(const AudioFrame& decodedFrame)
     return Status::Success;
 }
 
+MediaDecoder::Status
+MediaDecoder::decode(const uint8_t* data, size_t size, const AudioFrame& decodedFrame)
+{
+    AVPacket inpacket;
+    av_init_packet(&inpacket);
+    inpacket.data = const_cast<uint8_t*>(data);
+    inpacket.size = size;
+
+    const auto decodeStart = MediaStreamStats::clock::now();
+    int ret = avcodec_send_packet(decoderCtx_, &inpacket);
+    if (ret < 0)
+        return ret == AVERROR_EOF ? Status::Success : Status::DecodeError;
+
+    ret = avcodec_receive_frame(decoderCtx_, decodedFrame.pointer());
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        return Status::Success;
+    if (ret < 0)
+        return Status::DecodeError;
+
+    if (stats_)
+        stats_->onFrame(MediaStreamStats::clock::now() - decodeStart);
+    return Status::FrameFinished;
+}
+
 #ifdef RING_VIDEO
 MediaDecoder::Status
 MediaDecoder::flush(VideoFrame& result)
@@ -518,6 +579,12 @@ int MediaDecoder::getPixelFormat() const
 void
 MediaDecoder::writeToRingBuffer(const AudioFrame& decodedFrame,
                                 RingBuffer& rb, const AudioFormat outFormat)
+{
+    rb.put(toAudioBuffer(decodedFrame, outFormat));
+}
+
+const AudioBuffer&
+MediaDecoder::toAudioBuffer(const AudioFrame& decodedFrame, const AudioFormat outFormat)
 {
     const auto libav_frame = decodedFrame.pointer();
     decBuff_.setFormat(AudioFormat{
@@ -542,10 +609,9 @@ MediaDecoder::writeToRingBuffer(const AudioFrame& decodedFrame,
         resamplingBuff_.setFormat({(unsigned) outFormat.sample_rate, (unsigned) decoderCtx_->channels});
         resamplingBuff_.resize(libav_frame->nb_samples);
         resampler_->resample(decBuff_, resamplingBuff_);
-        rb.put(resamplingBuff_);
-    } else {
-        rb.put(decBuff_);
+        return resamplingBuff_;
     }
+    return decBuff_;
 }
 
 int
@@ -55,6 +55,7 @@ class AudioFormat;
 class RingBuffer;
 class Resampler;
 class MediaIOHandle;
+class MediaStreamStats;
 struct DeviceParams;
 
 class MediaDecoder {
@@ -86,6 +87,19 @@ class MediaDecoder {
         Status decode(const AudioFrame&);
         void writeToRingBuffer(const AudioFrame&, RingBuffer&, const AudioFormat);
 
+        /**
+         * Open the decoder of codecId without any input, packets are then
+         * given to decode() as buffers (e.g. RTP payloads).
+         */
+        int setupFromAudioCodec(int codecId, const AudioFormat format);
+        Status decode(const uint8_t* data, size_t size, const AudioFrame&);
+
+        /**
+         * Convert a decoded frame to outFormat sample rate. The returned
+         * buffer is valid until the next call.
+         */
+        const AudioBuffer& toAudioBuffer(const AudioFrame&, const AudioFormat outFormat);
+
         int getWidth() const;
         int getHeight() const;
         std::string getDecoderName() const;
@@ -94,6 +108,12 @@ class MediaDecoder {
         int getPixelFormat() const;
 
         void setOptions(const std::map<std::string, std::string>& options);
+
+        /**
+         * Account the decoded frames and the decoding time in stats,
+         * which must outlive the decoder.
+         */
+        void setStats(MediaStreamStats* stats) { stats_ = stats; }
 #ifdef RING_ACCEL
         void enableAccel(const bool enableAccel) { enableAccel_ = enableAccel; }
 #endif
@@ -111,6 +131,7 @@ class MediaDecoder {
         int streamIndex_ = -1;
         bool emulateRate_ = false;
         int64_t startTime_;
+        MediaStreamStats* stats_ {nullptr};
 
         AudioBuffer decBuff_;
         AudioBuffer resamplingBuff_;
@@ -55,6 +55,8 @@ MediaEncoder::~MediaEncoder()
         avformat_free_context(outputCtx_);
     }
 
+    av_frame_free(&audioFrame_);
+    av_packet_free(&audioPacket_);
     av_dict_free(&options_);
 }
 
@@ -126,7 +128,6 @@ void
 MediaEncoder::openOutput(const char *filename,
                          const ring::MediaDescription& args)
 {
-    setOptions(args);
     AVOutputFormat *oformat = av_guess_format("rtp", filename, nullptr);
 
     if (!oformat) {
@@ -139,6 +140,25 @@ MediaEncoder::openOutput(const char *filename,
     // guarantee that buffer is NULL terminated
     outputCtx_->filename[sizeof(outputCtx_->filename) - 1] = '\0';
 
+    openEncoder(args);
+
+    // add video stream to outputformat context
+    stream_ = avformat_new_stream(outputCtx_, 0);
+    if (!stream_)
+        throw MediaEncoderException("Could not allocate stream");
+
+#ifndef _WIN32
+    avcodec_parameters_from_context(stream_->codecpar, encoderCtx_);
+#else
+    stream_->codec = encoderCtx_;
+#endif
+}
+
+void
+MediaEncoder::openEncoder(const ring::MediaDescription& args)
+{
+    setOptions(args);
+
     /* find the video encoder */
     if (args.codec->systemCodecInfo.avcodecId == AV_CODEC_ID_H263)
         // For H263 encoding, we force the use of AV_CODEC_ID_H263P (H263-1998)
@@ -211,16 +231,6 @@ MediaEncoder::openOutput(const char *filename,
     if (ret)
         throw MediaEncoderException("Could not open encoder");
 
-    // add video stream to outputformat context
-    stream_ = avformat_new_stream(outputCtx_, 0);
-    if (!stream_)
-        throw MediaEncoderException("Could not allocate stream");
-
-#ifndef _WIN32
-    avcodec_parameters_from_context(stream_->codecpar, encoderCtx_);
-#else
-    stream_->codec = encoderCtx_;
-#endif
 #ifdef RING_VIDEO
     if (args.codec->systemCodecInfo.mediaType == MEDIA_VIDEO) {
         // allocate buffers for both scaled (pre-encoder) and encoded frames
@@ -276,6 +286,15 @@ print_averror(const char *funcname, int err)
 int
 MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
                      int64_t frame_number)
+{
+    return encode(input, is_keyframe, frame_number, [this](AVPacket& pkt) {
+        return send(pkt, *this);
+    });
+}
+
+int
+MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
+                     int64_t frame_number, const PacketCallback& cb)
 {
     /* Prepare a frame suitable to our encoder frame format,
      * keeping also the input aspect ratio.
@@ -310,20 +329,8 @@ MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
             return -1;
 
         if (pkt.size) {
-            if (pkt.pts != AV_NOPTS_VALUE)
-                pkt.pts = av_rescale_q(pkt.pts, encoderCtx_->time_base,
-                                       stream_->time_base);
-            if (pkt.dts != AV_NOPTS_VALUE)
-                pkt.dts = av_rescale_q(pkt.dts, encoderCtx_->time_base,
-                                       stream_->time_base);
-
-            pkt.stream_index = stream_->index;
-
-            // write the compressed frame
-            ret = av_write_frame(outputCtx_, &pkt);
-            if (ret < 0)
-                print_averror("av_write_frame", ret);
-            else
+            ret = cb(pkt);
+            if (ret >= 0)
                 break;
         }
     }
@@ -334,74 +341,118 @@ MediaEncoder::encode(VideoFrame& input, bool is_keyframe,
 }
 #endif // RING_VIDEO
 
-int MediaEncoder::encode_audio(const AudioBuffer &buffer)
+int
+MediaEncoder::send(const AVPacket& pkt, const MediaEncoder& source, int64_t ptsOffset)
 {
-    const int needed_bytes = av_samples_get_buffer_size(NULL, buffer.channels(),
-                                                        buffer.frames(),
-                                                        AV_SAMPLE_FMT_S16, 0);
-    if (needed_bytes < 0) {
-        RING_ERR("Couldn't calculate buffer size");
-        return -1;
-    }
+    // the packet may be sent to other outputs: timestamps are changed on a reference
+    AVPacket out;
+    memset(&out, 0, sizeof(out));
+    av_init_packet(&out);
+    int ret = av_packet_ref(&out, &pkt);
+    if (ret < 0)
+        return ret;
 
-    std::vector<AudioSample> samples (needed_bytes / sizeof(AudioSample));
-    AudioSample* sample_data = samples.data();
+    if (out.pts != AV_NOPTS_VALUE)
+        out.pts = av_rescale_q(out.pts + ptsOffset, source.encoderCtx_->time_base,
+                               stream_->time_base);
+    if (out.dts != AV_NOPTS_VALUE)
+        out.dts = av_rescale_q(out.dts + ptsOffset, source.encoderCtx_->time_base,
+                               stream_->time_base);
 
-    AudioSample *offset_ptr = sample_data;
-    int nb_frames = buffer.frames();
+    out.stream_index = stream_->index;
 
-    if (not is_muted) {
-        //only fill buffer with samples if not muted
-        buffer.interleave(sample_data);
-    } else {
-        //otherwise filll buffer with zero
-        buffer.fillWithZero(sample_data);
-    }
-    const auto layout = buffer.channels() == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
-    const auto sample_rate = buffer.getSampleRate();
+    // write the compressed frame
+    ret = av_write_frame(outputCtx_, &out);
+    if (ret < 0)
+        print_averror("av_write_frame", ret);
 
-    while (nb_frames > 0) {
-        AVFrame *frame = av_frame_alloc();
-        if (!frame)
-            return -1;
+    av_packet_unref(&out);
+    return ret;
+}
 
-        if (encoderCtx_->frame_size)
-            frame->nb_samples = std::min<int>(nb_frames,
-                                              encoderCtx_->frame_size);
-        else
-            frame->nb_samples = nb_frames;
+AVFrame*
+MediaEncoder::prepareAudioFrame(int nb_samples, unsigned channels, int sample_rate)
+{
+    if (not audioFrame_) {
+        audioFrame_ = av_frame_alloc();
+        if (not audioFrame_)
+            return nullptr;
+    }
+
+    auto frame = audioFrame_;
+    // The frame holds as many channels as the buffer it is filled from
+    const auto layout = av_get_default_channel_layout(channels);
+    if (not layout) {
+        RING_ERR("Unsupported number of audio channels: %u", channels);
+        return nullptr;
+    }
 
+    // Buffers are kept as long as they are large enough for the packet
+    if (not frame->buf[0] or frame->channel_layout != static_cast<uint64_t>(layout)
+        or nb_samples > audioFrameCapacity_) {
+        av_frame_unref(frame);
         frame->format = AV_SAMPLE_FMT_S16;
         frame->channel_layout = layout;
-        frame->sample_rate = sample_rate;
+        frame->channels = channels;
+        frame->nb_samples = nb_samples;
+        int err = av_frame_get_buffer(frame, 0);
+        if (err < 0) {
+            print_averror("av_frame_get_buffer", err);
+            return nullptr;
+        }
+        audioFrameCapacity_ = nb_samples;
+    } else if (not av_frame_is_writable(frame)) {
+        // still referenced by the encoder, data is copied to new buffers
+        int err = av_frame_make_writable(frame);
+        if (err < 0) {
+            print_averror("av_frame_make_writable", err);
+            return nullptr;
+        }
+    }
 
-        frame->pts = sent_samples;
-        sent_samples += frame->nb_samples;
+    frame->nb_samples = nb_samples;
+    frame->sample_rate = sample_rate;
+    return frame;
+}
+
+int MediaEncoder::encode_audio(const AudioBuffer &buffer)
+{
+    if (not audioPacket_) {
+        audioPacket_ = av_packet_alloc();
+        if (not audioPacket_)
+            return -1;
+    }
+    auto& pkt = *audioPacket_;
+
+    const unsigned channels = buffer.channels();
+    const auto sample_rate = buffer.getSampleRate();
+    size_t pos = 0;
+    int nb_frames = buffer.frames();
 
-        const auto buffer_size = \
-            av_samples_get_buffer_size(NULL, buffer.channels(),
-                                       frame->nb_samples, AV_SAMPLE_FMT_S16, 0);
+    while (nb_frames > 0) {
+        const int nb_samples = encoderCtx_->frame_size ?
+            std::min<int>(nb_frames, encoderCtx_->frame_size) : nb_frames;
 
-        int err = avcodec_fill_audio_frame(frame, buffer.channels(),
-                                           AV_SAMPLE_FMT_S16,
-                                           reinterpret_cast<const uint8_t *>(offset_ptr),
-                                           buffer_size, 0);
-        if (err < 0) {
-            char errbuf[128];
-            av_strerror(err, errbuf, sizeof(errbuf));
-            RING_ERR("Couldn't fill audio frame: %s: %d %d", errbuf,
-                     frame->nb_samples, buffer_size);
-            av_frame_free(&frame);
+        AVFrame *frame = prepareAudioFrame(nb_samples, channels, sample_rate);
+        if (!frame)
             return -1;
+
+        // samples are written straight into the frame
+        auto data = reinterpret_cast<AudioSample*>(frame->data[0]);
+        if (not is_muted) {
+            //only fill buffer with samples if not muted
+            buffer.interleave(data, pos, nb_samples);
+        } else {
+            //otherwise filll buffer with zero
+            std::fill_n(data, nb_samples * channels, 0);
         }
 
-        nb_frames -= frame->nb_samples;
-        offset_ptr += frame->nb_samples * buffer.channels();
+        frame->pts = sent_samples;
+        sent_samples += nb_samples;
+
+        nb_frames -= nb_samples;
+        pos += nb_samples;
 
-        AVPacket pkt;
-        av_init_packet(&pkt);
-        pkt.data = NULL; // packet data will be allocated by the encoder
-        pkt.size = 0;
         int ret = 0;
 
         ret = avcodec_send_frame(encoderCtx_, frame);
@@ -435,7 +486,6 @@ int MediaEncoder::encode_audio(const AudioBuffer &buffer)
         }
 
         av_packet_unref(&pkt);
-        av_frame_free(&frame);
     }
 
     return 0;
@@ -32,6 +32,7 @@
 #include "media_buffer.h"
 #include "media_device.h"
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -42,6 +43,7 @@ class AVStream;
 class AVFormatContext;
 class AVDictionary;
 class AVCodec;
+class AVPacket;
 
 namespace ring {
 
@@ -64,13 +66,30 @@ public:
 
     void setDeviceOptions(const DeviceParams& args);
     void openOutput(const char *filename, const MediaDescription& args);
+    /**
+     * Open the encoder only, without output.
+     * Encoded packets are given to the callback of encode().
+     */
+    void openEncoder(const MediaDescription& args);
     void startIO();
     void setIOContext(const std::unique_ptr<MediaIOHandle> &ioctx);
 
 #ifdef RING_VIDEO
     int encode(VideoFrame &input, bool is_keyframe, int64_t frame_number);
+
+    /* Return a negative value on error */
+    using PacketCallback = std::function<int(AVPacket&)>;
+    int encode(VideoFrame &input, bool is_keyframe, int64_t frame_number,
+               const PacketCallback& cb);
 #endif // RING_VIDEO
 
+    /**
+     * Write a packet encoded by source to the output.
+     * Both encoders must use the same codec and parameters.
+     * ptsOffset is added to the packet timestamps, in the source time base.
+     */
+    int send(const AVPacket& pkt, const MediaEncoder& source, int64_t ptsOffset = 0);
+
     int encode_audio(const AudioBuffer &input);
     int flush();
     std::string print_sdp();
@@ -95,6 +114,7 @@ private:
     void prepareEncoderContext(bool is_video);
     void forcePresetX264();
     void extractProfileLevelID(const std::string &parameters, AVCodecContext *ctx);
+    AVFrame* prepareAudioFrame(int nb_samples, unsigned channels, int sample_rate);
 
     AVCodec *outputEncoder_ = nullptr;
     AVCodecContext *encoderCtx_ = nullptr;
@@ -102,6 +122,11 @@ private:
     AVStream *stream_ = nullptr;
     unsigned sent_samples = 0;
 
+    // reused by encode_audio()
+    AVFrame *audioFrame_ = nullptr;
+    AVPacket *audioPacket_ = nullptr;
+    int audioFrameCapacity_ = 0;
+
 #ifdef RING_VIDEO
     video::VideoScaler scaler_;
     VideoFrame scaledFrame_;
@@ -0,0 +1,250 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "media_stats.h"
+#include "string_utils.h"
+
+#include <cmath>
+#include <ciso646> // fix windows compiler bug
+
+namespace ring {
+
+static constexpr size_t RTP_HEADER_SIZE {12};
+
+// Sequence number jumps considered as a restart of the stream (RFC 3550 A.1)
+static constexpr int MAX_DROPOUT {3000};
+static constexpr int MAX_MISORDER {100};
+
+void
+MediaStreamStats::onRtpSent(size_t len) noexcept
+{
+    packets_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(len, std::memory_order_relaxed);
+}
+
+void
+MediaStreamStats::onRtpReceived(const uint8_t* buf, size_t len,
+                                clock::time_point now) noexcept
+{
+    packets_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(len, std::memory_order_relaxed);
+
+    if (len < RTP_HEADER_SIZE or (buf[0] >> 6) != 2)
+        return;
+
+    const uint16_t seq = (buf[2] << 8) | buf[3];
+    const uint32_t timestamp = (uint32_t(buf[4]) << 24) | (buf[5] << 16)
+                             | (buf[6] << 8) | buf[7];
+
+    bool resync = not seqInit_;
+    if (seqInit_) {
+        const int delta = static_cast<int16_t>(seq - maxSeq_);
+        auto lost = lost_.load(std::memory_order_relaxed);
+        if (delta > 0 and delta < MAX_DROPOUT) {
+            lost += delta - 1;
+            maxSeq_ = seq;
+        } else if (delta < 0 and delta > -MAX_MISORDER) {
+            // late packet, it was accounted as lost
+            if (lost)
+                --lost;
+        } else if (delta != 0) {
+            resync = true;
+        }
+        lost_.store(lost, std::memory_order_relaxed);
+    }
+    if (resync) {
+        seqInit_ = true;
+        maxSeq_ = seq;
+    }
+
+    const auto rate = clockRate_.load(std::memory_order_relaxed);
+    if (not rate)
+        return;
+
+    // Jitter is computed once per timestamp: the packets of a video frame
+    // share the same one
+    if (not resync and timestamp == lastTimestamp_)
+        return;
+
+    const auto arrivalUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        now.time_since_epoch()).count();
+    const double transit = arrivalUs * (rate / 1e6) - timestamp;
+
+    if (not resync) {
+        const double d = std::fabs(transit - lastTransit_);
+        // ignore timestamp discontinuities
+        if (d < rate) {
+            jitter_ += (d - jitter_) / 16.;
+            jitterUs_.store(jitter_ * 1e6 / rate, std::memory_order_relaxed);
+        }
+    }
+    lastTransit_ = transit;
+    lastTimestamp_ = timestamp;
+}
+
+void
+MediaStreamStats::onFrame(clock::duration processTime) noexcept
+{
+    const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(processTime).count();
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    processTimeUs_.fetch_add(us, std::memory_order_relaxed);
+    auto max = processTimeMaxUs_.load(std::memory_order_relaxed);
+    while (us > max and not processTimeMaxUs_.compare_exchange_weak(max, us,
+                                                                    std::memory_order_relaxed))
+        ;
+}
+
+void
+MediaStreamStats::setCodec(const std::string& codec)
+{
+    std::lock_guard<std::mutex> lk(codecMutex_);
+    codec_ = codec;
+}
+
+MediaStreamStats::Snapshot
+MediaStreamStats::getSnapshot() const
+{
+    Snapshot s;
+    {
+        std::lock_guard<std::mutex> lk(codecMutex_);
+        s.codec = codec_;
+    }
+    s.packets = packets_.load(std::memory_order_relaxed);
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.lost = lost_.load(std::memory_order_relaxed);
+    s.jitterUs = jitterUs_.load(std::memory_order_relaxed);
+    s.frames = frames_.load(std::memory_order_relaxed);
+    s.processTimeUs = processTimeUs_.load(std::memory_order_relaxed);
+    s.processTimeMaxUs = processTimeMaxUs_.load(std::memory_order_relaxed);
+    s.queueDepth = queueDepth_.load(std::memory_order_relaxed);
+    s.concealed = concealed_.load(std::memory_order_relaxed);
+    s.discarded = discarded_.load(std::memory_order_relaxed);
+    s.playoutDelayUs = playoutDelayUs_.load(std::memory_order_relaxed);
+    s.width = width_.load(std::memory_order_relaxed);
+    s.height = height_.load(std::memory_order_relaxed);
+    return s;
+}
+
+MediaStatsRegistry&
+MediaStatsRegistry::instance()
+{
+    static MediaStatsRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<CallMediaStats>
+MediaStatsRegistry::get(const std::string& callId)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto it = calls_.begin(); it != calls_.end();) {
+        if (it->second.expired())
+            it = calls_.erase(it);
+        else
+            ++it;
+    }
+
+    auto& entry = calls_[callId];
+    auto stats = entry.lock();
+    if (not stats) {
+        stats = std::make_shared<CallMediaStats>();
+        entry = stats;
+    }
+    return stats;
+}
+
+std::shared_ptr<CallMediaStats>
+MediaStatsRegistry::find(const std::string& callId) const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = calls_.find(callId);
+    return it != calls_.end() ? it->second.lock() : nullptr;
+}
+
+std::vector<std::pair<std::string, std::shared_ptr<CallMediaStats>>>
+MediaStatsRegistry::getCalls(const std::vector<std::string>& callIds) const
+{
+    std::vector<std::pair<std::string, std::shared_ptr<CallMediaStats>>> ret;
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (callIds.empty()) {
+        ret.reserve(calls_.size());
+        for (auto it = calls_.begin(); it != calls_.end();) {
+            if (auto stats = it->second.lock()) {
+                ret.emplace_back(it->first, std::move(stats));
+                ++it;
+            } else
+                it = calls_.erase(it);
+        }
+    } else {
+        for (const auto& id : callIds) {
+            auto it = calls_.find(id);
+            if (it == calls_.end())
+                continue;
+            if (auto stats = it->second.lock())
+                ret.emplace_back(id, std::move(stats));
+        }
+    }
+    return ret;
+}
+
+static void
+addStream(std::map<std::string, std::string>& out, const std::string& prefix,
+          const MediaStreamStats& stream)
+{
+    const auto s = stream.getSnapshot();
+    if (s.codec.empty() and not s.packets and not s.frames)
+        return;
+    out[prefix + "codec"] = s.codec;
+    out[prefix + "packets"] = ring::to_string(s.packets);
+    out[prefix + "bytes"] = ring::to_string(s.bytes);
+    out[prefix + "lost"] = ring::to_string(s.lost);
+    out[prefix + "jitterUs"] = ring::to_string(s.jitterUs);
+    out[prefix + "frames"] = ring::to_string(s.frames);
+    out[prefix + "processTimeUs"] = ring::to_string(s.processTimeUs);
+    out[prefix + "processTimeMaxUs"] = ring::to_string(s.processTimeMaxUs);
+    out[prefix + "queueDepth"] = ring::to_string(s.queueDepth);
+    if (s.playoutDelayUs) {
+        out[prefix + "concealed"] = ring::to_string(s.concealed);
+        out[prefix + "discarded"] = ring::to_string(s.discarded);
+        out[prefix + "playoutDelayUs"] = ring::to_string(s.playoutDelayUs);
+    }
+    if (s.width or s.height) {
+        out[prefix + "width"] = ring::to_string(s.width);
+        out[prefix + "height"] = ring::to_string(s.height);
+    }
+}
+
+std::vector<std::map<std::string, std::string>>
+MediaStatsRegistry::getStats(const std::vector<std::string>& callIds) const
+{
+    // formatted out of the registry lock
+    const auto calls = getCalls(callIds);
+    std::vector<std::map<std::string, std::string>> ret;
+    ret.reserve(calls.size());
+    for (const auto& call : calls) {
+        std::map<std::string, std::string> m;
+        m["callID"] = call.first;
+        addStream(m, "audio.send.", call.second->audioSend);
+        addStream(m, "audio.receive.", call.second->audioReceive);
+        addStream(m, "video.send.", call.second->videoSend);
+        addStream(m, "video.receive.", call.second->videoReceive);
+        ret.emplace_back(std::move(m));
+    }
+    return ret;
+}
+
+} // namespace ring
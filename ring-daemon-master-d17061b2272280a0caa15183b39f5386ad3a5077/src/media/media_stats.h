@@ -0,0 +1,190 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ring {
+
+/**
+ * Counters of one direction of a media stream.
+ *
+ * Media threads update the counters without locking, they are only read
+ * when a client asks for a snapshot.
+ */
+class MediaStreamStats {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        struct Snapshot {
+            std::string codec;
+            uint64_t packets;
+            uint64_t bytes;
+            /** Receive only: packets missing from the RTP sequence */
+            uint64_t lost;
+            /** Receive only: RFC 3550 interarrival jitter */
+            uint64_t jitterUs;
+            /** Frames decoded or encoded */
+            uint64_t frames;
+            uint64_t processTimeUs;
+            uint64_t processTimeMaxUs;
+            /** Packets waiting to be demuxed, on the last read */
+            unsigned queueDepth;
+            /** Receive only: frames concealed by the jitter buffer */
+            uint64_t concealed;
+            /** Receive only: packets dropped by the jitter buffer (late, duplicated) */
+            uint64_t discarded;
+            /** Receive only: playout delay of the jitter buffer */
+            uint64_t playoutDelayUs;
+            unsigned width;
+            unsigned height;
+        };
+
+        MediaStreamStats() = default;
+
+        /** Account an RTP packet sent */
+        void onRtpSent(size_t len) noexcept;
+
+        /**
+         * Account an RTP packet received, losses and jitter are computed
+         * from its header. Must be called by a single thread.
+         */
+        void onRtpReceived(const uint8_t* buf, size_t len,
+                           clock::time_point now = clock::now()) noexcept;
+
+        /** Account a frame decoded or encoded in processTime */
+        void onFrame(clock::duration processTime) noexcept;
+
+        /** Size of the video frames, 0 for audio */
+        void setFrameSize(unsigned width, unsigned height) noexcept {
+            width_.store(width, std::memory_order_relaxed);
+            height_.store(height, std::memory_order_relaxed);
+        }
+
+        void setQueueDepth(unsigned depth) noexcept {
+            queueDepth_.store(depth, std::memory_order_relaxed);
+        }
+
+        void onConcealed() noexcept {
+            concealed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void setJitterBuffer(uint64_t discarded, uint64_t playoutDelayUs) noexcept {
+            discarded_.store(discarded, std::memory_order_relaxed);
+            playoutDelayUs_.store(playoutDelayUs, std::memory_order_relaxed);
+        }
+
+        /** RTP timestamp clock rate, needed for the jitter */
+        void setClockRate(unsigned rate) noexcept {
+            clockRate_.store(rate, std::memory_order_relaxed);
+        }
+
+        /** Called when the codec is (re)opened, not per frame */
+        void setCodec(const std::string& codec);
+
+        Snapshot getSnapshot() const;
+
+    private:
+        NON_COPYABLE(MediaStreamStats);
+
+        std::atomic<uint64_t> packets_ {0};
+        std::atomic<uint64_t> bytes_ {0};
+        std::atomic<uint64_t> lost_ {0};
+        std::atomic<uint64_t> jitterUs_ {0};
+        std::atomic<uint64_t> frames_ {0};
+        std::atomic<uint64_t> processTimeUs_ {0};
+        std::atomic<uint64_t> processTimeMaxUs_ {0};
+        std::atomic<unsigned> queueDepth_ {0};
+        std::atomic<uint64_t> concealed_ {0};
+        std::atomic<uint64_t> discarded_ {0};
+        std::atomic<uint64_t> playoutDelayUs_ {0};
+        std::atomic<unsigned> width_ {0};
+        std::atomic<unsigned> height_ {0};
+        std::atomic<unsigned> clockRate_ {0};
+
+        mutable std::mutex codecMutex_ {};
+        std::string codec_ {};
+
+        /* Receiving thread only */
+        bool seqInit_ {false};
+        uint16_t maxSeq_ {0};
+        uint32_t lastTimestamp_ {0};
+        double lastTransit_ {0};
+        double jitter_ {0}; // in timestamp units
+};
+
+/**
+ * Media counters of a call, shared by its RTP sessions.
+ */
+struct CallMediaStats {
+    MediaStreamStats audioSend;
+    MediaStreamStats audioReceive;
+    MediaStreamStats videoSend;
+    MediaStreamStats videoReceive;
+};
+
+/**
+ * Stats of the ongoing calls.
+ *
+ * The registry lock is only taken when a call starts its media and when
+ * a snapshot is taken. Entries are removed once the last RTP session of
+ * the call releases its stats.
+ */
+class MediaStatsRegistry {
+    public:
+        static MediaStatsRegistry& instance();
+
+        /** Return the stats of callId, created if needed */
+        std::shared_ptr<CallMediaStats> get(const std::string& callId);
+
+        /** Return the stats of callId, or null */
+        std::shared_ptr<CallMediaStats> find(const std::string& callId) const;
+
+        /**
+         * Return the stats of the given calls, or of all the calls
+         * if callIds is empty. Calls without media are skipped.
+         */
+        std::vector<std::pair<std::string, std::shared_ptr<CallMediaStats>>>
+        getCalls(const std::vector<std::string>& callIds = {}) const;
+
+        /**
+         * Same as getCalls(), formatted as maps for the clients.
+         * See DRing::getCallMediaStats() for the keys.
+         */
+        std::vector<std::map<std::string, std::string>>
+        getStats(const std::vector<std::string>& callIds) const;
+
+    private:
+        NON_COPYABLE(MediaStatsRegistry);
+        MediaStatsRegistry() = default;
+
+        mutable std::mutex mutex_ {};
+        mutable std::map<std::string, std::weak_ptr<CallMediaStats>> calls_ {};
+};
+
+} // namespace ring
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "packet_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ring {
+
+PacketRing::PacketRing(size_t depth, size_t slotSize)
+    : depth_(depth)
+    , slotSize_(slotSize)
+    , slab_(new uint8_t[depth * slotSize])
+    , sizes_(new size_t[depth])
+{}
+
+bool
+PacketRing::push(const uint8_t* data, size_t size)
+{
+    if (size > slotSize_) {
+        oversized_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const auto h = head_.load(std::memory_order_relaxed);
+    auto t = tail_.load(std::memory_order_acquire);
+
+    // Full: drop the oldest packet. If the CAS fails, the reader just
+    // took it and there is room anyway. In both cases the reader is done
+    // with the slot we are about to write.
+    if (h - t >= depth_ and tail_.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel))
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+
+    std::memcpy(slot(h), data, size);
+    sizes_[h % depth_] = size;
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+int
+PacketRing::pop(void* buf, size_t buf_size)
+{
+    while (true) {
+        auto t = tail_.load(std::memory_order_acquire);
+        const auto h = head_.load(std::memory_order_acquire);
+        if (t == h)
+            return -1;
+
+        const size_t len = std::min(sizes_[t % depth_], buf_size);
+        std::memcpy(buf, slot(t), len);
+
+        // The writer moves the tail before reusing a slot: if it did
+        // while we were copying, the packet was dropped, take the next one.
+        if (tail_.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel))
+            return len;
+    }
+}
+
+bool
+PacketRing::empty() const
+{
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
+
+size_t
+PacketRing::size() const
+{
+    const auto tail = tail_.load(std::memory_order_acquire);
+    const auto head = head_.load(std::memory_order_acquire);
+    return head > tail ? head - tail : 0;
+}
+
+PacketRing::Stats
+PacketRing::getStats() const
+{
+    return {
+        head_.load(std::memory_order_relaxed),
+        dropped_.load(std::memory_order_relaxed),
+        oversized_.load(std::memory_order_relaxed)
+    };
+}
+
+} // namespace ring
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace ring {
+
+/**
+ * Fixed-size ring of packets, preallocated in a single slab.
+ *
+ * One thread pushes packets (the receiving callback) and one thread pops
+ * them; none of them takes a lock. When the ring is full, the oldest
+ * packet is dropped to make room for the new one.
+ * Each packet is copied once in and once out, straight to the reader buffer.
+ */
+class PacketRing {
+    public:
+        struct Stats {
+            uint64_t received;
+            /** Packets dropped because the reader was too slow */
+            uint64_t dropped;
+            /** Packets dropped because they didn't fit in a slot */
+            uint64_t oversized;
+        };
+
+        /**
+         * @param depth number of packets kept
+         * @param slotSize maximum packet size in bytes
+         */
+        PacketRing(size_t depth, size_t slotSize);
+
+        /**
+         * Writer side: copy a packet in the ring, dropping the oldest
+         * one if needed. Return false if the packet is too large.
+         */
+        bool push(const uint8_t* data, size_t size);
+
+        /**
+         * Reader side: copy the oldest packet to buf and remove it.
+         * Packet is truncated to buf_size bytes.
+         * Return the number of bytes copied, or -1 if the ring is empty.
+         */
+        int pop(void* buf, size_t buf_size);
+
+        bool empty() const;
+
+        /** Packets waiting to be popped */
+        size_t size() const;
+
+        Stats getStats() const;
+
+    private:
+        NON_COPYABLE(PacketRing);
+
+        uint8_t* slot(uint64_t index) const {
+            return slab_.get() + (index % depth_) * slotSize_;
+        }
+
+        const size_t depth_;
+        const size_t slotSize_;
+        std::unique_ptr<uint8_t[]> slab_;
+        std::unique_ptr<size_t[]> sizes_;
+
+        /** Total packets pushed, only written by the writer */
+        std::atomic<uint64_t> head_ {0};
+
+        /** Total packets popped or dropped, moved by both sides */
+        std::atomic<uint64_t> tail_ {0};
+
+        std::atomic<uint64_t> dropped_ {0};
+        std::atomic<uint64_t> oversized_ {0};
+};
+
+} // namespace ring
@@ -0,0 +1,151 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "rtcp_receiver_report.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ciso646> // fix windows compiler bug
+
+namespace ring {
+
+constexpr std::chrono::seconds RtcpReceiverReport::INTERVAL;
+
+static constexpr uint8_t RTCP_SR {200};
+static constexpr uint8_t RTCP_RR {201};
+static constexpr uint8_t RTCP_SDES {202};
+static constexpr uint8_t SDES_CNAME {1};
+
+static constexpr size_t RR_SIZE {8 + 24};
+static constexpr size_t SR_MIN_SIZE {28};
+
+static uint32_t
+read32(const uint8_t* p)
+{
+    return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint8_t*
+write32(uint8_t* p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+RtcpReceiverReport::RtcpReceiverReport(const std::string& cname, clock::time_point now)
+    : cname_(cname.substr(0, 255))
+    , rand_(std::random_device{}())
+{
+    // The first report is sent after half the interval (RFC 3550 6.2)
+    schedule(now, .5);
+}
+
+void
+RtcpReceiverReport::schedule(clock::time_point now, double factor)
+{
+    std::uniform_real_distribution<double> dist(.5, 1.5);
+    next_ = now + std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(INTERVAL) * factor * dist(rand_));
+}
+
+void
+RtcpReceiverReport::onRtcp(const uint8_t* buf, size_t len, clock::time_point arrival)
+{
+    // Walk the compound packet
+    while (len >= 4 and (buf[0] >> 6) == 2) {
+        const size_t size = 4 * (((buf[2] << 8) | buf[3]) + 1);
+        if (size > len)
+            break;
+        if (buf[1] == RTCP_SR and size >= SR_MIN_SIZE) {
+            srSsrc_ = read32(buf + 4);
+            // Middle 32 bits of the NTP timestamp
+            lsr_ = (read32(buf + 8) << 16) | (read32(buf + 12) >> 16);
+            srArrival_ = arrival;
+        }
+        buf += size;
+        len -= size;
+    }
+}
+
+size_t
+RtcpReceiverReport::build(const RtpJitterBuffer::Reception& reception, uint8_t* buf, size_t size,
+                          clock::time_point now)
+{
+    const size_t sdesSize = (8 + 2 + cname_.size() + 1 + 3) & ~size_t(3);
+    if (size < RR_SIZE + sdesSize)
+        return 0;
+
+    if (reception.ssrc != ssrc_) {
+        ssrc_ = reception.ssrc;
+        expectedPrior_ = 0;
+        receivedPrior_ = 0;
+    }
+
+    // RFC 3550 A.3
+    const int64_t expected = reception.maxSeq - reception.baseSeq + 1;
+    const int64_t lost = std::max<int64_t>(std::min<int64_t>(expected - reception.received, 0x7fffff),
+                                           -0x800000);
+    const int64_t expectedInterval = expected - expectedPrior_;
+    const int64_t lostInterval = expectedInterval - static_cast<int64_t>(reception.received - receivedPrior_);
+    expectedPrior_ = expected;
+    receivedPrior_ = reception.received;
+    const uint32_t fraction = expectedInterval <= 0 or lostInterval <= 0
+        ? 0 : std::min<int64_t>((lostInterval << 8) / expectedInterval, 255);
+
+    uint32_t lsr = 0;
+    uint32_t dlsr = 0;
+    if (srSsrc_ == reception.ssrc and srArrival_ != clock::time_point {}) {
+        lsr = lsr_;
+        // In units of 1/65536 second
+        dlsr = std::chrono::duration_cast<std::chrono::microseconds>(now - srArrival_).count() * 65536 / 1000000;
+    }
+
+    const uint32_t ssrc = reception.ssrc + 1;
+    auto p = buf;
+
+    // Receiver report with one report block
+    *p++ = 0x81;
+    *p++ = RTCP_RR;
+    *p++ = 0;
+    *p++ = RR_SIZE / 4 - 1;
+    p = write32(p, ssrc);
+    p = write32(p, reception.ssrc);
+    p = write32(p, (fraction << 24) | (static_cast<uint32_t>(lost) & 0xffffff));
+    p = write32(p, static_cast<uint32_t>(reception.maxSeq));
+    p = write32(p, reception.jitter);
+    p = write32(p, lsr);
+    p = write32(p, dlsr);
+
+    // Source description with the CNAME, ended by a null item and padded
+    std::memset(p, 0, sdesSize);
+    p[0] = 0x81;
+    p[1] = RTCP_SDES;
+    p[3] = sdesSize / 4 - 1;
+    write32(p + 4, ssrc);
+    p[8] = SDES_CNAME;
+    p[9] = cname_.size();
+    std::memcpy(p + 10, cname_.data(), cname_.size());
+
+    schedule(now, 1.);
+    return RR_SIZE + sdesSize;
+}
+
+} // namespace ring
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "rtp_jitter_buffer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace ring {
+
+/**
+ * RTCP receiver reports of a stream received without the libav demuxer.
+ *
+ * Builds RR + SDES compound packets (RFC 3550 6.4.2) from the reception
+ * counters of a RtpJitterBuffer, and keeps the last sender report of the
+ * source for the LSR and DLSR fields. Like the libav demuxer, the reporter
+ * SSRC is the source SSRC plus one.
+ *
+ * Not thread-safe: used by the receiving thread only.
+ */
+class RtcpReceiverReport {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /** Deterministic reporting interval, randomized by 0.5 to 1.5 (RFC 3550 6.3.1) */
+        static constexpr std::chrono::seconds INTERVAL {5};
+
+        explicit RtcpReceiverReport(const std::string& cname, clock::time_point now = clock::now());
+
+        /** Parse a received RTCP compound packet for a sender report */
+        void onRtcp(const uint8_t* buf, size_t len, clock::time_point arrival = clock::now());
+
+        bool due(clock::time_point now = clock::now()) const {
+            return now >= next_;
+        }
+
+        /**
+         * Write the report of reception into buf and schedule the next one.
+         * Return the packet size, or 0 if size is too small.
+         */
+        size_t build(const RtpJitterBuffer::Reception& reception, uint8_t* buf, size_t size,
+                     clock::time_point now = clock::now());
+
+    private:
+        void schedule(clock::time_point now, double factor);
+
+        const std::string cname_;
+        std::mt19937 rand_;
+        clock::time_point next_;
+
+        // Counters at the previous report, for the fraction lost
+        uint32_t ssrc_ {0};
+        int64_t expectedPrior_ {0};
+        uint64_t receivedPrior_ {0};
+
+        // Last sender report received
+        uint32_t srSsrc_ {0};
+        uint32_t lsr_ {0};
+        clock::time_point srArrival_ {};
+};
+
+} // namespace ring
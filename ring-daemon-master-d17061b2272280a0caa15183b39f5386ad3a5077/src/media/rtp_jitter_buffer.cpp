@@ -0,0 +1,319 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "rtp_jitter_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ciso646> // fix windows compiler bug
+
+namespace ring {
+
+using std::chrono::microseconds;
+
+constexpr RtpJitterBuffer::Config RtpJitterBuffer::DEFAULT_CONFIG;
+
+static constexpr size_t RTP_HEADER_SIZE {12};
+
+// Sequence number jumps considered as a restart of the stream (RFC 3550 A.1)
+static constexpr int MAX_DROPOUT {3000};
+static constexpr int MAX_MISORDER {100};
+
+// Target delay, in multiples of the interarrival jitter
+static constexpr unsigned JITTER_FACTOR {4};
+
+// Peak delay decreases by 1/PEAK_DECAY per packet
+static constexpr int64_t PEAK_DECAY {512};
+
+// Period of the arrival offset minimum, to follow clock drifts
+static constexpr auto BASE_WINDOW = std::chrono::seconds(2);
+
+RtpJitterBuffer::RtpJitterBuffer(unsigned clockRate, const Config& config)
+    : clockRate_(clockRate)
+    , config_(config)
+    , targetDelay_(std::min(2 * config.minDelay, config.maxDelay))
+    , delay_(targetDelay_)
+{}
+
+microseconds
+RtpJitterBuffer::toDuration(int64_t timestamp) const
+{
+    return microseconds(timestamp * 1000000 / clockRate_);
+}
+
+RtpJitterBuffer::clock::time_point
+RtpJitterBuffer::playoutTime(int64_t timestamp) const
+{
+    return base_ + toDuration(timestamp) + delay_;
+}
+
+void
+RtpJitterBuffer::recycle(std::vector<uint8_t>&& payload)
+{
+    if (freeBuffers_.size() < config_.maxPackets)
+        freeBuffers_.emplace_back(std::move(payload));
+}
+
+void
+RtpJitterBuffer::resync(uint32_t ssrc, uint16_t seq, uint32_t timestamp)
+{
+    if (started_)
+        ++stats_.resyncs;
+    for (auto& p : packets_)
+        recycle(std::move(p.second.payload));
+    packets_.clear();
+
+    started_ = true;
+    ssrc_ = ssrc;
+    maxSeq_ = seq;
+    maxExtSeq_ = seq;
+    baseExtSeq_ = seq;
+    sourceReceived_ = 0;
+    nextSeq_ = seq;
+    lastTimestamp_ = timestamp;
+    lastExtTimestamp_ = 0;
+    frameDuration_ = 0;
+    baseSet_ = false;
+}
+
+void
+RtpJitterBuffer::reset()
+{
+    for (auto& p : packets_)
+        recycle(std::move(p.second.payload));
+    packets_.clear();
+    started_ = false;
+    baseSet_ = false;
+}
+
+void
+RtpJitterBuffer::updateDelay(int64_t timestamp, clock::time_point arrival)
+{
+    const auto offset = arrival - toDuration(timestamp);
+    const double arrivalTs = std::chrono::duration<double>(arrival.time_since_epoch()).count()
+                           * clockRate_;
+    const double transit = arrivalTs - timestamp;
+
+    if (not baseSet_) {
+        baseSet_ = true;
+        base_ = windowBase_ = offset;
+        windowEnd_ = arrival + BASE_WINDOW;
+    } else {
+        // RFC 3550 interarrival jitter
+        jitter_ += (std::fabs(transit - transit_) - jitter_) / 16.;
+
+        base_ = std::min(base_, offset);
+        windowBase_ = std::min(windowBase_, offset);
+        if (arrival >= windowEnd_) {
+            base_ = windowBase_;
+            windowBase_ = offset;
+            windowEnd_ = arrival + BASE_WINDOW;
+        }
+    }
+    transit_ = transit;
+
+    peakDelay_ -= peakDelay_ / PEAK_DECAY;
+    const auto jitterDelay = microseconds(static_cast<int64_t>(JITTER_FACTOR * jitter_ * 1e6 / clockRate_));
+    targetDelay_ = std::min(std::max({jitterDelay, peakDelay_, config_.minDelay}), config_.maxDelay);
+}
+
+bool
+RtpJitterBuffer::push(const uint8_t* rtp, size_t len, clock::time_point arrival)
+{
+    if (len < RTP_HEADER_SIZE or (rtp[0] >> 6) != 2) {
+        ++stats_.invalid;
+        return false;
+    }
+
+    // Payload boundaries
+    size_t begin = RTP_HEADER_SIZE + 4 * (rtp[0] & 0x0f);
+    if (rtp[0] & 0x10) {
+        if (begin + 4 > len) {
+            ++stats_.invalid;
+            return false;
+        }
+        begin += 4 + 4 * ((rtp[begin + 2] << 8) | rtp[begin + 3]);
+    }
+    size_t end = len;
+    if (rtp[0] & 0x20)
+        end -= std::min<size_t>(rtp[len - 1], len);
+    if (begin > end) {
+        ++stats_.invalid;
+        return false;
+    }
+
+    const uint8_t payloadType = rtp[1] & 0x7f;
+    const uint16_t seq = (rtp[2] << 8) | rtp[3];
+    const uint32_t timestamp = (uint32_t(rtp[4]) << 24) | (rtp[5] << 16) | (rtp[6] << 8) | rtp[7];
+    const uint32_t ssrc = (uint32_t(rtp[8]) << 24) | (rtp[9] << 16) | (rtp[10] << 8) | rtp[11];
+
+    ++stats_.received;
+
+    if (not started_ or ssrc != ssrc_)
+        resync(ssrc, seq, timestamp);
+
+    int delta = static_cast<int16_t>(seq - maxSeq_);
+    if (delta > MAX_DROPOUT or delta < -MAX_MISORDER) {
+        resync(ssrc, seq, timestamp);
+        delta = 0;
+    }
+
+    ++sourceReceived_;
+
+    const int64_t extSeq = maxExtSeq_ + delta;
+    const int64_t extTimestamp = lastExtTimestamp_ + static_cast<int32_t>(timestamp - lastTimestamp_);
+
+    if (delta > 0) {
+        const auto tsDelta = extTimestamp - lastExtTimestamp_;
+        if (delta == 1 and tsDelta > 0 and tsDelta < clockRate_)
+            frameDuration_ = tsDelta;
+        maxSeq_ = seq;
+        maxExtSeq_ = extSeq;
+        lastTimestamp_ = timestamp;
+        lastExtTimestamp_ = extTimestamp;
+    }
+
+    if (extSeq < nextSeq_) {
+        // already played or concealed: next packets need more delay
+        ++stats_.late;
+        if (baseSet_) {
+            const auto lateness = std::chrono::duration_cast<microseconds>(arrival - playoutTime(extTimestamp));
+            peakDelay_ = std::max(peakDelay_, std::min(delay_ + lateness, config_.maxDelay));
+        }
+        return false;
+    }
+
+    if (packets_.count(extSeq)) {
+        ++stats_.duplicated;
+        return false;
+    }
+
+    if (delta < 0)
+        ++stats_.reordered;
+
+    updateDelay(extTimestamp, arrival);
+
+    while (packets_.size() >= config_.maxPackets) {
+        auto oldest = packets_.begin();
+        nextSeq_ = std::max(nextSeq_, oldest->first + 1);
+        recycle(std::move(oldest->second.payload));
+        packets_.erase(oldest);
+        ++stats_.overflowed;
+    }
+
+    std::vector<uint8_t> payload;
+    if (not freeBuffers_.empty()) {
+        payload = std::move(freeBuffers_.back());
+        freeBuffers_.pop_back();
+    }
+    payload.assign(rtp + begin, rtp + end);
+    packets_.emplace(extSeq, Entry {extTimestamp, seq, payloadType, std::move(payload)});
+    return true;
+}
+
+RtpJitterBuffer::Status
+RtpJitterBuffer::pop(Packet& pkt, clock::time_point now)
+{
+    while (not packets_.empty()) {
+        auto it = packets_.begin();
+        auto& entry = it->second;
+        const auto frame = toDuration(frameDuration_);
+
+        if (it->first != nextSeq_) {
+            // Missing packets would have been played before this one
+            const auto missing = it->first - nextSeq_;
+            const auto playout = playoutTime(entry.timestamp - missing * frameDuration_);
+            if (now < playout)
+                return Status::Empty;
+            ++nextSeq_;
+            ++stats_.lost;
+            // Too late to be concealed, skip to the next one
+            if (frameDuration_ and now - playout > delay_)
+                continue;
+            return Status::Lost;
+        }
+
+        if (now < playoutTime(entry.timestamp))
+            return Status::Empty;
+
+        if (frameDuration_) {
+            // Increase the delay by one concealed frame
+            if (targetDelay_ >= delay_ + frame) {
+                delay_ += frame;
+                ++stats_.expanded;
+                return Status::Lost;
+            }
+            // Decrease it by dropping a packet
+            if (delay_ >= targetDelay_ + 2 * frame and packets_.size() > 1) {
+                delay_ -= frame;
+                ++stats_.accelerated;
+                ++nextSeq_;
+                recycle(std::move(entry.payload));
+                packets_.erase(it);
+                continue;
+            }
+        }
+
+        pkt.seq = entry.seq;
+        pkt.timestamp = static_cast<uint32_t>(lastTimestamp_ + (entry.timestamp - lastExtTimestamp_));
+        pkt.payloadType = entry.payloadType;
+        pkt.payload.swap(entry.payload);
+        recycle(std::move(entry.payload));
+        packets_.erase(it);
+        ++nextSeq_;
+        ++stats_.played;
+        return Status::Packet;
+    }
+    return Status::Empty;
+}
+
+RtpJitterBuffer::clock::time_point
+RtpJitterBuffer::nextPlayout() const
+{
+    if (packets_.empty())
+        return clock::time_point::max();
+    const auto& first = *packets_.begin();
+    const auto missing = first.first - nextSeq_;
+    return playoutTime(first.second.timestamp - missing * frameDuration_);
+}
+
+RtpJitterBuffer::Stats
+RtpJitterBuffer::getStats() const
+{
+    auto stats = stats_;
+    stats.jitterUs = jitter_ * 1e6 / clockRate_;
+    stats.targetDelayUs = targetDelay_.count();
+    stats.delayUs = delay_.count();
+    stats.queued = packets_.size();
+    return stats;
+}
+
+bool
+RtpJitterBuffer::getReception(Reception& reception) const
+{
+    if (not started_)
+        return false;
+    reception.ssrc = ssrc_;
+    reception.baseSeq = baseExtSeq_;
+    reception.maxSeq = maxExtSeq_;
+    reception.received = sourceReceived_;
+    reception.jitter = static_cast<uint32_t>(jitter_);
+    return true;
+}
+
+} // namespace ring
@@ -0,0 +1,201 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace ring {
+
+/**
+ * Adaptive playout buffer of an RTP stream.
+ *
+ * Packets are reordered by sequence number and played at their RTP
+ * timestamp plus a playout delay. The delay follows the measured
+ * interarrival jitter (RFC 3550), between minDelay and maxDelay: it grows
+ * quickly when packets would be late and shrinks slowly.
+ * A missing packet is reported as lost once a later packet is buffered and
+ * its playout time is past, so that the caller can conceal it.
+ *
+ * Not thread-safe: packets are pushed and popped by the receiving thread.
+ */
+class RtpJitterBuffer {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        struct Config {
+            std::chrono::microseconds minDelay;
+            std::chrono::microseconds maxDelay;
+            /** Packets kept at most, the oldest ones are dropped */
+            size_t maxPackets;
+        };
+
+        static constexpr Config DEFAULT_CONFIG {
+            std::chrono::milliseconds(20),
+            std::chrono::milliseconds(300),
+            64
+        };
+
+        struct Stats {
+            uint64_t received;
+            /** Packets returned by pop() */
+            uint64_t played;
+            /** Packets reported as lost by pop() */
+            uint64_t lost;
+            /** Packets received after their playout time */
+            uint64_t late;
+            uint64_t duplicated;
+            /** Packets received out of order, in time */
+            uint64_t reordered;
+            /** Packets dropped because the buffer was full */
+            uint64_t overflowed;
+            /** Packets without a valid RTP header */
+            uint64_t invalid;
+            /** Restarts on a new SSRC or a sequence discontinuity */
+            uint64_t resyncs;
+            /** Frames to conceal inserted to increase the delay */
+            uint64_t expanded;
+            /** Packets dropped to decrease the delay */
+            uint64_t accelerated;
+            uint64_t jitterUs;
+            uint64_t targetDelayUs;
+            uint64_t delayUs;
+            size_t queued;
+        };
+
+        /** Reception from the current source, for RTCP reports (RFC 3550 6.4.1) */
+        struct Reception {
+            uint32_t ssrc;
+            /** Extended sequence numbers of the first and highest packets */
+            int64_t baseSeq;
+            int64_t maxSeq;
+            /** Packets received from the source, late and duplicated ones included */
+            uint64_t received;
+            /** Interarrival jitter, in timestamp units */
+            uint32_t jitter;
+        };
+
+        struct Packet {
+            uint16_t seq;
+            uint32_t timestamp;
+            uint8_t payloadType;
+            /** RTP payload, without header nor padding */
+            std::vector<uint8_t> payload;
+        };
+
+        enum class Status {
+            /** The next packet is returned */
+            Packet,
+            /**
+             * One frame should be concealed: the next packet is missing,
+             * or the delay is increased
+             */
+            Lost,
+            /** Nothing to play before nextPlayout() */
+            Empty
+        };
+
+        /**
+         * @param clockRate RTP timestamp clock rate
+         */
+        explicit RtpJitterBuffer(unsigned clockRate, const Config& config = DEFAULT_CONFIG);
+
+        /**
+         * Add a received RTP packet, header included.
+         * Return false if the packet was dropped (late, duplicated, invalid).
+         */
+        bool push(const uint8_t* rtp, size_t len, clock::time_point arrival = clock::now());
+
+        /**
+         * Return the next packet of the sequence in pkt if its playout
+         * time is reached, or report it as lost.
+         * The payload buffer of pkt is recycled by the next push().
+         */
+        Status pop(Packet& pkt, clock::time_point now = clock::now());
+
+        /**
+         * Time when pop() may return something else than Empty,
+         * clock::time_point::max() if the buffer is empty.
+         */
+        clock::time_point nextPlayout() const;
+
+        Stats getStats() const;
+
+        /** Return false if no packet was received since the last reset() */
+        bool getReception(Reception& reception) const;
+
+        /** Drop all the packets and restart on the next one */
+        void reset();
+
+    private:
+        NON_COPYABLE(RtpJitterBuffer);
+
+        struct Entry {
+            int64_t timestamp; // unwrapped
+            uint16_t seq;
+            uint8_t payloadType;
+            std::vector<uint8_t> payload;
+        };
+
+        void resync(uint32_t ssrc, uint16_t seq, uint32_t timestamp);
+        void updateDelay(int64_t timestamp, clock::time_point arrival);
+        std::chrono::microseconds toDuration(int64_t timestamp) const;
+        clock::time_point playoutTime(int64_t timestamp) const;
+        void recycle(std::vector<uint8_t>&& payload);
+
+        const unsigned clockRate_;
+        const Config config_;
+
+        // by unwrapped sequence number
+        std::map<int64_t, Entry> packets_ {};
+        std::vector<std::vector<uint8_t>> freeBuffers_ {};
+
+        bool started_ {false};
+        uint32_t ssrc_ {0};
+        uint16_t maxSeq_ {0};
+        int64_t maxExtSeq_ {0};
+        int64_t baseExtSeq_ {0};
+        uint64_t sourceReceived_ {0};
+        uint32_t lastTimestamp_ {0};
+        int64_t lastExtTimestamp_ {0};
+        int64_t nextSeq_ {0};
+        /** Timestamp units between two packets */
+        int64_t frameDuration_ {0};
+
+        // Playout time of timestamp t is base_ + t / clockRate_ + delay_,
+        // base_ being the smallest arrival offset seen recently
+        bool baseSet_ {false};
+        clock::time_point base_ {};
+        clock::time_point windowBase_ {};
+        clock::time_point windowEnd_ {};
+        double transit_ {0};
+        double jitter_ {0}; // in timestamp units
+        /** Delay needed by the last late packets, decaying */
+        std::chrono::microseconds peakDelay_ {0};
+        std::chrono::microseconds targetDelay_;
+        std::chrono::microseconds delay_;
+
+        Stats stats_ {};
+};
+
+} // namespace ring
@@ -22,6 +22,7 @@
 #pragma once
 
 #include "socket_pair.h"
+#include "media_stats.h"
 #include "sip/sip_utils.h"
 #include "media/media_codec.h"
 
@@ -35,7 +36,9 @@ class IceSocket;
 
 class RtpSession {
 public:
-    RtpSession(const std::string &callID) : callID_(callID) {}
+    RtpSession(const std::string &callID)
+        : stats_(MediaStatsRegistry::instance().get(callID))
+        , callID_(callID) {}
     virtual ~RtpSession() {};
 
     virtual void start(std::unique_ptr<IceSocket> rtp_sock,
@@ -57,6 +60,8 @@ public:
 
 protected:
     std::recursive_mutex mutex_;
+    // MUST outlive socketPair_
+    std::shared_ptr<CallMediaStats> stats_;
     std::unique_ptr<SocketPair> socketPair_;
     const std::string callID_;
 
@@ -24,6 +24,7 @@
 #include "socket_pair.h"
 #include "ice_socket.h"
 #include "libav_utils.h"
+#include "media_stats.h"
 #include "logger.h"
 #include "security/memory.h"
 
@@ -37,6 +38,7 @@ extern "C" {
 }
 
 #include <cstring>
+#include <cinttypes>
 #include <stdexcept>
 #include <unistd.h>
 #include <sys/types.h>
@@ -61,6 +63,7 @@ namespace ring {
 
 static constexpr int NET_POLL_TIMEOUT = 100; /* poll() timeout in ms */
 static constexpr int RTP_MAX_PACKET_LENGTH = 2048;
+static constexpr std::chrono::seconds OVERSIZED_LOG_PERIOD {10};
 static constexpr auto UDP_HEADER_SIZE = 8;
 static constexpr auto SRTP_OVERHEAD = 10;
 
@@ -111,6 +114,97 @@ ff_network_wait_fd(int fd)
     return ret < 0 ? errno : p.revents & (POLLOUT | POLLERR | POLLHUP) ? 0 : -EAGAIN;
 }
 
+#ifdef HAVE_RECVMMSG
+/**
+ * Datagrams read from a socket with one recvmmsg() call,
+ * then handed one by one to the demuxer.
+ */
+class RecvBatch {
+public:
+    RecvBatch() : data_(new uint8_t[SIZE * RTP_MAX_PACKET_LENGTH]) {
+        std::memset(msgs_, 0, sizeof(msgs_));
+        for (unsigned i = 0; i < SIZE; ++i) {
+            iov_[i].iov_base = data_.get() + i * RTP_MAX_PACKET_LENGTH;
+            iov_[i].iov_len = RTP_MAX_PACKET_LENGTH;
+            msgs_[i].msg_hdr.msg_iov = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    bool empty() const { return next_ == count_; }
+
+    unsigned pending() const { return count_ - next_; }
+
+    /**
+     * Read all the datagrams available on fd, up to the batch size.
+     * Return the number of datagrams read, or -1 on error.
+     */
+    int fill(int fd) {
+        auto ret = recvmmsg(fd, msgs_, SIZE, MSG_DONTWAIT, nullptr);
+        count_ = ret > 0 ? ret : 0;
+        next_ = 0;
+        return ret;
+    }
+
+    int pop(void* buf, int buf_size) {
+        const int len = std::min(static_cast<int>(msgs_[next_].msg_len), buf_size);
+        std::memcpy(buf, iov_[next_].iov_base, len);
+        ++next_;
+        return len;
+    }
+
+private:
+    NON_COPYABLE(RecvBatch);
+    static constexpr unsigned SIZE {16};
+
+    std::unique_ptr<uint8_t[]> data_;
+    mmsghdr msgs_[SIZE];
+    iovec iov_[SIZE];
+    unsigned count_ {0};
+    unsigned next_ {0};
+};
+#endif
+
+#ifdef HAVE_SENDMMSG
+/**
+ * Datagrams queued to be sent with one sendmmsg() call.
+ */
+class SendBatch {
+public:
+    SendBatch() : data_(new uint8_t[SIZE * RTP_MAX_PACKET_LENGTH]) {
+        std::memset(msgs_, 0, sizeof(msgs_));
+        for (unsigned i = 0; i < SIZE; ++i) {
+            iov_[i].iov_base = data_.get() + i * RTP_MAX_PACKET_LENGTH;
+            msgs_[i].msg_hdr.msg_iov = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    bool full() const { return count_ == SIZE; }
+    unsigned size() const { return count_; }
+    mmsghdr* msgs() { return msgs_; }
+    void clear() { count_ = 0; }
+
+    /** Packet must fit in RTP_MAX_PACKET_LENGTH and the batch must not be full */
+    void push(const uint8_t* buf, size_t len, sockaddr_storage* dest, socklen_t dest_len) {
+        std::memcpy(iov_[count_].iov_base, buf, len);
+        iov_[count_].iov_len = len;
+        msgs_[count_].msg_hdr.msg_name = dest;
+        msgs_[count_].msg_hdr.msg_namelen = dest_len;
+        ++count_;
+    }
+
+private:
+    NON_COPYABLE(SendBatch);
+    static constexpr unsigned SIZE {16};
+
+    std::unique_ptr<uint8_t[]> data_;
+    mmsghdr msgs_[SIZE];
+    iovec iov_[SIZE];
+    unsigned count_ {0};
+};
+#endif
+
 static struct addrinfo*
 udp_resolve_host(const char* node, int service)
 {
@@ -198,19 +292,30 @@ udp_socket_create(sockaddr_storage* addr, socklen_t* addr_len, int local_port, i
 }
 
 SocketPair::SocketPair(const char *uri, int localPort)
-    : rtp_sock_()
+    : rtpDataBuff_(RTP_RING_DEPTH, RTP_MAX_PACKET_LENGTH)
+    , rtcpDataBuff_(RTCP_RING_DEPTH, RTP_MAX_PACKET_LENGTH)
+    , rtp_sock_()
     , rtcp_sock_()
     , rtpDestAddr_()
     , rtpDestAddrLen_()
     , rtcpDestAddr_()
     , rtcpDestAddrLen_()
+#ifdef HAVE_RECVMMSG
+    , rtpRecvBatch_(new RecvBatch)
+    , rtcpRecvBatch_(new RecvBatch)
+#endif
+#ifdef HAVE_SENDMMSG
+    , sendBatch_(new SendBatch)
+#endif
 {
     openSockets(uri, localPort);
 }
 
 SocketPair::SocketPair(std::unique_ptr<IceSocket> rtp_sock,
                        std::unique_ptr<IceSocket> rtcp_sock)
-    : rtp_sock_(std::move(rtp_sock))
+    : rtpDataBuff_(RTP_RING_DEPTH, RTP_MAX_PACKET_LENGTH)
+    , rtcpDataBuff_(RTCP_RING_DEPTH, RTP_MAX_PACKET_LENGTH)
+    , rtp_sock_(std::move(rtp_sock))
     , rtcp_sock_(std::move(rtcp_sock))
     , rtpDestAddr_()
     , rtpDestAddrLen_()
@@ -219,16 +324,16 @@ SocketPair::SocketPair(std::unique_ptr<IceSocket> rtp_sock,
     , listRtcpHeader_()
 {
     auto queueRtpPacket = [this](uint8_t* buf, size_t len) {
-        std::lock_guard<std::mutex> l(dataBuffMutex_);
-        rtpDataBuff_.emplace_back(buf, buf+len);
-        cv_.notify_one();
+        if (not rtpDataBuff_.push(buf, len))
+            logOversized("RTP", rtpDataBuff_, rtpOversizedLog_, len);
+        notifyData();
         return len;
     };
 
     auto queueRtcpPacket = [this](uint8_t* buf, size_t len) {
-        std::lock_guard<std::mutex> l(dataBuffMutex_);
-        rtcpDataBuff_.emplace_back(buf, buf+len);
-        cv_.notify_one();
+        if (not rtcpDataBuff_.push(buf, len))
+            logOversized("RTCP", rtcpDataBuff_, rtcpOversizedLog_, len);
+        notifyData();
         return len;
     };
 
@@ -242,6 +347,31 @@ SocketPair::~SocketPair()
     closeSockets();
 }
 
+void
+SocketPair::logOversized(const char* type, const PacketRing& ring, OversizedLog& log, size_t len)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - log.last < OVERSIZED_LOG_PERIOD)
+        return;
+    const auto oversized = ring.getStats().oversized;
+    RING_WARN("%" PRIu64 " %s packets larger than %d bytes dropped (last one: %zu bytes)",
+              oversized - log.reported, type, RTP_MAX_PACKET_LENGTH, len);
+    log.last = now;
+    log.reported = oversized;
+}
+
+void
+SocketPair::notifyData()
+{
+    // Only lock when the reader may be sleeping: it sets readerWaiting_
+    // under the lock before checking the rings.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (readerWaiting_) {
+        std::lock_guard<std::mutex> l(dataBuffMutex_);
+        cv_.notify_one();
+    }
+}
+
 void
 SocketPair::saveRtcpPacket(uint8_t* buf, size_t len)
 {
@@ -287,6 +417,7 @@ SocketPair::interrupt()
     interrupted_ = true;
     if (rtp_sock_) rtp_sock_->setOnRecv(nullptr);
     if (rtcp_sock_) rtcp_sock_->setOnRecv(nullptr);
+    std::lock_guard<std::mutex> l(dataBuffMutex_);
     cv_.notify_all();
 }
 
@@ -353,10 +484,23 @@ SocketPair::createIOContext(const uint16_t mtu)
 }
 
 int
-SocketPair::waitForData()
+SocketPair::waitForData(int timeoutMs)
 {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
     // System sockets
     if (rtpHandle_ >= 0) {
+#ifdef HAVE_RECVMMSG
+        // Datagrams left from the last read don't need a poll
+        int pending = 0;
+        if (not rtpRecvBatch_->empty())
+            pending |= static_cast<int>(DataType::RTP);
+        if (not rtcpRecvBatch_->empty())
+            pending |= static_cast<int>(DataType::RTCP);
+        if (pending)
+            return pending;
+#endif
+
         int ret;
         do {
             if (interrupted_) {
@@ -364,10 +508,18 @@ SocketPair::waitForData()
                 return -1;
             }
 
+            auto pollTimeout = NET_POLL_TIMEOUT;
+            if (timeoutMs >= 0) {
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                pollTimeout = std::max<int>(std::min<int>(pollTimeout, left), 0);
+            }
+
             // work with system socket
             struct pollfd p[2] = { {rtpHandle_, POLLIN, 0},
                                    {rtcpHandle_, POLLIN, 0} };
-            ret = poll(p, 2, NET_POLL_TIMEOUT);
+            ret = poll(p, 2, pollTimeout);
+            ++rxSyscalls_;
             if (ret > 0) {
                 ret = 0;
                 if (p[0].revents & POLLIN)
@@ -375,6 +527,8 @@ SocketPair::waitForData()
                 if (p[1].revents & POLLIN)
                     ret |= static_cast<int>(DataType::RTCP);
             }
+            if (!ret and timeoutMs >= 0 and std::chrono::steady_clock::now() >= deadline)
+                return 0;
         } while (!ret or (ret < 0 and errno == EAGAIN));
 
         return ret;
@@ -384,7 +538,17 @@ SocketPair::waitForData()
     // work with IceSocket
     {
         std::unique_lock<std::mutex> lk(dataBuffMutex_);
-        cv_.wait(lk, [this]{ return interrupted_ or not rtpDataBuff_.empty() or not rtcpDataBuff_.empty(); });
+        readerWaiting_ = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto ready = [this]{ return interrupted_ or not rtpDataBuff_.empty() or not rtcpDataBuff_.empty(); };
+        bool hasData = true;
+        if (timeoutMs < 0)
+            cv_.wait(lk, ready);
+        else
+            hasData = cv_.wait_until(lk, deadline, ready);
+        readerWaiting_ = false;
+        if (not hasData)
+            return 0;
     }
 
     if (interrupted_) {
@@ -399,63 +563,70 @@ int
 SocketPair::readRtpData(void* buf, int buf_size)
 {
     // handle system socket
-    if (rtpHandle_ >= 0) {
-        struct sockaddr_storage from;
-        socklen_t from_len = sizeof(from);
-        return recvfrom(rtpHandle_, static_cast<char*>(buf), buf_size, 0,
-                        reinterpret_cast<struct sockaddr*>(&from), &from_len);
-    }
+    if (rtpHandle_ >= 0)
+        return recvPacket(rtpHandle_, buf, buf_size);
 
     // handle ICE
-    std::unique_lock<std::mutex> lk(dataBuffMutex_);
-    if (not rtpDataBuff_.empty()) {
-        auto pkt = rtpDataBuff_.front();
-        rtpDataBuff_.pop_front();
-        lk.unlock(); // to not block our ICE callbacks
-        int pkt_size = pkt.size();
-        int len = std::min(pkt_size, buf_size);
-        std::copy_n(pkt.begin(), len, static_cast<char*>(buf));
-        return len;
-    }
-
-    return 0;
+    return std::max(rtpDataBuff_.pop(buf, buf_size), 0);
 }
 
 int
 SocketPair::readRtcpData(void* buf, int buf_size)
 {
     // handle system socket
-    if (rtcpHandle_ >= 0) {
-        struct sockaddr_storage from;
-        socklen_t from_len = sizeof(from);
-        return recvfrom(rtcpHandle_, static_cast<char*>(buf), buf_size, 0,
-                        reinterpret_cast<struct sockaddr*>(&from), &from_len);
-    }
+    if (rtcpHandle_ >= 0)
+        return recvPacket(rtcpHandle_, buf, buf_size);
 
     // handle ICE
-    std::unique_lock<std::mutex> lk(dataBuffMutex_);
-    if (not rtcpDataBuff_.empty()) {
-        auto pkt = rtcpDataBuff_.front();
-        rtcpDataBuff_.pop_front();
-        lk.unlock();
-        int pkt_size = pkt.size();
-        int len = std::min(pkt_size, buf_size);
-        std::copy_n(pkt.begin(), len, static_cast<char*>(buf));
-        return len;
-    }
+    return std::max(rtcpDataBuff_.pop(buf, buf_size), 0);
+}
 
+unsigned
+SocketPair::rtpQueueDepth() const
+{
+    if (rtpHandle_ < 0)
+        return rtpDataBuff_.size();
+#ifdef HAVE_RECVMMSG
+    return rtpRecvBatch_->pending();
+#else
     return 0;
+#endif
 }
 
 int
-SocketPair::readCallback(uint8_t* buf, int buf_size)
+SocketPair::recvPacket(int fd, void* buf, int buf_size)
 {
-    auto datatype = waitForData();
-    if (datatype < 0)
+#ifdef HAVE_RECVMMSG
+    auto& batch = fd == rtpHandle_ ? *rtpRecvBatch_ : *rtcpRecvBatch_;
+    if (batch.empty()) {
+        ++rxSyscalls_;
+        auto ret = batch.fill(fd);
+        if (ret <= 0)
+            return ret;
+        rxPackets_ += ret;
+    }
+    return batch.pop(buf, buf_size);
+#else
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    ++rxSyscalls_;
+    auto ret = recvfrom(fd, static_cast<char*>(buf), buf_size, 0,
+                        reinterpret_cast<struct sockaddr*>(&from), &from_len);
+    if (ret > 0)
+        ++rxPackets_;
+    return ret;
+#endif
+}
+
+int
+SocketPair::readPacket(uint8_t* buf, int buf_size, int timeoutMs, bool& fromRTCP)
+{
+    fromRTCP = false;
+    auto datatype = waitForData(timeoutMs);
+    if (datatype <= 0)
         return datatype;
 
     int len = 0;
-    bool fromRTCP = false;
 
     // Priority to RTCP as its less invasive in bandwidth
     if (datatype & static_cast<int>(DataType::RTCP)) {
@@ -480,9 +651,36 @@ SocketPair::readCallback(uint8_t* buf, int buf_size)
             RING_WARN("decrypt error %d", err);
     }
 
+    if (not fromRTCP and receiveStats_) {
+        receiveStats_->onRtpReceived(buf, len);
+        receiveStats_->setQueueDepth(rtpQueueDepth());
+    }
+
     return len;
 }
 
+int
+SocketPair::readCallback(uint8_t* buf, int buf_size)
+{
+    bool fromRTCP;
+    return readPacket(buf, buf_size, -1, fromRTCP);
+}
+
+int
+SocketPair::readMediaPacket(uint8_t* buf, int buf_size, std::chrono::milliseconds timeout,
+                            bool& fromRTCP)
+{
+    return readPacket(buf, buf_size, timeout.count(), fromRTCP);
+}
+
+int
+SocketPair::sendRtcpPacket(uint8_t* buf, int buf_size)
+{
+    if (buf_size < 2 or not RTP_PT_IS_RTCP(buf[1]))
+        return -EINVAL;
+    return writeCallback(buf, buf_size);
+}
+
 int
 SocketPair::writeData(uint8_t* buf, int buf_size)
 {
@@ -490,28 +688,38 @@ SocketPair::writeData(uint8_t* buf, int buf_size)
 
     // System sockets?
     if (rtpHandle_ >= 0) {
-        int fd;
-        sockaddr_storage dest_addr;
-        socklen_t dest_addr_len;
-
-        if (isRTCP) {
-            fd = rtcpHandle_;
-            dest_addr = rtcpDestAddr_;
-            dest_addr_len = rtcpDestAddrLen_;
-        } else {
-            fd = rtpHandle_;
-            dest_addr = rtpDestAddr_;
-            dest_addr_len = rtpDestAddrLen_;
+        if (noWrite_)
+            return buf_size;
+
+#ifdef HAVE_SENDMMSG
+        // RTCP may be sent by the receiving thread: don't read sendBatching_
+        if (not isRTCP and sendBatching_ and buf_size <= RTP_MAX_PACKET_LENGTH) {
+            sendBatch_->push(buf, buf_size, &rtpDestAddr_, rtpDestAddrLen_);
+            if (sendBatch_->full())
+                sendQueued();
+            return buf_size;
         }
+#endif
 
-        auto ret = ff_network_wait_fd(fd);
-        if (ret < 0)
+        const int fd = isRTCP ? rtcpHandle_ : rtpHandle_;
+        const auto& dest_addr = isRTCP ? rtcpDestAddr_ : rtpDestAddr_;
+        const auto dest_addr_len = isRTCP ? rtcpDestAddrLen_ : rtpDestAddrLen_;
+
+        ++txSyscalls_;
+        auto ret = sendto(fd, reinterpret_cast<const char*>(buf), buf_size, 0,
+                          reinterpret_cast<const sockaddr*>(&dest_addr), dest_addr_len);
+        if (ret >= 0) {
+            ++txPackets_;
             return ret;
+        }
 
-        if (noWrite_)
-            return buf_size;
-        return sendto(fd, reinterpret_cast<const char*>(buf), buf_size, 0,
-                      reinterpret_cast<sockaddr*>(&dest_addr), dest_addr_len);
+        // Only poll when the socket buffer is full, writeCallback() retries
+        if (errno == EAGAIN or errno == EWOULDBLOCK) {
+            ++txSyscalls_;
+            ff_network_wait_fd(fd);
+            errno = EAGAIN;
+        }
+        return ret;
     }
 
     if (noWrite_)
@@ -549,7 +757,72 @@ SocketPair::writeCallback(uint8_t* buf, int buf_size)
         ret = writeData(buf, buf_size);
     } while (ret < 0 and errno == EAGAIN);
 
+    if (ret >= 0 and not isRTCP and sendStats_)
+        sendStats_->onRtpSent(ret);
+
     return ret < 0 ? -errno : ret;
 }
 
+void
+SocketPair::beginSendBatch()
+{
+    sendBatching_ = true;
+}
+
+void
+SocketPair::endSendBatch()
+{
+    sendBatching_ = false;
+#ifdef HAVE_SENDMMSG
+    if (sendBatch_ and sendBatch_->size())
+        sendQueued();
+#endif
+}
+
+void
+SocketPair::sendQueued()
+{
+#ifdef HAVE_SENDMMSG
+    auto& batch = *sendBatch_;
+    unsigned sent = 0;
+    while (sent < batch.size()) {
+        ++txSyscalls_;
+        auto ret = sendmmsg(rtpHandle_, batch.msgs() + sent, batch.size() - sent, 0);
+        if (ret > 0) {
+            sent += ret;
+            txPackets_ += ret;
+        } else if (ret < 0 and (errno == EAGAIN or errno == EWOULDBLOCK)) {
+            if (interrupted_)
+                break;
+            ++txSyscalls_;
+            ff_network_wait_fd(rtpHandle_);
+        } else {
+            // Error on the first queued packet, skip it
+            RING_WARN("sendmmsg failed");
+            strErr();
+            ++sent;
+        }
+    }
+    batch.clear();
+#endif
+}
+
+void
+SocketPair::setStats(MediaStreamStats* send, MediaStreamStats* receive)
+{
+    sendStats_ = send;
+    receiveStats_ = receive;
+}
+
+SocketPair::IOStats
+SocketPair::getIOStats() const
+{
+    return {
+        rxPackets_.load(std::memory_order_relaxed),
+        rxSyscalls_.load(std::memory_order_relaxed),
+        txPackets_.load(std::memory_order_relaxed),
+        txSyscalls_.load(std::memory_order_relaxed)
+    };
+}
+
 } // namespace ring
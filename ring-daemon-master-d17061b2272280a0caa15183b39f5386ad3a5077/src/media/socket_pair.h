@@ -26,6 +26,7 @@
 #endif
 
 #include "media_io_handle.h"
+#include "packet_ring.h"
 
 #ifndef _WIN32
 #include <sys/socket.h>
@@ -44,12 +45,20 @@ using socklen_t = int;
 #include <list>
 #include <vector>
 #include <condition_variable>
+#include <chrono>
 
 
 namespace ring {
 
 class IceSocket;
 class SRTPProtoContext;
+class MediaStreamStats;
+#ifdef HAVE_RECVMMSG
+class RecvBatch;
+#endif
+#ifdef HAVE_SENDMMSG
+class SendBatch;
+#endif
 
 typedef struct {
 #ifdef WORDS_BIGENDIAN
@@ -82,6 +91,23 @@ class SocketPair {
 
         MediaIOHandle* createIOContext(const uint16_t mtu);
 
+        /**
+         * Read one RTP or RTCP packet without going through an IO context.
+         * RTP packets are decrypted, RTCP packets are also kept for
+         * getRtcpInfo().
+         * Return the packet size, 0 on timeout or a negative value
+         * on error or interruption.
+         */
+        int readMediaPacket(uint8_t* buf, int buf_size, std::chrono::milliseconds timeout,
+                            bool& fromRTCP);
+
+        /**
+         * Send an RTCP packet without going through an IO context, like the
+         * libav RTP demuxer does through it: unencrypted. Safe to call
+         * while another thread sends RTP.
+         */
+        int sendRtcpPacket(uint8_t* buf, int buf_size);
+
         void openSockets(const char* uri, int localPort);
         void closeSockets();
 
@@ -107,22 +133,86 @@ class SocketPair {
         void stopSendOp(bool state = true);
         std::vector<rtcpRRHeader> getRtcpInfo();
 
+        /**
+         * Counters of the packets received through ICE.
+         */
+        PacketRing::Stats getRtpRecvStats() const { return rtpDataBuff_.getStats(); }
+        PacketRing::Stats getRtcpRecvStats() const { return rtcpDataBuff_.getStats(); }
+
+        /**
+         * Queue RTP packets written on system sockets until endSendBatch(),
+         * or until the queue is full, to send them with one system call.
+         * Must be called by the thread writing to the IO context.
+         * Packets are sent right away where sendmmsg() is not available.
+         */
+        void beginSendBatch();
+        void endSendBatch();
+
+        /**
+         * Packets and system calls (including polls) on system sockets.
+         */
+        struct IOStats {
+            uint64_t rxPackets;
+            uint64_t rxSyscalls;
+            uint64_t txPackets;
+            uint64_t txSyscalls;
+        };
+        IOStats getIOStats() const;
+
+        /**
+         * Account the RTP packets sent and received in these stats,
+         * which must outlive the socket pair. Must be called before the
+         * IO contexts are used.
+         */
+        void setStats(MediaStreamStats* send, MediaStreamStats* receive);
+
     private:
         NON_COPYABLE(SocketPair);
 
         int readCallback(uint8_t* buf, int buf_size);
         int writeCallback(uint8_t* buf, int buf_size);
 
-        int waitForData();
+        int readPacket(uint8_t* buf, int buf_size, int timeoutMs, bool& fromRTCP);
+
+        /**
+         * Wait for data on the RTP or RTCP socket, forever if timeoutMs
+         * is negative. Return 0 on timeout.
+         */
+        int waitForData(int timeoutMs = -1);
         int readRtpData(void* buf, int buf_size);
         int readRtcpData(void* buf, int buf_size);
+        int recvPacket(int fd, void* buf, int buf_size);
+        unsigned rtpQueueDepth() const;
         int writeData(uint8_t* buf, int buf_size);
+        void sendQueued();
         void saveRtcpPacket(uint8_t* buf, size_t len);
+        void notifyData();
+
+        /** Packets too large for a ring, reported by the last warning */
+        struct OversizedLog {
+            std::chrono::steady_clock::time_point last {};
+            uint64_t reported {0};
+        };
+        /**
+         * Warn about the packets too large for the ring, at most once per
+         * period. Only called by the ICE callback pushing to this ring.
+         */
+        static void logOversized(const char* type, const PacketRing& ring, OversizedLog& log,
+                                 size_t len);
 
+        // Packets received through ICE, pushed by the ICE callback
+        // and read by the demux thread
+        static constexpr size_t RTP_RING_DEPTH {256};
+        static constexpr size_t RTCP_RING_DEPTH {16};
+        PacketRing rtpDataBuff_;
+        PacketRing rtcpDataBuff_;
+        OversizedLog rtpOversizedLog_;
+        OversizedLog rtcpOversizedLog_;
+
+        // Only used when the reader waits for data
         std::mutex dataBuffMutex_;
         std::condition_variable cv_;
-        std::list<std::vector<uint8_t>> rtpDataBuff_;
-        std::list<std::vector<uint8_t>> rtcpDataBuff_;
+        std::atomic_bool readerWaiting_ {false};
 
         std::unique_ptr<IceSocket> rtp_sock_;
         std::unique_ptr<IceSocket> rtcp_sock_;
@@ -139,6 +229,24 @@ class SocketPair {
         std::atomic_bool noWrite_ {false};
         std::unique_ptr<SRTPProtoContext> srtpContext_;
 
+#ifdef HAVE_RECVMMSG
+        // Datagrams read at once but not yet given to the demuxer
+        std::unique_ptr<RecvBatch> rtpRecvBatch_;
+        std::unique_ptr<RecvBatch> rtcpRecvBatch_;
+#endif
+#ifdef HAVE_SENDMMSG
+        std::unique_ptr<SendBatch> sendBatch_;
+#endif
+        bool sendBatching_ {false}; // only used by the writer thread
+
+        std::atomic<uint64_t> rxPackets_ {0};
+        std::atomic<uint64_t> rxSyscalls_ {0};
+        std::atomic<uint64_t> txPackets_ {0};
+        std::atomic<uint64_t> txSyscalls_ {0};
+
+        MediaStreamStats* sendStats_ {nullptr};
+        MediaStreamStats* receiveStats_ {nullptr};
+
         std::list<rtcpRRHeader> listRtcpHeader_;
         std::mutex rtcpInfo_mutex_;
         static constexpr unsigned MAX_LIST_SIZE {20};
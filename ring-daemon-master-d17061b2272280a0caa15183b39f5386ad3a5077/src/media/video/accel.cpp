@@ -20,6 +20,7 @@
 
 #include "libav_deps.h" // MUST BE INCLUDED FIRST
 #include "media_buffer.h"
+#include "video_frame_pool.h"
 
 #include "accel.h"
 
@@ -142,7 +143,7 @@ HardwareAccel::extractData(VideoFrame& input)
 
         // FFmpeg requires a second frame in which to transfer the data
         // from the GPU buffer to the main memory
-        auto output = std::unique_ptr<VideoFrame>(new VideoFrame());
+        auto output = VideoFramePool::instance().acquire();
         auto outFrame = output->pointer();
         outFrame->format = AV_PIX_FMT_YUV420P;
 
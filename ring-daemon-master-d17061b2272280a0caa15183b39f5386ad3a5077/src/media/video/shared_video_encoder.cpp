@@ -0,0 +1,158 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "libav_deps.h" // MUST BE INCLUDED FIRST
+#include "shared_video_encoder.h"
+#include "video_sender.h"
+#include "media_codec.h"
+#include "string_utils.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <map>
+#include <ciso646> // fix windows compiler bug
+
+namespace ring { namespace video {
+
+// Seconds between two keyframes
+static constexpr unsigned KEY_FRAME_PERIOD {5};
+
+using RegistryKey = std::pair<VideoFrameActiveWriter*, std::string>;
+
+static std::mutex registryMutex;
+static std::map<RegistryKey, std::weak_ptr<SharedVideoEncoder>> registry;
+
+// Encoders giving identical packets have the same key
+static std::string
+encoderKey(const DeviceParams& dev, const MediaDescription& args)
+{
+    return ring::to_string(args.codec->systemCodecInfo.avcodecId)
+        + ' ' + ring::to_string(dev.width) + 'x' + ring::to_string(dev.height)
+        + '@' + ring::to_string(dev.framerate.real())
+        + ' ' + ring::to_string(args.codec->bitrate)
+        + ' ' + ring::to_string(args.codec->quality)
+        + ' ' + args.parameters;
+}
+
+std::shared_ptr<SharedVideoEncoder>
+SharedVideoEncoder::get(const std::shared_ptr<VideoFrameActiveWriter>& source,
+                        const DeviceParams& dev, const MediaDescription& args)
+{
+    std::lock_guard<std::mutex> lk(registryMutex);
+    for (auto it = registry.begin(); it != registry.end();) {
+        if (it->second.expired())
+            it = registry.erase(it);
+        else
+            ++it;
+    }
+
+    auto& entry = registry[RegistryKey(source.get(), encoderKey(dev, args))];
+    if (auto encoder = entry.lock())
+        return encoder;
+
+    std::shared_ptr<SharedVideoEncoder> encoder(new SharedVideoEncoder(source, dev, args));
+    source->attach(encoder.get());
+    entry = encoder;
+    RING_DBG("[enc:%p] New shared %s encoder, %ux%u", encoder.get(),
+             encoder->encoder_.getEncoderName().c_str(), dev.width, dev.height);
+    return encoder;
+}
+
+SharedVideoEncoder::SharedVideoEncoder(const std::shared_ptr<VideoFrameActiveWriter>& source,
+                                       const DeviceParams& dev,
+                                       const MediaDescription& args)
+    : source_(source)
+{
+    encoder_.setDeviceOptions(dev);
+    keyFrameFreq_ = dev.framerate.numerator() * KEY_FRAME_PERIOD;
+    encoder_.openEncoder(args);
+}
+
+SharedVideoEncoder::~SharedVideoEncoder()
+{
+    source_->detach(this);
+    stopMailbox();
+    if (auto dropped = getDroppedCount())
+        RING_DBG("[enc:%p] %llu frames dropped", this, (unsigned long long)dropped);
+}
+
+void
+SharedVideoEncoder::addSender(VideoSender& sender)
+{
+    {
+        std::lock_guard<std::mutex> lk(outputsMutex_);
+        outputs_.emplace_back(Output {&sender, false});
+    }
+    // the sender can only start on a keyframe
+    forceKeyFrame();
+}
+
+void
+SharedVideoEncoder::removeSender(VideoSender& sender)
+{
+    std::lock_guard<std::mutex> lk(outputsMutex_);
+    outputs_.erase(std::remove_if(outputs_.begin(), outputs_.end(),
+                                  [&](const Output& o) { return o.sender == &sender; }),
+                   outputs_.end());
+}
+
+void
+SharedVideoEncoder::forceKeyFrame()
+{
+    ++forceKeyFrame_;
+}
+
+void
+SharedVideoEncoder::process(Observable<std::shared_ptr<VideoFrame>>* /*obs*/,
+                            const std::shared_ptr<VideoFrame>& frame_p)
+{
+    {
+        std::lock_guard<std::mutex> lk(outputsMutex_);
+        if (outputs_.empty())
+            return;
+    }
+
+    bool is_keyframe = forceKeyFrame_ > 0 \
+        or (keyFrameFreq_ > 0 and (frameNumber_ % keyFrameFreq_) == 0);
+
+    if (is_keyframe and forceKeyFrame_ > 0)
+        --forceKeyFrame_;
+
+    encodeStart_ = std::chrono::steady_clock::now();
+    if (encoder_.encode(*frame_p, is_keyframe, frameNumber_++,
+                        [this](AVPacket& pkt) { return sendPacket(pkt); }) < 0)
+        RING_ERR("[enc:%p] encoding failed", this);
+}
+
+int
+SharedVideoEncoder::sendPacket(AVPacket& pkt)
+{
+    const bool key = pkt.flags & AV_PKT_FLAG_KEY;
+    const auto encodeTime = std::chrono::steady_clock::now() - encodeStart_;
+    std::lock_guard<std::mutex> lk(outputsMutex_);
+    for (auto& output : outputs_) {
+        const bool resync = not output.started;
+        if (resync and not key)
+            continue;
+        output.started = true;
+        output.sender->sendPacket(pkt, encoder_, resync, encodeTime);
+    }
+    return 0;
+}
+
+}} // namespace ring::video
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+#include "video_base.h"
+#include "media_encoder.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ring { namespace video {
+
+class VideoSender;
+
+/**
+ * Encoder shared by the senders of a video source (e.g. a conference mixer)
+ * negotiating the same codec, resolution and bitrate.
+ *
+ * Frames are encoded once, then each sender writes the packets through its
+ * own RTP output (SSRC, sequence numbers, SRTP).
+ * A sender only gets packets from the next keyframe after it is added.
+ */
+class SharedVideoEncoder : public VideoFrameAsyncReader
+{
+public:
+    /**
+     * Return the encoder of source for these parameters,
+     * created and attached to source if needed.
+     * @throw MediaEncoderException
+     */
+    static std::shared_ptr<SharedVideoEncoder>
+    get(const std::shared_ptr<VideoFrameActiveWriter>& source,
+        const DeviceParams& dev, const MediaDescription& args);
+
+    ~SharedVideoEncoder();
+
+    void addSender(VideoSender& sender);
+
+    /** The sender gets no more packets once it returns */
+    void removeSender(VideoSender& sender);
+
+    /** Request a keyframe, sent to all the senders */
+    void forceKeyFrame();
+
+private:
+    NON_COPYABLE(SharedVideoEncoder);
+
+    SharedVideoEncoder(const std::shared_ptr<VideoFrameActiveWriter>& source,
+                       const DeviceParams& dev, const MediaDescription& args);
+
+    // as VideoFrameAsyncReader
+    void process(Observable<std::shared_ptr<VideoFrame>>* obs,
+                 const std::shared_ptr<VideoFrame>& frame_p) override;
+
+    int sendPacket(AVPacket& pkt);
+
+    struct Output {
+        VideoSender* sender;
+        /** Set on the first keyframe sent */
+        bool started;
+    };
+
+    std::shared_ptr<VideoFrameActiveWriter> source_;
+    MediaEncoder encoder_ {};
+
+    std::mutex outputsMutex_ {}; // lock outputs_, held while sending
+    std::vector<Output> outputs_ {};
+
+    std::atomic<int> forceKeyFrame_ {0};
+    int keyFrameFreq_ {0};
+    int64_t frameNumber_ {0};
+    std::chrono::steady_clock::time_point encodeStart_ {};
+};
+
+}} // namespace ring::video
@@ -24,11 +24,14 @@
 #include <cstdint>
 #include <semaphore.h>
 
-/* Implementation note: double-buffering
- * Shared memory is divided in two regions, each representing one frame.
+/* Implementation note: ring of frames
+ * Shared memory is divided in N regions (slots), each representing one frame.
  * First byte of each frame is guaranteed to be aligned on 16 bytes.
- * One region is marked as readable: this region can be safely read.
- * The other region is writeable: only the producer can use it.
+ * One region is marked as readable: it holds the latest frame.
+ * Another one is writeable: only the producer can use it.
+ * The producer writes the slots in turn, so a readable frame is not
+ * overwritten before N - 1 newer frames were produced.
+ * N can be computed from mapSize and frameSize, if needed.
  */
 
 struct SHMHeader {
@@ -24,6 +24,7 @@
 #include "config.h"
 #endif
 
+#include "libav_deps.h" // MUST BE INCLUDED FIRST
 #include "sinkclient.h"
 
 #if HAVE_SHM
@@ -37,7 +38,7 @@
 #include "dring/videomanager_interface.h"
 #include "libav_utils.h"
 #include "video_scaler.h"
-#include "smartools.h"
+#include "video_frame_pool.h"
 
 #ifndef _WIN32
 #include <sys/mman.h>
@@ -50,10 +51,14 @@
 #include <cerrno>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 
 namespace ring { namespace video {
 
 #if HAVE_SHM
+// Frames in the shared memory ring
+static constexpr unsigned SHM_FRAME_SLOTS = 4;
+
 // RAII class helper on sem_wait/sem_post sempahore operations
 class SemGuardLock {
     public:
@@ -85,7 +90,12 @@ class ShmHolder
             return openedName_;
         }
 
-        void renderFrame(VideoFrame& src) noexcept;
+        /**
+         * Convert src to BGRA in the next slot and make it readable.
+         * Return the converted frame, unchanged until the next call,
+         * or nullptr on error.
+         */
+        const uint8_t* renderFrame(const VideoFrame& src) noexcept;
 
     private:
         bool resizeArea(std::size_t desired_length) noexcept;
@@ -100,8 +110,10 @@ class ShmHolder
 
         SHMHeader* area_ {static_cast<SHMHeader*>(MAP_FAILED)};
         std::size_t areaSize_ {0};
+        std::size_t dataOffset_ {0}; // of the first slot
         std::string openedName_;
         int fd_ {-1};
+        VideoScaler scaler_;
 };
 
 ShmHolder::ShmHolder(const std::string& name)
@@ -177,7 +189,7 @@ ShmHolder::resizeArea(std::size_t frameSize) noexcept
         return true;
 
     // full area size: +15 to take care of maximum padding size
-    const auto areaSize = sizeof(SHMHeader) + 2 * frameSize + 15;
+    const auto areaSize = sizeof(SHMHeader) + SHM_FRAME_SLOTS * frameSize + 15;
     RING_DBG("ShmHolder[%s]: new sizes: f=%zu, a=%zu", openedName_.c_str(),
              frameSize, areaSize);
 
@@ -212,15 +224,16 @@ ShmHolder::resizeArea(std::size_t frameSize) noexcept
         // Note: we not using std::align as not implemented in 4.9
         // https://gcc.gnu.org/bugzilla/show_bug.cgi?id=57350
         auto p = reinterpret_cast<std::uintptr_t>(area_->data);
-        area_->writeOffset = ((p + 15) & ~15) - p;
-        area_->readOffset = area_->writeOffset + frameSize;
+        dataOffset_ = ((p + 15) & ~15) - p;
+        area_->writeOffset = dataOffset_;
+        area_->readOffset = dataOffset_ + frameSize;
     }
 
     return true;
 }
 
-void
-ShmHolder::renderFrame(VideoFrame& src) noexcept
+const uint8_t*
+ShmHolder::renderFrame(const VideoFrame& src) noexcept
 {
     const auto width = src.width();
     const auto height = src.height();
@@ -230,24 +243,28 @@ ShmHolder::renderFrame(VideoFrame& src) noexcept
     if (!resizeArea(frameSize)) {
         RING_ERR("ShmHolder[%s]: could not resize area",
                  openedName_.c_str());
-        return;
+        return nullptr;
     }
 
+    const auto frame = area_->data + area_->writeOffset;
     {
-        VideoFrame dst;
-        VideoScaler scaler;
-
-        dst.setFromMemory(area_->data + area_->writeOffset, format, width, height);
-        scaler.scale(src, dst);
+        auto dst = VideoFramePool::instance().acquire();
+        dst->setFromMemory(frame, format, width, height);
+        scaler_.scale(src, *dst);
     }
 
     {
         SemGuardLock lk {area_->mutex};
 
         ++area_->frameGen;
-        std::swap(area_->readOffset, area_->writeOffset);
+        area_->readOffset = area_->writeOffset;
+        area_->writeOffset += area_->frameSize;
+        if (area_->writeOffset >= dataOffset_ + SHM_FRAME_SLOTS * area_->frameSize)
+            area_->writeOffset = dataOffset_;
         ::sem_post(&area_->frameGenMutex);
     }
+
+    return frame;
 }
 
 std::string
@@ -323,40 +340,49 @@ SinkClient::update(Observable<std::shared_ptr<VideoFrame>>* /*obs*/,
     const std::chrono::duration<double> seconds = currentTime - lastFrameDebug_;
     ++frameCount_;
     if (seconds.count() > 1) {
-        std::ostringstream fps;
-        fps << frameCount_ / seconds.count();
-        // Send the framerate in smartInfo
-        Smartools::getInstance().setFrameRate(id_, fps.str());
+        RING_DBG("[sink:%s] %.1f fps", id_.c_str(), frameCount_ / seconds.count());
         frameCount_ = 0;
         lastFrameDebug_ = currentTime;
     }
 #endif
 
+    // BGRA frame of the shared memory, if any
+    const uint8_t* bgra = nullptr;
+
 #if HAVE_SHM
-    // Send the resolution in smartInfo
-    Smartools::getInstance().setResolution(id_, f.width(), f.height());
-    shm_->renderFrame(f);
+    bgra = shm_->renderFrame(f);
 #endif
 
     if (target_.pull) {
-        VideoFrame dst;
-        VideoScaler scaler;
         const int width = f.width();
         const int height = f.height();
 #if (defined(__ANDROID__) || defined(__APPLE__))
-        const int format = VIDEO_PIXFMT_RGBA;
+        const int defaultFormat = VIDEO_PIXFMT_RGBA;
 #else
-        const int format = VIDEO_PIXFMT_BGRA;
+        const int defaultFormat = VIDEO_PIXFMT_BGRA;
 #endif
+        const int format = libav_utils::libav_pixel_format(target_.format >= 0 ?
+                                                           target_.format : defaultFormat);
         const auto bytes = videoFrameSize(format, width, height);
 
         if (bytes > 0) {
             if (auto buffer_ptr = target_.pull(bytes)) {
-                buffer_ptr->format = libav_utils::libav_pixel_format(format);
+                buffer_ptr->format = format;
                 buffer_ptr->width = width;
                 buffer_ptr->height = height;
-                dst.setFromMemory(buffer_ptr->ptr, format, width, height);
-                scaler_->scale(f, dst);
+                const auto input = f.pointer();
+                if (bgra and format == PIXEL_FORMAT(BGRA)) {
+                    // already converted for the shared memory
+                    std::copy_n(bgra, bytes, buffer_ptr->ptr);
+                } else if (format == input->format) {
+                    av_image_copy_to_buffer(buffer_ptr->ptr, bytes, input->data,
+                                            input->linesize, (AVPixelFormat)format,
+                                            width, height, 1);
+                } else {
+                    auto dst = VideoFramePool::instance().acquire();
+                    dst->setFromMemory(buffer_ptr->ptr, format, width, height);
+                    scaler_->scale(f, *dst);
+                }
                 target_.push(std::move(buffer_ptr));
             }
         }
@@ -22,6 +22,7 @@
 #include "libav_deps.h" // MUST BE INCLUDED FIRST
 #include "video_base.h"
 #include "media_buffer.h"
+#include "video_frame_pool.h"
 #include "string_utils.h"
 #include "logger.h"
 
@@ -38,7 +39,7 @@ VideoGenerator::getNewFrame()
     if (writableFrame_)
         writableFrame_->reset();
     else
-        writableFrame_.reset(new VideoFrame());
+        writableFrame_ = VideoFramePool::instance().acquire();
     return *writableFrame_.get();
 }
 
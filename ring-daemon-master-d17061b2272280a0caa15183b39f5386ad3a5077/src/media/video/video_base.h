@@ -34,6 +34,9 @@
 #include <memory>
 #include <set>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 #include <ciso646> // fix windows compiler bug
 
 class AVPacket;
@@ -121,8 +124,116 @@ public:
     virtual void detached(Observable<T>*) {};
 };
 
+/*=== AsyncObserver ==========================================================*/
+
+/**
+ * Observer processing data on its own thread (mailbox mode).
+ *
+ * update() only stores data in a single slot, so the producer never waits
+ * for process(). If the previous data was not processed yet, it is replaced
+ * and counted as dropped: only the latest data is processed.
+ *
+ * Subclasses must call stopMailbox() first in their destructor, and
+ * AsyncObserver::detached() if they override detached().
+ */
+template <typename T>
+class AsyncObserver : public Observer<T>
+{
+public:
+    AsyncObserver() : thread_([this]{ mailboxLoop(); }) {}
+
+    virtual ~AsyncObserver() {
+        stopMailbox();
+    }
+
+    void update(Observable<T>* obs, const T& data) final override {
+        {
+            std::lock_guard<std::mutex> lk(mailboxMutex_);
+            if (not running_)
+                return;
+            if (pending_)
+                ++dropped_;
+            pending_ = obs;
+            data_ = data;
+        }
+        cv_.notify_one();
+    }
+
+    /**
+     * Drop data pending from obs, and wait until it is no longer processed:
+     * obs may be destroyed afterwards.
+     */
+    void detached(Observable<T>* obs) override {
+        std::unique_lock<std::mutex> lk(mailboxMutex_);
+        if (pending_ == obs) {
+            pending_ = nullptr;
+            data_ = T();
+        }
+        if (thread_.get_id() != std::this_thread::get_id())
+            processed_.wait(lk, [this, obs]{ return processing_ != obs; });
+    }
+
+    /** Data replaced before being processed */
+    uint64_t getDroppedCount() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    /** Called on the mailbox thread, with the latest data */
+    virtual void process(Observable<T>*, const T&) = 0;
+
+    /** Stop the mailbox thread, pending data is dropped */
+    void stopMailbox() {
+        {
+            std::lock_guard<std::mutex> lk(mailboxMutex_);
+            if (not running_)
+                return;
+            running_ = false;
+        }
+        cv_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+        pending_ = nullptr;
+        data_ = T();
+    }
+
+private:
+    NON_COPYABLE(AsyncObserver<T>);
+
+    void mailboxLoop() {
+        std::unique_lock<std::mutex> lk(mailboxMutex_);
+        while (true) {
+            cv_.wait(lk, [this]{ return not running_ or pending_; });
+            if (not running_)
+                break;
+            T data = std::move(data_);
+            data_ = T();
+            auto obs = processing_ = pending_;
+            pending_ = nullptr;
+            lk.unlock();
+            process(obs, data);
+            data = T();
+            lk.lock();
+            processing_ = nullptr;
+            processed_.notify_all();
+        }
+    }
+
+    std::mutex mailboxMutex_ {}; // lock the following members
+    std::condition_variable cv_ {};
+    std::condition_variable processed_ {};
+    bool running_ {true};
+    Observable<T>* pending_ {nullptr};
+    Observable<T>* processing_ {nullptr};
+    T data_ {};
+
+    std::atomic<uint64_t> dropped_ {0};
+    std::thread thread_; // must be the last member
+};
+
 struct VideoFrameActiveWriter: Observable<std::shared_ptr<VideoFrame>> {};
 struct VideoFramePassiveReader: Observer<std::shared_ptr<VideoFrame>> {};
+struct VideoFrameAsyncReader: AsyncObserver<std::shared_ptr<VideoFrame>> {};
 
 /*=== VideoGenerator =========================================================*/
 
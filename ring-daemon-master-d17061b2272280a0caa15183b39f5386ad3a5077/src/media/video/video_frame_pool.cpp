@@ -0,0 +1,181 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "libav_deps.h" // MUST BE INCLUDED FIRST
+#include "video_frame_pool.h"
+#include "media_buffer.h"
+
+#include <new> // std::bad_alloc
+#include <ciso646> // fix windows compiler bug
+
+namespace ring { namespace video {
+
+// Alignment of lines and buffers, as av_frame_get_buffer() does
+static constexpr int BUFFER_ALIGN = 32;
+
+// Geometries with a buffer pool, the least recently used pool is dropped
+static constexpr size_t MAX_POOLS = 8;
+
+// Released frames kept for reuse
+static constexpr size_t MAX_FREE_FRAMES = 32;
+
+VideoFramePool&
+VideoFramePool::instance()
+{
+    // Never destroyed: frames may be released during static destruction
+    static auto pool = new VideoFramePool();
+    return *pool;
+}
+
+std::shared_ptr<VideoFrame>
+VideoFramePool::acquire()
+{
+    ++frameRequests_;
+    std::unique_ptr<VideoFrame> frame;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (not freeFrames_.empty()) {
+            frame = std::move(freeFrames_.back());
+            freeFrames_.pop_back();
+        }
+    }
+    if (frame)
+        ++frameHits_;
+    else
+        frame.reset(new VideoFrame());
+
+    ++liveFrames_;
+    return {frame.release(), [this](VideoFrame* f){ release(f); }};
+}
+
+void
+VideoFramePool::release(VideoFrame* frame) noexcept
+{
+    --liveFrames_;
+    frame->reset();
+    std::unique_ptr<VideoFrame> f(frame);
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (freeFrames_.size() < MAX_FREE_FRAMES)
+        freeFrames_.emplace_back(std::move(f));
+}
+
+AVBufferRef*
+VideoFramePool::allocBuffer(void* opaque, int size)
+{
+    auto data = static_cast<uint8_t*>(av_malloc(size));
+    if (not data)
+        return nullptr;
+    auto buf = av_buffer_create(data, size, &VideoFramePool::freeBuffer, opaque, 0);
+    if (not buf) {
+        av_free(data);
+        return nullptr;
+    }
+    auto self = static_cast<VideoFramePool*>(opaque);
+    ++self->bufferAllocs_;
+    ++self->liveBuffers_;
+    return buf;
+}
+
+void
+VideoFramePool::freeBuffer(void* opaque, uint8_t* data)
+{
+    av_free(data);
+    --static_cast<VideoFramePool*>(opaque)->liveBuffers_;
+}
+
+// mutex_ must be held
+VideoFramePool::BufferPool&
+VideoFramePool::getPool(const Geometry& geometry)
+{
+    auto it = pools_.find(geometry);
+    if (it == pools_.end()) {
+        if (pools_.size() >= MAX_POOLS) {
+            auto lru = pools_.begin();
+            for (auto i = pools_.begin(); i != pools_.end(); ++i)
+                if (i->second.lastUse < lru->second.lastUse)
+                    lru = i;
+            // buffers in use are freed when released
+            av_buffer_pool_uninit(&lru->second.pool);
+            pools_.erase(lru);
+        }
+
+        const auto format = (AVPixelFormat)std::get<0>(geometry);
+        const auto width = std::get<1>(geometry);
+        const auto height = std::get<2>(geometry);
+
+        BufferPool p {};
+        if (av_image_fill_linesizes(p.linesize, format, FFALIGN(width, BUFFER_ALIGN)) < 0)
+            throw std::bad_alloc();
+        for (auto& l : p.linesize)
+            l = FFALIGN(l, BUFFER_ALIGN);
+
+        uint8_t* data[4];
+        const auto size = av_image_fill_pointers(data, format, FFALIGN(height, BUFFER_ALIGN),
+                                                 nullptr, p.linesize);
+        if (size < 0)
+            throw std::bad_alloc();
+        for (unsigned i = 0; i < 4; ++i)
+            p.offsets[i] = reinterpret_cast<uintptr_t>(data[i]);
+
+        p.pool = av_buffer_pool_init2(size + 16 + BUFFER_ALIGN - 1, this,
+                                      &VideoFramePool::allocBuffer, nullptr);
+        if (not p.pool)
+            throw std::bad_alloc();
+        it = pools_.emplace(geometry, p).first;
+    }
+    it->second.lastUse = ++useCount_;
+    return it->second;
+}
+
+void
+VideoFramePool::allocate(AVFrame* frame)
+{
+    ++bufferRequests_;
+
+    AVBufferRef* buf;
+    const BufferPool* pool;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        pool = &getPool(Geometry {frame->format, frame->width, frame->height});
+        buf = av_buffer_pool_get(pool->pool);
+        if (not buf)
+            throw std::bad_alloc();
+        for (unsigned i = 0; i < 4; ++i) {
+            frame->linesize[i] = pool->linesize[i];
+            frame->data[i] = pool->linesize[i] ? buf->data + pool->offsets[i] : nullptr;
+        }
+    }
+    frame->buf[0] = buf;
+    frame->extended_data = frame->data;
+}
+
+VideoFramePool::Stats
+VideoFramePool::getStats() const
+{
+    const uint64_t bufferRequests = bufferRequests_;
+    return {
+        frameRequests_,
+        frameHits_,
+        liveFrames_,
+        bufferRequests,
+        bufferRequests - bufferAllocs_,
+        liveBuffers_
+    };
+}
+
+}} // namespace ring::video
@@ -0,0 +1,110 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+class AVFrame;
+class AVBufferPool;
+class AVBufferRef;
+
+namespace ring {
+class VideoFrame;
+}
+
+namespace ring { namespace video {
+
+/**
+ * Recycles VideoFrame objects and their pixel buffers.
+ *
+ * Pixel buffers are refcounted AVBufferRef, taken from an AVBufferPool per
+ * (format, width, height). A buffer returns to its pool once the last frame
+ * referencing it is reset or destroyed, so frames can share buffers
+ * instead of copying them.
+ */
+class VideoFramePool {
+    public:
+        struct Stats {
+            uint64_t frameRequests;
+            uint64_t frameHits;
+            /** Frames handed out and not yet released */
+            uint64_t liveFrames;
+            uint64_t bufferRequests;
+            uint64_t bufferHits;
+            /** Pixel buffers allocated, in use or pooled */
+            uint64_t liveBuffers;
+        };
+
+        static VideoFramePool& instance();
+
+        /**
+         * Return an empty frame. Its pixel buffers are released and the
+         * frame is recycled when the last shared_ptr is dropped.
+         */
+        std::shared_ptr<VideoFrame> acquire();
+
+        /**
+         * Attach pooled pixel buffers to frame, following its libav
+         * format, width and height, which must be set.
+         * @throw std::bad_alloc
+         */
+        void allocate(AVFrame* frame);
+
+        Stats getStats() const;
+
+    private:
+        NON_COPYABLE(VideoFramePool);
+        VideoFramePool() = default;
+
+        using Geometry = std::tuple<int, int, int>;
+
+        struct BufferPool {
+            AVBufferPool* pool;
+            int linesize[4];
+            size_t offsets[4];
+            uint64_t lastUse;
+        };
+
+        static AVBufferRef* allocBuffer(void* opaque, int size);
+        static void freeBuffer(void* opaque, uint8_t* data);
+        BufferPool& getPool(const Geometry& geometry);
+        void release(VideoFrame* frame) noexcept;
+
+        mutable std::mutex mutex_ {};
+        std::vector<std::unique_ptr<VideoFrame>> freeFrames_ {};
+        std::map<Geometry, BufferPool> pools_ {};
+        uint64_t useCount_ {0};
+
+        std::atomic<uint64_t> frameRequests_ {0};
+        std::atomic<uint64_t> frameHits_ {0};
+        std::atomic<uint64_t> liveFrames_ {0};
+        std::atomic<uint64_t> bufferRequests_ {0};
+        std::atomic<uint64_t> bufferAllocs_ {0};
+        std::atomic<uint64_t> liveBuffers_ {0};
+};
+
+}} // namespace ring::video
@@ -21,35 +21,97 @@
 #include "libav_deps.h" // MUST BE INCLUDED FIRST
 
 #include "video_mixer.h"
+#include "video_scaler.h"
+#include "video_frame_pool.h"
 #include "media_buffer.h"
 #include "client/videomanager.h"
 #include "manager.h"
 #include "sinkclient.h"
+#include "thread_pool.h"
 #include "logger.h"
 
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <unistd.h>
 
 namespace ring { namespace video {
 
 struct VideoMixer::VideoMixerSource {
     Observable<std::shared_ptr<VideoFrame>>* source = nullptr;
-    std::unique_ptr<VideoFrame> update_frame;
-    std::unique_ptr<VideoFrame> render_frame;
-    void atomic_swap_render(std::unique_ptr<VideoFrame>& other) {
+
+    /* Used by the mixer thread and the render tasks only */
+    std::shared_ptr<VideoFrame> render_frame;
+    VideoScaler scaler;
+    int x = 0, y = 0, width = 0, height = 0; // tile in the output
+    int rendered_width = 0, rendered_height = 0; // input size rendered in the tile
+
+    void setFrame(std::shared_ptr<VideoFrame>&& frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        update_frame.swap(frame);
+    }
+    std::shared_ptr<VideoFrame> takeFrame() {
         std::lock_guard<std::mutex> lock(mutex_);
-        render_frame.swap(other);
+        return std::move(update_frame);
     }
 private:
     std::mutex mutex_;
+    std::shared_ptr<VideoFrame> update_frame;
 };
 
-static constexpr const auto FRAME_DURATION = std::chrono::duration<double>(1/30.);
+static constexpr double DEFAULT_FRAME_RATE = 30.;
+
+/**
+ * Tiles to render, claimed one by one by the mixer thread and the pool
+ * tasks. Pool tasks running late find nothing left and only touch this.
+ */
+struct VideoMixer::RenderBatch {
+    std::vector<VideoMixerSource*> tiles;
+    std::atomic<size_t> next {0};
+    std::mutex mutex {};
+    std::condition_variable cv {};
+    size_t done {0};
+
+    /** Render the tiles not claimed yet */
+    template <typename Render>
+    void renderNext(Render&& render) {
+        size_t i;
+        while ((i = next.fetch_add(1)) < tiles.size()) {
+            render(*tiles[i]);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++done == tiles.size())
+                cv.notify_all();
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]{ return done == tiles.size(); });
+    }
+};
+
+// Fill a rectangle of a YUV420P frame with black, coordinates must be even
+static void
+clear_rect(VideoFrame& frame, int x, int y, int width, int height)
+{
+    auto f = frame.pointer();
+    for (int i = 0; i < height; ++i)
+        std::memset(f->data[0] + (y + i) * f->linesize[0] + x, 0, width);
+    // 128 is the black level for U/V channels
+    for (int p = 1; p < 3; ++p)
+        for (int i = 0; i < height / 2; ++i)
+            std::memset(f->data[p] + (y / 2 + i) * f->linesize[p] + x / 2, 128, width / 2);
+}
 
 VideoMixer::VideoMixer(const std::string& id)
     : VideoGenerator::VideoGenerator()
     , id_(id)
     , sink_ (Manager::instance().createSinkClient(id, true))
+    , frameDurationUs_(1000000 / DEFAULT_FRAME_RATE)
     , loop_([]{return true;},
             std::bind(&VideoMixer::process, this),
             []{})
@@ -84,6 +146,7 @@ VideoMixer::attached(Observable<std::shared_ptr<VideoFrame>>* ob)
     auto src = std::unique_ptr<VideoMixerSource>(new VideoMixerSource);
     src->source = ob;
     sources_.emplace_back(std::move(src));
+    layoutChanged_ = true;
 }
 
 void
@@ -94,6 +157,7 @@ VideoMixer::detached(Observable<std::shared_ptr<VideoFrame>>* ob)
     for (const auto& x : sources_) {
         if (x->source == ob) {
             sources_.remove(x);
+            layoutChanged_ = true;
             break;
         }
     }
@@ -107,12 +171,10 @@ VideoMixer::update(Observable<std::shared_ptr<VideoFrame>>* ob,
 
     for (const auto& x : sources_) {
         if (x->source == ob) {
-            if (!x->update_frame)
-                x->update_frame.reset(new VideoFrame);
-            else
-                x->update_frame->reset();
-            *x->update_frame = *frame_p; // copy frame content, it will be destroyed after return
-            x->atomic_swap_render(x->update_frame);
+            // reference frame content, the source may reuse the frame after return
+            auto frame = VideoFramePool::instance().acquire();
+            frame->copyFrom(*frame_p);
+            x->setFrame(std::move(frame));
             return;
         }
     }
@@ -121,62 +183,135 @@ VideoMixer::update(Observable<std::shared_ptr<VideoFrame>>* ob,
 void
 VideoMixer::process()
 {
-    const auto now = std::chrono::system_clock::now();
-    const auto diff = now - lastProcess_;
-    const auto delay = FRAME_DURATION - diff;
-    if (delay.count() > 0)
-        std::this_thread::sleep_for(delay);
-    lastProcess_ = now;
+    std::this_thread::sleep_until(nextProcess_);
+    const auto now = std::chrono::steady_clock::now();
+    const auto frameDuration = std::chrono::microseconds(frameDurationUs_.load());
+    nextProcess_ += frameDuration;
+    if (nextProcess_ < now)
+        nextProcess_ = now + frameDuration;
+
+    bool changed = false;
+    {
+        auto lock(rwMutex_.read());
+
+        if (!width_ or !height_)
+            return;
+
+        if (layoutChanged_.exchange(false)) {
+            try {
+                canvas_.reserve(VIDEO_PIXFMT_YUV420P, width_, height_);
+            } catch (const std::bad_alloc& e) {
+                RING_ERR("VideoFrame::allocBuffer() failed");
+                layoutChanged_ = true;
+                return;
+            }
+            yuv422_clear_to_black(canvas_);
+            computeLayout();
+            changed = true;
+        }
+
+        auto batch = std::make_shared<RenderBatch>();
+        for (const auto& x : sources_) {
+            if (auto frame = x->takeFrame()) {
+                x->render_frame = std::move(frame);
+                batch->tiles.emplace_back(x.get());
+            } else if (changed and x->render_frame) {
+                batch->tiles.emplace_back(x.get());
+            }
+        }
+
+        if (not batch->tiles.empty()) {
+            // Tiles are disjoint: render them in parallel. The pool is
+            // shared, when its workers are busy this thread renders the
+            // tiles itself, it only waits for the ones being rendered.
+            for (size_t i = 1; i < batch->tiles.size(); ++i) {
+                ThreadPool::instance().run([this, batch] {
+                    batch->renderNext([this](VideoMixerSource& src) { render_frame(src); });
+                });
+            }
+            batch->renderNext([this](VideoMixerSource& src) { render_frame(src); });
+            batch->wait();
+            changed = true;
+        }
+    }
+
+    auto last = obtainLastFrame();
+    if (not changed and last) {
+        // nothing new, the previous frame is sent again
+        notify(last);
+        return;
+    }
 
     VideoFrame& output = getNewFrame();
     try {
-        output.reserve(VIDEO_PIXFMT_YUYV422, width_, height_);
+        output.reserve(VIDEO_PIXFMT_YUV420P, canvas_.width(), canvas_.height());
     } catch (const std::bad_alloc& e) {
         RING_ERR("VideoFrame::allocBuffer() failed");
         return;
     }
+    av_frame_copy(output.pointer(), canvas_.pointer());
+    publishFrame();
+}
 
-    yuv422_clear_to_black(output);
-
-    {
-        auto lock(rwMutex_.read());
+// rwMutex_ must be held
+void
+VideoMixer::computeLayout()
+{
+    const int n = sources_.size();
+    if (n == 0)
+        return;
 
-        int i = 0;
+    int i = 0;
+    if (layout_ == Layout::ONE_BIG_WITH_SMALL and n > 1) {
+        const int strip_height = (height_ / 4) & ~1;
+        const int small_width = (width_ / (n - 1)) & ~1;
         for (const auto& x : sources_) {
-            /* thread stop pending? */
-            if (!loop_.isRunning())
-                return;
-
-            // make rendered frame temporarily unavailable for update()
-            // to avoid concurrent access.
-            std::unique_ptr<VideoFrame> input;
-            x->atomic_swap_render(input);
-
-            if (input)
-                render_frame(output, *input, i);
-
-            x->atomic_swap_render(input);
+            if (i == 0) {
+                x->x = x->y = 0;
+                x->width = width_ & ~1;
+                x->height = (height_ - strip_height) & ~1;
+            } else {
+                x->x = (i - 1) * small_width;
+                x->y = height_ - strip_height;
+                x->width = small_width;
+                x->height = strip_height;
+            }
+            ++i;
+        }
+    } else {
+        const int zoom = ceil(sqrt(n));
+        const int cell_width = (width_ / zoom) & ~1;
+        const int cell_height = (height_ / zoom) & ~1;
+        for (const auto& x : sources_) {
+            x->x = (i % zoom) * cell_width;
+            x->y = (i / zoom) * cell_height;
+            x->width = cell_width;
+            x->height = cell_height;
             ++i;
         }
     }
 
-    publishFrame();
+    // the whole output was cleared
+    for (const auto& x : sources_)
+        x->rendered_width = x->rendered_height = 0;
 }
 
 void
-VideoMixer::render_frame(VideoFrame& output, const VideoFrame& input, int index)
+VideoMixer::render_frame(VideoMixerSource& source)
 {
-    if (!width_ or !height_ or !input.pointer())
+    const auto& input = *source.render_frame;
+    if (!source.width or !source.height or !input.pointer())
         return;
 
-    const int n = sources_.size();
-    const int zoom = ceil(sqrt(n));
-    int cell_width = width_ / zoom;
-    int cell_height = height_ / zoom;
-    int xoff = (index % zoom) * cell_width;
-    int yoff = (index / zoom) * cell_height;
+    // keeping the aspect ratio leaves borders, cleared when the input size changes
+    if (input.width() != source.rendered_width or input.height() != source.rendered_height) {
+        clear_rect(canvas_, source.x, source.y, source.width, source.height);
+        source.rendered_width = input.width();
+        source.rendered_height = input.height();
+    }
 
-    scaler_.scale_and_pad(input, output, xoff, yoff, cell_width, cell_height, true);
+    source.scaler.scale_and_pad(input, canvas_, source.x, source.y,
+                                source.width, source.height, true);
 }
 
 void
@@ -186,15 +321,26 @@ VideoMixer::setDimensions(int width, int height)
 
     width_ = width;
     height_ = height;
-
-    // cleanup the previous frame to have a nice copy in rendering method
-    std::shared_ptr<VideoFrame> previous_p(obtainLastFrame());
-    if (previous_p)
-        yuv422_clear_to_black(*previous_p);
+    layoutChanged_ = true;
 
     start_sink();
 }
 
+void
+VideoMixer::setLayout(Layout layout)
+{
+    auto lock(rwMutex_.write());
+    layout_ = layout;
+    layoutChanged_ = true;
+}
+
+void
+VideoMixer::setFrameRate(double fps)
+{
+    if (fps > 0)
+        frameDurationUs_ = 1000000 / fps;
+}
+
 void
 VideoMixer::start_sink()
 {
@@ -231,6 +377,6 @@ VideoMixer::getHeight() const
 
 int
 VideoMixer::getPixelFormat() const
-{ return VIDEO_PIXFMT_YUYV422; }
+{ return VIDEO_PIXFMT_YUV420P; }
 
 }} // namespace ring::video
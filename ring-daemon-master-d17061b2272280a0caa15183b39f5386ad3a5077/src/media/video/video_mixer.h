@@ -22,10 +22,11 @@
 
 #include "noncopyable.h"
 #include "video_base.h"
-#include "video_scaler.h"
+#include "media_buffer.h"
 #include "threadloop.h"
 #include "rw_mutex.h"
 
+#include <atomic>
 #include <list>
 #include <chrono>
 #include <memory>
@@ -34,15 +35,30 @@ namespace ring { namespace video {
 
 class SinkClient;
 
+/**
+ * Composes the frames of its sources in a single YUV420P frame.
+ *
+ * Only the tiles of the sources having a new frame are rendered again,
+ * in parallel on the thread pool, each tile keeping its own scaler.
+ */
 class VideoMixer:
         public VideoGenerator,
         public VideoFramePassiveReader
 {
 public:
+    enum class Layout {
+        /** Sources in equal tiles */
+        GRID,
+        /** First source (the local camera) large, others in a strip below */
+        ONE_BIG_WITH_SMALL
+    };
+
     VideoMixer(const std::string& id);
     ~VideoMixer();
 
     void setDimensions(int width, int height);
+    void setLayout(Layout layout);
+    void setFrameRate(double fps);
 
     int getWidth() const override;
     int getHeight() const override;
@@ -57,8 +73,10 @@ private:
     NON_COPYABLE(VideoMixer);
 
     struct VideoMixerSource;
+    struct RenderBatch;
 
-    void render_frame(VideoFrame& output, const VideoFrame& input, int index);
+    void computeLayout();
+    void render_frame(VideoMixerSource& source);
 
     void start_sink();
     void stop_sink();
@@ -68,14 +86,20 @@ private:
     const std::string id_;
     int width_ = 0;
     int height_ = 0;
+    Layout layout_ {Layout::GRID};
     std::list<std::unique_ptr<VideoMixerSource>> sources_;
     rw_mutex rwMutex_;
 
+    /** Set when tiles must be computed and rendered again */
+    std::atomic<bool> layoutChanged_ {true};
+    /** Composed frame, only changed tiles are rendered in it */
+    VideoFrame canvas_;
+
     std::shared_ptr<SinkClient> sink_;
 
-    std::chrono::time_point<std::chrono::system_clock> lastProcess_;
+    std::atomic<int64_t> frameDurationUs_;
+    std::chrono::steady_clock::time_point nextProcess_;
     std::shared_ptr<VideoFrameActiveWriter> videoLocal_;
-    VideoScaler scaler_;
 
     ThreadLoop loop_; // as to be last member
 };
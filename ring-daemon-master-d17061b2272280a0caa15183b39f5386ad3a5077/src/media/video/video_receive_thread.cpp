@@ -23,11 +23,11 @@
 #include "video_receive_thread.h"
 #include "media/media_decoder.h"
 #include "socket_pair.h"
+#include "media_stats.h"
 #include "manager.h"
 #include "client/videomanager.h"
 #include "sinkclient.h"
 #include "logger.h"
-#include "smartools.h"
 
 #include <unistd.h>
 #include <map>
@@ -39,6 +39,7 @@ using std::string;
 VideoReceiveThread::VideoReceiveThread(const std::string& id,
                                        const std::string &sdp,
                                        const bool isReset,
+                                       MediaStreamStats& stats,
                                        uint16_t mtu) :
     VideoGenerator::VideoGenerator()
     , args_()
@@ -50,6 +51,7 @@ VideoReceiveThread::VideoReceiveThread(const std::string& id,
     , sink_ {Manager::instance().createSinkClient(id)}
     , restartDecoder_(false)
     , isReset_(isReset)
+    , stats_(stats)
     , mtu_(mtu)
     , requestKeyFrameCallback_(0)
     , loop_(std::bind(&VideoReceiveThread::setup, this),
@@ -130,8 +132,8 @@ bool VideoReceiveThread::setup()
     if (!conf)
         exitConference();
 
-    // Send remote video codec in SmartInfo
-    Smartools::getInstance().setRemoteVideoCodec(videoDecoder_->getDecoderName(), id_);
+    videoDecoder_->setStats(&stats_);
+    stats_.setCodec(videoDecoder_->getDecoderName());
 
     return true;
 }
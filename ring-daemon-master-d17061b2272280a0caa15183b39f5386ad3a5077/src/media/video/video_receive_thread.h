@@ -39,6 +39,7 @@
 namespace ring {
 class SocketPair;
 class MediaDecoder;
+class MediaStreamStats;
 } // namespace ring
 
 namespace ring { namespace video {
@@ -47,7 +48,8 @@ class SinkClient;
 
 class VideoReceiveThread : public VideoGenerator {
 public:
-    VideoReceiveThread(const std::string &id, const std::string &sdp, const bool isReset, uint16_t mtu);
+    VideoReceiveThread(const std::string &id, const std::string &sdp, const bool isReset,
+                       MediaStreamStats& stats, uint16_t mtu);
     ~VideoReceiveThread();
     void startLoop();
 
@@ -80,6 +82,7 @@ private:
     std::shared_ptr<SinkClient> sink_;
     std::atomic_bool restartDecoder_;
     bool isReset_;
+    MediaStreamStats& stats_;
     uint16_t mtu_;
 
     void (*requestKeyFrameCallback_)(const std::string &);
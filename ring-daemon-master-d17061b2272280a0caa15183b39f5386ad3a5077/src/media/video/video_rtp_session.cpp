@@ -22,6 +22,7 @@
 #include "client/videomanager.h"
 #include "video_rtp_session.h"
 #include "video_sender.h"
+#include "shared_video_encoder.h"
 #include "video_receive_thread.h"
 #include "video_mixer.h"
 #include "ice_socket.h"
@@ -84,6 +85,7 @@ void VideoRtpSession::startSender()
                 videoLocal_->detach(sender_.get());
             if (videoMixer_)
                 videoMixer_->detach(sender_.get());
+            detachSharedEncoder();
             RING_WARN("Restarting video sender");
         }
 
@@ -115,7 +117,8 @@ void VideoRtpSession::startSender()
             sender_.reset();
             socketPair_->stopSendOp(false);
             sender_.reset(new VideoSender(getRemoteRtpUri(), localVideoParams_,
-                                          send_, *socketPair_, initSeqVal_, mtu_));
+                                          send_, *socketPair_, stats_->videoSend,
+                                          initSeqVal_, mtu_));
         } catch (const MediaEncoderException &e) {
             RING_ERR("%s", e.what());
             send_.enabled = false;
@@ -151,7 +154,8 @@ void VideoRtpSession::startReceiver()
             isReset = true;
         }
         receiveThread_.reset(
-                             new VideoReceiveThread(callID_, receive_.receiving_sdp, isReset, mtu_)
+                             new VideoReceiveThread(callID_, receive_.receiving_sdp, isReset,
+                                                    stats_->videoReceive, mtu_)
         );
 
         /* ebail: keyframe requests can lead to timeout if they are not answered.
@@ -198,6 +202,9 @@ void VideoRtpSession::start(std::unique_ptr<IceSocket> rtp_sock,
         else
             socketPair_.reset(new SocketPair(getRemoteRtpUri().c_str(), receive_.addr.getPort()));
 
+        stats_->videoReceive.setClockRate(receive_.rtp_clockrate);
+        socketPair_->setStats(&stats_->videoSend, &stats_->videoReceive);
+
         if (send_.crypto and receive_.crypto) {
             socketPair_->createSRTP(receive_.crypto.getCryptoSuite().c_str(),
                                     receive_.crypto.getSrtpKeyInfo().c_str(),
@@ -226,6 +233,7 @@ void VideoRtpSession::stop()
 
     if (videoMixer_) {
         videoMixer_->detach(sender_.get());
+        detachSharedEncoder();
         if (receiveThread_)
             receiveThread_->detach(videoMixer_.get());
     }
@@ -249,7 +257,9 @@ void VideoRtpSession::stop()
 void VideoRtpSession::forceKeyFrame()
 {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
-    if (sender_)
+    if (sharedEncoder_)
+        sharedEncoder_->forceKeyFrame();
+    else if (sender_)
         sender_->forceKeyFrame();
 }
 
@@ -277,7 +287,15 @@ VideoRtpSession::setupConferenceVideoPipeline(Conference& conference)
         // Swap sender from local video to conference video mixer
         if (videoLocal_)
             videoLocal_->detach(sender_.get());
-        videoMixer_->attach(sender_.get());
+        detachSharedEncoder();
+        try {
+            // participants encoding alike share the same encoder
+            sharedEncoder_ = SharedVideoEncoder::get(videoMixer_, localVideoParams_, send_);
+            sharedEncoder_->addSender(*sender_);
+        } catch (const MediaEncoderException& e) {
+            RING_WARN("[call:%s] Can't share video encoder: %s", callID_.c_str(), e.what());
+            videoMixer_->attach(sender_.get());
+        }
     } else
         RING_WARN("[call:%s] no sender", callID_.c_str());
 
@@ -288,6 +306,16 @@ VideoRtpSession::setupConferenceVideoPipeline(Conference& conference)
         RING_WARN("[call:%s] no receiver", callID_.c_str());
 }
 
+void
+VideoRtpSession::detachSharedEncoder()
+{
+    if (sharedEncoder_) {
+        if (sender_)
+            sharedEncoder_->removeSender(*sender_);
+        sharedEncoder_.reset();
+    }
+}
+
 void
 VideoRtpSession::enterConference(Conference* conference)
 {
@@ -319,6 +347,7 @@ void VideoRtpSession::exitConference()
     if (videoMixer_) {
         if (sender_)
             videoMixer_->detach(sender_.get());
+        detachSharedEncoder();
 
         if (receiveThread_) {
             receiveThread_->detach(videoMixer_.get());
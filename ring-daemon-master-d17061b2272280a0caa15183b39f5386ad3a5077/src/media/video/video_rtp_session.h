@@ -39,6 +39,7 @@ namespace ring { namespace video {
 
 class VideoMixer;
 class VideoSender;
+class SharedVideoEncoder;
 class VideoReceiveThread;
 
 struct VideoBitrateInfo {
@@ -83,6 +84,7 @@ public:
 private:
     void setupConferenceVideoPipeline(Conference& conference);
     void setupVideoPipeline();
+    void detachSharedEncoder();
     void startSender();
     void startReceiver();
 
@@ -96,6 +98,7 @@ private:
     std::unique_ptr<VideoReceiveThread> receiveThread_;
     Conference* conference_ {nullptr};
     std::shared_ptr<VideoMixer> videoMixer_;
+    std::shared_ptr<SharedVideoEncoder> sharedEncoder_;
     std::shared_ptr<VideoFrameActiveWriter> videoLocal_;
     uint16_t initSeqVal_ = 0;
 
@@ -20,13 +20,14 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
  */
 
+#include "libav_deps.h" // MUST BE INCLUDED FIRST
 #include "video_sender.h"
 #include "video_mixer.h"
 #include "socket_pair.h"
+#include "media_stats.h"
 #include "client/videomanager.h"
 #include "logger.h"
 #include "manager.h"
-#include "smartools.h"
 
 #include <map>
 #include <unistd.h>
@@ -37,10 +38,13 @@ using std::string;
 
 VideoSender::VideoSender(const std::string& dest, const DeviceParams& dev,
                          const MediaDescription& args, SocketPair& socketPair,
+                         MediaStreamStats& stats,
                          const uint16_t seqVal,
                          uint16_t mtu)
     : muxContext_(socketPair.createIOContext(mtu))
     , videoEncoder_(new MediaEncoder)
+    , socketPair_(socketPair)
+    , stats_(stats)
 {
     videoEncoder_->setDeviceOptions(dev);
     keyFrameFreq_ = dev.framerate.numerator() * KEY_FRAME_PERIOD;
@@ -50,10 +54,14 @@ VideoSender::VideoSender(const std::string& dest, const DeviceParams& dev,
     videoEncoder_->startIO();
 
     videoEncoder_->print_sdp();
+    stats_.setCodec(videoEncoder_->getEncoderName());
 }
 
 VideoSender::~VideoSender()
 {
+    stopMailbox();
+    if (auto dropped = getDroppedCount())
+        RING_DBG("%llu frames dropped by the encoder", (unsigned long long)dropped);
     videoEncoder_->flush();
 }
 
@@ -67,20 +75,44 @@ VideoSender::encodeAndSendVideo(VideoFrame& input_frame)
     if (is_keyframe)
         --forceKeyFrame_;
 
+    const auto encodeStart = MediaStreamStats::clock::now();
+
+    // The packets of a frame are sent together
+    socketPair_.beginSendBatch();
     if (videoEncoder_->encode(input_frame, is_keyframe, frameNumber_++) < 0)
         RING_ERR("encoding failed");
+    socketPair_.endSendBatch();
 
-    // Send local video codec in SmartInfo
-    Smartools::getInstance().setLocalVideoCodec(videoEncoder_->getEncoderName());
+    stats_.onFrame(MediaStreamStats::clock::now() - encodeStart);
+    stats_.setFrameSize(videoEncoder_->getWidth(), videoEncoder_->getHeight());
 }
 
 void
-VideoSender::update(Observable<std::shared_ptr<VideoFrame>>* /*obs*/,
+VideoSender::process(Observable<std::shared_ptr<VideoFrame>>* /*obs*/,
                     const std::shared_ptr<VideoFrame>& frame_p)
 {
     encodeAndSendVideo(*frame_p);
 }
 
+void
+VideoSender::sendPacket(const AVPacket& pkt, const MediaEncoder& source, bool resync,
+                        std::chrono::steady_clock::duration encodeTime)
+{
+    // keep timestamps of this RTP stream monotonic
+    if (resync) {
+        ptsOffset_ = frameNumber_ - pkt.pts;
+        stats_.setCodec(source.getEncoderName());
+        stats_.setFrameSize(source.getWidth(), source.getHeight());
+    }
+    frameNumber_ = pkt.pts + ptsOffset_ + 1;
+
+    socketPair_.beginSendBatch();
+    videoEncoder_->send(pkt, source, ptsOffset_);
+    socketPair_.endSendBatch();
+
+    stats_.onFrame(encodeTime);
+}
+
 void
 VideoSender::forceKeyFrame()
 {
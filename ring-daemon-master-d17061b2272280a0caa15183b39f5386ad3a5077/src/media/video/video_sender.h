@@ -30,22 +30,25 @@
 #include <string>
 #include <memory>
 #include <atomic>
+#include <chrono>
 
 // Forward declarations
 namespace ring {
 class SocketPair;
+class MediaStreamStats;
 struct AccountVideoCodecInfo;
 }
 
 namespace ring { namespace video {
 
-class VideoSender : public VideoFramePassiveReader
+class VideoSender : public VideoFrameAsyncReader
 {
 public:
     VideoSender(const std::string& dest,
                 const DeviceParams& dev,
                 const MediaDescription& args,
                 SocketPair& socketPair,
+                MediaStreamStats& stats,
                 const uint16_t seqVal,
                 uint16_t mtu);
 
@@ -53,9 +56,12 @@ public:
 
     void forceKeyFrame();
 
-    // as VideoFramePassiveReader
-    void update(Observable<std::shared_ptr<VideoFrame>>* obs,
-                const std::shared_ptr<VideoFrame>& frame_p) override;
+    /**
+     * Send a packet encoded by a SharedVideoEncoder in encodeTime.
+     * Timestamps are resynchronized on the first packet (resync set).
+     */
+    void sendPacket(const AVPacket& pkt, const MediaEncoder& source, bool resync,
+                    std::chrono::steady_clock::duration encodeTime);
 
     void setMuted(bool isMuted);
     uint16_t getLastSeqValue();
@@ -68,15 +74,22 @@ private:
 
     NON_COPYABLE(VideoSender);
 
+    // as VideoFrameAsyncReader, encodes on the mailbox thread
+    void process(Observable<std::shared_ptr<VideoFrame>>* obs,
+                 const std::shared_ptr<VideoFrame>& frame_p) override;
+
     void encodeAndSendVideo(VideoFrame&);
 
     // encoder MUST be deleted before muxContext
     std::unique_ptr<MediaIOHandle> muxContext_ = nullptr;
     std::unique_ptr<MediaEncoder> videoEncoder_ = nullptr;
+    SocketPair& socketPair_;
+    MediaStreamStats& stats_;
 
     std::atomic<int> forceKeyFrame_ {KEYFRAMES_AT_START};
     int keyFrameFreq_ {0}; // Set keyframe rate, 0 to disable auto-keyframe. Computed in constructor
     int64_t frameNumber_ = 0;
+    int64_t ptsOffset_ = 0; // from SharedVideoEncoder timestamps
 };
 }} // namespace ring::video
 
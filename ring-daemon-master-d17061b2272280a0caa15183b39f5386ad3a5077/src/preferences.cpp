@@ -25,6 +25,7 @@
 #include "preferences.h"
 #include "logger.h"
 #include "audio/audiolayer.h"
+#include "audio/null/nulllayer.h"
 #if HAVE_OPENSL
 #include "audio/opensl/opensllayer.h"
 #else
@@ -101,6 +102,7 @@ static const char * const URL_SIP_FIELD_KEY = "urlSipField";
 constexpr const char * const AudioPreference::CONFIG_LABEL;
 static const char * const ALSAMAP_KEY = "alsa";
 static const char * const PULSEMAP_KEY = "pulse";
+static const char * const NULLMAP_KEY = "null";
 static const char * const CARDIN_KEY = "cardIn";
 static const char * const CARDOUT_KEY = "cardOut";
 static const char * const CARDRING_KEY = "cardRing";
@@ -109,8 +111,12 @@ static const char * const SMPLRATE_KEY = "smplRate";
 static const char * const DEVICE_PLAYBACK_KEY = "devicePlayback";
 static const char * const DEVICE_RECORD_KEY = "deviceRecord";
 static const char * const DEVICE_RINGTONE_KEY = "deviceRingtone";
+static const char * const CAPTURE_KEY = "capture";
+static const char * const REALTIME_KEY = "realtime";
 static const char * const RECORDPATH_KEY = "recordPath";
 static const char * const ALWAYS_RECORDING_KEY = "alwaysRecording";
+static const char * const RECORD_FORMAT_KEY = "recordFormat";
+static const char * const RECORD_TRACKS_KEY = "recordTracks";
 static const char * const VOLUMEMIC_KEY = "volumeMic";
 static const char * const VOLUMESPKR_KEY = "volumeSpkr";
 static const char * const NOISE_REDUCE_KEY = "noiseReduce";
@@ -313,8 +319,12 @@ AudioPreference::AudioPreference() :
     , pulseDevicePlayback_("")
     , pulseDeviceRecord_("")
     , pulseDeviceRingtone_("")
+    , nullCapture_("")
+    , nullRealtime_(true)
     , recordpath_("")
     , alwaysRecording_(false)
+    , recordFormat_("wav")
+    , recordTracks_(false)
     , volumemic_(1.0)
     , volumespkr_(1.0)
     , denoise_(false)
@@ -340,6 +350,9 @@ checkSoundCard(int &card, DeviceType type)
 AudioLayer*
 AudioPreference::createAudioLayer()
 {
+    if (audioApi_ == NULL_API_STR)
+        return new NullLayer(*this);
+
 #if HAVE_OPENSL
     return new OpenSLLayer(*this);
 #else
@@ -441,8 +454,16 @@ void AudioPreference::serialize(YAML::Emitter &out)
     out << YAML::Key << DEVICE_RINGTONE_KEY << YAML::Value << pulseDeviceRingtone_;
     out << YAML::EndMap;
 
+    // null submap
+    out << YAML::Key << NULLMAP_KEY << YAML::Value << YAML::BeginMap;
+    out << YAML::Key << CAPTURE_KEY << YAML::Value << nullCapture_;
+    out << YAML::Key << REALTIME_KEY << YAML::Value << nullRealtime_;
+    out << YAML::EndMap;
+
     // more common options!
     out << YAML::Key << RECORDPATH_KEY << YAML::Value << recordpath_;
+    out << YAML::Key << RECORD_FORMAT_KEY << YAML::Value << recordFormat_;
+    out << YAML::Key << RECORD_TRACKS_KEY << YAML::Value << recordTracks_;
     out << YAML::Key << VOLUMEMIC_KEY << YAML::Value << volumemic_;
     out << YAML::Key << VOLUMESPKR_KEY << YAML::Value << volumespkr_;
 
@@ -489,8 +510,15 @@ void AudioPreference::unserialize(const YAML::Node &in)
     parseValue(pulse, DEVICE_RECORD_KEY, pulseDeviceRecord_);
     parseValue(pulse, DEVICE_RINGTONE_KEY, pulseDeviceRingtone_);
 
+    // null submap
+    const auto &null = node[NULLMAP_KEY];
+    parseValue(null, CAPTURE_KEY, nullCapture_);
+    parseValue(null, REALTIME_KEY, nullRealtime_);
+
     // more common options!
     parseValue(node, RECORDPATH_KEY, recordpath_);
+    parseValue(node, RECORD_FORMAT_KEY, recordFormat_);
+    parseValue(node, RECORD_TRACKS_KEY, recordTracks_);
     parseValue(node, VOLUMEMIC_KEY, volumemic_);
     parseValue(node, VOLUMESPKR_KEY, volumespkr_);
 }
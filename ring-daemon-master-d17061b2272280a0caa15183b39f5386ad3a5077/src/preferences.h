@@ -291,6 +291,28 @@ class AudioPreference : public Serializable {
             pulseDeviceRingtone_ = r;
         }
 
+        // null audio layer preference
+        /**
+         * Captured audio: a sound file path, "tone:" followed by a tone
+         * definition (e.g. "tone:440"), or empty for silence.
+         */
+        std::string getNullCapture() const {
+            return nullCapture_;
+        }
+
+        void setNullCapture(const std::string &c) {
+            nullCapture_ = c;
+        }
+
+        /** Run at real speed, or as fast as possible */
+        bool getNullRealtime() const {
+            return nullRealtime_;
+        }
+
+        void setNullRealtime(bool r) {
+            nullRealtime_ = r;
+        }
+
         // general preference
         std::string getRecordPath() const {
             return recordpath_;
@@ -307,6 +329,24 @@ class AudioPreference : public Serializable {
             alwaysRecording_ = rec;
         }
 
+        /** Recording file format: "wav", "flac" or "ogg" */
+        std::string getRecordFormat() const {
+            return recordFormat_;
+        }
+
+        void setRecordFormat(const std::string &f) {
+            recordFormat_ = f;
+        }
+
+        /** Also record each conference participant in its own file */
+        bool getRecordTracks() const {
+            return recordTracks_;
+        }
+
+        void setRecordTracks(bool t) {
+            recordTracks_ = t;
+        }
+
         double getVolumemic() const {
             return volumemic_;
         }
@@ -368,9 +408,15 @@ class AudioPreference : public Serializable {
         std::string pulseDeviceRecord_;
         std::string pulseDeviceRingtone_;
 
+        // null audio layer preference
+        std::string nullCapture_;
+        bool nullRealtime_;
+
         // general preference
         std::string recordpath_; //: /home/msavard/Bureau
         bool alwaysRecording_;
+        std::string recordFormat_;
+        bool recordTracks_;
         double volumemic_;
         double volumespkr_;
 
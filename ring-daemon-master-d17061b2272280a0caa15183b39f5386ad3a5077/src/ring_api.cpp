@@ -46,11 +46,15 @@ init(enum InitFlag flags) noexcept
 {
     ::setDebugMode(flags & DRING_FLAG_DEBUG);
     ::setConsoleLog(flags & DRING_FLAG_CONSOLE_LOG);
+    ::setAsyncLog(flags & DRING_FLAG_ASYNC_LOG);
+    ::setLogRateLimit(flags & DRING_FLAG_LOG_RATE_LIMIT ? LOG_DEFAULT_RATE_LIMIT : 0);
 
     // Following function create a local static variable inside
     // This var must have the same live as Manager.
     // So we call it now to create this var.
     ring::getSignalHandlers();
+    if (flags & DRING_FLAG_ASYNC_SIGNALS)
+        ring::SignalDispatcher::instance().start();
 
     try {
         // current implementation use static variable
@@ -77,6 +81,8 @@ void
 fini() noexcept
 {
     ring::Manager::instance().finish();
+    ring::SignalDispatcher::instance().stop();
+    ::setAsyncLog(false);
 }
 
 void
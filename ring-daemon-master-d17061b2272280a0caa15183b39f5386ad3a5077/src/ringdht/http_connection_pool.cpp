@@ -0,0 +1,546 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "http_connection_pool.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ciso646> // fix windows compiler bug
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define close(x) closesocket(x)
+#define poll WSAPoll
+#define SHUT_RDWR SD_BOTH
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace ring {
+
+constexpr unsigned HttpConnectionPool::DEFAULT_CONNECTIONS;
+constexpr unsigned HttpConnectionPool::DEFAULT_PIPELINE;
+constexpr unsigned HttpConnectionPool::MAX_ATTEMPTS;
+constexpr size_t HttpConnectionPool::MAX_RESPONSE_SIZE;
+const std::chrono::seconds HttpConnectionPool::IDLE_TIMEOUT {30};
+const std::chrono::seconds HttpConnectionPool::IO_TIMEOUT {10};
+
+static constexpr size_t MAX_HEADER_SIZE {64 * 1024};
+/** Period at which a connection attempt checks for the pool destruction */
+static constexpr std::chrono::milliseconds CONNECT_POLL_PERIOD {100};
+
+static bool
+iequals(const std::string& a, const char* b)
+{
+    const auto len = std::strlen(b);
+    if (a.size() != len)
+        return false;
+    for (size_t i = 0; i < len; ++i)
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    return true;
+}
+
+static std::string
+trim(const std::string& s)
+{
+    const auto begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+        return {};
+    return s.substr(begin, s.find_last_not_of(" \t") + 1 - begin);
+}
+
+/**
+ * Reads HTTP responses from a connection. Bytes read past a response
+ * belong to the next one.
+ */
+class ResponseReader {
+    public:
+        ResponseReader(int fd) : fd_(fd) {}
+
+        /**
+         * Read the next response.
+         * keepAlive is false if the server closes the connection after it.
+         */
+        bool read(HttpConnectionPool::Response& response, bool& keepAlive);
+
+    private:
+        /** Read more bytes in buf_, false at the end of the stream or on error */
+        bool receive();
+        bool readLine(std::string& line);
+        bool readBytes(size_t size, std::string& out);
+
+        const int fd_;
+        std::string buf_;
+        size_t pos_ {0};
+        /** Set when the server closed the connection */
+        bool eof_ {false};
+};
+
+bool
+ResponseReader::receive()
+{
+    // Drop what was parsed
+    if (pos_) {
+        buf_.erase(0, pos_);
+        pos_ = 0;
+    }
+    char data[4096];
+    const auto n = ::recv(fd_, data, sizeof(data), 0);
+    if (n == 0)
+        eof_ = true;
+    if (n <= 0)
+        return false;
+    buf_.append(data, n);
+    return true;
+}
+
+bool
+ResponseReader::readLine(std::string& line)
+{
+    size_t end;
+    while ((end = buf_.find("\r\n", pos_)) == std::string::npos) {
+        if (buf_.size() - pos_ > MAX_HEADER_SIZE or not receive())
+            return false;
+    }
+    line = buf_.substr(pos_, end - pos_);
+    pos_ = end + 2;
+    return true;
+}
+
+bool
+ResponseReader::readBytes(size_t size, std::string& out)
+{
+    while (buf_.size() - pos_ < size) {
+        if (not receive())
+            return false;
+    }
+    out.append(buf_, pos_, size);
+    pos_ += size;
+    return true;
+}
+
+bool
+ResponseReader::read(HttpConnectionPool::Response& response, bool& keepAlive)
+{
+    // Status line: HTTP/1.1 200 OK
+    std::string line;
+    if (not readLine(line) or line.compare(0, 5, "HTTP/") != 0 or line.size() < 12)
+        return false;
+    keepAlive = line.compare(5, 3, "1.0") != 0;
+    const auto status = std::strtoul(line.c_str() + 9, nullptr, 10);
+
+    bool chunked = false;
+    bool hasLength = false;
+    size_t length = 0;
+    while (true) {
+        if (not readLine(line))
+            return false;
+        if (line.empty())
+            break;
+        const auto sep = line.find(':');
+        if (sep == std::string::npos)
+            continue;
+        const auto name = line.substr(0, sep);
+        const auto value = trim(line.substr(sep + 1));
+        if (iequals(name, "Content-Length")) {
+            hasLength = true;
+            length = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (iequals(name, "Transfer-Encoding")) {
+            chunked = not iequals(value, "identity");
+        } else if (iequals(name, "Connection")) {
+            if (iequals(value, "close"))
+                keepAlive = false;
+            else if (iequals(value, "keep-alive"))
+                keepAlive = true;
+        }
+    }
+
+    std::string body;
+    if ((status >= 100 and status < 200) or status == 204 or status == 304) {
+        // No body
+    } else if (chunked) {
+        while (true) {
+            if (not readLine(line))
+                return false;
+            const auto size = std::strtoul(line.c_str(), nullptr, 16);
+            if (body.size() + size > HttpConnectionPool::MAX_RESPONSE_SIZE)
+                return false;
+            if (size == 0)
+                break;
+            if (not readBytes(size, body) or not readLine(line))
+                return false;
+        }
+        // Trailers
+        do {
+            if (not readLine(line))
+                return false;
+        } while (not line.empty());
+    } else if (hasLength) {
+        if (length > HttpConnectionPool::MAX_RESPONSE_SIZE or not readBytes(length, body))
+            return false;
+    } else {
+        // Ends with the connection
+        keepAlive = false;
+        while (receive()) {
+            if (buf_.size() > HttpConnectionPool::MAX_RESPONSE_SIZE)
+                return false;
+        }
+        // A timeout or an error doesn't end the body
+        if (not eof_)
+            return false;
+        body = buf_.substr(pos_);
+        pos_ = buf_.size();
+    }
+
+    response.status = status;
+    response.body = std::move(body);
+    return true;
+}
+
+/** Percent-encode what can't appear in a request line */
+static std::string
+encodePath(const std::string& path)
+{
+    static constexpr const char* HEX {"0123456789ABCDEF"};
+    std::string encoded;
+    encoded.reserve(path.size());
+    for (const auto c : path) {
+        const auto b = static_cast<unsigned char>(c);
+        if (b <= ' ' or b >= 0x7f) {
+            encoded += '%';
+            encoded += HEX[b >> 4];
+            encoded += HEX[b & 0xf];
+        } else {
+            encoded += c;
+        }
+    }
+    return encoded;
+}
+
+HttpConnectionPool::HttpConnectionPool(const std::string& host, unsigned connections, unsigned pipeline)
+    : host_(host)
+    , pipeline_(std::max(pipeline, 1u))
+    , sockets_(std::max(connections, 1u), -1)
+    , active_(sockets_.size(), false)
+    , threads_(sockets_.size())
+{
+    // hostname[:port] or [ipv6][:port]
+    auto portSep = host.rfind(':');
+    if (not host.empty() and host[0] == '[') {
+        const auto end = host.find(']');
+        hostname_ = host.substr(1, end - 1);
+        if (end == std::string::npos or portSep < end)
+            portSep = std::string::npos;
+    } else if (portSep != std::string::npos and host.find(':') != portSep) {
+        // ipv6 address without port
+        portSep = std::string::npos;
+        hostname_ = host;
+    } else {
+        hostname_ = host.substr(0, portSep);
+    }
+    port_ = portSep == std::string::npos ? "80" : host.substr(portSep + 1);
+}
+
+HttpConnectionPool::~HttpConnectionPool()
+{
+    std::deque<Request> queue;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        running_ = false;
+        stopping_ = true;
+        queue = std::move(queue_);
+        queue_.clear();
+        // Interrupt the exchanges in progress
+        for (auto fd : sockets_)
+            if (fd >= 0)
+                ::shutdown(fd, SHUT_RDWR);
+    }
+    cv_.notify_all();
+    for (auto& t : threads_)
+        if (t.joinable())
+            t.join();
+    for (auto& r : queue)
+        r.cb({});
+}
+
+void
+HttpConnectionPool::get(const std::string& path, ResponseCallback&& cb)
+{
+    bool queued = false;
+    std::thread finished;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (running_) {
+            queue_.emplace_back(Request {encodePath(path), std::move(cb), 0});
+            queued = true;
+            if (idle_ == 0)
+                startConnection(finished);
+        }
+    }
+    if (finished.joinable())
+        finished.join();
+    if (queued)
+        cv_.notify_one();
+    else
+        cb({});
+}
+
+void
+HttpConnectionPool::startConnection(std::thread& finished)
+{
+    for (size_t i = 0; i < active_.size(); ++i) {
+        if (not active_[i]) {
+            // The previous thread of this connection has stopped
+            finished = std::move(threads_[i]);
+            active_[i] = true;
+            threads_[i] = std::thread(&HttpConnectionPool::run, this, i);
+            return;
+        }
+    }
+}
+
+static bool
+setBlocking(int fd, bool blocking)
+{
+#ifdef _WIN32
+    u_long nonBlocking = blocking ? 0 : 1;
+    return ::ioctlsocket(fd, FIONBIO, &nonBlocking) == 0;
+#else
+    const auto flags = ::fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return false;
+    return ::fcntl(fd, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK) == 0;
+#endif
+}
+
+/** Connect fd within IO_TIMEOUT, false if stopping is set first */
+static bool
+connectSocket(int fd, const sockaddr* addr, socklen_t len, const std::atomic_bool& stopping)
+{
+    // connect() can't be interrupted: wait for it by periods, so the
+    // destructor doesn't wait for IO_TIMEOUT
+    if (not setBlocking(fd, false))
+        return false;
+    if (::connect(fd, addr, len) != 0) {
+#ifdef _WIN32
+        if (WSAGetLastError() != WSAEWOULDBLOCK)
+#else
+        if (errno != EINPROGRESS)
+#endif
+            return false;
+        const auto deadline = std::chrono::steady_clock::now() + HttpConnectionPool::IO_TIMEOUT;
+        while (true) {
+            if (stopping or std::chrono::steady_clock::now() >= deadline)
+                return false;
+            pollfd pfd {};
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            const auto ret = ::poll(&pfd, 1, CONNECT_POLL_PERIOD.count());
+            if (ret > 0)
+                break;
+            if (ret < 0 and errno != EINTR)
+                return false;
+        }
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, (char*)&err, &errLen) != 0 or err != 0)
+            return false;
+    }
+    // Requests and responses rely on the send and receive timeouts
+    return setBlocking(fd, true);
+}
+
+int
+HttpConnectionPool::connect()
+{
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (auto err = ::getaddrinfo(hostname_.c_str(), port_.c_str(), &hints, &result)) {
+        RING_WARN("Can't resolve %s: %s", hostname_.c_str(), gai_strerror(err));
+        return -1;
+    }
+
+    int fd = -1;
+    for (auto ai = result; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+#ifdef _WIN32
+        const DWORD timeout = std::chrono::milliseconds(IO_TIMEOUT).count();
+#else
+        const timeval timeout {static_cast<time_t>(IO_TIMEOUT.count()), 0};
+#endif
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+        if (connectSocket(fd, ai->ai_addr, ai->ai_addrlen, stopping_))
+            break;
+        close(fd);
+        fd = -1;
+        if (stopping_)
+            break;
+    }
+    freeaddrinfo(result);
+
+    if (fd >= 0)
+        ++connectionsOpened_;
+    else if (not stopping_)
+        RING_WARN("Can't connect to %s", host_.c_str());
+    return fd;
+}
+
+void
+HttpConnectionPool::closeSocket(size_t index, int& fd)
+{
+    if (fd < 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        sockets_[index] = -1;
+    }
+    close(fd);
+    fd = -1;
+}
+
+size_t
+HttpConnectionPool::exchange(size_t index, int& fd, std::vector<Request>& batch, size_t& failed)
+{
+    failed = batch.size();
+    if (fd < 0) {
+        fd = connect();
+        if (fd < 0)
+            return 0;
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (not running_) {
+            close(fd);
+            fd = -1;
+            return 0;
+        }
+        sockets_[index] = fd;
+    }
+
+    // All the requests are sent before reading the responses
+    std::string data;
+    for (const auto& r : batch)
+        data += "GET " + r.path + " HTTP/1.1\r\nHost: " + host_ + "\r\nAccept: */*\r\n\r\n";
+    for (size_t sent = 0; sent < data.size();) {
+        const auto n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            closeSocket(index, fd);
+            return 0;
+        }
+        sent += n;
+    }
+
+    ResponseReader reader(fd);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Response response;
+        bool keepAlive;
+        if (not reader.read(response, keepAlive)) {
+            closeSocket(index, fd);
+            // The next ones may not have been read by the server
+            failed = 1;
+            return i;
+        }
+        batch[i].cb(std::move(response));
+        if (not keepAlive) {
+            closeSocket(index, fd);
+            failed = 0;
+            return i + 1;
+        }
+    }
+    failed = 0;
+    return batch.size();
+}
+
+void
+HttpConnectionPool::run(size_t index)
+{
+    int fd = -1;
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (running_) {
+        if (queue_.empty()) {
+            ++idle_;
+            const auto woken = cv_.wait_for(lk, IDLE_TIMEOUT, [this] {
+                return not queue_.empty() or not running_;
+            });
+            --idle_;
+            if (not woken)
+                break;
+            continue;
+        }
+
+        std::vector<Request> batch;
+        while (not queue_.empty() and batch.size() < pipeline_) {
+            batch.emplace_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        lk.unlock();
+
+        size_t failed;
+        const auto answered = exchange(index, fd, batch, failed);
+
+        // Unanswered requests are sent again first, in the same order
+        std::vector<Request> dropped;
+        lk.lock();
+        for (auto i = batch.size(); i-- > answered;) {
+            auto& r = batch[i];
+            if (i < answered + failed)
+                ++r.attempts;
+            if (running_ and r.attempts < MAX_ATTEMPTS)
+                queue_.emplace_front(std::move(r));
+            else
+                dropped.emplace_back(std::move(r));
+        }
+        if (not dropped.empty()) {
+            lk.unlock();
+            for (auto r = dropped.rbegin(); r != dropped.rend(); ++r)
+                r->cb({});
+            lk.lock();
+        }
+        if (answered < batch.size())
+            cv_.notify_one();
+    }
+
+    // Closed with the lock held: the next thread of this connection may
+    // start as soon as it is released
+    if (fd >= 0) {
+        sockets_[index] = -1;
+        close(fd);
+    }
+    active_[index] = false;
+}
+
+} // namespace ring
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ring {
+
+/**
+ * Persistent HTTP/1.1 connections to a host, for small GET requests.
+ *
+ * Each connection has its own thread, which sends the queued requests
+ * by batches of up to "pipeline" requests and reads the responses in
+ * order. Connections are opened when requests are queued, kept open
+ * between batches, and closed with their thread after IDLE_TIMEOUT.
+ * Requests left unanswered by a closed connection are sent again, up to
+ * MAX_ATTEMPTS times.
+ */
+class HttpConnectionPool {
+    public:
+        struct Response {
+            /** 0 if no valid response was received */
+            unsigned status {0};
+            std::string body;
+        };
+        using ResponseCallback = std::function<void(Response&& response)>;
+
+        static constexpr unsigned DEFAULT_CONNECTIONS {2};
+        static constexpr unsigned DEFAULT_PIPELINE {8};
+        static constexpr unsigned MAX_ATTEMPTS {3};
+        static constexpr size_t MAX_RESPONSE_SIZE {1024 * 1024};
+        static const std::chrono::seconds IDLE_TIMEOUT;
+        static const std::chrono::seconds IO_TIMEOUT;
+
+        /**
+         * @param host "hostname[:port]", port 80 by default
+         */
+        HttpConnectionPool(const std::string& host,
+                           unsigned connections = DEFAULT_CONNECTIONS,
+                           unsigned pipeline = DEFAULT_PIPELINE);
+
+        /** Queued requests are answered with status 0 */
+        ~HttpConnectionPool();
+
+        /**
+         * Queue a GET request of path.
+         * Control characters, spaces and non-ASCII bytes of path are
+         * percent-encoded: they can't end the request line.
+         * cb is called from a thread of the pool.
+         */
+        void get(const std::string& path, ResponseCallback&& cb);
+
+        /** Connections opened since the creation of the pool */
+        unsigned connectionsOpened() const {
+            return connectionsOpened_;
+        }
+
+    private:
+        NON_COPYABLE(HttpConnectionPool);
+
+        struct Request {
+            std::string path;
+            ResponseCallback cb;
+            unsigned attempts;
+        };
+
+        /** Must be called with mutex_ held. */
+        void startConnection(std::thread& finished);
+        void run(size_t index);
+        int connect();
+        void closeSocket(size_t index, int& fd);
+
+        /**
+         * Send the requests and read their responses on fd, opened if
+         * needed. Return the number of requests answered, failed is the
+         * number of the next ones that count as an attempt.
+         */
+        size_t exchange(size_t index, int& fd, std::vector<Request>& batch, size_t& failed);
+
+        const std::string host_;
+        std::string hostname_;
+        std::string port_;
+        const unsigned pipeline_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<Request> queue_;
+        bool running_ {true};
+        /** Set with running_, read without mutex_ while connecting */
+        std::atomic_bool stopping_ {false};
+        /** Threads waiting for a request */
+        unsigned idle_ {0};
+        /** Socket of each connection, to interrupt them on destruction */
+        std::vector<int> sockets_;
+        /** Whether the thread of each connection is running */
+        std::vector<bool> active_;
+        std::vector<std::thread> threads_;
+
+        std::atomic<unsigned> connectionsOpened_ {0};
+};
+
+} // namespace ring
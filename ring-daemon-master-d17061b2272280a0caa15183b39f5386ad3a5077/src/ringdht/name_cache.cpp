@@ -0,0 +1,158 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "name_cache.h"
+
+#include <msgpack.hpp>
+
+#include <functional>
+#include <map>
+#include <sstream>
+#include <ciso646> // fix windows compiler bug
+
+namespace ring {
+
+// Names are registered for good, but refreshed from time to time
+const NameCache::clock::duration NameCache::FOUND_TTL = std::chrono::hours(24 * 7);
+// Unknown names may be registered at any time
+const NameCache::clock::duration NameCache::NOT_FOUND_TTL = std::chrono::minutes(5);
+
+constexpr size_t NameCache::Index::SHARDS;
+
+static constexpr uint8_t CACHE_VERSION {1};
+
+NameCache::Index::Shard&
+NameCache::Index::getShard(const std::string& key)
+{
+    return shards_[std::hash<std::string>()(key) % SHARDS];
+}
+
+NameCache::Status
+NameCache::Index::get(const std::string& key, std::string& value)
+{
+    auto& shard = getShard(key);
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end())
+        return Status::unknown;
+    if (it->second.expiration <= clock::now()) {
+        shard.entries.erase(it);
+        return Status::unknown;
+    }
+    if (it->second.value.empty())
+        return Status::notFound;
+    value = it->second.value;
+    return Status::found;
+}
+
+void
+NameCache::Index::set(const std::string& key, Entry&& entry)
+{
+    auto& shard = getShard(key);
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    const auto now = clock::now();
+    if (now >= shard.nextSweep) {
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (it->second.expiration <= now)
+                it = shard.entries.erase(it);
+            else
+                ++it;
+        }
+        shard.nextSweep = now + NOT_FOUND_TTL;
+    }
+    shard.entries[key] = std::move(entry);
+}
+
+NameCache::Status
+NameCache::getAddress(const std::string& name, std::string& addr)
+{
+    return names_.get(name, addr);
+}
+
+NameCache::Status
+NameCache::getName(const std::string& addr, std::string& name)
+{
+    return addrs_.get(addr, name);
+}
+
+void
+NameCache::setFound(const std::string& name, const std::string& addr, clock::time_point expiration)
+{
+    names_.set(name, {addr, expiration});
+    addrs_.set(addr, {name, expiration});
+}
+
+void
+NameCache::setNameNotFound(const std::string& name)
+{
+    names_.set(name, {{}, clock::now() + NOT_FOUND_TTL});
+}
+
+void
+NameCache::setAddressNotFound(const std::string& addr)
+{
+    addrs_.set(addr, {{}, clock::now() + NOT_FOUND_TTL});
+}
+
+std::string
+NameCache::pack() const
+{
+    std::map<std::string, std::pair<std::string, int64_t>> found;
+    names_.forEachFound(clock::now(), [&](const std::string& name, const Entry& e) {
+        found.emplace(name, std::make_pair(e.value, static_cast<int64_t>(clock::to_time_t(e.expiration))));
+    });
+
+    std::stringstream ss;
+    msgpack::pack(ss, CACHE_VERSION);
+    msgpack::pack(ss, found);
+    return ss.str();
+}
+
+size_t
+NameCache::unpack(const char* data, size_t size)
+{
+    size_t offset = 0;
+    auto result = msgpack::unpack(data, size, offset);
+
+    // Previous versions saved a map of address -> name
+    if (result.get().type == msgpack::type::MAP) {
+        const auto names = result.get().as<std::map<std::string, std::string>>();
+        for (const auto& n : names)
+            setFound(n.second, n.first);
+        return names.size();
+    }
+
+    const auto version = result.get().as<uint8_t>();
+    if (version != CACHE_VERSION)
+        throw msgpack::type_error();
+
+    result = msgpack::unpack(data, size, offset);
+    const auto found = result.get().as<std::map<std::string, std::pair<std::string, int64_t>>>();
+    const auto now = clock::now();
+    size_t loaded = 0;
+    for (const auto& f : found) {
+        const auto expiration = clock::from_time_t(static_cast<time_t>(f.second.second));
+        if (expiration <= now)
+            continue;
+        setFound(f.first, f.second.first, expiration);
+        ++loaded;
+    }
+    return loaded;
+}
+
+} // namespace ring
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include "noncopyable.h"
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ring {
+
+/**
+ * Name-address mappings known from a name server.
+ *
+ * Found mappings expire after FOUND_TTL, names and addresses the server
+ * doesn't know after NOT_FOUND_TTL. Thread-safe: keys are spread on
+ * shards locked independently.
+ */
+class NameCache {
+    public:
+        using clock = std::chrono::system_clock;
+        enum class Status { unknown, found, notFound };
+
+        static const clock::duration FOUND_TTL;
+        static const clock::duration NOT_FOUND_TTL;
+
+        NameCache() {}
+
+        Status getAddress(const std::string& name, std::string& addr);
+        Status getName(const std::string& addr, std::string& name);
+
+        void setFound(const std::string& name, const std::string& addr, clock::time_point expiration);
+        void setFound(const std::string& name, const std::string& addr) {
+            setFound(name, addr, clock::now() + FOUND_TTL);
+        }
+        void setNameNotFound(const std::string& name);
+        void setAddressNotFound(const std::string& addr);
+
+        /** Serialize the found mappings with msgpack */
+        std::string pack() const;
+
+        /**
+         * Add the mappings serialized by pack(), or by previous versions.
+         * Return the number of mappings added.
+         * Throw msgpack::unpack_error or msgpack::type_error.
+         */
+        size_t unpack(const char* data, size_t size);
+
+    private:
+        NON_COPYABLE(NameCache);
+
+        /** The value is empty for a key not found */
+        struct Entry {
+            std::string value;
+            clock::time_point expiration;
+        };
+
+        class Index {
+            public:
+                Index() {}
+                Status get(const std::string& key, std::string& value);
+                void set(const std::string& key, Entry&& entry);
+
+                template <typename Callback>
+                void forEachFound(clock::time_point now, Callback&& cb) const {
+                    for (const auto& shard : shards_) {
+                        std::lock_guard<std::mutex> lk(shard.mutex);
+                        for (const auto& e : shard.entries)
+                            if (not e.second.value.empty() and e.second.expiration > now)
+                                cb(e.first, e.second);
+                    }
+                }
+
+            private:
+                NON_COPYABLE(Index);
+
+                static constexpr size_t SHARDS {16};
+
+                struct Shard {
+                    mutable std::mutex mutex;
+                    std::unordered_map<std::string, Entry> entries;
+                    /** Expired entries are removed at most once per NOT_FOUND_TTL */
+                    clock::time_point nextSweep;
+                };
+
+                Shard& getShard(const std::string& key);
+
+                std::array<Shard, SHARDS> shards_;
+        };
+
+        /** name -> address */
+        Index names_;
+        /** address -> name */
+        Index addrs_;
+};
+
+} // namespace ring
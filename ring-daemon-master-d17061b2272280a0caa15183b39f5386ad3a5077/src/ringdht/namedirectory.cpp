@@ -21,6 +21,8 @@
 #include "string_utils.h"
 #include "thread_pool.h"
 #include "fileutils.h"
+#include "config/config_writer.h"
+#include "http_connection_pool.h"
 
 #include <msgpack.hpp>
 #include <json/json.h>
@@ -41,6 +43,8 @@ constexpr const char* const HTTP_PROTO {"http://"};
 /** Parser for Ring URIs.         ( protocol        )    ( username         ) ( hostname                            ) */
 const std::regex URI_VALIDATOR {"^([a-zA-Z]+:(?://)?)?(?:([a-z0-9-_]{1,64})@)?([a-zA-Z0-9\\-._~%!$&'()*+,;=:\\[\\]]+)"};
 const std::regex NAME_VALIDATOR {"^[a-zA-Z0-9-_]{3,32}$"};
+/** Ring account addresses are 160-bit hashes in hexadecimal */
+const std::regex ADDR_VALIDATOR {"^[0-9a-fA-F]{40}$"};
 
 constexpr size_t MAX_RESPONSE_SIZE {1024 * 1024};
 
@@ -68,25 +72,58 @@ NameDirectory::lookupUri(const std::string& uri, const std::string& default_serv
 
 NameDirectory::NameDirectory(const std::string& s)
    : serverHost_(s),
-     cachePath_(fileutils::get_cache_dir()+DIR_SEPARATOR_STR+"namecache"+DIR_SEPARATOR_STR+serverHost_)
+     cachePath_(fileutils::get_cache_dir()+DIR_SEPARATOR_STR+"namecache"+DIR_SEPARATOR_STR+serverHost_),
+     cacheWriter_(new ConfigWriter(cachePath_, [this]{ return cache_.pack(); })),
+     lookupPool_(new HttpConnectionPool(serverHost_))
+{}
+
+NameDirectory::~NameDirectory()
 {}
 
 void
 NameDirectory::load()
 {
+    fileutils::recursive_mkdir(fileutils::get_cache_dir()+DIR_SEPARATOR_STR+"namecache");
     loadCache();
 }
 
 NameDirectory& NameDirectory::instance(const std::string& server)
 {
     const std::string& s = server.empty() ? DEFAULT_SERVER_HOST : server;
+    static std::mutex instancesMutex;
     static std::map<std::string, NameDirectory> instances {};
-    auto r = instances.emplace(s, NameDirectory{s});
+    std::lock_guard<std::mutex> lock(instancesMutex);
+    auto r = instances.emplace(std::piecewise_construct, std::forward_as_tuple(s), std::forward_as_tuple(s));
     if (r.second)
         r.first->second.load();
     return r.first->second;
 }
 
+bool
+NameDirectory::addPendingLookup(PendingLookups& pending, const std::string& key, LookupCallback&& cb)
+{
+    std::lock_guard<std::mutex> lock(lookupsMutex_);
+    auto& callbacks = pending[key];
+    callbacks.emplace_back(std::move(cb));
+    return callbacks.size() == 1;
+}
+
+void
+NameDirectory::endLookup(PendingLookups& pending, const std::string& key, const std::string& result, Response response)
+{
+    std::vector<LookupCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(lookupsMutex_);
+        auto it = pending.find(key);
+        if (it == pending.end())
+            return;
+        callbacks = std::move(it->second);
+        pending.erase(it);
+    }
+    for (const auto& cb : callbacks)
+        cb(result, response);
+}
+
 size_t getContentLength(restbed::Response& reply)
 {
     size_t length = 0;
@@ -99,137 +136,116 @@ size_t getContentLength(restbed::Response& reply)
 
 void NameDirectory::lookupAddress(const std::string& addr, LookupCallback cb)
 {
-    try {
-        auto cacheRes = nameCache_.find(addr);
-        if (cacheRes != nameCache_.end()) {
-            cb(cacheRes->second, Response::found);
-            return;
-        }
-
-        restbed::Uri uri(HTTP_PROTO + serverHost_ + QUERY_ADDR + addr);
-        auto req = std::make_shared<restbed::Request>(uri);
-        req->set_header("Accept", "*/*");
-        req->set_header("Host", serverHost_);
-
-        RING_DBG("Address lookup for %s: %s", addr.c_str(), uri.to_string().c_str());
+    if (not validateAddress(addr)) {
+        cb("", Response::invalidName);
+        return;
+    }
 
-        auto ret = restbed::Http::async(req, [this,cb,addr](const std::shared_ptr<restbed::Request>&,
-                                                 const std::shared_ptr<restbed::Response>& reply) {
-            auto code = reply->get_status_code();
-            if (code == 200) {
-                size_t length = getContentLength(*reply);
-                if (length > MAX_RESPONSE_SIZE) {
-                    cb("", Response::error);
-                    return;
-                }
-                restbed::Http::fetch(length, reply);
-                std::string body;
-                reply->get_body(body);
+    std::string cachedName;
+    switch (cache_.getName(addr, cachedName)) {
+    case NameCache::Status::found:
+        cb(cachedName, Response::found);
+        return;
+    case NameCache::Status::notFound:
+        cb("", Response::notFound);
+        return;
+    default:
+        break;
+    }
 
-                Json::Value json;
-                Json::Reader reader;
-                if (!reader.parse(body, json)) {
-                    RING_ERR("Address lookup for %s: can't parse server response: %s", addr.c_str(), body.c_str());
-                    cb("", Response::error);
-                    return;
-                }
-                auto name = json["name"].asString();
-                if (not name.empty()) {
-                    RING_DBG("Found name for %s: %s", addr.c_str(), name.c_str());
-                    addrCache_.emplace(name, addr);
-                    nameCache_.emplace(addr, name);
-                    cb(name, Response::found);
-                    saveCache();
-                } else {
-                    cb("", Response::notFound);
-                }
-            } else if (code >= 400 && code < 500) {
-                cb("", Response::notFound);
+    // The first lookup sends the request, the others wait for its response
+    if (not addPendingLookup(pendingAddrs_, addr, std::move(cb)))
+        return;
+
+    RING_DBG("Address lookup for %s on %s", addr.c_str(), serverHost_.c_str());
+    lookupPool_->get(QUERY_ADDR + addr, [this,addr](HttpConnectionPool::Response&& reply) {
+        const auto code = reply.status;
+        if (code == 200) {
+            Json::Value json;
+            Json::Reader reader;
+            if (!reader.parse(reply.body, json)) {
+                RING_ERR("Address lookup for %s: can't parse server response: %s", addr.c_str(), reply.body.c_str());
+                endLookup(pendingAddrs_, addr, "", Response::error);
+                return;
+            }
+            auto name = json["name"].asString();
+            if (not name.empty()) {
+                RING_DBG("Found name for %s: %s", addr.c_str(), name.c_str());
+                cache_.setFound(name, addr);
+                saveCache();
+                endLookup(pendingAddrs_, addr, name, Response::found);
             } else {
-                cb("", Response::error);
+                cache_.setAddressNotFound(addr);
+                endLookup(pendingAddrs_, addr, "", Response::notFound);
             }
-        }).share();
-
-        // avoid blocking on future destruction
-        ThreadPool::instance().run([ret](){ ret.get(); });
-    } catch (const std::exception& e) {
-        RING_ERR("Error when performing address lookup: %s", e.what());
-        cb("", Response::error);
-    }
+        } else if (code >= 400 && code < 500) {
+            cache_.setAddressNotFound(addr);
+            endLookup(pendingAddrs_, addr, "", Response::notFound);
+        } else {
+            endLookup(pendingAddrs_, addr, "", Response::error);
+        }
+    });
 }
 
 static const std::string HEX_PREFIX {"0x"};
 
 void NameDirectory::lookupName(const std::string& n, LookupCallback cb)
 {
-    try {
-        std::string name {n};
-        if (not validateName(name)) {
-            cb(name, Response::invalidName);
-            return;
-        }
-        toLower(name);
-
-        auto cacheRes = addrCache_.find(name);
-        if (cacheRes != addrCache_.end()) {
-            cb(cacheRes->second, Response::found);
-            return;
-        }
-
-        restbed::Uri uri(HTTP_PROTO + serverHost_ + QUERY_NAME + name);
-        auto request = std::make_shared<restbed::Request>(std::move(uri));
-        request->set_header("Accept", "*/*");
-        request->set_header("Host", serverHost_);
-
-        RING_DBG("Name lookup for %s: %s", name.c_str(), uri.to_string().c_str());
-
-        auto ret = restbed::Http::async(request, [this,cb,name](const std::shared_ptr<restbed::Request>&,
-                                                     const std::shared_ptr<restbed::Response>& reply) {
-            auto code = reply->get_status_code();
-            if (code != 200)
-                RING_DBG("Name lookup for %s: got reply code %d", name.c_str(), code);
-            if (code >= 200 && code < 300) {
-                size_t length = getContentLength(*reply);
-                if (length > MAX_RESPONSE_SIZE) {
-                    cb("", Response::error);
-                    return;
-                }
-                restbed::Http::fetch(length, reply);
-                std::string body;
-                reply->get_body(body);
+    std::string name {n};
+    if (not validateName(name)) {
+        cb(name, Response::invalidName);
+        return;
+    }
+    toLower(name);
+
+    std::string cachedAddr;
+    switch (cache_.getAddress(name, cachedAddr)) {
+    case NameCache::Status::found:
+        cb(cachedAddr, Response::found);
+        return;
+    case NameCache::Status::notFound:
+        cb("", Response::notFound);
+        return;
+    default:
+        break;
+    }
 
-                Json::Value json;
-                Json::Reader reader;
-                if (!reader.parse(body, json)) {
-                    RING_ERR("Name lookup for %s: can't parse server response: %s", name.c_str(), body.c_str());
-                    cb("", Response::error);
-                    return;
-                }
-                auto addr = json["addr"].asString();
-                if (!addr.compare(0, HEX_PREFIX.size(), HEX_PREFIX))
-                    addr = addr.substr(HEX_PREFIX.size());
-                if (not addr.empty()) {
-                    RING_DBG("Found address for %s: %s", name.c_str(), addr.c_str());
-                    addrCache_.emplace(name, addr);
-                    nameCache_.emplace(addr, name);
-                    cb(addr, Response::found);
-                    saveCache();
-                } else {
-                    cb("", Response::notFound);
-                }
-            } else if (code >= 400 && code < 500) {
-                cb("", Response::notFound);
+    // The first lookup sends the request, the others wait for its response
+    if (not addPendingLookup(pendingNames_, name, std::move(cb)))
+        return;
+
+    RING_DBG("Name lookup for %s on %s", name.c_str(), serverHost_.c_str());
+    lookupPool_->get(QUERY_NAME + name, [this,name](HttpConnectionPool::Response&& reply) {
+        const auto code = reply.status;
+        if (code != 200)
+            RING_DBG("Name lookup for %s: got reply code %u", name.c_str(), code);
+        if (code >= 200 && code < 300) {
+            Json::Value json;
+            Json::Reader reader;
+            if (!reader.parse(reply.body, json)) {
+                RING_ERR("Name lookup for %s: can't parse server response: %s", name.c_str(), reply.body.c_str());
+                endLookup(pendingNames_, name, "", Response::error);
+                return;
+            }
+            auto addr = json["addr"].asString();
+            if (!addr.compare(0, HEX_PREFIX.size(), HEX_PREFIX))
+                addr = addr.substr(HEX_PREFIX.size());
+            if (not addr.empty()) {
+                RING_DBG("Found address for %s: %s", name.c_str(), addr.c_str());
+                cache_.setFound(name, addr);
+                saveCache();
+                endLookup(pendingNames_, name, addr, Response::found);
             } else {
-                cb("", Response::error);
+                cache_.setNameNotFound(name);
+                endLookup(pendingNames_, name, "", Response::notFound);
             }
-        }).share();
-
-        // avoid blocking on future destruction
-        ThreadPool::instance().run([ret](){ ret.get(); });
-    } catch (const std::exception& e) {
-        RING_ERR("Error when performing name lookup: %s", e.what());
-        cb("", Response::error);
-    }
+        } else if (code >= 400 && code < 500) {
+            cache_.setNameNotFound(name);
+            endLookup(pendingNames_, name, "", Response::notFound);
+        } else {
+            endLookup(pendingNames_, name, "", Response::error);
+        }
+    });
 }
 
 bool NameDirectory::validateName(const std::string& name) const
@@ -237,6 +253,11 @@ bool NameDirectory::validateName(const std::string& name) const
     return std::regex_match(name, NAME_VALIDATOR);
 }
 
+bool NameDirectory::validateAddress(const std::string& addr) const
+{
+    return std::regex_match(addr, ADDR_VALIDATOR);
+}
+
 void NameDirectory::registerName(const std::string& addr, const std::string& n, const std::string& owner, RegistrationCallback cb)
 {
     try {
@@ -247,9 +268,9 @@ void NameDirectory::registerName(const std::string& addr, const std::string& n,
         }
         toLower(name);
 
-        auto cacheRes = addrCache_.find(name);
-        if (cacheRes != addrCache_.end()) {
-            if (cacheRes->second == addr)
+        std::string cachedAddr;
+        if (cache_.getAddress(name, cachedAddr) == NameCache::Status::found) {
+            if (cachedAddr == addr)
                 cb(RegistrationResponse::success);
             else
                 cb(RegistrationResponse::alreadyTaken);
@@ -299,8 +320,8 @@ void NameDirectory::registerName(const std::string& addr, const std::string& n,
                 auto success = json["success"].asBool();
                 RING_DBG("Got reply for registration of %s -> %s: %s", name.c_str(), addr.c_str(), success ? "success" : "failure");
                 if (success) {
-                    addrCache_.emplace(name, addr);
-                    nameCache_.emplace(addr, name);
+                    cache_.setFound(name, addr);
+                    saveCache();
                 }
                 cb(success ? RegistrationResponse::success : RegistrationResponse::error);
             } else if (code >= 400 && code < 500) {
@@ -311,7 +332,7 @@ void NameDirectory::registerName(const std::string& addr, const std::string& n,
         }, params).share();
 
         // avoid blocking on future destruction
-        ThreadPool::instance().run([ret](){ ret.get(); });
+        ThreadPool::instance().run([ret](){ ret.get(); }, ThreadPool::Priority::LOW);
     } catch (const std::exception& e) {
         RING_ERR("Error when performing name registration: %s", e.what());
         cb(RegistrationResponse::error);
@@ -321,39 +342,19 @@ void NameDirectory::registerName(const std::string& addr, const std::string& n,
 void
 NameDirectory::saveCache()
 {
-    fileutils::recursive_mkdir(fileutils::get_cache_dir()+DIR_SEPARATOR_STR+"namecache");
-    std::ofstream file(cachePath_, std::ios::trunc | std::ios::binary);
-    msgpack::pack(file, nameCache_);
-    RING_DBG("Saved %lu name-address mappings", (long unsigned)nameCache_.size());
+    cacheWriter_->schedule();
 }
 
 void
 NameDirectory::loadCache()
 {
-    msgpack::unpacker pac;
-
-    // read file
-    {
-        std::ifstream file(cachePath_);
-        if (!file.is_open()) {
-            RING_DBG("Could not load %s", cachePath_.c_str());
-            return;
-        }
-        std::string line;
-        while (std::getline(file, line)) {
-            pac.reserve_buffer(line.size());
-            memcpy(pac.buffer(), line.data(), line.size());
-            pac.buffer_consumed(line.size());
-        }
+    try {
+        const auto file = fileutils::loadFile(cachePath_);
+        const auto loaded = cache_.unpack((const char*)file.data(), file.size());
+        RING_DBG("Loaded %zu name-address mappings", loaded);
+    } catch (const std::exception& e) {
+        RING_DBG("Could not load %s: %s", cachePath_.c_str(), e.what());
     }
-
-    // load values
-    msgpack::object_handle oh;
-    if (pac.next(oh))
-        oh.get().convert(nameCache_);
-    for (const auto& m : nameCache_)
-        addrCache_.emplace(m.second, m.first);
-    RING_DBG("Loaded %lu name-address mappings", (long unsigned)nameCache_.size());
 }
 
 }
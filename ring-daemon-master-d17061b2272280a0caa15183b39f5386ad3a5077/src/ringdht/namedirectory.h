@@ -17,12 +17,21 @@
  */
 #pragma once
 
+#include "name_cache.h"
+#include "noncopyable.h"
+
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace ring {
 
+class ConfigWriter;
+class HttpConnectionPool;
+
 class NameDirectory
 {
 public:
@@ -32,8 +41,8 @@ public:
     using LookupCallback = std::function<void(const std::string& result, Response response)>;
     using RegistrationCallback = std::function<void(RegistrationResponse response)>;
 
-    NameDirectory() {}
     NameDirectory(const std::string& s);
+    ~NameDirectory();
     void load();
 
     static NameDirectory& instance(const std::string& server);
@@ -53,14 +62,39 @@ public:
 private:
     constexpr static const char* const DEFAULT_SERVER_HOST = "ns.ring.cx";
 
+    NON_COPYABLE(NameDirectory);
+
+    using PendingLookups = std::map<std::string, std::vector<LookupCallback>>;
+
     const std::string serverHost_ {DEFAULT_SERVER_HOST};
     const std::string cachePath_;
 
-    std::map<std::string, std::string> nameCache_;
-    std::map<std::string, std::string> addrCache_;
+    NameCache cache_;
+
+    /** Callbacks of the lookups in progress, by name and by address */
+    std::mutex lookupsMutex_;
+    PendingLookups pendingNames_;
+    PendingLookups pendingAddrs_;
+
+    /** Writes the cache a little after the lookups */
+    std::unique_ptr<ConfigWriter> cacheWriter_;
 
+    /**
+     * Persistent connections to the server for the lookups.
+     * Declared last, to be destroyed first: it answers the lookups in
+     * progress.
+     */
+    std::unique_ptr<HttpConnectionPool> lookupPool_;
 
     bool validateName(const std::string& name) const;
+    bool validateAddress(const std::string& addr) const;
+
+    /**
+     * Add cb to the callbacks of the lookup of key.
+     * Return true if no such lookup is in progress: the request must be sent.
+     */
+    bool addPendingLookup(PendingLookups& pending, const std::string& key, LookupCallback&& cb);
+    void endLookup(PendingLookups& pending, const std::string& key, const std::string& result, Response response);
 
     void saveCache();
     void loadCache();
@@ -302,6 +302,8 @@ static constexpr int ICE_COMPONENTS {1};
 static constexpr int ICE_COMP_SIP_TRANSPORT {0};
 static constexpr auto ICE_NEGOTIATION_TIMEOUT = std::chrono::seconds(60);
 static constexpr auto TLS_TIMEOUT = std::chrono::seconds(30);
+// Without thread, the DHT only reads received packets when it is run
+static constexpr auto DHT_POLL_PERIOD = std::chrono::milliseconds(50);
 const constexpr auto EXPORT_KEY_RENEWAL_TIME = std::chrono::minutes(20);
 
 static constexpr const char * const RING_URI_PREFIX = "ring:";
@@ -385,7 +387,6 @@ RingAccount::RingAccount(const std::string& accountID, bool /* presenceEnabled *
 
 RingAccount::~RingAccount()
 {
-    Manager::instance().unregisterEventHandler((uintptr_t)this);
     dht_.join();
 }
 
@@ -562,13 +563,17 @@ RingAccount::startOutgoingCall(const std::shared_ptr<SIPCall>& call, const std::
                 }
             );
 
-            sthis->pendingCalls_.emplace_back(PendingCall{
-                std::chrono::steady_clock::now(),
-                ice, weak_dev_call,
-                std::move(listenKey),
-                callkey, dev,
-                tls::CertificateStore::instance().getCertificate(toUri)
-            });
+            {
+                std::lock_guard<std::mutex> lock(sthis->callsMutex_);
+                sthis->pendingCalls_.emplace_back(PendingCall{
+                    std::chrono::steady_clock::now(),
+                    ice, weak_dev_call,
+                    std::move(listenKey),
+                    callkey, dev,
+                    tls::CertificateStore::instance().getCertificate(toUri)
+                });
+            }
+            sthis->checkPendingCalls();
             return false;
         });
     }, [=](bool ok){
@@ -1210,7 +1215,7 @@ RingAccount::addDevice(const std::string& password)
             emitSignal<DRing::ConfigurationSignal::ExportOnRingEnded>(this_->getAccountID(), 2, "");
             return;
         }
-    });
+    }, ThreadPool::Priority::LOW);
 }
 
 bool
@@ -1218,7 +1223,7 @@ RingAccount::revokeDevice(const std::string& password, const std::string& device
 {
     // shared_ptr of future
     auto fa = ThreadPool::instance().getShared<ArchiveContent>(
-        [this, password] { return readArchive(password); });
+        [this, password] { return readArchive(password); }, ThreadPool::Priority::LOW);
     auto sthis = shared();
     findCertificate(dht::InfoHash(device),
                     [fa,sthis,password,device](const std::shared_ptr<dht::crypto::Certificate>& crt) mutable
@@ -1295,7 +1300,7 @@ RingAccount::loadAccountFromDHT(const std::string& archive_password, const std::
             this_->initRingDevice(a);
             this_->saveArchive(a, archive_password);
             this_->registrationState_ = RegistrationState::UNREGISTERED;
-            Manager::instance().saveConfig();
+            Manager::instance().saveConfig(this_);
             this_->doRegister();
         }
     };
@@ -1359,8 +1364,8 @@ RingAccount::loadAccountFromDHT(const std::string& archive_password, const std::
         }
     };
 
-    ThreadPool::instance().run(std::bind(search, true, state_old));
-    ThreadPool::instance().run(std::bind(search, false, state_new));
+    ThreadPool::instance().run(std::bind(search, true, state_old), ThreadPool::Priority::LOW);
+    ThreadPool::instance().run(std::bind(search, false, state_new), ThreadPool::Priority::LOW);
 }
 
 void
@@ -1373,6 +1378,7 @@ RingAccount::createAccount(const std::string& archive_password, dht::crypto::Ide
         ArchiveContent a;
         auto& this_ = *sthis;
 
+        // waited by this LOW priority task, must not wait behind it
         auto future_keypair = ThreadPool::instance().get<dev::KeyPair>(std::bind(&dev::KeyPair::create));
         try {
             if (migrate.first and migrate.second) {
@@ -1413,9 +1419,9 @@ RingAccount::createAccount(const std::string& archive_password, dht::crypto::Ide
         }
         RING_DBG("[Account %s] Ring account creation ended, saving configuration", this_.getAccountID().c_str());
         this_.setRegistrationState(RegistrationState::UNREGISTERED);
-        Manager::instance().saveConfig();
+        Manager::instance().saveConfig(sthis);
         this_.doRegister();
-    });
+    }, ThreadPool::Priority::LOW);
 }
 
 bool
@@ -1536,7 +1542,7 @@ RingAccount::loadAccount(const std::string& archive_password, const std::string&
                     Migration::setState(accountID_, Migration::State::SUCCESS);
                     setRegistrationState(RegistrationState::UNREGISTERED);
                 }
-                Manager::instance().saveConfig();
+                Manager::instance().saveConfig(shared());
                 loadAccount();
             }
         } else {
@@ -1701,13 +1707,39 @@ RingAccount::registerName(const std::string& /*password*/, const std::string& na
 #endif
 
 void
-RingAccount::handleEvents()
+RingAccount::scheduleDhtLoop(unsigned generation, std::chrono::steady_clock::time_point when)
+{
+    std::weak_ptr<RingAccount> w = std::static_pointer_cast<RingAccount>(shared_from_this());
+    Manager::instance().scheduleTask([w, generation] {
+        auto this_ = w.lock();
+        if (not this_ or this_->dhtLoopGeneration_ != generation or not this_->dht_.isRunning())
+            return;
+        const auto now = std::chrono::steady_clock::now();
+        const auto next = this_->dht_.loop();
+        this_->scheduleDhtLoop(generation, std::max(now, std::min(next, now + DHT_POLL_PERIOD)));
+    }, when);
+}
+
+void
+RingAccount::checkPendingCalls()
 {
-    // Process DHT events
-    dht_.loop();
+    if (pendingCallsCheck_.exchange(true))
+        return;
 
-    // Call msg in "callto:"
-    handlePendingCallList();
+    // Polled by the event loop until all pending calls are handled
+    std::weak_ptr<RingAccount> w = std::static_pointer_cast<RingAccount>(shared_from_this());
+    Manager::instance().addTask([w] {
+        auto this_ = w.lock();
+        if (not this_)
+            return false;
+        this_->handlePendingCallList();
+        std::lock_guard<std::mutex> lock(this_->callsMutex_);
+        if (this_->pendingCalls_.empty()) {
+            this_->pendingCallsCheck_ = false;
+            return false;
+        }
+        return true;
+    });
 }
 
 void
@@ -2159,6 +2191,7 @@ RingAccount::doRegister_()
         });
 
         dht_.run((in_port_t)dhtPortUsed_, identity_, false);
+        scheduleDhtLoop(++dhtLoopGeneration_, std::chrono::steady_clock::now());
 
         dht_.setLocalCertificateStore([](const dht::InfoHash& pk_id) {
             std::vector<std::shared_ptr<dht::crypto::Certificate>> ret;
@@ -2192,7 +2225,6 @@ RingAccount::doRegister_()
 
         dht_.importValues(loadValues());
 
-        Manager::instance().registerEventHandler((uintptr_t)this, [this]{ handleEvents(); });
         setRegistrationState(RegistrationState::TRYING);
 
         dht_.bootstrap(loadNodes());
@@ -2557,6 +2589,7 @@ RingAccount::replyToIncomingIceMsg(const std::shared_ptr<SIPCall>& call,
                 /*.from = */peer_ice_msg.from,
                 /*.from_cert = */from_cert });
     }
+    checkPendingCalls();
 }
 
 void
@@ -2580,7 +2613,6 @@ RingAccount::doUnregister(std::function<void(bool)> released_cb)
         upnp_->removeMappings();
     }
 
-    Manager::instance().unregisterEventHandler((uintptr_t)this);
     saveNodes(dht_.exportNodes());
     saveValues(dht_.exportValues());
     dht_.join();
@@ -2864,7 +2896,8 @@ RingAccount::generateDhParams()
 {
     //make sure cachePath_ is writable
     fileutils::check_dir(cachePath_.c_str(), 0700);
-    dhParams_ = ThreadPool::instance().get<tls::DhParams>(std::bind(loadDhParams, cachePath_ + DIR_SEPARATOR_STR "dhParams"));
+    dhParams_ = ThreadPool::instance().get<tls::DhParams>(std::bind(loadDhParams, cachePath_ + DIR_SEPARATOR_STR "dhParams"),
+                                                          ThreadPool::Priority::LOW);
 }
 
 MatchRank
@@ -377,7 +377,18 @@ class RingAccount : public SIPAccountBase {
 
         const dht::ValueType USER_PROFILE_TYPE = {9, "User profile", std::chrono::hours(24 * 7)};
 
-        void handleEvents();
+        /**
+         * Have pending calls handled by the event loop, until there is none.
+         */
+        void checkPendingCalls();
+
+        /**
+         * Run the DHT from the event loop, at the deadline it gives, while it
+         * runs. The DHT is not threaded: its callbacks run on the loop thread.
+         */
+        void scheduleDhtLoop(unsigned generation, std::chrono::steady_clock::time_point when);
+        /** Incremented when the DHT is started, ends the previous loop */
+        std::atomic<unsigned> dhtLoopGeneration_ {0};
 
         void forEachDevice(const dht::InfoHash& to, std::function<void(const std::shared_ptr<RingAccount>&, const dht::InfoHash&)> op, std::function<void(bool)> end = {});
 
@@ -447,6 +458,7 @@ class RingAccount : public SIPAccountBase {
         std::list<PendingCall> pendingSipCalls_;
         std::set<dht::Value::Id> treatedCalls_ {};
         mutable std::mutex callsMutex_ {};
+        std::atomic_bool pendingCallsCheck_ {false};
 
         std::map<dht::Value::Id, PendingMessage> sentMessages_;
         std::set<dht::Value::Id> treatedMessages_ {};
@@ -221,7 +221,7 @@ CertificateStore::pinCertificatePath(const std::string& path, std::function<void
         if (cb)
             cb(ids);
         emitSignal<DRing::ConfigurationSignal::CertificatePathPinned>(path, ids);
-    });
+    }, ThreadPool::Priority::LOW);
 }
 
 unsigned
@@ -1702,7 +1702,7 @@ SIPAccount::supportPresence(int function, bool enabled)
         not presence_->isSupported(PRESENCE_FUNCTION_SUBSCRIBE))
         enablePresence(false);
 
-    Manager::instance().saveConfig();
+    Manager::instance().saveConfig(shared_from_this());
     // FIXME: bad signal used here, we need a global config changed signal.
     emitSignal<DRing::ConfigurationSignal::AccountsChanged>();
 }
@@ -589,8 +589,13 @@ SIPVoIPLink::SIPVoIPLink() : pool_(nullptr, pj_pool_release)
     // ready to handle events
     // Implementation note: we don't use std::bind(xxx, this) here
     // as handleEvents needs a valid instance to be called.
-    Manager::instance().registerEventHandler((uintptr_t)this,
-                                             [this]{ handleEvents(); });
+    if (initWakeSocket())
+        Manager::instance().setEventWaiter(
+            [this](std::chrono::steady_clock::time_point deadline){ waitForEvents(deadline); },
+            [this]{ wakeUp(); });
+    else
+        Manager::instance().registerEventHandler((uintptr_t)this,
+                                                 [this]{ handleEvents(); });
 
     RING_DBG("SIPVoIPLink@%p", this);
 }
@@ -615,11 +620,17 @@ SIPVoIPLink::~SIPVoIPLink()
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
     pjsip_tpmgr_set_state_cb(pjsip_endpt_get_tpmgr(endpt_), nullptr);
-    Manager::instance().unregisterEventHandler((uintptr_t)this);
+    if (wakeKey_)
+        Manager::instance().setEventWaiter(nullptr, nullptr);
+    else
+        Manager::instance().unregisterEventHandler((uintptr_t)this);
     try {
         handleEvents();
     } catch (...) {}
 
+    if (wakeKey_)
+        pj_ioqueue_unregister(wakeKey_);
+
     sipTransportBroker.reset();
 
     pjsip_endpt_destroy(endpt_);
@@ -680,10 +691,16 @@ SIPVoIPLink::guessAccount(const std::string& userName,
 // Called from EventThread::run (not main thread)
 void
 SIPVoIPLink::handleEvents()
+{
+    static const pj_time_val timeout = {0, 0}; // polling
+    handleEvents(timeout);
+}
+
+void
+SIPVoIPLink::handleEvents(const pj_time_val& timeout)
 {
     sip_utils::register_thread();
 
-    static const pj_time_val timeout = {0, 0}; // polling
     auto ret = pjsip_endpt_handle_events(endpt_, &timeout);
     if (ret != PJ_SUCCESS)
         RING_ERR("pjsip_endpt_handle_events failed with error %s",
@@ -694,6 +711,79 @@ SIPVoIPLink::handleEvents()
 #endif
 }
 
+// Called from the event loop thread
+void
+SIPVoIPLink::waitForEvents(std::chrono::steady_clock::time_point deadline)
+{
+    using namespace std::chrono;
+    const auto now = steady_clock::now();
+    // round up, not to wake up just before the deadline
+    const auto ms = deadline > now ?
+        (duration_cast<microseconds>(deadline - now).count() + 999) / 1000 : 0;
+    const pj_time_val timeout = {static_cast<long>(ms / 1000), static_cast<long>(ms % 1000)};
+    handleEvents(timeout);
+}
+
+/**
+ * The event loop blocks in pjsip_endpt_handle_events(): it is woken up by
+ * a datagram sent to a loopback socket polled by the endpoint ioqueue.
+ */
+bool
+SIPVoIPLink::initWakeSocket()
+{
+    pj_sock_t sock;
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock) != PJ_SUCCESS) {
+        RING_WARN("Can't create event loop wake-up socket, polling SIP events");
+        return false;
+    }
+
+    static const pj_str_t loopback = CONST_PJ_STR("127.0.0.1");
+    pj_sockaddr_in_init(&wakeAddr_, &loopback, 0);
+    int addrLen = sizeof(wakeAddr_);
+
+    pj_ioqueue_callback cb;
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &SIPVoIPLink::onWakeRead;
+
+    if (pj_sock_bind(sock, &wakeAddr_, addrLen) != PJ_SUCCESS
+        or pj_sock_getsockname(sock, &wakeAddr_, &addrLen) != PJ_SUCCESS
+        or pj_ioqueue_register_sock(pool_.get(), pjsip_endpt_get_ioqueue(endpt_),
+                                    sock, this, &cb, &wakeKey_) != PJ_SUCCESS) {
+        RING_WARN("Can't setup event loop wake-up socket, polling SIP events");
+        pj_sock_close(sock);
+        wakeKey_ = nullptr;
+        return false;
+    }
+
+    wakeSock_ = sock;
+    pj_ioqueue_op_key_init(&wakeOp_, sizeof(wakeOp_));
+    readWakeSocket();
+    return true;
+}
+
+void
+SIPVoIPLink::readWakeSocket()
+{
+    // Datagrams only interrupt the poll, their content is dropped
+    pj_ssize_t size = sizeof(wakeBuf_);
+    pj_ioqueue_recv(wakeKey_, &wakeOp_, wakeBuf_, &size, PJ_IOQUEUE_ALWAYS_ASYNC);
+}
+
+void
+SIPVoIPLink::onWakeRead(pj_ioqueue_key_t* key, pj_ioqueue_op_key_t*, pj_ssize_t)
+{
+    static_cast<SIPVoIPLink*>(pj_ioqueue_get_user_data(key))->readWakeSocket();
+}
+
+// Called from any thread
+void
+SIPVoIPLink::wakeUp()
+{
+    static const char byte = 0;
+    pj_ssize_t size = sizeof(byte);
+    pj_sock_sendto(wakeSock_, &byte, &size, 0, &wakeAddr_, sizeof(wakeAddr_));
+}
+
 void SIPVoIPLink::registerKeepAliveTimer(pj_timer_entry &timer, pj_time_val &delay)
 {
     RING_DBG("Register new keep alive timer %d with delay %ld", timer.id, delay.sec);
@@ -730,8 +820,11 @@ void
 SIPVoIPLink::enqueueKeyframeRequest(const std::string &id)
 {
     if (auto link = getSIPVoIPLink()) {
-        std::lock_guard<std::mutex> lock(link->keyframeRequestsMutex_);
-        link->keyframeRequests_.push(id);
+        {
+            std::lock_guard<std::mutex> lock(link->keyframeRequestsMutex_);
+            link->keyframeRequests_.push(id);
+        }
+        Manager::instance().wakeEventLoop();
     } else
         RING_ERR("no more VoIP link");
 }
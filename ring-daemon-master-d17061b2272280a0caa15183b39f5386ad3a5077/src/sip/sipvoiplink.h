@@ -47,6 +47,7 @@
 #include <mutex>
 #include <memory>
 #include <functional>
+#include <chrono>
 
 namespace ring {
 
@@ -169,6 +170,25 @@ class SIPVoIPLink {
         mutable pj_caching_pool cp_;
         std::unique_ptr<pj_pool_t, decltype(pj_pool_release)&> pool_;
 
+        void handleEvents(const pj_time_val& timeout);
+
+        /**
+         * Event loop waiter: handle SIP events until the deadline,
+         * returns on the first events.
+         */
+        void waitForEvents(std::chrono::steady_clock::time_point deadline);
+
+        /* Event loop wake-up */
+        bool initWakeSocket();
+        void readWakeSocket();
+        void wakeUp();
+        static void onWakeRead(pj_ioqueue_key_t* key, pj_ioqueue_op_key_t*, pj_ssize_t);
+        pj_sock_t wakeSock_ {PJ_INVALID_SOCKET};
+        pj_sockaddr_in wakeAddr_;
+        pj_ioqueue_key_t* wakeKey_ {nullptr};
+        pj_ioqueue_op_key_t wakeOp_;
+        char wakeBuf_[16];
+
 #ifdef RING_VIDEO
         void dequeKeyframeRequests();
         void requestKeyframe(const std::string &callID);
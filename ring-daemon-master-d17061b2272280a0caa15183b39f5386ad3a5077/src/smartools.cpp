@@ -18,9 +18,8 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
  */
 #include "smartools.h"
-#include "media/media_decoder.h"
-#include "media/video/video_input.h"
-#include "media/video/video_device.h"
+#include "manager.h"
+#include "call.h"
 #include "dring/callmanager_interface.h"
 #include "client/ring_signal.h"
 #include "string_utils.h"
@@ -44,12 +43,74 @@ Smartools::~Smartools()
     loop_.join();
 }
 
+static void
+setFrameSize(std::map<std::string, std::string>& info, const std::string& prefix,
+             const MediaStreamStats::Snapshot& stats)
+{
+    if (stats.width or stats.height) {
+        info[prefix + " width"] = to_string(stats.width);
+        info[prefix + " height"] = to_string(stats.height);
+    }
+}
+
 void
 Smartools::sendInfo()
 {
     std::lock_guard<std::mutex> lk(mutexInfo_);
-    emitSignal<DRing::CallSignal::SmartInfo>(information_);
-    information_.clear();
+
+    // Describe the current call, or any call with media
+    auto callId = Manager::instance().getCurrentCallId();
+    auto stats = MediaStatsRegistry::instance().find(callId);
+    if (not stats) {
+        auto calls = MediaStatsRegistry::instance().getCalls();
+        if (calls.empty())
+            return;
+        callId = calls.front().first;
+        stats = calls.front().second;
+    }
+
+    const auto audioSend = stats->audioSend.getSnapshot();
+    const auto audioReceive = stats->audioReceive.getSnapshot();
+    const auto videoSend = stats->videoSend.getSnapshot();
+    const auto videoReceive = stats->videoReceive.getSnapshot();
+
+    std::map<std::string, std::string> information;
+    if (not audioSend.codec.empty())
+        information["local audio codec"] = audioSend.codec;
+    if (not audioReceive.codec.empty())
+        information["remote audio codec"] = audioReceive.codec;
+    if (not videoSend.codec.empty())
+        information["local video codec"] = videoSend.codec;
+    if (not videoReceive.codec.empty())
+        information["remote video codec"] = videoReceive.codec;
+    setFrameSize(information, "local", videoSend);
+    setFrameSize(information, "remote", videoReceive);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (callId == lastCallId_) {
+        const std::chrono::duration<double> elapsed = now - lastSend_;
+        if (elapsed.count() > 0) {
+            information["local FPS"] = to_string((videoSend.frames - lastLocalFrames_) / elapsed.count());
+            information["remote FPS"] = to_string((videoReceive.frames - lastRemoteFrames_) / elapsed.count());
+        }
+    }
+    lastCallId_ = callId;
+    lastLocalFrames_ = videoSend.frames;
+    lastRemoteFrames_ = videoReceive.frames;
+    lastSend_ = now;
+
+    if (auto call = Manager::instance().getCallFromCallID(callId)) {
+        auto confID = call->getConfId();
+        if (confID != "") {
+            information["type"] = "conference";
+            information["callID"] = confID;
+        } else {
+            information["type"] = "no conference";
+            information["callID"] = callId;
+        }
+    }
+
+    emitSignal<DRing::CallSignal::SmartInfo>(information);
 }
 
 void
@@ -75,74 +136,7 @@ Smartools::stop()
     std::lock_guard<std::mutex> lk(mutexInfo_);
     RING_DBG("Stop SmartInfo");
     loop_.stop();
-    information_.clear();
+    lastCallId_.clear();
 }
 
-
-//Set all the information in the map
-
-void
-Smartools::setFrameRate(const std::string& id, const std::string& fps)
-{
-    std::lock_guard<std::mutex> lk(mutexInfo_);
-    if(id == "local"){
-        information_["local FPS"]= fps;
-    } else {
-        information_["remote FPS"]= fps;
-    }
-}
-
-void
-Smartools::setResolution(const std::string& id, int width, int height)
-{
-    std::lock_guard<std::mutex> lk(mutexInfo_);
-    if(id == "local"){
-        information_["local width"] = to_string(width);
-        information_["local height"] = to_string(height);
-    } else {
-        information_["remote width"] = to_string(width);
-        information_["remote height"] = to_string(height);
-    }
-}
-
-void
-Smartools::setRemoteAudioCodec(const std::string& remoteAudioCodec)
-{
-    std::lock_guard<std::mutex> lk(mutexInfo_);
-    information_["remote audio codec"]= remoteAudioCodec;
-}
-
-void
-Smartools::setLocalAudioCodec(const std::string& localAudioCodec)
-{
-    std::lock_guard<std::mutex> lk(mutexInfo_);
-    information_["local audio codec"]= localAudioCodec;
-}
-
-void
-Smartools::setLocalVideoCodec(const std::string& localVideoCodec)
-{
-    std::lock_guard<std::mutex> lk(mutexInfo_);
-    information_["local video codec"]= localVideoCodec;
-}
-
-void
-Smartools::setRemoteVideoCodec(const std::string& remoteVideoCodec, const std::string& callID)
-{
-    std::lock_guard<std::mutex> lk(mutexInfo_);
-    information_["remote video codec"]= remoteVideoCodec;
-    auto call = Manager::instance().getCallFromCallID(callID);
-    if (!call) {
-        return;
-    }
-    auto confID = call->getConfId();
-    if (confID != ""){
-        information_["type"]= "conference";
-        information_["callID"]= confID;
-    } else {
-        information_["type"]= "no conference";
-        information_["callID"]= callID;
-    }
- }
-
- } // end namespace ring
+} // end namespace ring
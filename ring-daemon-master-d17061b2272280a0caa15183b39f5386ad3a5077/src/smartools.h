@@ -20,31 +20,41 @@
 #pragma once
 
 #include "threadloop.h"
-#include "manager.h"
+#include "media/media_stats.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace ring {
+
+/**
+ * Periodically emit the SmartInfo signal, describing the media of the
+ * current call. Values are read from MediaStatsRegistry when the signal
+ * is sent.
+ */
 class Smartools
 {
     public:
         static Smartools& getInstance();
         void start(std::chrono::milliseconds refreshTimeMs);
         void stop();
-        void setFrameRate(const std::string& id, const std::string& fps);
-        void setResolution(const std::string& id, int width, int height);
-        void setLocalVideoCodec(const std::string& localVideoCodec);
-        void setRemoteVideoCodec(const std::string& remoteVideoCodec, const std::string& callID);
-        void setRemoteAudioCodec(const std::string& remoteAudioCodec);
-        void setLocalAudioCodec(const std::string& remoteAudioCodec);
         void sendInfo();
 
     private:
         Smartools();
         ~Smartools();
         void process();
-        std::map<std::string, std::string> information_;
-        std::mutex mutexInfo_; // Protect information_ from multithreading
+
+        std::mutex mutexInfo_; // Protect the members below from multithreading
         std::chrono::milliseconds refreshTimeMs_ {500};
+        // Frame counts on the last send, for the frame rates
+        std::string lastCallId_ {};
+        uint64_t lastLocalFrames_ {0};
+        uint64_t lastRemoteFrames_ {0};
+        std::chrono::steady_clock::time_point lastSend_ {};
         ThreadLoop loop_; // Has to be last member
 };
 } //ring namespace
@@ -20,23 +20,106 @@
 #include "thread_pool.h"
 #include "logger.h"
 
-#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <thread>
 
 #include <ciso646> // fix windows compiler bug
 
 namespace ring {
 
-struct ThreadPool::ThreadState
+using clock = std::chrono::steady_clock;
+
+static constexpr unsigned PRIORITY_COUNT = static_cast<unsigned>(ThreadPool::Priority::COUNT);
+static constexpr unsigned LOW = static_cast<unsigned>(ThreadPool::Priority::LOW);
+
+// Tasks queued per worker and priority before the next worker queue is used
+static constexpr size_t MAX_QUEUE_DEPTH = 1024;
+
+// Workers idle for that long are stopped, but the last one
+static constexpr std::chrono::seconds IDLE_TIMEOUT {60};
+
+struct ThreadPool::Entry
+{
+    Task task;
+    clock::time_point queued;
+};
+
+struct ThreadPool::Worker
 {
     std::thread thread {};
-    std::atomic_bool run {true};
+    /** Protected by ThreadPool::lock_ */
+    bool active {false};
+
+    std::mutex lock {};
+    std::deque<Entry> queues[PRIORITY_COUNT];
+    /** Queue sizes, read without the lock to skip empty queues */
+    std::atomic<size_t> sizes[PRIORITY_COUNT];
+
+    Worker() {
+        for (auto& s : sizes)
+            s = 0;
+    }
+
+    bool push(Entry&& entry, unsigned priority) {
+        std::lock_guard<std::mutex> l(lock);
+        auto& q = queues[priority];
+        if (q.size() >= MAX_QUEUE_DEPTH)
+            return false;
+        q.emplace_back(std::move(entry));
+        sizes[priority].fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Entry& entry, unsigned priority) {
+        if (sizes[priority].load(std::memory_order_acquire) == 0)
+            return false;
+        std::lock_guard<std::mutex> l(lock);
+        auto& q = queues[priority];
+        if (q.empty())
+            return false;
+        entry = std::move(q.front());
+        q.pop_front();
+        sizes[priority].fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> l(lock);
+        for (unsigned p = 0; p < PRIORITY_COUNT; ++p) {
+            queues[p].clear();
+            sizes[p] = 0;
+        }
+    }
+};
+
+struct ThreadPool::Counters
+{
+    std::atomic<uint64_t> executed {0};
+    std::atomic<uint64_t> waitTotal {0};
+    std::atomic<uint64_t> waitMax {0};
+    std::atomic<uint64_t> runTotal {0};
+    std::atomic<uint64_t> runMax {0};
+
+    static void updateMax(std::atomic<uint64_t>& max, uint64_t value) {
+        auto cur = max.load(std::memory_order_relaxed);
+        while (value > cur and not max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+    }
 };
 
+// Worker of the current thread, if any
+static thread_local std::pair<const ThreadPool*, unsigned> currentWorker {nullptr, 0};
+
 ThreadPool::ThreadPool()
  : maxThreads_(std::max<size_t>(std::thread::hardware_concurrency(), 4))
+ , counters_(new Counters[PRIORITY_COUNT])
 {
-    threads_.reserve(maxThreads_);
+    workers_.reserve(maxThreads_);
+    for (unsigned i = 0; i < maxThreads_; ++i)
+        workers_.emplace_back(new Worker());
+    for (auto& p : pending_)
+        p = 0;
 }
 
 ThreadPool::~ThreadPool()
@@ -45,60 +128,194 @@ ThreadPool::~ThreadPool()
 }
 
 void
-ThreadPool::run(std::function<void()>&& cb)
+ThreadPool::run(Task&& task, Priority priority)
 {
-    std::unique_lock<std::mutex> l(lock_);
-
-    // launch new thread if necessary
-    if (not readyThreads_ && threads_.size() < maxThreads_) {
-        threads_.emplace_back(new ThreadState());
-        auto& t = *threads_.back();
-        t.thread = std::thread([&]() {
-            while (t.run) {
-                std::function<void()> task;
-
-                // pick task from queue
-                {
-                    std::unique_lock<std::mutex> l(lock_);
-                    readyThreads_++;
-                    cv_.wait(l, [&](){
-                        return not t.run or not tasks_.empty();
-                    });
-                    readyThreads_--;
-                    if (not t.run)
-                        break;
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
-                }
-
-                // run task
-                try {
-                    if (task)
-                        task();
-                } catch (const std::exception& e) {
-                    RING_ERR("Exception running task: %s", e.what());
-                }
+    const auto p = static_cast<unsigned>(priority);
+    Entry entry {std::move(task), clock::now()};
+    if (not push(std::move(entry), p)) {
+        // every queue is full: the caller does the work
+        overflowed_.fetch_add(1, std::memory_order_relaxed);
+        execute(entry, p);
+        return;
+    }
+
+    std::lock_guard<std::mutex> l(lock_);
+    if (idleThreads_)
+        cv_.notify_one();
+    else if (activeThreads_ < maxThreads_)
+        startWorker();
+}
+
+bool
+ThreadPool::push(Entry&& entry, unsigned priority)
+{
+    // workers queue their own tasks, to keep them hot in cache
+    const unsigned first = currentWorker.first == this ?
+        currentWorker.second : nextQueue_.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned i = 0; i < maxThreads_; ++i) {
+        if (workers_[(first + i) % maxThreads_]->push(std::move(entry), priority)) {
+            pending_[priority].fetch_add(1, std::memory_order_seq_cst);
+            return true;
+        }
+    }
+    // entry was left untouched
+    return false;
+}
+
+bool
+ThreadPool::pop(unsigned self, Entry& entry, unsigned& priority)
+{
+    for (priority = 0; priority < PRIORITY_COUNT; ++priority) {
+        if (pending_[priority].load() == 0)
+            continue;
+        // keep a worker for normal priority tasks
+        if (priority == LOW and lowRunning_.load() + 1 >= maxThreads_)
+            return false;
+        for (unsigned i = 0; i < maxThreads_; ++i) {
+            if (workers_[(self + i) % maxThreads_]->pop(entry, priority)) {
+                pending_[priority].fetch_sub(1);
+                if (i)
+                    stolen_.fetch_add(1, std::memory_order_relaxed);
+                return true;
             }
+        }
+    }
+    return false;
+}
+
+bool
+ThreadPool::hasRunnable() const
+{
+    for (unsigned p = 0; p < PRIORITY_COUNT; ++p)
+        if (pending_[p].load() and (p != LOW or lowRunning_.load() + 1 < maxThreads_))
+            return true;
+    return false;
+}
+
+// lock_ must be held
+void
+ThreadPool::startWorker()
+{
+    for (unsigned i = 0; i < maxThreads_; ++i) {
+        auto& w = *workers_[i];
+        if (w.active)
+            continue;
+        // a stopped worker exits right after releasing lock_
+        if (w.thread.joinable())
+            w.thread.join();
+        w.active = true;
+        ++activeThreads_;
+        w.thread = std::thread([this, i]{ workerLoop(i); });
+        return;
+    }
+}
+
+void
+ThreadPool::workerLoop(unsigned self)
+{
+    currentWorker = {this, self};
+    auto& worker = *workers_[self];
+
+    while (true) {
+        Entry entry;
+        unsigned priority;
+        if (pop(self, entry, priority)) {
+            execute(entry, priority);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> l(lock_);
+        if (not running_)
+            break;
+        if (hasRunnable())
+            continue;
+        ++idleThreads_;
+        const bool woken = cv_.wait_for(l, IDLE_TIMEOUT, [this]{
+            return not running_ or hasRunnable();
         });
+        --idleThreads_;
+        if (not running_)
+            break;
+        if (not woken and activeThreads_ > 1) {
+            worker.active = false;
+            --activeThreads_;
+            break;
+        }
     }
+}
 
-    // push task to queue
-    tasks_.emplace(std::move(cb));
+void
+ThreadPool::execute(Entry& entry, unsigned priority)
+{
+    auto& c = counters_[priority];
+    const auto start = clock::now();
+    const uint64_t wait = std::chrono::duration_cast<std::chrono::microseconds>(start - entry.queued).count();
+    c.waitTotal.fetch_add(wait, std::memory_order_relaxed);
+    Counters::updateMax(c.waitMax, wait);
 
-    // notify thread
-    l.unlock();
-    cv_.notify_one();
+    if (priority == LOW)
+        ++lowRunning_;
+    try {
+        if (entry.task)
+            entry.task();
+    } catch (const std::exception& e) {
+        RING_ERR("Exception running task: %s", e.what());
+    }
+    entry.task.reset();
+    if (priority == LOW)
+        --lowRunning_;
+
+    const uint64_t run = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    c.runTotal.fetch_add(run, std::memory_order_relaxed);
+    Counters::updateMax(c.runMax, run);
+    c.executed.fetch_add(1, std::memory_order_relaxed);
 }
 
 void
 ThreadPool::join()
 {
-    for (auto& t : threads_)
-        t->run = false;
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        running_ = false;
+    }
     cv_.notify_all();
-    for (auto& t : threads_)
-        t->thread.join();
-    threads_.clear();
+    for (auto& w : workers_)
+        if (w->thread.joinable())
+            w->thread.join();
+
+    std::lock_guard<std::mutex> l(lock_);
+    for (auto& w : workers_) {
+        w->clear();
+        w->active = false;
+    }
+    for (auto& p : pending_)
+        p = 0;
+    activeThreads_ = 0;
+    running_ = true;
+}
+
+ThreadPool::Stats
+ThreadPool::getStats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        stats.threads = activeThreads_;
+        stats.idleThreads = idleThreads_;
+    }
+    for (unsigned p = 0; p < PRIORITY_COUNT; ++p) {
+        auto& s = stats.priority[p];
+        const auto& c = counters_[p];
+        s.queued = pending_[p].load(std::memory_order_relaxed);
+        s.executed = c.executed.load(std::memory_order_relaxed);
+        s.waitTotalUs = c.waitTotal.load(std::memory_order_relaxed);
+        s.waitMaxUs = c.waitMax.load(std::memory_order_relaxed);
+        s.runTotalUs = c.runTotal.load(std::memory_order_relaxed);
+        s.runMaxUs = c.runMax.load(std::memory_order_relaxed);
+    }
+    stats.stolen = stolen_.load(std::memory_order_relaxed);
+    stats.overflowed = overflowed_.load(std::memory_order_relaxed);
+    return stats;
 }
 
 }
@@ -21,14 +21,161 @@
 
 #include <condition_variable>
 #include <vector>
-#include <queue>
 #include <future>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
 
 namespace ring {
 
+/**
+ * Move-only callable taking no argument.
+ * Callables fitting in INLINE_SIZE bytes are stored in place, without
+ * heap allocation.
+ */
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    Task() noexcept {}
+
+    template<class Cb, class F = typename std::decay<Cb>::type,
+             class = typename std::enable_if<not std::is_same<F, Task>::value>::type>
+    Task(Cb&& cb) {
+        init<F>(std::forward<Cb>(cb), std::integral_constant<bool, fitsInline<F>()>{});
+    }
+
+    Task(Task&& o) noexcept { moveFrom(o); }
+
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            reset();
+            moveFrom(o);
+        }
+        return *this;
+    }
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_; }
+
+    void operator()() { ops_->call(&storage_); }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    using Storage = std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type;
+
+    struct Ops {
+        void (*call)(void*);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<class F>
+    static constexpr bool fitsInline() {
+        return sizeof(F) <= sizeof(Storage)
+            and alignof(Storage) % alignof(F) == 0
+            and std::is_nothrow_move_constructible<F>::value;
+    }
+
+    template<class F>
+    struct InlineOps {
+        static void call(void* p) { (*static_cast<F*>(p))(); }
+        static void move(void* dst, void* src) noexcept {
+            new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void* p) noexcept { static_cast<F*>(p)->~F(); }
+        static constexpr Ops ops {&call, &move, &destroy};
+    };
+
+    template<class F>
+    struct HeapOps {
+        static void call(void* p) { (**static_cast<F**>(p))(); }
+        static void move(void* dst, void* src) noexcept {
+            *static_cast<F**>(dst) = *static_cast<F**>(src);
+        }
+        static void destroy(void* p) noexcept { delete *static_cast<F**>(p); }
+        static constexpr Ops ops {&call, &move, &destroy};
+    };
+
+    template<class F, class Cb>
+    void init(Cb&& cb, std::true_type) {
+        new (&storage_) F(std::forward<Cb>(cb));
+        ops_ = &InlineOps<F>::ops;
+    }
+
+    template<class F, class Cb>
+    void init(Cb&& cb, std::false_type) {
+        *reinterpret_cast<F**>(&storage_) = new F(std::forward<Cb>(cb));
+        ops_ = &HeapOps<F>::ops;
+    }
+
+    void moveFrom(Task& o) noexcept {
+        if ((ops_ = o.ops_)) {
+            ops_->move(&storage_, &o.storage_);
+            o.ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops* ops_ {nullptr};
+};
+
+template<class F> constexpr Task::Ops Task::InlineOps<F>::ops;
+template<class F> constexpr Task::Ops Task::HeapOps<F>::ops;
+
+/**
+ * Pool of worker threads, started on demand.
+ *
+ * Each worker has its own task queues and steals tasks from the other
+ * workers when idle. Tasks of a higher priority class are always taken
+ * first, and low priority tasks never occupy all the workers.
+ * Workers idle for a while are stopped.
+ */
 class ThreadPool {
 public:
+    enum class Priority : unsigned {
+        /** Default, for tasks on the critical path (e.g. call setup) */
+        NORMAL = 0,
+        /** Long or blocking background work: key generation, name lookups... */
+        LOW,
+        COUNT
+    };
+
+    struct Stats {
+        unsigned threads;
+        unsigned idleThreads;
+        struct {
+            /** Tasks waiting in queues */
+            uint64_t queued;
+            uint64_t executed;
+            /** Time spent by tasks waiting in queues */
+            uint64_t waitTotalUs;
+            uint64_t waitMaxUs;
+            uint64_t runTotalUs;
+            uint64_t runMaxUs;
+        } priority[static_cast<unsigned>(Priority::COUNT)];
+        /** Tasks taken from the queue of another worker */
+        uint64_t stolen;
+        /** Tasks run by the caller because all queues were full */
+        uint64_t overflowed;
+    };
+
     static ThreadPool& instance() {
         static ThreadPool pool;
         return pool;
@@ -37,32 +184,61 @@ public:
     ThreadPool();
     ~ThreadPool();
 
-    void run(std::function<void()>&& cb);
+    void run(Task&& task, Priority priority = Priority::NORMAL);
 
-    template<class T>
-    std::future<T> get(std::function<T()>&& cb) {
-        auto ret = std::make_shared<std::promise<T>>();
-        run(std::bind([=](std::function<T()>& mcb) mutable {
-                ret->set_value(mcb());
-            }, std::move(cb)));
-        return ret->get_future();
+    template<class T, class Cb>
+    std::future<T> get(Cb&& cb, Priority priority = Priority::NORMAL) {
+        std::packaged_task<T()> task(std::forward<Cb>(cb));
+        auto ret = task.get_future();
+        run(std::move(task), priority);
+        return ret;
     }
-    template<class T>
-    std::shared_ptr<std::future<T>> getShared(std::function<T()>&& cb) {
-        return std::make_shared<std::future<T>>(get(std::move(cb)));
+    template<class T, class Cb>
+    std::shared_ptr<std::future<T>> getShared(Cb&& cb, Priority priority = Priority::NORMAL) {
+        return std::make_shared<std::future<T>>(get<T>(std::forward<Cb>(cb), priority));
     }
 
+    /**
+     * Stop all the workers, pending tasks are dropped.
+     * The pool restarts on the next run().
+     */
     void join();
 
+    Stats getStats() const;
+
 private:
-    struct ThreadState;
-    std::queue<std::function<void()>> tasks_ {};
-    std::vector<std::unique_ptr<ThreadState>> threads_;
-    unsigned readyThreads_ {0};
-    std::mutex lock_ {};
-    std::condition_variable cv_ {};
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    struct Entry;
+    struct Worker;
+    struct Counters;
+
+    bool push(Entry&& entry, unsigned priority);
+    bool pop(unsigned self, Entry& entry, unsigned& priority);
+    bool hasRunnable() const;
+    void startWorker();
+    void workerLoop(unsigned self);
+    void execute(Entry& entry, unsigned priority);
 
     const unsigned maxThreads_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<Counters[]> counters_;
+
+    /* Protects the worker threads life cycle */
+    mutable std::mutex lock_ {};
+    std::condition_variable cv_ {};
+    bool running_ {true};
+    unsigned activeThreads_ {0};
+    unsigned idleThreads_ {0};
+
+    /** Tasks pushed and not yet taken, by priority */
+    std::atomic<unsigned> pending_[static_cast<unsigned>(Priority::COUNT)];
+    /** Workers running a LOW priority task */
+    std::atomic<unsigned> lowRunning_ {0};
+    std::atomic<unsigned> nextQueue_ {0};
+    std::atomic<uint64_t> stolen_ {0};
+    std::atomic<uint64_t> overflowed_ {0};
 };
 
 }
@@ -0,0 +1,221 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include "im/message_engine.h"
+#include "sip/sipaccountbase.h"
+#include "manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Sends messages through an account that never reaches anyone, and reloads
+ * them from the journal. Main thread tasks are run by polling the manager.
+ */
+
+namespace ring_test {
+
+using ring::im::MessageEngine;
+using ring::im::MessageStatus;
+using ring::im::MessageToken;
+
+static const std::string PATH {"test_message_engine.messages"};
+static const std::string JOURNAL_PATH {PATH + ".journal"};
+static constexpr std::chrono::milliseconds RETRY_PERIOD {50};
+/** MessageEngine::MAX_RETRIES */
+static constexpr unsigned MAX_RETRIES {3};
+
+/** Account owning the engine under test, so its tasks are bound to the account */
+class TestAccount : public ring::SIPAccountBase {
+public:
+    TestAccount() : SIPAccountBase("test"), engine(*this, PATH, RETRY_PERIOD) {}
+
+    const char* getAccountType() const override { return "TEST"; }
+    void loadConfig() override {}
+    void doRegister() override {}
+    void doUnregister(std::function<void(bool)>) override {}
+    std::shared_ptr<ring::Call> newOutgoingCall(const std::string&) override { return {}; }
+    std::shared_ptr<ring::SIPCall> newIncomingCall(const std::string&) override { return {}; }
+    ring::sip_utils::KeyExchangeProtocol getSrtpKeyExchange() const override {
+        return ring::sip_utils::KeyExchangeProtocol::NONE;
+    }
+    bool getSrtpFallback() const override { return false; }
+    pj_str_t getContactHeader(pjsip_transport*) override { return {}; }
+    std::string getToUri(const std::string& username) const override { return username; }
+    ring::MatchRank matches(const std::string&, const std::string&) const override {
+        return ring::MatchRank::NONE;
+    }
+
+    void sendTextMessage(const std::string&, const std::map<std::string, std::string>&,
+                         uint64_t id) override {
+        sent.emplace_back(id);
+    }
+
+    MessageEngine engine;
+    /** Tokens, in sending order */
+    std::vector<MessageToken> sent;
+};
+
+/** State of a message, as persisted */
+struct MessageState {
+    MessageStatus status;
+    unsigned retried;
+
+    bool operator==(const MessageState& o) const {
+        return status == o.status and retried == o.retried;
+    }
+};
+
+static MessageState
+getState(const MessageEngine& engine, MessageToken token)
+{
+    return {engine.getStatus(token), engine.getRetried(token)};
+}
+
+static std::vector<MessageToken>
+sorted(std::vector<MessageToken> tokens)
+{
+    std::sort(tokens.begin(), tokens.end());
+    return tokens;
+}
+
+/** Run main thread tasks until the message is sent again */
+static bool
+waitSending(TestAccount& account, MessageToken token)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    do {
+        ring::Manager::instance().pollEvents();
+        if (account.engine.getStatus(token) == MessageStatus::SENDING)
+            return true;
+        std::this_thread::sleep_for(RETRY_PERIOD / 5);
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+class MessageEngineTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "message_engine"; }
+
+    void setUp() { removeFiles(); }
+    void tearDown() { removeFiles(); }
+
+private:
+    static void removeFiles() {
+        std::remove(PATH.c_str());
+        std::remove(JOURNAL_PATH.c_str());
+    }
+
+    void testSendRetryReload();
+
+    CPPUNIT_TEST_SUITE(MessageEngineTest);
+    CPPUNIT_TEST(testSendRetryReload);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(MessageEngineTest, MessageEngineTest::name());
+
+void
+MessageEngineTest::testSendRetryReload()
+{
+    auto account = std::make_shared<TestAccount>();
+    auto& engine = account->engine;
+    engine.load();
+
+    CPPUNIT_ASSERT_EQUAL(MessageToken(0), engine.sendMessage("", {{"text/plain", "empty"}}));
+    const auto sent = engine.sendMessage("alice", {{"text/plain", "sent"}});
+    const auto failed = engine.sendMessage("bob", {{"text/plain", "failed"}});
+    const auto idle = engine.sendMessage("carol", {{"text/plain", "idle"}});
+    const auto sending = engine.sendMessage("dave", {{"text/plain", "sending"}});
+    CPPUNIT_ASSERT(sent and failed and idle and sending);
+    CPPUNIT_ASSERT(engine.getStatus(sent) == MessageStatus::UNKNOWN);
+
+    // Sent from the main thread
+    ring::Manager::instance().pollEvents();
+    CPPUNIT_ASSERT_EQUAL(size_t(4), account->sent.size());
+    for (const auto token : {sent, failed, idle, sending})
+        CPPUNIT_ASSERT(getState(engine, token) == (MessageState {MessageStatus::SENDING, 1}));
+    CPPUNIT_ASSERT(engine.getRetryQueue().empty());
+
+    engine.onMessageSent(sent, true);
+    CPPUNIT_ASSERT(getState(engine, sent) == (MessageState {MessageStatus::SENT, 1}));
+    // Only messages being sent change
+    engine.onMessageSent(sent, false);
+    CPPUNIT_ASSERT(engine.getStatus(sent) == MessageStatus::SENT);
+
+    // Sent again after the retry period, until it fails for good
+    for (unsigned i = 1; i < MAX_RETRIES; ++i) {
+        engine.onMessageSent(failed, false);
+        CPPUNIT_ASSERT(getState(engine, failed) == (MessageState {MessageStatus::IDLE, i}));
+        CPPUNIT_ASSERT(engine.getRetryQueue() == std::vector<MessageToken> {failed});
+        CPPUNIT_ASSERT(waitSending(*account, failed));
+        CPPUNIT_ASSERT_EQUAL(i + 1, engine.getRetried(failed));
+        CPPUNIT_ASSERT_EQUAL(failed, account->sent.back());
+    }
+    engine.onMessageSent(failed, false);
+    CPPUNIT_ASSERT(getState(engine, failed) == (MessageState {MessageStatus::FAILURE, MAX_RETRIES}));
+    CPPUNIT_ASSERT(engine.getRetryQueue().empty());
+
+    engine.onMessageSent(idle, false);
+    CPPUNIT_ASSERT(getState(engine, idle) == (MessageState {MessageStatus::IDLE, 1}));
+
+    std::map<MessageToken, MessageState> states;
+    for (const auto token : {sent, failed, idle})
+        states.emplace(token, getState(engine, token));
+    CPPUNIT_ASSERT(engine.getRetryQueue() == std::vector<MessageToken> {idle});
+
+    // Pending tasks of the engine are dropped with the account
+    account.reset();
+    account = std::make_shared<TestAccount>();
+    auto& reloaded = account->engine;
+    reloaded.load();
+
+    for (const auto& s : states)
+        CPPUNIT_ASSERT(getState(reloaded, s.first) == s.second);
+    // A message being sent is sent again
+    CPPUNIT_ASSERT(getState(reloaded, sending) == (MessageState {MessageStatus::IDLE, 1}));
+    // Retry times are persisted to the second, the order of close ones may change
+    CPPUNIT_ASSERT(sorted(reloaded.getRetryQueue()) == sorted({idle, sending}));
+
+    CPPUNIT_ASSERT(waitSending(*account, idle));
+    CPPUNIT_ASSERT(waitSending(*account, sending));
+    CPPUNIT_ASSERT(sorted(account->sent) == sorted({idle, sending}));
+    CPPUNIT_ASSERT_EQUAL(2u, reloaded.getRetried(idle));
+}
+
+} // namespace ring_test
+
+int main()
+{
+    CppUnit::TextUi::TestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry(ring_test::MessageEngineTest::name()).makeTest());
+    return runner.run() ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include "im/message_journal.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Reads back journals as left by an interrupted append or a disk error.
+ */
+
+namespace ring_test {
+
+using ring::im::MessageJournal;
+
+static const std::string PATH {"test_message_journal.journal"};
+
+static std::vector<std::string>
+replay(const MessageJournal& journal)
+{
+    std::vector<std::string> records;
+    CPPUNIT_ASSERT_EQUAL(journal.replay([&](const std::string& r) { records.emplace_back(r); }),
+                         records.size());
+    return records;
+}
+
+static std::string
+readFile()
+{
+    std::ifstream file(PATH, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static void
+writeFile(const std::string& content)
+{
+    std::ofstream file(PATH, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+class MessageJournalTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "message_journal"; }
+
+    void setUp() { std::remove(PATH.c_str()); }
+    void tearDown() { std::remove(PATH.c_str()); }
+
+private:
+    void testTruncatedRecord();
+    void testCorruptedRecord();
+    void testCompactAppend();
+
+    CPPUNIT_TEST_SUITE(MessageJournalTest);
+    CPPUNIT_TEST(testTruncatedRecord);
+    CPPUNIT_TEST(testCorruptedRecord);
+    CPPUNIT_TEST(testCompactAppend);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(MessageJournalTest, MessageJournalTest::name());
+
+void
+MessageJournalTest::testTruncatedRecord()
+{
+    {
+        MessageJournal journal(PATH);
+        CPPUNIT_ASSERT(replay(journal).empty());
+        CPPUNIT_ASSERT(journal.compact({}));
+        CPPUNIT_ASSERT(journal.append("first"));
+        CPPUNIT_ASSERT(journal.append("second"));
+        CPPUNIT_ASSERT(journal.append("third"));
+    }
+    const auto content = readFile();
+
+    // Interrupted in the middle of the last record, then before its line break
+    for (const size_t cut : {size_t(4), size_t(1)}) {
+        writeFile(content.substr(0, content.size() - cut));
+        MessageJournal journal(PATH);
+        const auto records = replay(journal);
+        CPPUNIT_ASSERT_EQUAL(size_t(2), records.size());
+        CPPUNIT_ASSERT_EQUAL(std::string("first"), records[0]);
+        CPPUNIT_ASSERT_EQUAL(std::string("second"), records[1]);
+    }
+
+    writeFile(content);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), replay(MessageJournal(PATH)).size());
+}
+
+void
+MessageJournalTest::testCorruptedRecord()
+{
+    {
+        MessageJournal journal(PATH);
+        CPPUNIT_ASSERT(journal.compact({"first", "second"}));
+        CPPUNIT_ASSERT(journal.append("third"));
+    }
+    auto content = readFile();
+
+    // A flipped bit in the second record: the rest of the file is ignored
+    const auto pos = content.find("second");
+    CPPUNIT_ASSERT(pos != std::string::npos);
+    content[pos] ^= 0x01;
+    writeFile(content);
+    auto records = replay(MessageJournal(PATH));
+    CPPUNIT_ASSERT_EQUAL(size_t(1), records.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("first"), records[0]);
+
+    // Same for a broken checksum
+    content[pos] ^= 0x01;
+    content[0] = content[0] == '0' ? '1' : '0';
+    writeFile(content);
+    CPPUNIT_ASSERT(replay(MessageJournal(PATH)).empty());
+
+    // And for a record without checksum
+    writeFile("first\n");
+    CPPUNIT_ASSERT(replay(MessageJournal(PATH)).empty());
+}
+
+void
+MessageJournalTest::testCompactAppend()
+{
+    MessageJournal journal(PATH);
+    CPPUNIT_ASSERT(not journal.isOpen());
+    CPPUNIT_ASSERT(not journal.append("lost"));
+
+    CPPUNIT_ASSERT(journal.compact({}));
+    CPPUNIT_ASSERT(journal.isOpen());
+    for (unsigned i = 0; i < 5; ++i)
+        CPPUNIT_ASSERT(journal.append("record " + std::to_string(i)));
+    CPPUNIT_ASSERT_EQUAL(size_t(5), journal.size());
+
+    // Compaction replaces the records, appends go after them
+    CPPUNIT_ASSERT(journal.compact({"a", "b"}));
+    CPPUNIT_ASSERT_EQUAL(size_t(2), journal.size());
+    CPPUNIT_ASSERT(journal.append("c"));
+    journal.sync();
+    CPPUNIT_ASSERT_EQUAL(size_t(3), journal.size());
+
+    const auto records = replay(journal);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), records.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("a"), records[0]);
+    CPPUNIT_ASSERT_EQUAL(std::string("b"), records[1]);
+    CPPUNIT_ASSERT_EQUAL(std::string("c"), records[2]);
+
+    // Records may hold any character but line breaks
+    const std::string record {"{\"to\":\"\\u00e9 \\t|\"}"};
+    CPPUNIT_ASSERT(journal.compact({record}));
+    CPPUNIT_ASSERT_EQUAL(record, replay(MessageJournal(PATH)).at(0));
+}
+
+} // namespace ring_test
+
+int main()
+{
+    CppUnit::TextUi::TestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry(ring_test::MessageJournalTest::name()).makeTest());
+    return runner.run() ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include "media/rtp_jitter_buffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+/*
+ * Replays packet traces through the jitter buffer.
+ *
+ * A trace has one packet per line, as exported from a capture:
+ *     <arrival time in us> <sequence number> <timestamp> [<ssrc>]
+ * Lines starting with '#' are ignored.
+ * Set RING_JITTER_TRACE to the path of a trace to replay it and print
+ * the buffer statistics.
+ */
+
+namespace ring_test {
+
+using ring::RtpJitterBuffer;
+using clock = RtpJitterBuffer::clock;
+
+static constexpr unsigned CLOCK_RATE {8000};
+static constexpr unsigned FRAME_MS {20};
+static constexpr unsigned FRAME_TS {CLOCK_RATE * FRAME_MS / 1000};
+static constexpr size_t RTP_HEADER_SIZE {12};
+static constexpr size_t PAYLOAD_SIZE {160};
+
+struct TracePacket {
+    int64_t arrivalUs;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+};
+
+using Trace = std::vector<TracePacket>;
+
+static Trace
+loadTrace(std::istream& is)
+{
+    Trace trace;
+    std::string line;
+    while (std::getline(is, line)) {
+        if (line.empty() or line[0] == '#')
+            continue;
+        std::istringstream ls(line);
+        TracePacket p {0, 0, 0, 0x1234};
+        ls >> p.arrivalUs >> p.seq >> p.timestamp >> p.ssrc;
+        trace.emplace_back(p);
+    }
+    std::stable_sort(trace.begin(), trace.end(), [](const TracePacket& a, const TracePacket& b) {
+        return a.arrivalUs < b.arrivalUs;
+    });
+    return trace;
+}
+
+/**
+ * Packets sent every FRAME_MS, lost with lossRate probability (except the
+ * last ones) and delayed by up to maxJitterMs, in arrival order.
+ */
+static Trace
+makeTrace(unsigned count, double lossRate, unsigned maxJitterMs, unsigned seed = 42)
+{
+    std::mt19937 rand(seed);
+    std::bernoulli_distribution lost(lossRate);
+    std::uniform_int_distribution<int64_t> jitter(0, maxJitterMs * 1000);
+    Trace trace;
+    for (unsigned i = 0; i < count; ++i) {
+        if (i > 0 and i < count - 10 and lost(rand))
+            continue;
+        trace.push_back({int64_t(i) * FRAME_MS * 1000 + jitter(rand),
+                         static_cast<uint16_t>(60000 + i),
+                         static_cast<uint32_t>(i * FRAME_TS),
+                         0x1234});
+    }
+    std::stable_sort(trace.begin(), trace.end(), [](const TracePacket& a, const TracePacket& b) {
+        return a.arrivalUs < b.arrivalUs;
+    });
+    return trace;
+}
+
+struct ReplayResult {
+    RtpJitterBuffer::Stats stats;
+    std::vector<uint16_t> played;
+    /** Played packets not following the previous one */
+    unsigned misordered;
+};
+
+static ReplayResult
+replay(const Trace& trace, RtpJitterBuffer& jb)
+{
+    ReplayResult res {};
+    if (trace.empty())
+        return res;
+
+    const auto start = clock::time_point() + std::chrono::hours(1);
+    const auto end = trace.back().arrivalUs + 1000000;
+    uint8_t buf[RTP_HEADER_SIZE + PAYLOAD_SIZE] {};
+    RtpJitterBuffer::Packet pkt;
+    size_t next = 0;
+    uint32_t lastTimestamp = 0;
+
+    // Time advances by 1 ms, like a receiving thread waking up
+    for (int64_t nowUs = trace.front().arrivalUs; nowUs <= end; nowUs += 1000) {
+        const auto now = start + std::chrono::microseconds(nowUs);
+        for (; next < trace.size() and trace[next].arrivalUs <= nowUs; ++next) {
+            const auto& p = trace[next];
+            buf[0] = 0x80;
+            buf[1] = 0;
+            buf[2] = p.seq >> 8;
+            buf[3] = p.seq;
+            buf[4] = p.timestamp >> 24;
+            buf[5] = p.timestamp >> 16;
+            buf[6] = p.timestamp >> 8;
+            buf[7] = p.timestamp;
+            buf[8] = p.ssrc >> 24;
+            buf[9] = p.ssrc >> 16;
+            buf[10] = p.ssrc >> 8;
+            buf[11] = p.ssrc;
+            jb.push(buf, sizeof(buf), start + std::chrono::microseconds(p.arrivalUs));
+        }
+        RtpJitterBuffer::Status status;
+        while ((status = jb.pop(pkt, now)) != RtpJitterBuffer::Status::Empty) {
+            if (status != RtpJitterBuffer::Status::Packet)
+                continue;
+            CPPUNIT_ASSERT_EQUAL(PAYLOAD_SIZE, pkt.payload.size());
+            if (not res.played.empty() and pkt.timestamp <= lastTimestamp)
+                ++res.misordered;
+            lastTimestamp = pkt.timestamp;
+            res.played.push_back(pkt.seq);
+        }
+    }
+    res.stats = jb.getStats();
+    return res;
+}
+
+static void
+printStats(const std::string& name, const RtpJitterBuffer::Stats& s)
+{
+    std::cout << std::endl << name << ": received " << s.received
+              << ", played " << s.played << ", lost " << s.lost
+              << ", late " << s.late << ", reordered " << s.reordered
+              << ", duplicated " << s.duplicated << ", expanded " << s.expanded
+              << ", accelerated " << s.accelerated << ", jitter " << s.jitterUs / 1000.
+              << " ms, delay " << s.delayUs / 1000. << " ms (target "
+              << s.targetDelayUs / 1000. << " ms)" << std::endl;
+}
+
+class JitterBufferTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "jitter_buffer"; }
+
+private:
+    void testInOrder();
+    void testReorder();
+    void testLoss();
+    void testJitter();
+    void testResync();
+    void testTraceFile();
+
+    CPPUNIT_TEST_SUITE(JitterBufferTest);
+    CPPUNIT_TEST(testInOrder);
+    CPPUNIT_TEST(testReorder);
+    CPPUNIT_TEST(testLoss);
+    CPPUNIT_TEST(testJitter);
+    CPPUNIT_TEST(testResync);
+    CPPUNIT_TEST(testTraceFile);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(JitterBufferTest, JitterBufferTest::name());
+
+void
+JitterBufferTest::testInOrder()
+{
+    RtpJitterBuffer jb(CLOCK_RATE);
+    const auto res = replay(makeTrace(500, 0, 0), jb);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(500), res.stats.played);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), res.stats.lost);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), res.stats.late);
+    CPPUNIT_ASSERT_EQUAL(0u, res.misordered);
+}
+
+void
+JitterBufferTest::testReorder()
+{
+    std::istringstream is(
+        "# swapped, duplicated and wrapping sequence numbers\n"
+        "0      65533 0\n"
+        "20000  65534 160\n"
+        "45000  0     480\n"
+        "46000  65535 320\n"
+        "60000  1     640\n"
+        "61000  1     640\n"
+        "80000  2     800\n"
+        "100000 4     1120\n"
+        "101000 3     960\n"
+        "120000 5     1280\n");
+    RtpJitterBuffer jb(CLOCK_RATE);
+    const auto res = replay(loadTrace(is), jb);
+    printStats("reorder", res.stats);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(9), res.stats.played);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), res.stats.lost);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(2), res.stats.reordered);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1), res.stats.duplicated);
+    CPPUNIT_ASSERT_EQUAL(0u, res.misordered);
+}
+
+void
+JitterBufferTest::testLoss()
+{
+    const unsigned count = 2000;
+    const auto trace = makeTrace(count, 0.05, 0);
+    RtpJitterBuffer jb(CLOCK_RATE);
+    const auto res = replay(trace, jb);
+    printStats("5% loss", res.stats);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(trace.size()), res.stats.played + res.stats.accelerated);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(count - trace.size()), res.stats.lost);
+    CPPUNIT_ASSERT_EQUAL(0u, res.misordered);
+}
+
+void
+JitterBufferTest::testJitter()
+{
+    const unsigned count = 3000;
+    const auto trace = makeTrace(count, 0, 60);
+    RtpJitterBuffer jb(CLOCK_RATE);
+    const auto res = replay(trace, jb);
+    printStats("60 ms jitter", res.stats);
+    // The delay adapts: few packets are late, with a bounded latency
+    CPPUNIT_ASSERT(res.stats.late < count / 50);
+    CPPUNIT_ASSERT(res.stats.targetDelayUs >= 40000);
+    CPPUNIT_ASSERT(res.stats.delayUs <= 150000);
+    CPPUNIT_ASSERT(res.stats.reordered > 0);
+    CPPUNIT_ASSERT_EQUAL(0u, res.misordered);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(count),
+                         res.stats.played + res.stats.late + res.stats.accelerated);
+}
+
+void
+JitterBufferTest::testResync()
+{
+    auto trace = makeTrace(200, 0, 0);
+    // The sender restarts with a new SSRC and sequence
+    for (size_t i = 100; i < trace.size(); ++i) {
+        trace[i].ssrc = 0x5678;
+        trace[i].seq += 12345;
+        trace[i].timestamp += 1000000;
+    }
+    RtpJitterBuffer jb(CLOCK_RATE);
+    const auto res = replay(trace, jb);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1), res.stats.resyncs);
+    CPPUNIT_ASSERT(res.stats.played >= 195);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), res.stats.lost);
+}
+
+void
+JitterBufferTest::testTraceFile()
+{
+    const char* path = getenv("RING_JITTER_TRACE");
+    if (not path)
+        return;
+    std::ifstream file(path);
+    CPPUNIT_ASSERT(file.good());
+    RtpJitterBuffer jb(CLOCK_RATE);
+    const auto res = replay(loadTrace(file), jb);
+    printStats(path, res.stats);
+    CPPUNIT_ASSERT_EQUAL(0u, res.misordered);
+}
+
+} // namespace ring_test
+
+int main()
+{
+    CppUnit::TextUi::TestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry(ring_test::JitterBufferTest::name()).makeTest());
+    return runner.run() ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include "media/audio/ringbuffer.h"
+#include "media/audio/lockfree_ringbuffer.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+/*
+ * Runs RingBuffer and LockFreeRingBuffer on the same operations: they
+ * must give the same lengths and the same data.
+ */
+
+namespace ring_test {
+
+using ring::AudioBuffer;
+using ring::AudioFormat;
+using ring::AudioSample;
+using ring::LockFreeRingBuffer;
+using ring::RingBuffer;
+
+static constexpr size_t SIZE {1024};
+static const std::string READER {"call"};
+
+/** Stereo frames numbered from first, the right channel negated */
+static AudioBuffer
+makeFrames(size_t count, unsigned first)
+{
+    AudioBuffer buf(count, AudioFormat::STEREO());
+    for (size_t i = 0; i < count; ++i) {
+        buf.getChannel(0)[i] = static_cast<AudioSample>(first + i);
+        buf.getChannel(1)[i] = -static_cast<AudioSample>(first + i);
+    }
+    return buf;
+}
+
+struct Pair {
+    RingBuffer locked {"locked", SIZE, AudioFormat::STEREO()};
+    LockFreeRingBuffer lockFree {"lockfree", SIZE, AudioFormat::STEREO()};
+
+    Pair() {
+        locked.createReadOffset(READER);
+        lockFree.createReadOffset(READER);
+    }
+
+    void put(AudioBuffer& buf) {
+        locked.put(buf);
+        lockFree.put(buf);
+        checkLength();
+    }
+
+    void get(size_t count) {
+        AudioBuffer a(count, AudioFormat::STEREO());
+        AudioBuffer b(count, AudioFormat::STEREO());
+        const auto na = locked.get(a, READER);
+        const auto nb = lockFree.get(b, READER);
+        CPPUNIT_ASSERT_EQUAL(na, nb);
+        for (unsigned c = 0; c < 2; ++c)
+            for (size_t i = 0; i < na; ++i)
+                CPPUNIT_ASSERT_EQUAL(a.getChannel(c)[i], b.getChannel(c)[i]);
+        checkLength();
+    }
+
+    void discard(size_t count) {
+        CPPUNIT_ASSERT_EQUAL(locked.discard(count, READER), lockFree.discard(count, READER));
+        checkLength();
+    }
+
+    void flush() {
+        locked.flush(READER);
+        lockFree.flush(READER);
+        checkLength();
+    }
+
+    void checkLength() {
+        CPPUNIT_ASSERT_EQUAL(locked.availableForGet(READER), lockFree.availableForGet(READER));
+    }
+};
+
+class RingBufferTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "ringbuffer"; }
+
+private:
+    void testOverrun();
+    void testSameOperations();
+    void testConcurrentReader();
+
+    CPPUNIT_TEST_SUITE(RingBufferTest);
+    CPPUNIT_TEST(testOverrun);
+    CPPUNIT_TEST(testSameOperations);
+    CPPUNIT_TEST(testConcurrentReader);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(RingBufferTest, RingBufferTest::name());
+
+void
+RingBufferTest::testOverrun()
+{
+    Pair p;
+    unsigned next = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        auto buf = makeFrames(160, next);
+        next += 160;
+        p.put(buf);
+        // The 7th write overruns the reader: all its data is dropped
+        CPPUNIT_ASSERT_EQUAL(i == 6 ? size_t(0) : (i < 6 ? 160 * (i + 1) : 160),
+                             p.lockFree.availableForGet(READER));
+    }
+    p.get(200);
+    p.get(200);
+}
+
+void
+RingBufferTest::testSameOperations()
+{
+    std::mt19937 rand(42);
+    std::uniform_int_distribution<size_t> count(1, 480);
+    std::uniform_int_distribution<unsigned> op(0, 19);
+
+    Pair p;
+    unsigned next = 0;
+    for (unsigned i = 0; i < 20000; ++i) {
+        const auto o = op(rand);
+        if (o < 9) {
+            auto buf = makeFrames(count(rand), next);
+            next += buf.frames();
+            p.put(buf);
+        } else if (o < 18) {
+            p.get(count(rand));
+        } else if (o < 19) {
+            p.discard(count(rand));
+        } else {
+            p.flush();
+        }
+    }
+}
+
+void
+RingBufferTest::testConcurrentReader()
+{
+    LockFreeRingBuffer rb {"lockfree", SIZE, AudioFormat::STEREO()};
+    rb.createReadOffset(READER);
+    const auto reader = rb.getReaderHandle(READER);
+    CPPUNIT_ASSERT(reader != LockFreeRingBuffer::INVALID_READER);
+
+    static constexpr unsigned FRAMES {200000};
+    std::atomic<bool> done {false};
+    std::thread writer([&] {
+        for (unsigned next = 0; next < FRAMES; next += 160) {
+            auto buf = makeFrames(160, next % 28800);
+            rb.put(buf);
+            if (next % 1600 == 0)
+                std::this_thread::yield();
+        }
+        done = true;
+    });
+
+    // Frames may be dropped on overrun, but never torn nor reordered
+    AudioBuffer buf(100, AudioFormat::STEREO());
+    size_t received = 0;
+    bool failed = false;
+    while (not done or rb.getLength(reader)) {
+        const auto n = rb.get(buf, reader);
+        for (size_t i = 1; i < n; ++i) {
+            const auto prev = buf.getChannel(0)[i - 1];
+            const auto cur = buf.getChannel(0)[i];
+            failed |= cur != prev + 1 and not (prev % 160 == 159 and cur % 160 == 0);
+            failed |= buf.getChannel(1)[i] != -cur;
+        }
+        received += n;
+    }
+    writer.join();
+    CPPUNIT_ASSERT(not failed);
+    CPPUNIT_ASSERT(received > 0);
+}
+
+} // namespace ring_test
+
+int main()
+{
+    CppUnit::TextUi::TestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry(ring_test::RingBufferTest::name()).makeTest());
+    return runner.run() ? 0 : 1;
+}
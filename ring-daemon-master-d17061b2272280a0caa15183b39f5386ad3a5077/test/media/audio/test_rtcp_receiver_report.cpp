@@ -0,0 +1,240 @@
+/*
+ *  Copyright (C) 2017 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include "media/rtcp_receiver_report.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Checks the receiver reports built from the jitter buffer counters.
+ */
+
+namespace ring_test {
+
+using ring::RtcpReceiverReport;
+using ring::RtpJitterBuffer;
+using clock = RtpJitterBuffer::clock;
+
+static constexpr unsigned CLOCK_RATE {8000};
+static constexpr unsigned FRAME_TS {160};
+static constexpr uint32_t SSRC {0x1234};
+static constexpr size_t RTP_SIZE {12 + 160};
+
+static uint32_t
+read32(const uint8_t* p)
+{
+    return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void
+write32(uint8_t* p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/** Push the index-th packet of a stream starting at firstSeq */
+static void
+push(RtpJitterBuffer& jb, uint16_t firstSeq, unsigned index, clock::time_point arrival)
+{
+    const uint16_t seq = firstSeq + index;
+    uint8_t buf[RTP_SIZE] {};
+    buf[0] = 0x80;
+    buf[2] = seq >> 8;
+    buf[3] = seq;
+    write32(buf + 4, index * FRAME_TS);
+    write32(buf + 8, SSRC);
+    jb.push(buf, sizeof(buf), arrival);
+}
+
+/** Report block fields of an RR + SDES packet */
+struct ReportBlock {
+    uint32_t ssrc;
+    uint32_t source;
+    uint8_t fractionLost;
+    uint32_t cumulativeLost;
+    uint32_t maxSeq;
+    uint32_t jitter;
+    uint32_t lsr;
+    uint32_t dlsr;
+};
+
+static ReportBlock
+parse(const std::vector<uint8_t>& pkt)
+{
+    CPPUNIT_ASSERT(pkt.size() >= 32 + 12);
+    CPPUNIT_ASSERT_EQUAL(0x81, int(pkt[0]));
+    CPPUNIT_ASSERT_EQUAL(201, int(pkt[1]));
+    CPPUNIT_ASSERT_EQUAL(7, (pkt[2] << 8) | pkt[3]);
+    const auto sdes = pkt.data() + 32;
+    CPPUNIT_ASSERT_EQUAL(202, int(sdes[1]));
+    CPPUNIT_ASSERT_EQUAL(pkt.size() - 32, size_t(4 * (((sdes[2] << 8) | sdes[3]) + 1)));
+    CPPUNIT_ASSERT_EQUAL(1, int(sdes[8]));
+    CPPUNIT_ASSERT_EQUAL(std::string("call"), std::string((const char*)sdes + 10, sdes[9]));
+    CPPUNIT_ASSERT_EQUAL(0, int(sdes[10 + sdes[9]]));
+
+    const auto p = pkt.data();
+    return {read32(p + 4), read32(p + 8), p[12], read32(p + 12) & 0xffffff,
+            read32(p + 16), read32(p + 20), read32(p + 24), read32(p + 28)};
+}
+
+static std::vector<uint8_t>
+build(RtcpReceiverReport& report, const RtpJitterBuffer& jb, clock::time_point now)
+{
+    RtpJitterBuffer::Reception reception;
+    CPPUNIT_ASSERT(jb.getReception(reception));
+    std::vector<uint8_t> pkt(512);
+    pkt.resize(report.build(reception, pkt.data(), pkt.size(), now));
+    return pkt;
+}
+
+class RtcpReceiverReportTest : public CppUnit::TestFixture {
+public:
+    static std::string name() { return "rtcp_receiver_report"; }
+
+private:
+    void testLoss();
+    void testSenderReport();
+    void testInterval();
+
+    CPPUNIT_TEST_SUITE(RtcpReceiverReportTest);
+    CPPUNIT_TEST(testLoss);
+    CPPUNIT_TEST(testSenderReport);
+    CPPUNIT_TEST(testInterval);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(RtcpReceiverReportTest, RtcpReceiverReportTest::name());
+
+void
+RtcpReceiverReportTest::testLoss()
+{
+    const auto start = clock::time_point() + std::chrono::hours(1);
+    RtpJitterBuffer jb(CLOCK_RATE);
+    RtcpReceiverReport report("call", start);
+
+    // 100 packets across the sequence number wrap, 1 in 10 lost
+    for (unsigned i = 0; i < 100; ++i)
+        if (i % 10 != 5)
+            push(jb, 65500, i, start + std::chrono::milliseconds(20 * i));
+    auto rr = parse(build(report, jb, start + std::chrono::seconds(2)));
+    CPPUNIT_ASSERT_EQUAL(SSRC + 1, rr.ssrc);
+    CPPUNIT_ASSERT_EQUAL(SSRC, rr.source);
+    CPPUNIT_ASSERT_EQUAL(10u, rr.cumulativeLost);
+    CPPUNIT_ASSERT_EQUAL(25, int(rr.fractionLost));
+    // One wrap of the sequence number
+    CPPUNIT_ASSERT_EQUAL((1u << 16) + (65500 + 99 - 65536), rr.maxSeq);
+    CPPUNIT_ASSERT_EQUAL(0u, rr.jitter);
+    CPPUNIT_ASSERT_EQUAL(0u, rr.lsr);
+    CPPUNIT_ASSERT_EQUAL(0u, rr.dlsr);
+
+    // No loss in the next interval, a duplicate compensates a loss
+    for (unsigned i = 100; i < 200; ++i)
+        push(jb, 65500, i, start + std::chrono::milliseconds(20 * i));
+    push(jb, 65500, 199, start + std::chrono::seconds(4));
+    rr = parse(build(report, jb, start + std::chrono::seconds(4)));
+    CPPUNIT_ASSERT_EQUAL(0, int(rr.fractionLost));
+    CPPUNIT_ASSERT_EQUAL(9u, rr.cumulativeLost);
+}
+
+void
+RtcpReceiverReportTest::testSenderReport()
+{
+    const auto start = clock::time_point() + std::chrono::hours(1);
+    RtpJitterBuffer jb(CLOCK_RATE);
+    RtcpReceiverReport report("call", start);
+    for (unsigned i = 0; i < 10; ++i)
+        push(jb, 0, i, start + std::chrono::milliseconds(20 * i));
+
+    // SR without report block followed by an SDES, like the libav muxer sends
+    std::vector<uint8_t> sr(28 + 12);
+    sr[0] = 0x80;
+    sr[1] = 200;
+    sr[3] = 6;
+    write32(&sr[4], SSRC);
+    write32(&sr[8], 0xdba4c2f1);
+    write32(&sr[12], 0x8000abcd);
+    sr[28] = 0x81;
+    sr[29] = 202;
+    sr[31] = 2;
+    report.onRtcp(sr.data(), sr.size(), start + std::chrono::milliseconds(500));
+
+    auto rr = parse(build(report, jb, start + std::chrono::seconds(2)));
+    CPPUNIT_ASSERT_EQUAL(0xc2f18000u, rr.lsr);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1.5 * 65536), rr.dlsr);
+
+    // Truncated packets are ignored
+    write32(&sr[12], 0x1234abcd);
+    report.onRtcp(sr.data(), 20, start + std::chrono::seconds(3));
+    rr = parse(build(report, jb, start + std::chrono::seconds(4)));
+    CPPUNIT_ASSERT_EQUAL(0xc2f18000u, rr.lsr);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3.5 * 65536), rr.dlsr);
+
+    // A report of another source is ignored
+    write32(&sr[4], SSRC + 7);
+    report.onRtcp(sr.data(), sr.size(), start + std::chrono::seconds(5));
+    rr = parse(build(report, jb, start + std::chrono::seconds(6)));
+    CPPUNIT_ASSERT_EQUAL(0u, rr.lsr);
+    CPPUNIT_ASSERT_EQUAL(0u, rr.dlsr);
+}
+
+void
+RtcpReceiverReportTest::testInterval()
+{
+    const auto start = clock::time_point() + std::chrono::hours(1);
+    RtpJitterBuffer jb(CLOCK_RATE);
+    RtcpReceiverReport report("call", start);
+    RtpJitterBuffer::Reception reception;
+    CPPUNIT_ASSERT(not jb.getReception(reception));
+    push(jb, 0, 0, start);
+
+    // First report after half the interval
+    CPPUNIT_ASSERT(not report.due(start + std::chrono::milliseconds(1249)));
+    CPPUNIT_ASSERT(report.due(start + std::chrono::milliseconds(3750)));
+
+    auto now = start + std::chrono::seconds(4);
+    for (unsigned i = 0; i < 20; ++i) {
+        CPPUNIT_ASSERT(not build(report, jb, now).empty());
+        CPPUNIT_ASSERT(not report.due(now + std::chrono::milliseconds(2499)));
+        CPPUNIT_ASSERT(report.due(now + std::chrono::milliseconds(7500)));
+        now += std::chrono::seconds(8);
+    }
+
+    // Too small
+    uint8_t buf[32];
+    CPPUNIT_ASSERT(jb.getReception(reception));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), report.build(reception, buf, sizeof(buf), now));
+}
+
+} // namespace ring_test
+
+int main()
+{
+    CppUnit::TextUi::TestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry(ring_test::RtcpReceiverReportTest::name()).makeTest());
+    return runner.run() ? 0 : 1;
+}